@@ -0,0 +1,104 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <time.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#include <chacha/chacha.h>
+#include <chacha-avx2/chacha-avx2.h>
+
+#define BENCH_MIN_NSEC	200000000ULL
+#define BENCH_MSG_MAX	65536
+
+static uint64_t _nsec(void) {
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static uint64_t _cycles(void) {
+#if defined(__x86_64__) || defined(__i386__)
+	return __rdtsc();
+#else
+	return 0;
+#endif
+}
+
+/* Returns cycles per byte and sets 'mbs' to MB/s */
+static double _run(unsigned char *out, const unsigned char *in, size_t len, const unsigned char *n, const unsigned char *k, double *mbs) {
+	uint64_t start = _nsec(), elapsed, cyc = _cycles(), bytes = 0;
+
+	do {
+		chacha_crypto_stream_xor(out, in, len, n, k);
+
+		bytes += len;
+	} while ((elapsed = _nsec() - start) < BENCH_MIN_NSEC);
+
+	cyc = _cycles() - cyc;
+	*mbs = (bytes / 1048576.0) / (elapsed / 1000000000.0);
+
+	return (double) cyc / bytes;
+}
+
+int main(int argc, char *argv[]) {
+	static const char *impls[] = { "ref", "sse2", "avx", "avx2", "avx512" };
+	static const size_t sizes[] = { 64, 256, 512, 1024, 1500, 4096, 16384, 65536 };
+	unsigned char *in = malloc(BENCH_MSG_MAX), *out = malloc(BENCH_MSG_MAX + 1), *ref = malloc(BENCH_MSG_MAX);
+	unsigned char n[CHACHA_CRYPTO_NONCEBYTES], k[CHACHA_CRYPTO_KEYBYTES];
+	unsigned int i, s, m;
+	double cpb[sizeof(impls) / sizeof(char *)], mbs[sizeof(impls) / sizeof(char *)];
+
+	srand(1);
+
+	for (i = 0; i < sizeof(n); i ++)
+		n[i] = rand();
+
+	for (i = 0; i < sizeof(k); i ++)
+		k[i] = rand();
+
+	for (i = 0; i < BENCH_MSG_MAX; i ++)
+		in[i] = rand();
+
+	printf("size impl cpb mbs speedup_vs_avx2\n");
+
+	for (s = 0; s < sizeof(sizes) / sizeof(size_t); s ++) {
+		chacha_avx2_crypto_stream_xor(ref, in, sizes[s], n, k);
+
+		for (m = 0; m < sizeof(impls) / sizeof(char *); m ++) {
+			cpb[m] = 0;
+
+			if (chacha_crypto_stream_set_impl(impls[m]) < 0)
+				continue;
+
+			/* Every kernel must produce the chacha-avx2 stream, on unaligned buffers too */
+			chacha_crypto_stream_xor(out + 1, in, sizes[s], n, k);
+
+			if (memcmp(ref, out + 1, sizes[s])) {
+				printf("Error #1: %s %zu\n", impls[m], sizes[s]);
+				return 1;
+			}
+
+			cpb[m] = _run(out, in, sizes[s], n, k, &mbs[m]);
+		}
+
+		/* Kernels not supported by this CPU are not reported */
+		for (m = 0; m < sizeof(impls) / sizeof(char *); m ++) {
+			if (cpb[m])
+				printf("%zu %s %.2f %.1f %.2f\n", sizes[s], impls[m], cpb[m], mbs[m], cpb[3] ? cpb[3] / cpb[m] : 0);
+		}
+	}
+
+	chacha_crypto_stream_set_impl(NULL);
+
+	free(in);
+	free(out);
+	free(ref);
+
+	return 0;
+}
@@ -0,0 +1,223 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <time.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#include <openssl/evp.h>
+
+#include <chacha/chacha.h>
+#include <nacl/crypto_onetimeauth.h>
+
+#define BENCH_MIN_NSEC	200000000ULL
+#define BENCH_MSG_MAX	65536
+#define BENCH_BATCH	64	/* Messages (connections) per batch */
+
+enum {
+	BENCH_TWO_PASS,
+	BENCH_AEAD,
+	BENCH_OPENSSL,
+	BENCH_MAX
+};
+
+static const char *bench_names[BENCH_MAX] = { "two-pass", "aead", "openssl" };
+
+static unsigned char key[CHACHA_CRYPTO_AEAD_KEYBYTES], nonce[CHACHA_CRYPTO_AEAD_NONCEBYTES];
+
+static uint64_t _nsec(void) {
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static uint64_t _cycles(void) {
+#if defined(__x86_64__) || defined(__i386__)
+	return __rdtsc();
+#else
+	return 0;
+#endif
+}
+
+/* Stream encryption followed by a second pass of Poly1305 over the ciphertext */
+static void _two_pass(unsigned char *out, unsigned char *tag, const unsigned char *in, size_t len) {
+	unsigned char otk[64];
+
+	memset(otk, 0, sizeof(otk));
+
+	chacha_crypto_stream_xor(otk, otk, sizeof(otk), nonce, key);
+	chacha_crypto_stream_xor_ic(out, in, len, nonce, 1, key);
+	crypto_onetimeauth(tag, out, len, otk);
+}
+
+static void _openssl(EVP_CIPHER_CTX *ctx, unsigned char *out, unsigned char *tag, const unsigned char *in, size_t len) {
+	int l;
+
+	EVP_EncryptInit_ex(ctx, NULL, NULL, NULL, nonce);
+	EVP_EncryptUpdate(ctx, out, &l, in, len);
+	EVP_EncryptFinal_ex(ctx, out + l, &l);
+	EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_AEAD_GET_TAG, 16, tag);
+}
+
+/* Returns cycles per byte and sets 'mbs' to MB/s */
+static double _run(int mode, EVP_CIPHER_CTX *ctx, unsigned char *out, const unsigned char *in, size_t len, double *mbs) {
+	uint64_t start = _nsec(), elapsed, cyc = _cycles(), bytes = 0;
+	unsigned char tag[16];
+
+	do {
+		if (mode == BENCH_TWO_PASS) {
+			_two_pass(out, tag, in, len);
+		} else if (mode == BENCH_AEAD) {
+			chacha_crypto_aead_encrypt(out, tag, in, len, NULL, 0, nonce, key);
+		} else {
+			_openssl(ctx, out, tag, in, len);
+		}
+
+		bytes += len;
+	} while ((elapsed = _nsec() - start) < BENCH_MIN_NSEC);
+
+	cyc = _cycles() - cyc;
+	*mbs = (bytes / 1048576.0) / (elapsed / 1000000000.0);
+
+	return (double) cyc / bytes;
+}
+
+/* Returns cycles per byte of 'n' messages, one per key, sealed one by one or as a batch */
+static double _run_batch(int batch, struct chacha_crypto_aead_job *jobs, unsigned int n) {
+	uint64_t start = _nsec(), cyc = _cycles(), bytes = 0;
+	unsigned int i;
+
+	do {
+		if (batch) {
+			chacha_crypto_aead_encrypt_batch(jobs, n);
+		} else {
+			for (i = 0; i < n; i ++)
+				chacha_crypto_aead_encrypt(jobs[i].out, jobs[i].tag, jobs[i].in, jobs[i].inlen, NULL, 0, jobs[i].n, jobs[i].k);
+		}
+
+		bytes += jobs[0].inlen * n;
+	} while ((_nsec() - start) < BENCH_MIN_NSEC);
+
+	return (double) (_cycles() - cyc) / bytes;
+}
+
+/* Many connections with a short message each: per-message calls vs a batch */
+static int _bench_batch(const unsigned char *in) {
+	static const size_t sizes[] = { 64, 128, 256, 512, 1024, 1500 };
+	static unsigned char keys[BENCH_BATCH][CHACHA_CRYPTO_AEAD_KEYBYTES], nonces[BENCH_BATCH][CHACHA_CRYPTO_AEAD_NONCEBYTES];
+	static unsigned char out[BENCH_BATCH][1500], tags[BENCH_BATCH][16];
+	struct chacha_crypto_aead_job jobs[BENCH_BATCH];
+	unsigned char ref[1500], ref_tag[16];
+	unsigned int i, j, s;
+	double single, batch;
+
+	for (i = 0; i < BENCH_BATCH; i ++) {
+		for (j = 0; j < sizeof(keys[i]); j ++)
+			keys[i][j] = rand();
+
+		for (j = 0; j < sizeof(nonces[i]); j ++)
+			nonces[i][j] = rand();
+	}
+
+	printf("batch of %d connections, kernel %s\n", BENCH_BATCH, chacha_crypto_stream_impl());
+	printf("size single_cpb batch_cpb speedup\n");
+
+	for (s = 0; s < sizeof(sizes) / sizeof(size_t); s ++) {
+		for (i = 0; i < BENCH_BATCH; i ++) {
+			jobs[i].out = out[i];
+			jobs[i].tag = tags[i];
+			jobs[i].in = in + i;
+			jobs[i].inlen = sizes[s];
+			jobs[i].ad = NULL;
+			jobs[i].adlen = 0;
+			jobs[i].n = nonces[i];
+			jobs[i].k = keys[i];
+		}
+
+		/* Every job must match its own single message encryption */
+		if (chacha_crypto_aead_encrypt_batch(jobs, BENCH_BATCH) < 0) {
+			printf("Error #3: %zu\n", sizes[s]);
+			return -1;
+		}
+
+		for (i = 0; i < BENCH_BATCH; i ++) {
+			chacha_crypto_aead_encrypt(ref, ref_tag, jobs[i].in, sizes[s], NULL, 0, nonces[i], keys[i]);
+
+			if (memcmp(ref, out[i], sizes[s]) || memcmp(ref_tag, tags[i], sizeof(ref_tag))) {
+				printf("Error #4: %zu\n", sizes[s]);
+				return -1;
+			}
+		}
+
+		single = _run_batch(0, jobs, BENCH_BATCH);
+		batch = _run_batch(1, jobs, BENCH_BATCH);
+
+		printf("%zu %.2f %.2f %.2f\n", sizes[s], single, batch, single / batch);
+	}
+
+	return 0;
+}
+
+int main(int argc, char *argv[]) {
+	static const size_t sizes[] = { 64, 256, 512, 1024, 1500, 4096, 16384, 65536 };
+	unsigned char *in = malloc(BENCH_MSG_MAX), *out = malloc(BENCH_MSG_MAX), *ref = malloc(BENCH_MSG_MAX), *dec = malloc(BENCH_MSG_MAX);
+	unsigned char tag[16], ref_tag[16];
+	EVP_CIPHER_CTX *ctx = EVP_CIPHER_CTX_new();
+	unsigned int i, s, m;
+	double cpb[BENCH_MAX], mbs[BENCH_MAX];
+
+	srand(1);
+
+	for (i = 0; i < sizeof(key); i ++)
+		key[i] = rand();
+
+	for (i = 0; i < sizeof(nonce); i ++)
+		nonce[i] = rand();
+
+	for (i = 0; i < BENCH_MSG_MAX; i ++)
+		in[i] = rand();
+
+	EVP_EncryptInit_ex(ctx, EVP_chacha20_poly1305(), NULL, key, nonce);
+
+	printf("kernel %s\n", chacha_crypto_stream_impl());
+	printf("size mode cpb mbs speedup_vs_two_pass\n");
+
+	for (s = 0; s < sizeof(sizes) / sizeof(size_t); s ++) {
+		/* The AEAD must match OpenSSL and open its own output */
+		_openssl(ctx, ref, ref_tag, in, sizes[s]);
+		chacha_crypto_aead_encrypt(out, tag, in, sizes[s], NULL, 0, nonce, key);
+
+		if (memcmp(ref, out, sizes[s]) || memcmp(ref_tag, tag, sizeof(tag))) {
+			printf("Error #1: %zu\n", sizes[s]);
+			return 1;
+		}
+
+		if (chacha_crypto_aead_decrypt(dec, out, sizes[s], tag, NULL, 0, nonce, key) || memcmp(dec, in, sizes[s])) {
+			printf("Error #2: %zu\n", sizes[s]);
+			return 1;
+		}
+
+		for (m = 0; m < BENCH_MAX; m ++)
+			cpb[m] = _run(m, ctx, out, in, sizes[s], &mbs[m]);
+
+		for (m = 0; m < BENCH_MAX; m ++)
+			printf("%zu %s %.2f %.1f %.2f\n", sizes[s], bench_names[m], cpb[m], mbs[m], cpb[BENCH_TWO_PASS] / cpb[m]);
+	}
+
+	EVP_CIPHER_CTX_free(ctx);
+
+	if (_bench_batch(in) < 0)
+		return 1;
+
+	free(in);
+	free(out);
+	free(ref);
+	free(dec);
+
+	return 0;
+}
@@ -0,0 +1,270 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <time.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#include "cl_api.h"
+#include "cl_telemetry.h"
+
+#define BENCH_MIN_NSEC		50000000ULL
+#define BENCH_CORPUS_LEN	(1024 * 1024)
+
+/*
+ * Allocation counting: the malloc family is interposed so that calls made
+ * from within libsidp and the codec libraries are counted as well.
+ */
+#ifdef __GLIBC__
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t nmemb, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+
+static unsigned long _allocs = 0;
+
+void *malloc(size_t size) {
+	_allocs ++;
+
+	return __libc_malloc(size);
+}
+
+void *calloc(size_t nmemb, size_t size) {
+	_allocs ++;
+
+	return __libc_calloc(nmemb, size);
+}
+
+void *realloc(void *ptr, size_t size) {
+	_allocs ++;
+
+	return __libc_realloc(ptr, size);
+}
+#define BENCH_ALLOCS_COUNTED	1
+#else
+static unsigned long _allocs = 0;
+#define BENCH_ALLOCS_COUNTED	0
+#endif
+
+/* Telemetry records: timestamp, sequence, temperature, reading, status, flags */
+static const uint8_t _schema_types[] = {
+	CL_TELEMETRY_FIELD_U32,
+	CL_TELEMETRY_FIELD_U16,
+	CL_TELEMETRY_FIELD_I16,
+	CL_TELEMETRY_FIELD_F32,
+	CL_TELEMETRY_FIELD_U8,
+	CL_TELEMETRY_FIELD_U8
+};
+
+static const char *_words[] = {
+	"the ", "sensor ", "reported ", "a ", "value ", "of ", "within ", "expected ",
+	"range ", "for ", "device ", "temperature ", "and ", "pressure ", ".\n"
+};
+
+static const struct {
+	int type;
+	const char *name;
+} _codecs[] = {
+	{ CL_COMPRESS_TYPE_LZO, "lzo" },
+	{ CL_COMPRESS_TYPE_ZLIB, "zlib" },
+	{ CL_COMPRESS_TYPE_FASTLZ, "fastlz" },
+	{ CL_COMPRESS_TYPE_LZ4, "lz4" },
+	{ CL_COMPRESS_TYPE_TELEMETRY, "telemetry" }
+};
+
+static const char *_corpora[] = { "text", "json", "telemetry", "random" };
+
+static const size_t _sizes[] = { 64, 256, 1024, 4096, 16384, 65536 };
+
+static uint64_t _nsec(void) {
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static uint64_t _cycles(void) {
+#if defined(__x86_64__) || defined(__i386__)
+	return __rdtsc();
+#else
+	return 0;
+#endif
+}
+
+static void _gen(unsigned char *buf, size_t len, const char *corpus) {
+	size_t i = 0, n;
+	char tmp[128];
+	uint32_t ts = 1400000000;
+	uint16_t seq = 0;
+	int16_t temp = 2150;
+	float reading = 101.3f;
+
+	srand(1);
+
+	while (i < len) {
+		if (!strcmp(corpus, "text")) {
+			n = snprintf(tmp, sizeof(tmp), "%s", _words[rand() % (sizeof(_words) / sizeof(char *))]);
+		} else if (!strcmp(corpus, "json")) {
+			n = snprintf(tmp, sizeof(tmp), "{\"dev\":%d,\"ts\":%u,\"temp\":%d.%d,\"status\":\"%s\"},", rand() % 64, ts ++, 20 + rand() % 5, rand() % 10, rand() % 8 ? "ok" : "warn");
+		} else if (!strcmp(corpus, "telemetry")) {
+			temp += (rand() % 5) - 2;
+			reading += ((rand() % 21) - 10) / 100.0f;
+
+			memcpy(tmp, &ts, 4);
+			memcpy(tmp + 4, &seq, 2);
+			memcpy(tmp + 6, &temp, 2);
+			memcpy(tmp + 8, &reading, 4);
+			tmp[12] = !(rand() % 32);
+			tmp[13] = 0x01;
+
+			ts += 10;
+			seq ++;
+			n = 14;
+		} else {
+			n = 1;
+			tmp[0] = rand();
+		}
+
+		if (n > (len - i))
+			n = len - i;
+
+		memcpy(buf + i, tmp, n);
+		i += n;
+	}
+}
+
+static int _compress(struct cl_data *cld, void *out, const void *in, size_t len, int level, const struct cl_telemetry_schema *schema) {
+	if (cld->compress_schema)
+		return cld->compress_schema(out, in, len, schema);
+
+	if (level != CL_COMPRESS_LEVEL_DEFAULT)
+		return cld->compress_level(out, in, len, level);
+
+	return cld->compress(out, in, len);
+}
+
+static int _decompress(struct cl_data *cld, void *out, size_t out_len, const void *in, size_t in_len, const struct cl_telemetry_schema *schema) {
+	if (cld->decompress_schema)
+		return cld->decompress_schema(out, out_len, in, in_len, schema);
+
+	return cld->decompress(out, out_len, in, in_len);
+}
+
+static void _usage(int argc, char **argv) {
+	fprintf(stderr, "Usage: %s [level]\n", argv[0]);
+
+	exit(EXIT_FAILURE);
+}
+
+int main(int argc, char *argv[]) {
+	struct cl_data cld;
+	struct cl_telemetry_schema schema;
+	unsigned char *corpus = malloc(BENCH_CORPUS_LEN), *comp, *out;
+	int *comp_lens, level = CL_COMPRESS_LEVEL_DEFAULT, ret;
+	unsigned int c, k, s, m, nmsg, calls;
+	size_t size, comp_total, comp_max;
+	uint64_t start, elapsed, cyc;
+	unsigned long allocs;
+	double comp_mbs, comp_cpb, comp_apc, decomp_mbs, decomp_cpb, decomp_apc;
+
+	if (argc > 2)
+		_usage(argc, argv);
+
+	if (argc == 2)
+		level = atoi(argv[1]);
+
+	if (cl_telemetry_schema_init(&schema, _schema_types, sizeof(_schema_types)) < 0) {
+		printf("Error #1.\n");
+		return 1;
+	}
+
+	printf("codec corpus size ratio comp_mbs decomp_mbs comp_cpb decomp_cpb comp_allocs decomp_allocs\n");
+
+	for (c = 0; c < sizeof(_codecs) / sizeof(_codecs[0]); c ++) {
+		if (cl_data_init(&cld, _codecs[c].type) < 0) {
+			fprintf(stderr, "%s: not available, skipped\n", _codecs[c].name);
+			continue;
+		}
+
+		for (k = 0; k < sizeof(_corpora) / sizeof(char *); k ++) {
+			_gen(corpus, BENCH_CORPUS_LEN, _corpora[k]);
+
+			for (s = 0; s < sizeof(_sizes) / sizeof(size_t); s ++) {
+				/* The corpus is split in messages of the same size */
+				size = _sizes[s];
+				nmsg = BENCH_CORPUS_LEN / size;
+				comp_max = cld.compress_output_len(size);
+
+				comp = malloc(nmsg * comp_max);
+				comp_lens = malloc(nmsg * sizeof(int));
+				out = malloc(size);
+
+				/* Compression */
+				allocs = _allocs;
+				calls = 0;
+				cyc = _cycles();
+				start = _nsec();
+
+				do {
+					for (m = 0; m < nmsg; m ++)
+						comp_lens[m] = _compress(&cld, comp + m * comp_max, corpus + m * size, size, level, &schema);
+
+					calls += nmsg;
+				} while ((elapsed = _nsec() - start) < BENCH_MIN_NSEC);
+
+				cyc = _cycles() - cyc;
+				comp_apc = BENCH_ALLOCS_COUNTED ? (double) (_allocs - allocs) / calls : -1;
+				comp_mbs = ((double) calls * size / 1048576.0) / (elapsed / 1000000000.0);
+				comp_cpb = (double) cyc / ((double) calls * size);
+
+				for (m = 0, comp_total = 0; m < nmsg; m ++) {
+					if (comp_lens[m] < 0) {
+						printf("Error #2: %s %s %zu\n", _codecs[c].name, _corpora[k], size);
+						return 1;
+					}
+
+					comp_total += comp_lens[m];
+				}
+
+				/* Decompression */
+				allocs = _allocs;
+				calls = 0;
+				cyc = _cycles();
+				start = _nsec();
+
+				do {
+					for (m = 0; m < nmsg; m ++) {
+						ret = _decompress(&cld, out, size, comp + m * comp_max, comp_lens[m], &schema);
+
+						if ((ret != (int) size) || (!calls && memcmp(out, corpus + m * size, size))) {
+							printf("Error #3: %s %s %zu\n", _codecs[c].name, _corpora[k], size);
+							return 1;
+						}
+					}
+
+					calls += nmsg;
+				} while ((elapsed = _nsec() - start) < BENCH_MIN_NSEC);
+
+				cyc = _cycles() - cyc;
+				decomp_apc = BENCH_ALLOCS_COUNTED ? (double) (_allocs - allocs) / calls : -1;
+				decomp_mbs = ((double) calls * size / 1048576.0) / (elapsed / 1000000000.0);
+				decomp_cpb = (double) cyc / ((double) calls * size);
+
+				printf("%s %s %zu %.3f %.1f %.1f %.2f %.2f %.2f %.2f\n",
+					_codecs[c].name, _corpora[k], size, (double) comp_total / ((double) nmsg * size),
+					comp_mbs, decomp_mbs, comp_cpb, decomp_cpb, comp_apc, decomp_apc);
+
+				free(comp);
+				free(comp_lens);
+				free(out);
+			}
+		}
+	}
+
+	free(corpus);
+
+	return 0;
+}
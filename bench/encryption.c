@@ -0,0 +1,357 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <time.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#include <openssl/evp.h>
+#include <openssl/rand.h>
+
+#include <nacl/crypto_stream.h>
+#include <nacl/crypto_onetimeauth.h>
+#include <chacha/chacha.h>
+
+#include "el_api.h"
+#include "el_aes256gcm.h"
+#include "el_xsalsa20.h"
+#include "el_chacha.h"
+#include "el_chacha20poly1305.h"
+#include "el_null.h"
+
+#define BENCH_MIN_NSEC		20000000ULL
+#define BENCH_MSG_MAX		65536
+#define BENCH_OUT_MAX		(BENCH_MSG_MAX + 256)
+#define BENCH_SEQ_PKTS		32	/* Packets of a counter nonce sequence replayed on decryption */
+
+/* The primitives each cipher type is made of, timed on their own */
+enum {
+	BENCH_PRIM_AES_CBC_HMAC,	/* AES-256-CBC + HMAC-SHA256 */
+	BENCH_PRIM_AES_GCM,		/* AES-256-CTR + GHASH */
+	BENCH_PRIM_XSALSA20,		/* XSalsa20 + Poly1305 */
+	BENCH_PRIM_CHACHA,		/* ChaCha20 + Poly1305 */
+	BENCH_PRIM_NONE,		/* Copy (the CRC32C is fused with it) */
+	BENCH_PRIM_NONE_MAC		/* Copy + Poly1305 */
+};
+
+static const struct {
+	int type;
+	const char *name;
+	size_t rng_len;		/* Random bytes drawn per packet without counter nonces */
+	int prim;
+} _ciphers[] = {
+	{ EL_CIPHER_TYPE_AES256, "aes256", EVP_MAX_IV_LENGTH, BENCH_PRIM_AES_CBC_HMAC },
+	{ EL_CIPHER_TYPE_AES256_GCM, "aes256-gcm", EL_AES256_GCM_NONCE_LEN, BENCH_PRIM_AES_GCM },
+	{ EL_CIPHER_TYPE_XSALSA20, "xsalsa20", EL_XSALSA20_NONCE_LEN, BENCH_PRIM_XSALSA20 },
+	{ EL_CIPHER_TYPE_CHACHA, "chacha", EL_CHACHA_NONCE_LEN, BENCH_PRIM_CHACHA },
+	{ EL_CIPHER_TYPE_CHACHA_AVX, "chacha-avx", EL_CHACHA_AVX_NONCE_LEN, BENCH_PRIM_CHACHA },
+	{ EL_CIPHER_TYPE_CHACHA_AVX2, "chacha-avx2", EL_CHACHA_AVX2_NONCE_LEN, BENCH_PRIM_CHACHA },
+	{ EL_CIPHER_TYPE_CHACHA20_POLY1305, "chacha20-poly1305", EL_CHACHA20_POLY1305_NONCE_LEN, BENCH_PRIM_CHACHA },
+	{ EL_CIPHER_TYPE_NONE, "none", 0, BENCH_PRIM_NONE },
+	{ EL_CIPHER_TYPE_NONE_MAC, "none-mac", EL_NULL_MAC_NONCE_LEN, BENCH_PRIM_NONE_MAC }
+};
+
+static const size_t _sizes[] = { 16, 64, 256, 1024, 1500, 4096, 16384, 65536 };
+
+struct bench_ctx {
+	struct el_data eld;
+	struct el_ctx ctx_enc;
+	struct el_ctx ctx_dec;
+	struct el_nonce nonce_enc;
+	struct el_nonce nonce_dec;
+	unsigned char key[64];
+	size_t len;		/* Plain-text size */
+	size_t rng_len;
+	int prim;
+
+	unsigned char *in;
+	unsigned char *out;
+	unsigned char *dec;
+	/* Encrypted packets, BENCH_SEQ_PKTS of them in counter nonce mode */
+	unsigned char *pkts;
+	int pkt_len[BENCH_SEQ_PKTS];
+
+	/* Key schedules and HMAC pads are set up once, as the layer keeps them */
+	EVP_CIPHER_CTX *evp_cipher;
+	EVP_CIPHER_CTX *evp_mac;
+	EVP_MD_CTX *md;
+	EVP_MD_CTX *md_inner;
+	EVP_MD_CTX *md_outer;
+};
+
+static uint64_t _nsec(void) {
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static uint64_t _cycles(void) {
+#if defined(__x86_64__) || defined(__i386__)
+	return __rdtsc();
+#else
+	return 0;
+#endif
+}
+
+/* Runs 'fn' (which processes 'pkts' packets per call) for BENCH_MIN_NSEC.
+ * Returns ns per packet and sets 'cyc' to cycles per packet. */
+static double _measure(int (*fn) (struct bench_ctx *), struct bench_ctx *bc, unsigned int pkts, double *cyc) {
+	uint64_t start = _nsec(), elapsed, cycles = _cycles(), calls = 0;
+
+	do {
+		if (fn(bc) < 0) {
+			printf("Error #1: %zu\n", bc->len);
+			exit(EXIT_FAILURE);
+		}
+
+		calls += pkts;
+	} while ((elapsed = _nsec() - start) < BENCH_MIN_NSEC);
+
+	*cyc = (double) (_cycles() - cycles) / calls;
+
+	return (double) elapsed / calls;
+}
+
+/* Encryption Layer, as used by the outgoing chain */
+static int _enc_legacy(struct bench_ctx *bc) {
+	if (bc->eld.encrypt_ctx)
+		return bc->eld.encrypt_ctx(&bc->ctx_enc, bc->key, bc->out, bc->in, bc->len);
+
+	return bc->eld.encrypt(bc->key, bc->out, bc->in, bc->len);
+}
+
+static int _dec_legacy(struct bench_ctx *bc) {
+	if (bc->eld.decrypt_ctx)
+		return bc->eld.decrypt_ctx(&bc->ctx_dec, bc->key, bc->dec, bc->pkts, bc->pkt_len[0]);
+
+	return bc->eld.decrypt(bc->key, bc->dec, bc->pkts, bc->pkt_len[0]);
+}
+
+static int _enc_seq(struct bench_ctx *bc) {
+	return el_encrypt_seq(&bc->eld, &bc->ctx_enc, &bc->nonce_enc, bc->key, bc->out, bc->in, bc->len);
+}
+
+static int _dec_seq(struct bench_ctx *bc) {
+	int i;
+
+	/* Start over as a new receiver, so the base packet is decrypted once per run */
+	memset(&bc->nonce_dec, 0, sizeof(bc->nonce_dec));
+
+	for (i = 0; i < BENCH_SEQ_PKTS; i ++) {
+		if (el_decrypt_seq(&bc->eld, &bc->ctx_dec, &bc->nonce_dec, bc->key, bc->dec, bc->pkts + i * BENCH_OUT_MAX, bc->pkt_len[i]) < 0)
+			return -1;
+	}
+
+	return 0;
+}
+
+/* Primitives */
+static int _prim_init(struct bench_ctx *bc) {
+	unsigned char pad[64];
+
+	switch (bc->prim) {
+		case BENCH_PRIM_AES_CBC_HMAC:
+			memset(pad, 0x36, sizeof(pad));
+
+			if (!EVP_DigestInit_ex(bc->md_inner, EVP_sha256(), NULL) || !EVP_DigestUpdate(bc->md_inner, pad, sizeof(pad)))
+				return -1;
+
+			memset(pad, 0x5c, sizeof(pad));
+
+			if (!EVP_DigestInit_ex(bc->md_outer, EVP_sha256(), NULL) || !EVP_DigestUpdate(bc->md_outer, pad, sizeof(pad)))
+				return -1;
+
+			return -!EVP_EncryptInit_ex(bc->evp_cipher, EVP_aes_256_cbc(), NULL, bc->key, NULL);
+		case BENCH_PRIM_AES_GCM:
+			if (!EVP_EncryptInit_ex(bc->evp_mac, EVP_aes_256_gcm(), NULL, bc->key, NULL))
+				return -1;
+
+			return -!EVP_EncryptInit_ex(bc->evp_cipher, EVP_aes_256_ctr(), NULL, bc->key, NULL);
+		default:
+			return 0;
+	}
+}
+
+static int _rng(struct bench_ctx *bc) {
+	if (!bc->rng_len)
+		return 0;
+
+	return -!RAND_bytes(bc->out, bc->rng_len);
+}
+
+static int _cipher(struct bench_ctx *bc) {
+	int l;
+
+	switch (bc->prim) {
+		case BENCH_PRIM_AES_CBC_HMAC:
+			if (!EVP_EncryptInit_ex(bc->evp_cipher, NULL, NULL, NULL, bc->key + 32))
+				return -1;
+
+			return -!(EVP_EncryptUpdate(bc->evp_cipher, bc->out, &l, bc->in, bc->len) && EVP_EncryptFinal_ex(bc->evp_cipher, bc->out + l, &l));
+		case BENCH_PRIM_AES_GCM:
+			if (!EVP_EncryptInit_ex(bc->evp_cipher, NULL, NULL, NULL, bc->key + 32))
+				return -1;
+
+			return -!EVP_EncryptUpdate(bc->evp_cipher, bc->out, &l, bc->in, bc->len);
+		case BENCH_PRIM_XSALSA20:
+			return crypto_stream_xor(bc->out, bc->in, bc->len, bc->key + 32, bc->key);
+		case BENCH_PRIM_NONE:
+		case BENCH_PRIM_NONE_MAC:
+			memcpy(bc->out, bc->in, bc->len);
+
+			return 0;
+		default:
+			return chacha_crypto_stream_xor(bc->out, bc->in, bc->len, bc->key + 32, bc->key);
+	}
+}
+
+static int _mac(struct bench_ctx *bc) {
+	unsigned char md[EVP_MAX_MD_SIZE];
+	unsigned int mdlen;
+	int l;
+
+	switch (bc->prim) {
+		case BENCH_PRIM_AES_CBC_HMAC:
+			/* HMAC-SHA256, from the precomputed inner and outer pad states */
+			if (!EVP_MD_CTX_copy_ex(bc->md, bc->md_inner) || !EVP_DigestUpdate(bc->md, bc->in, bc->len) || !EVP_DigestFinal_ex(bc->md, md, &mdlen))
+				return -1;
+
+			return -!(EVP_MD_CTX_copy_ex(bc->md, bc->md_outer) && EVP_DigestUpdate(bc->md, md, mdlen) && EVP_DigestFinal_ex(bc->md, md, &mdlen));
+		case BENCH_PRIM_AES_GCM:
+			/* GMAC: the data as associated data only */
+			if (!EVP_EncryptInit_ex(bc->evp_mac, NULL, NULL, NULL, bc->key + 32))
+				return -1;
+
+			return -!(EVP_EncryptUpdate(bc->evp_mac, NULL, &l, bc->in, bc->len) && EVP_EncryptFinal_ex(bc->evp_mac, md, &l) &&
+				EVP_CIPHER_CTX_ctrl(bc->evp_mac, EVP_CTRL_AEAD_GET_TAG, 16, md));
+		case BENCH_PRIM_NONE:
+			return 0;
+		default:
+			return crypto_onetimeauth(md, bc->in, bc->len, bc->key);
+	}
+}
+
+static void _report(const char *cipher, const char *mode, struct bench_ctx *bc, int overhead, int (*enc) (struct bench_ctx *), int (*dec) (struct bench_ctx *), unsigned int dec_pkts, double rng_ns, double cipher_ns, double mac_ns) {
+	double enc_ns, dec_ns, enc_cyc, dec_cyc;
+
+	enc_ns = _measure(enc, bc, 1, &enc_cyc);
+	dec_ns = _measure(dec, bc, dec_pkts, &dec_cyc);
+
+	printf("%s %s %zu %d %.2f %.2f %.0f %.0f %.0f %.0f %.0f %.0f\n",
+		cipher, mode, bc->len, overhead, enc_cyc / bc->len, dec_cyc / bc->len, enc_ns, dec_ns,
+		rng_ns, cipher_ns, mac_ns, enc_ns - rng_ns - cipher_ns - mac_ns);
+}
+
+int main(int argc, char *argv[]) {
+	struct bench_ctx bc;
+	unsigned int c, s, i;
+	double rng_ns, cipher_ns, mac_ns, cyc;
+
+	memset(&bc, 0, sizeof(bc));
+
+	bc.in = malloc(BENCH_MSG_MAX);
+	bc.out = malloc(BENCH_OUT_MAX);
+	bc.dec = malloc(BENCH_OUT_MAX);
+	bc.pkts = malloc(BENCH_SEQ_PKTS * BENCH_OUT_MAX);
+	bc.evp_cipher = EVP_CIPHER_CTX_new();
+	bc.evp_mac = EVP_CIPHER_CTX_new();
+	bc.md = EVP_MD_CTX_new();
+	bc.md_inner = EVP_MD_CTX_new();
+	bc.md_outer = EVP_MD_CTX_new();
+
+	srand(1);
+
+	for (i = 0; i < BENCH_MSG_MAX; i ++)
+		bc.in[i] = rand();
+
+	/*
+	 * 'other' is the packet time not spent on the RNG, the cipher or the MAC
+	 * (framing, copies, key and context setup). It's negative when the layer
+	 * is faster than its primitives run on their own (e.g. a stitched AEAD).
+	 */
+	printf("kernel %s\n", chacha_crypto_stream_impl());
+	printf("cipher mode size overhead enc_cpb dec_cpb enc_ns dec_ns rng_ns cipher_ns mac_ns other_ns\n");
+
+	for (c = 0; c < sizeof(_ciphers) / sizeof(_ciphers[0]); c ++) {
+		if ((el_data_init(&bc.eld, _ciphers[c].type) < 0) || (bc.eld.create_key((const unsigned char *) "bench key", bc.key) < 0)) {
+			fprintf(stderr, "%s: not available, skipped\n", _ciphers[c].name);
+			continue;
+		}
+
+		bc.rng_len = _ciphers[c].rng_len;
+		bc.prim = _ciphers[c].prim;
+
+		if (_prim_init(&bc) < 0) {
+			printf("Error #2: %s\n", _ciphers[c].name);
+			return 1;
+		}
+
+		for (s = 0; s < sizeof(_sizes) / sizeof(size_t); s ++) {
+			bc.len = _sizes[s];
+
+			rng_ns = _measure(_rng, &bc, 1, &cyc);
+			cipher_ns = _measure(_cipher, &bc, 1, &cyc);
+			mac_ns = _measure(_mac, &bc, 1, &cyc);
+
+			/* Random nonce per packet */
+			if ((bc.pkt_len[0] = _enc_legacy(&bc)) < 0) {
+				printf("Error #3: %s %zu\n", _ciphers[c].name, bc.len);
+				return 1;
+			}
+
+			memcpy(bc.pkts, bc.out, bc.pkt_len[0]);
+
+			if ((_dec_legacy(&bc) != (int) bc.len) || memcmp(bc.dec, bc.in, bc.len)) {
+				printf("Error #4: %s %zu\n", _ciphers[c].name, bc.len);
+				return 1;
+			}
+
+			_report(_ciphers[c].name, "legacy", &bc, bc.pkt_len[0] - (int) bc.len, _enc_legacy, _dec_legacy, 1, rng_ns, cipher_ns, mac_ns);
+
+			if (!bc.eld.encrypt_nonce)
+				continue;
+
+			/* Counter nonces: no RNG on the packet path, past the first packet */
+			el_ctx_destroy(&bc.ctx_enc);
+			memset(&bc.nonce_enc, 0, sizeof(bc.nonce_enc));
+
+			for (i = 0; i < BENCH_SEQ_PKTS; i ++) {
+				if ((bc.pkt_len[i] = _enc_seq(&bc)) < 0) {
+					printf("Error #5: %s %zu\n", _ciphers[c].name, bc.len);
+					return 1;
+				}
+
+				memcpy(bc.pkts + i * BENCH_OUT_MAX, bc.out, bc.pkt_len[i]);
+			}
+
+			if ((_dec_seq(&bc) < 0) || memcmp(bc.dec, bc.in, bc.len)) {
+				printf("Error #6: %s %zu\n", _ciphers[c].name, bc.len);
+				return 1;
+			}
+
+			_report(_ciphers[c].name, "seq", &bc, bc.pkt_len[1] - (int) bc.len, _enc_seq, _dec_seq, BENCH_SEQ_PKTS, 0, cipher_ns, mac_ns);
+		}
+
+		el_ctx_destroy(&bc.ctx_enc);
+		el_ctx_destroy(&bc.ctx_dec);
+		memset(&bc.nonce_enc, 0, sizeof(bc.nonce_enc));
+	}
+
+	EVP_CIPHER_CTX_free(bc.evp_cipher);
+	EVP_CIPHER_CTX_free(bc.evp_mac);
+	EVP_MD_CTX_free(bc.md);
+	EVP_MD_CTX_free(bc.md_inner);
+	EVP_MD_CTX_free(bc.md_outer);
+
+	free(bc.in);
+	free(bc.out);
+	free(bc.dec);
+	free(bc.pkts);
+
+	return 0;
+}
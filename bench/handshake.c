@@ -0,0 +1,216 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <time.h>
+#include <unistd.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+
+#include "sidp.h"
+
+#define BENCH_HANDSHAKES	20
+#define BENCH_RTT_MS		20
+
+static const struct {
+	int handshake;
+	int resume;
+	const char *name;
+} _modes[] = {
+	{ 0, 0, "legacy" },	/* init, auth and negotiation sequences: 4 round trips */
+	{ 1, 0, "handshake" },	/* Combined handshake sequence: 2 round trips */
+	{ 1, 1, "resume" }	/* Resumption ticket, no SRP: 1 round trip */
+};
+
+static unsigned int _handshakes = BENCH_HANDSHAKES;
+static unsigned int _rtt_ms = BENCH_RTT_MS;
+
+static struct sidp_ticket_key _ticket_key;
+static struct sidp_ticket _ticket;
+
+/* Link emulated by the relay between the user and the host */
+static int _relay_fd[2];
+static uint64_t _relay_bytes;
+
+static uint64_t _nsec(void) {
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static uint32_t _flags(void) {
+	return (1 << SIDP_SUPPORT_CIPHER_CHACHA_FL) | (1 << SIDP_SUPPORT_COMPRESS_LZ4_FL) | (1 << SIDP_SUPPORT_ENCAP_DEFAULT_FL);
+}
+
+/* Relays the data between both end-points, delaying it by half a RTT */
+static void *_relay(void *arg) {
+	static unsigned char buf[65536];
+	struct pollfd pfd[2];
+	struct timespec delay;
+	ssize_t len;
+	int i;
+
+	delay.tv_sec = (_rtt_ms / 2) / 1000;
+	delay.tv_nsec = ((_rtt_ms * 1000000L) / 2) % 1000000000L;
+
+	pfd[0].fd = _relay_fd[0];
+	pfd[1].fd = _relay_fd[1];
+	pfd[0].events = pfd[1].events = POLLIN;
+
+	for (;;) {
+		if (poll(pfd, 2, -1) < 0)
+			break;
+
+		for (i = 0; i < 2; i ++) {
+			if (!pfd[i].revents)
+				continue;
+
+			if ((len = read(pfd[i].fd, buf, sizeof(buf))) <= 0)
+				return NULL;
+
+			nanosleep(&delay, NULL);
+
+			if (write(pfd[!i].fd, buf, len) != len)
+				return NULL;
+
+			_relay_bytes += len;
+		}
+	}
+
+	return NULL;
+}
+
+/* The first handshake of each mode isn't timed (it issues the ticket) */
+static void _host(unsigned int m, int fd) {
+	struct sidpconn conn;
+	unsigned int i;
+	int ret;
+
+	for (i = 0; i <= _handshakes; i ++) {
+		sidp_conn_init(&conn, fd, 2, 0, 0, SIDP_CONN_TYPE_NONE);
+		sidp_conn_set_support_flags(&conn, _flags());
+
+		if (_modes[m].resume)
+			sidp_conn_set_ticket_key(&conn, &_ticket_key);
+
+		if (_modes[m].handshake) {
+			ret = sidp_seq_handshake_host(&conn, "bench", (const unsigned char *) "bench password");
+		} else if ((ret = sidp_seq_init_host(&conn)) >= 0) {
+			if ((ret = sidp_seq_auth_host(&conn, "bench", (const unsigned char *) "bench password")) >= 0)
+				ret = sidp_seq_negotiation_host(&conn);
+		}
+
+		if (ret < 0) {
+			printf("Error #1: %d\n", ret);
+			_exit(1);
+		}
+	}
+
+	_exit(0);
+}
+
+static void _bench(unsigned int m) {
+	struct sidpconn conn;
+	pthread_t tid;
+	uint64_t start, elapsed = 0;
+	unsigned int i;
+	int usr_sv[2], host_sv[2], status, ret;
+	pid_t pid;
+
+	if ((socketpair(AF_UNIX, SOCK_STREAM, 0, usr_sv) < 0) || (socketpair(AF_UNIX, SOCK_STREAM, 0, host_sv) < 0)) {
+		printf("Error #2\n");
+		exit(1);
+	}
+
+	if (!(pid = fork())) {
+		close(usr_sv[0]);
+		close(usr_sv[1]);
+		close(host_sv[0]);
+
+		_host(m, host_sv[1]);
+	}
+
+	close(host_sv[1]);
+
+	_relay_fd[0] = usr_sv[1];
+	_relay_fd[1] = host_sv[0];
+	_relay_bytes = 0;
+
+	pthread_create(&tid, NULL, _relay, NULL);
+
+	memset(&_ticket, 0, sizeof(_ticket));
+
+	for (i = 0; i <= _handshakes; i ++) {
+		sidp_conn_init(&conn, usr_sv[0], 1, 2, i + 1, SIDP_CONN_TYPE_PERSISTENT);
+		sidp_conn_set_support_flags(&conn, _flags());
+
+		if (_modes[m].resume)
+			sidp_conn_set_ticket(&conn, &_ticket);
+
+		if (i == 1)
+			_relay_bytes = 0;
+
+		start = _nsec();
+
+		if (_modes[m].handshake) {
+			ret = sidp_seq_handshake_user(&conn, "bench", (const unsigned char *) "bench password");
+		} else if ((ret = sidp_seq_init_user(&conn)) >= 0) {
+			if ((ret = sidp_seq_auth_user(&conn, "bench", (const unsigned char *) "bench password")) >= 0)
+				ret = sidp_seq_negotiation_user(&conn);
+		}
+
+		if (i)
+			elapsed += _nsec() - start;
+
+		if (ret < 0) {
+			printf("Error #3: %d\n", ret);
+			exit(1);
+		}
+	}
+
+	/* The relay and the host end on EOF */
+	close(usr_sv[0]);
+	pthread_join(tid, NULL);
+	close(usr_sv[1]);
+	close(host_sv[0]);
+
+	if ((waitpid(pid, &status, 0) < 0) || !WIFEXITED(status) || WEXITSTATUS(status)) {
+		printf("Error #4\n");
+		exit(1);
+	}
+
+	printf("%s %u %u %.2f %llu\n", _modes[m].name, _handshakes, _rtt_ms,
+		(double) elapsed / _handshakes / 1e6,
+		(unsigned long long) (_relay_bytes / _handshakes));
+}
+
+int main(int argc, char *argv[]) {
+	unsigned int m;
+
+	if (argc > 1)
+		_handshakes = atoi(argv[1]);
+
+	if (argc > 2)
+		_rtt_ms = atoi(argv[2]);
+
+	if (!_handshakes) {
+		fprintf(stderr, "Usage: %s [handshakes] [rtt ms]\n", argv[0]);
+		return 1;
+	}
+
+	if (sidp_ticket_key_init(&_ticket_key, NULL, 3600) < 0) {
+		printf("Error #5\n");
+		return 1;
+	}
+
+	printf("mode handshakes rtt_ms msec_per_handshake bytes_per_handshake\n");
+
+	for (m = 0; m < sizeof(_modes) / sizeof(_modes[0]); m ++)
+		_bench(m);
+
+	return 0;
+}
@@ -0,0 +1,337 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/resource.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+#include "sidp.h"
+#include "bitops.h"
+
+#define BENCH_DEVICES		2000
+#define BENCH_THREADS		1
+#define BENCH_ROUNDS		10
+#define BENCH_MSGS		8	/* Per device and round, at most */
+#define BENCH_MSG_BYTES		32768	/* Per device and round, at most */
+#define BENCH_MSG_MAX		32768
+#define BENCH_DEV_BASE		1000
+
+static const struct {
+	uint32_t flags;
+	const char *name;
+} _modes[] = {
+	{ 0, "splice" },
+	{ 1 << SIDP_HUB_NO_SPLICE_FL, "copy" },
+	{ 1 << SIDP_HUB_NO_RELAY_FL, "reencrypt" }
+};
+
+/* Bodies larger than 16 KiB are spliced */
+static const size_t _sizes[] = { 40, 512, 4096, 32768 };
+
+static struct sidpconn *_dev;		/* Device side */
+static struct sidpconn *_hub_conn;	/* Hub side */
+static struct sidp_hub _hub;
+static unsigned int _devices = BENCH_DEVICES;
+static unsigned int _threads = BENCH_THREADS;
+static unsigned int _msgs = BENCH_MSGS;
+
+static uint64_t _nsec(void) {
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/* Device 'i' sends to device 'i + 1' through a routing connection */
+static uint32_t _peer(unsigned int i) {
+	return BENCH_DEV_BASE + ((i + 1) % _devices);
+}
+
+static void _conn_setup(struct sidpconn *conn, int fd, unsigned int i, int compact) {
+	int one = 1;
+
+	setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+	sidp_conn_init(conn, fd, BENCH_DEV_BASE + i, _peer(i), 7, SIDP_CONN_TYPE_ROUTING);
+	sidp_conn_set_key(conn, (const unsigned char *) "bench key");
+
+	set_bit(&conn->status_flags, SIDP_INITIATED_FL);
+	set_bit(&conn->status_flags, SIDP_AUTHENTICATED_FL);
+	set_bit(&conn->status_flags, SIDP_NEGOTIATED_FL);
+	set_bit(&conn->negotiate_flags, SIDP_NEGOTIATE_ENCAP_DEFAULT_FL);
+	set_bit(&conn->negotiate_flags, SIDP_NEGOTIATE_COMPRESS_LZ4_FL);
+	set_bit(&conn->negotiate_flags, SIDP_NEGOTIATE_CIPHER_CHACHA_FL);
+
+	if (compact)
+		set_bit(&conn->negotiate_flags, SIDP_NEGOTIATE_ENCAP_COMPACT_FL);
+}
+
+/* Connects every device to the hub over TCP loopback */
+static void _setup(int compact) {
+	struct sockaddr_in addr;
+	socklen_t addr_len = sizeof(addr);
+	unsigned int i;
+	int lfd, fd;
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+	if (((lfd = socket(AF_INET, SOCK_STREAM, 0)) < 0) || (bind(lfd, (struct sockaddr *) &addr, sizeof(addr)) < 0) || (listen(lfd, 128) < 0) || (getsockname(lfd, (struct sockaddr *) &addr, &addr_len) < 0)) {
+		printf("Error #1\n");
+		exit(1);
+	}
+
+	for (i = 0; i < _devices; i ++) {
+		if (((fd = socket(AF_INET, SOCK_STREAM, 0)) < 0) || (connect(fd, (struct sockaddr *) &addr, sizeof(addr)) < 0)) {
+			printf("Error #2\n");
+			exit(1);
+		}
+
+		_conn_setup(&_dev[i], fd, i, compact);
+
+		if ((fd = accept(lfd, NULL, NULL)) < 0) {
+			printf("Error #3\n");
+			exit(1);
+		}
+
+		_conn_setup(&_hub_conn[i], fd, i, compact);
+	}
+
+	close(lfd);
+}
+
+static void _teardown(void) {
+	unsigned int i;
+
+	for (i = 0; i < _devices; i ++) {
+		sidp_conn_close(&_dev[i]);
+		sidp_conn_close(&_hub_conn[i]);
+	}
+}
+
+/* Forwards the packets of the hub side connections assigned to a thread */
+static void *_forward(void *arg) {
+	unsigned int i, m, t = (unsigned int) (uintptr_t) arg;
+	int ret;
+
+	for (i = t; i < _devices; i += _threads) {
+		for (m = 0; m < _msgs; m ++) {
+			if ((ret = sidp_hub_forward(&_hub, &_hub_conn[i])) < 0) {
+				printf("Error #4: %d\n", ret);
+				exit(1);
+			}
+		}
+	}
+
+	return NULL;
+}
+
+static void _fill(unsigned char *msg, size_t len, unsigned int dev, unsigned int seq) {
+	size_t i;
+
+	for (i = 0; i < len; i ++)
+		msg[i] = (unsigned char) ((dev * 131) ^ (seq * 31) ^ (i * 7) ^ (i >> 3));
+}
+
+static void _bench(unsigned int m, size_t len, int compact) {
+	static unsigned char msg[BENCH_MSG_MAX], exp[BENCH_MSG_MAX];
+	pthread_t tid[64];
+	struct sidppkt pkt;
+	struct sidpopt opt;
+	uint64_t start, elapsed = 0;
+	unsigned int r, i, k, t;
+
+	/* Keep the data in flight within the socket buffers */
+	_msgs = (BENCH_MSG_BYTES / len) > BENCH_MSGS ? BENCH_MSGS : (BENCH_MSG_BYTES / len);
+
+	_setup(compact);
+
+	if (sidp_hub_init(&_hub, _devices, _modes[m].flags) < 0) {
+		printf("Error #5\n");
+		exit(1);
+	}
+
+	for (i = 0; i < _devices; i ++) {
+		if (sidp_hub_add(&_hub, BENCH_DEV_BASE + i, &_hub_conn[i]) < 0) {
+			printf("Error #6\n");
+			exit(1);
+		}
+	}
+
+	for (r = 0; r < BENCH_ROUNDS; r ++) {
+		/* Every device sends its messages */
+		for (i = 0; i < _devices; i ++) {
+			for (k = 0; k < _msgs; k ++) {
+				_fill(msg, len, i, r * _msgs + k);
+
+				if (sidp_seq_data_send(&_dev[i], msg, len) < 0) {
+					printf("Error #7\n");
+					exit(1);
+				}
+			}
+		}
+
+		/* The hub forwards them, timed */
+		start = _nsec();
+
+		for (t = 0; t < _threads; t ++)
+			pthread_create(&tid[t], NULL, _forward, (void *) (uintptr_t) t);
+
+		for (t = 0; t < _threads; t ++)
+			pthread_join(tid[t], NULL);
+
+		elapsed += _nsec() - start;
+
+		/* Every device receives and checks the messages of its neighbour */
+		for (i = 0; i < _devices; i ++) {
+			for (k = 0; k < _msgs; k ++) {
+				sidp_pkt_set_opt(&opt, 0, 0, 0, SIDP_MSG_TYPE_DATA, _dev[i].key);
+
+				if (sidp_pkt_recv(&_dev[i], &pkt, &opt) < 0) {
+					printf("Error #8\n");
+					exit(1);
+				}
+
+				_fill(exp, len, (i + _devices - 1) % _devices, r * _msgs + k);
+
+				if ((pkt.msg_size != len) || memcmp(pkt.msg, exp, len) || (pkt.ddev != BENCH_DEV_BASE + i) || (pkt.sdev != BENCH_DEV_BASE + (i + _devices - 1) % _devices)) {
+					printf("Error #9\n");
+					exit(1);
+				}
+
+				free(pkt.msg);
+			}
+		}
+	}
+
+	sidp_hub_destroy(&_hub);
+
+	_teardown();
+
+	printf("%s %s %zu %u %.0f %.1f\n", _modes[m].name, compact ? "compact" : "default", len, _devices,
+		(double) _devices * _msgs * BENCH_ROUNDS * 1e9 / elapsed,
+		(double) _devices * _msgs * BENCH_ROUNDS * len * 1e3 / elapsed);
+}
+
+/* A re-encoded packet with a cipher type that wasn't negotiated is discarded
+ * as a whole: the hub keeps forwarding the packets that follow it
+ */
+static void _check_discard(void) {
+	static unsigned char msg[BENCH_MSG_MAX];
+	unsigned int devices = _devices;
+	struct sidppkt pkt;
+	size_t i;
+	struct sidpopt opt;
+	int ret;
+
+	_devices = 2;
+
+	_setup(0);
+
+	if ((sidp_hub_init(&_hub, _devices, 1 << SIDP_HUB_NO_RELAY_FL) < 0) || (sidp_hub_add(&_hub, BENCH_DEV_BASE, &_hub_conn[0]) < 0) || (sidp_hub_add(&_hub, BENCH_DEV_BASE + 1, &_hub_conn[1]) < 0)) {
+		printf("Error #10\n");
+		exit(1);
+	}
+
+	/* Incompressible, so that the packet data is larger than the 16 KiB read
+	 * ahead by the hub
+	 */
+	srand(1);
+
+	for (i = 0; i < BENCH_MSG_MAX; i ++)
+		msg[i] = (unsigned char) rand();
+
+	clear_bit(&_dev[0].negotiate_flags, SIDP_NEGOTIATE_CIPHER_CHACHA_FL);
+	set_bit(&_dev[0].negotiate_flags, SIDP_NEGOTIATE_CIPHER_NONE_FL);
+
+	if (sidp_seq_data_send(&_dev[0], msg, BENCH_MSG_MAX) < 0) {
+		printf("Error #11\n");
+		exit(1);
+	}
+
+	clear_bit(&_dev[0].negotiate_flags, SIDP_NEGOTIATE_CIPHER_NONE_FL);
+	set_bit(&_dev[0].negotiate_flags, SIDP_NEGOTIATE_CIPHER_CHACHA_FL);
+
+	for (i = 0; i < BENCH_MSG_MAX; i ++)
+		msg[i] = (unsigned char) rand();
+
+	if (sidp_seq_data_send(&_dev[0], msg, BENCH_MSG_MAX) < 0) {
+		printf("Error #11\n");
+		exit(1);
+	}
+
+	if ((ret = sidp_hub_forward(&_hub, &_hub_conn[0])) != -6) {
+		printf("Error #12: %d\n", ret);
+		exit(1);
+	}
+
+	if ((ret = sidp_hub_forward(&_hub, &_hub_conn[0])) < 0) {
+		printf("Error #13: %d\n", ret);
+		exit(1);
+	}
+
+	sidp_pkt_set_opt(&opt, 0, 0, 0, SIDP_MSG_TYPE_DATA, _dev[1].key);
+
+	if ((sidp_pkt_recv(&_dev[1], &pkt, &opt) < 0) || (pkt.msg_size != BENCH_MSG_MAX) || memcmp(pkt.msg, msg, BENCH_MSG_MAX)) {
+		printf("Error #14\n");
+		exit(1);
+	}
+
+	free(pkt.msg);
+
+	sidp_hub_destroy(&_hub);
+
+	_teardown();
+
+	_devices = devices;
+}
+
+int main(int argc, char *argv[]) {
+	struct rlimit rl;
+	unsigned int m, s, c;
+
+	if (argc > 1)
+		_devices = atoi(argv[1]);
+
+	if (argc > 2)
+		_threads = atoi(argv[2]);
+
+	if (!_devices || !_threads || (_threads > 64)) {
+		fprintf(stderr, "Usage: %s [devices] [threads (max 64)]\n", argv[0]);
+		return 1;
+	}
+
+	/* Two sockets per device */
+	if (!getrlimit(RLIMIT_NOFILE, &rl) && (rl.rlim_cur < (2 * _devices + 64))) {
+		rl.rlim_cur = (rl.rlim_max < (2 * _devices + 64)) ? rl.rlim_max : (2 * _devices + 64);
+		setrlimit(RLIMIT_NOFILE, &rl);
+	}
+
+	/* At least two devices for _check_discard() */
+	_dev = calloc(_devices > 2 ? _devices : 2, sizeof(struct sidpconn));
+	_hub_conn = calloc(_devices > 2 ? _devices : 2, sizeof(struct sidpconn));
+
+	_check_discard();
+
+	printf("mode framing size devices msgs_per_sec MB_per_sec\n");
+
+	for (s = 0; s < sizeof(_sizes) / sizeof(size_t); s ++) {
+		for (c = 0; c < 2; c ++) {
+			for (m = 0; m < sizeof(_modes) / sizeof(_modes[0]); m ++)
+				_bench(m, _sizes[s], c);
+		}
+	}
+
+	free(_dev);
+	free(_hub_conn);
+
+	return 0;
+}
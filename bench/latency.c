@@ -0,0 +1,183 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/socket.h>
+
+#include "sidp.h"
+#include "bitops.h"
+#include "el_api.h"
+
+#define BENCH_SAMPLES		20000
+#define BENCH_MSG_MAX		1500
+
+/* Messages sent with a precomputed keystream, out of EL_KEYSTREAM_SLOTS */
+#define BENCH_IDLE_EVERY	4
+
+static const struct {
+	int type;
+	int flag;
+	const char *name;
+} _ciphers[] = {
+	{ EL_CIPHER_TYPE_CHACHA, SIDP_NEGOTIATE_CIPHER_CHACHA_FL, "chacha" },
+	{ EL_CIPHER_TYPE_XSALSA20, SIDP_NEGOTIATE_CIPHER_XSALSA20_FL, "xsalsa20" }
+};
+
+static const size_t _sizes[] = { 16, 64, 128, 256, 512, 1024 };
+
+static uint64_t _samples[BENCH_SAMPLES];
+
+static uint64_t _nsec(void) {
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static int _cmp(const void *a, const void *b) {
+	uint64_t x = *(const uint64_t *) a, y = *(const uint64_t *) b;
+
+	return (x > y) - (x < y);
+}
+
+static void _report(const char *cipher, const char *path, size_t len, const char *mode) {
+	qsort(_samples, BENCH_SAMPLES, sizeof(uint64_t), _cmp);
+
+	printf("%s %s %zu %s %llu %llu %llu\n", cipher, path, len, mode,
+		(unsigned long long) _samples[BENCH_SAMPLES / 2],
+		(unsigned long long) _samples[(BENCH_SAMPLES * 99) / 100],
+		(unsigned long long) _samples[(BENCH_SAMPLES * 999) / 1000]);
+}
+
+/* Encryption layer only: el_encrypt_seq() of each message */
+static void _bench_layer(unsigned int c, const unsigned char *in, size_t len, int idle) {
+	static unsigned char out[BENCH_MSG_MAX + 256];
+	struct el_data eld;
+	struct el_ctx ctx;
+	struct el_nonce nonce;
+	unsigned char key[64];
+	uint64_t start;
+	unsigned int i;
+
+	memset(&ctx, 0, sizeof(ctx));
+	memset(&nonce, 0, sizeof(nonce));
+
+	if ((el_data_init(&eld, _ciphers[c].type) < 0) || (eld.create_key((const unsigned char *) "bench key", key) < 0)) {
+		printf("Error #1\n");
+		exit(1);
+	}
+
+	/* The first packet carries the nonce base */
+	el_encrypt_seq(&eld, &ctx, &nonce, key, out, in, len);
+
+	for (i = 0; i < BENCH_SAMPLES; i ++) {
+		/* Idle time between messages, not timed */
+		if (idle && (el_precompute_seq(&eld, &ctx, &nonce, key, BENCH_IDLE_EVERY) < 0)) {
+			printf("Error #2\n");
+			exit(1);
+		}
+
+		start = _nsec();
+
+		if (el_encrypt_seq(&eld, &ctx, &nonce, key, out, in, len) < 0) {
+			printf("Error #3\n");
+			exit(1);
+		}
+
+		_samples[i] = _nsec() - start;
+	}
+
+	el_ctx_destroy(&ctx);
+
+	_report(_ciphers[c].name, "layer", len, idle ? "precomputed" : "inline");
+}
+
+static void *_drain(void *arg) {
+	char buf[65536];
+
+	while (read(*(int *) arg, buf, sizeof(buf)) > 0);
+
+	return NULL;
+}
+
+/* Whole send path: sidp_seq_data_send() on a negotiated connection, over a
+ * socketpair drained by another thread */
+static void _bench_send(unsigned int c, const unsigned char *in, size_t len, int idle) {
+	struct sidpconn conn;
+	pthread_t tid;
+	uint64_t start;
+	unsigned int i;
+	int sv[2];
+
+	if (socketpair(AF_UNIX, SOCK_STREAM, 0, sv) < 0) {
+		printf("Error #4\n");
+		exit(1);
+	}
+
+	pthread_create(&tid, NULL, _drain, &sv[1]);
+
+	sidp_conn_init(&conn, sv[0], 1, 2, 3, 0);
+	sidp_conn_set_key(&conn, (const unsigned char *) "bench key");
+
+	set_bit(&conn.status_flags, SIDP_INITIATED_FL);
+	set_bit(&conn.status_flags, SIDP_AUTHENTICATED_FL);
+	set_bit(&conn.status_flags, SIDP_NEGOTIATED_FL);
+	set_bit(&conn.negotiate_flags, SIDP_NEGOTIATE_ENCAP_DEFAULT_FL);
+	set_bit(&conn.negotiate_flags, SIDP_NEGOTIATE_COMPRESS_LZ4_FL);
+	set_bit(&conn.negotiate_flags, SIDP_NEGOTIATE_NONCE_COUNTER_FL);
+	set_bit(&conn.negotiate_flags, _ciphers[c].flag);
+
+	sidp_seq_data_send(&conn, in, len);
+
+	for (i = 0; i < BENCH_SAMPLES; i ++) {
+		if (idle && (sidp_seq_data_precompute(&conn) < 0)) {
+			printf("Error #5\n");
+			exit(1);
+		}
+
+		start = _nsec();
+
+		if (sidp_seq_data_send(&conn, in, len) < 0) {
+			printf("Error #6\n");
+			exit(1);
+		}
+
+		_samples[i] = _nsec() - start;
+	}
+
+	/* Closes sv[0], which stops the drain thread */
+	sidp_conn_close(&conn);
+	pthread_join(tid, NULL);
+	close(sv[1]);
+
+	_report(_ciphers[c].name, "send", len, idle ? "precomputed" : "inline");
+}
+
+int main(int argc, char *argv[]) {
+	unsigned char in[BENCH_MSG_MAX];
+	unsigned int c, s, i;
+
+	srand(1);
+
+	/* Incompressible, so the cipher sees the whole message */
+	for (i = 0; i < sizeof(in); i ++)
+		in[i] = rand();
+
+	printf("cipher path size mode p50_ns p99_ns p999_ns\n");
+
+	for (c = 0; c < sizeof(_ciphers) / sizeof(_ciphers[0]); c ++) {
+		for (s = 0; s < sizeof(_sizes) / sizeof(size_t); s ++) {
+			_bench_layer(c, in, _sizes[s], 0);
+			_bench_layer(c, in, _sizes[s], 1);
+			_bench_send(c, in, _sizes[s], 0);
+			_bench_send(c, in, _sizes[s], 1);
+		}
+	}
+
+	return 0;
+}
+
@@ -0,0 +1,175 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/resource.h>
+
+#include "sidp.h"
+#include "bitops.h"
+
+#define BENCH_SUBSCRIBERS	10000
+#define BENCH_ROUNDS		10
+#define BENCH_MSG_MAX		16384
+
+static const struct {
+	int publish;
+	int group;
+	const char *name;
+} _modes[] = {
+	{ 0, 0, "send" },		/* sidp_seq_data_send() per subscriber */
+	{ 1, 0, "publish" },		/* Per-subscriber keys: compressed once */
+	{ 1, 1, "publish-group" }	/* Group key: compressed and encrypted once */
+};
+
+static const size_t _sizes[] = { 64, 1024, 16384 };
+
+static struct sidpconn *_pub;		/* Publisher side */
+static struct sidpconn **_pub_ptr;
+static struct sidpconn *_sub;		/* Subscriber side */
+static unsigned int _subscribers = BENCH_SUBSCRIBERS;
+
+static uint64_t _nsec(void) {
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void _conn_setup(struct sidpconn *conn, int fd, uint32_t sdev, uint32_t ddev, const char *key) {
+	sidp_conn_init(conn, fd, sdev, ddev, 7, SIDP_CONN_TYPE_NORMAL);
+	sidp_conn_set_key(conn, (const unsigned char *) key);
+
+	set_bit(&conn->status_flags, SIDP_INITIATED_FL);
+	set_bit(&conn->status_flags, SIDP_AUTHENTICATED_FL);
+	set_bit(&conn->status_flags, SIDP_NEGOTIATED_FL);
+	set_bit(&conn->negotiate_flags, SIDP_NEGOTIATE_ENCAP_DEFAULT_FL);
+	set_bit(&conn->negotiate_flags, SIDP_NEGOTIATE_COMPRESS_LZ4_FL);
+	set_bit(&conn->negotiate_flags, SIDP_NEGOTIATE_CIPHER_CHACHA_FL);
+}
+
+static void _setup(int group) {
+	char key[32];
+	unsigned int i;
+	int sv[2];
+
+	for (i = 0; i < _subscribers; i ++) {
+		if (socketpair(AF_UNIX, SOCK_STREAM, 0, sv) < 0) {
+			printf("Error #1\n");
+			exit(1);
+		}
+
+		if (group) {
+			strcpy(key, "group key");
+		} else {
+			sprintf(key, "subscriber key %u", i);
+		}
+
+		_conn_setup(&_pub[i], sv[0], 1, 1000 + i, key);
+		_conn_setup(&_sub[i], sv[1], 1000 + i, 1, key);
+
+		_pub_ptr[i] = &_pub[i];
+	}
+}
+
+static void _teardown(void) {
+	unsigned int i;
+
+	for (i = 0; i < _subscribers; i ++) {
+		sidp_conn_close(&_pub[i]);
+		sidp_conn_close(&_sub[i]);
+	}
+}
+
+/* Sensor-like records: compressible, but not trivially */
+static void _fill(unsigned char *msg, size_t len, unsigned int seq) {
+	size_t i;
+
+	for (i = 0; i < len; i ++)
+		msg[i] = (unsigned char) ((i % 16) < 8 ? (seq + i / 16) >> ((i % 4) * 2) : rand());
+}
+
+static void _bench(unsigned int m, size_t len) {
+	static unsigned char msg[BENCH_MSG_MAX], rmsg[BENCH_MSG_MAX];
+	uint64_t start, elapsed = 0;
+	unsigned int r, i;
+	size_t rlen;
+
+	_setup(_modes[m].group);
+
+	for (r = 0; r < BENCH_ROUNDS; r ++) {
+		_fill(msg, len, r);
+
+		/* Publish the message to every subscriber, timed */
+		start = _nsec();
+
+		if (_modes[m].publish) {
+			if (sidp_seq_data_publish(_pub_ptr, _subscribers, msg, len, NULL) != (int) _subscribers) {
+				printf("Error #2\n");
+				exit(1);
+			}
+		} else {
+			for (i = 0; i < _subscribers; i ++) {
+				if (sidp_seq_data_send(&_pub[i], msg, len) < 0) {
+					printf("Error #2\n");
+					exit(1);
+				}
+			}
+		}
+
+		elapsed += _nsec() - start;
+
+		/* Every subscriber receives and checks the message */
+		for (i = 0; i < _subscribers; i ++) {
+			if ((sidp_seq_data_recv(&_sub[i], rmsg, &rlen) < 0) || (rlen != len) || memcmp(rmsg, msg, len)) {
+				printf("Error #3\n");
+				exit(1);
+			}
+		}
+	}
+
+	_teardown();
+
+	printf("%s %zu %u %.1f %.0f\n", _modes[m].name, len, _subscribers,
+		(double) elapsed / BENCH_ROUNDS / 1e3,
+		(double) _subscribers * BENCH_ROUNDS * 1e9 / elapsed);
+}
+
+int main(int argc, char *argv[]) {
+	struct rlimit rl;
+	unsigned int m, s;
+
+	if (argc > 1)
+		_subscribers = atoi(argv[1]);
+
+	if (!_subscribers) {
+		fprintf(stderr, "Usage: %s [subscribers]\n", argv[0]);
+		return 1;
+	}
+
+	/* Two sockets per subscriber */
+	if (!getrlimit(RLIMIT_NOFILE, &rl) && (rl.rlim_cur < (2 * _subscribers + 64))) {
+		rl.rlim_cur = (rl.rlim_max < (2 * _subscribers + 64)) ? rl.rlim_max : (2 * _subscribers + 64);
+		setrlimit(RLIMIT_NOFILE, &rl);
+	}
+
+	_pub = calloc(_subscribers, sizeof(struct sidpconn));
+	_pub_ptr = calloc(_subscribers, sizeof(struct sidpconn *));
+	_sub = calloc(_subscribers, sizeof(struct sidpconn));
+
+	printf("mode size subscribers usec_per_publish msgs_per_sec\n");
+
+	for (s = 0; s < sizeof(_sizes) / sizeof(size_t); s ++) {
+		for (m = 0; m < sizeof(_modes) / sizeof(_modes[0]); m ++)
+			_bench(m, _sizes[s]);
+	}
+
+	free(_pub);
+	free(_pub_ptr);
+	free(_sub);
+
+	return 0;
+}
@@ -0,0 +1,125 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <time.h>
+#include <pthread.h>
+
+#include <openssl/rand.h>
+
+#include "rng.h"
+
+#define BENCH_MIN_NSEC		200000000ULL
+#define BENCH_THREADS_MAX	64
+
+/* Sizes drawn per call: a GCM nonce, an XSalsa20 nonce, an SRP ephemeral */
+static const size_t _sizes[] = { 12, 24, 32 };
+
+struct bench_thread {
+	pthread_t tid;
+	int (*draw) (unsigned char *, size_t);
+	size_t len;
+	uint64_t calls;
+};
+
+static pthread_barrier_t _start;
+static volatile int _stop;
+
+static uint64_t _nsec(void) {
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static int _draw_openssl(unsigned char *buf, size_t len) {
+	return -(RAND_bytes(buf, len) != 1);
+}
+
+static int _draw_sidp(unsigned char *buf, size_t len) {
+	return sidp_rng_bytes(buf, len);
+}
+
+static void *_worker(void *arg) {
+	struct bench_thread *bt = arg;
+	unsigned char buf[64];
+
+	/* Seed the per-thread generator before the clock starts */
+	bt->draw(buf, bt->len);
+
+	pthread_barrier_wait(&_start);
+
+	while (!_stop) {
+		if (bt->draw(buf, bt->len) < 0) {
+			printf("Error #1\n");
+			exit(1);
+		}
+
+		bt->calls ++;
+	}
+
+	return NULL;
+}
+
+/* Returns the aggregate number of calls per second of 'nthreads' threads */
+static double _run(int (*draw) (unsigned char *, size_t), size_t len, unsigned int nthreads) {
+	struct bench_thread bt[BENCH_THREADS_MAX];
+	uint64_t start, elapsed, calls = 0;
+	unsigned int i;
+
+	memset(bt, 0, sizeof(bt));
+
+	_stop = 0;
+	pthread_barrier_init(&_start, NULL, nthreads + 1);
+
+	for (i = 0; i < nthreads; i ++) {
+		bt[i].draw = draw;
+		bt[i].len = len;
+
+		if (pthread_create(&bt[i].tid, NULL, _worker, &bt[i])) {
+			printf("Error #2\n");
+			exit(1);
+		}
+	}
+
+	pthread_barrier_wait(&_start);
+
+	start = _nsec();
+
+	while ((elapsed = _nsec() - start) < BENCH_MIN_NSEC) {
+		struct timespec ts = { 0, 10000000 };
+
+		nanosleep(&ts, NULL);
+	}
+
+	_stop = 1;
+
+	for (i = 0; i < nthreads; i ++) {
+		pthread_join(bt[i].tid, NULL);
+		calls += bt[i].calls;
+	}
+
+	pthread_barrier_destroy(&_start);
+
+	return calls / (elapsed / 1000000000.0);
+}
+
+int main(int argc, char *argv[]) {
+	unsigned int s, nthreads;
+	double openssl, sidp;
+
+	printf("size threads openssl_mcalls sidp_mcalls speedup\n");
+
+	for (s = 0; s < sizeof(_sizes) / sizeof(size_t); s ++) {
+		for (nthreads = 1; nthreads <= BENCH_THREADS_MAX; nthreads *= 2) {
+			openssl = _run(_draw_openssl, _sizes[s], nthreads);
+			sidp = _run(_draw_sidp, _sizes[s], nthreads);
+
+			printf("%zu %u %.2f %.2f %.2fx\n", _sizes[s], nthreads, openssl / 1000000.0, sidp / 1000000.0, sidp / openssl);
+		}
+	}
+
+	return 0;
+}
+
@@ -0,0 +1,206 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "srp.h"
+
+#define BENCH_MIN_NSEC		500000000ULL
+#define BENCH_THREADS_MAX	8
+
+/* RFC 5054 2048-bit group, passed as a custom group so that it's parsed on
+ * every object, as the predefined groups were before being cached
+ */
+static const char *_n_hex =
+	"AC6BDB41324A9A9BF166DE5E1389582FAF72B6651987EE07FC3192943DB56050A37329CBB4"
+	"A099ED8193E0757767A13DD52312AB4B03310DCD7F48A9DA04FD50E8083969EDB767B0CF60"
+	"95179A163AB3661A05FBD5FAAAE82918A9962F0B93B855F97993EC975EEAA80D740ADBF4FF"
+	"747359D041D5C33EA71D281E446B14773BCA97B43A23FB801676BD207A436C6481F1D2B907"
+	"8717461A5B9D32E688F87748544523B524B0D57D5EA77A2775D2ECFA032CFBDBF52FB37861"
+	"60279004E57AE6AF874E7303CE53299CCC041C7BC308D82A5698F3A8D0C38271AE35F8E9DB"
+	"FBB694B5C803D89F7AE435DE236D525F54759B65E372FCD68EF20FA7111F9E4AFF73";
+static const char *_g_hex = "2";
+
+static const struct {
+	int cached;
+	int stored;
+	const char *name;
+} _modes[] = {
+	{ 0, 0, "uncached" },		/* Group parsed per object, verifier per handshake */
+	{ 1, 0, "cached" },		/* Shared group and fixed-base table of g */
+	{ 1, 1, "cached-vstore" }	/* ... and the verifier created once (verifier store) */
+};
+
+struct bench_thread {
+	pthread_t tid;
+	unsigned int m;
+	uint64_t handshakes;
+};
+
+static pthread_barrier_t _start;
+static volatile int _stop;
+
+static uint64_t _nsec(void) {
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void _verifier(unsigned int m, const unsigned char **bytes_s, int *len_s, const unsigned char **bytes_v, int *len_v) {
+	if (_modes[m].cached) {
+		srp_create_salted_verification_key(SRP_SHA1, SRP_NG_2048, "bench", (const unsigned char *) "bench password", 14, bytes_s, len_s, bytes_v, len_v, NULL, NULL);
+	} else {
+		srp_create_salted_verification_key(SRP_SHA1, SRP_NG_CUSTOM, "bench", (const unsigned char *) "bench password", 14, bytes_s, len_s, bytes_v, len_v, _n_hex, _g_hex);
+	}
+}
+
+/* Both end-points of a SRP exchange, as run by the authentication sequences */
+static void _handshake(unsigned int m, const unsigned char *st_s, int st_len_s, const unsigned char *st_v, int st_len_v) {
+	SRP_NGType ng_type = _modes[m].cached ? SRP_NG_2048 : SRP_NG_CUSTOM;
+	const char *n_hex = _modes[m].cached ? NULL : _n_hex;
+	const char *g_hex = _modes[m].cached ? NULL : _g_hex;
+	struct SRPUser *usr;
+	struct SRPVerifier *ver;
+
+	const unsigned char *bytes_s = st_s;
+	const unsigned char *bytes_v = st_v;
+	const unsigned char *bytes_A = NULL;
+	const unsigned char *bytes_B = NULL;
+	const unsigned char *bytes_M = NULL;
+	const unsigned char *bytes_HAMK = NULL;
+	const char *username = NULL;
+
+	int len_s = st_len_s;
+	int len_v = st_len_v;
+	int len_A = 0;
+	int len_B = 0;
+	int len_M = 0;
+
+	usr = srp_user_new(SRP_SHA1, ng_type, "bench", (const unsigned char *) "bench password", 14, n_hex, g_hex);
+	srp_user_start_authentication(usr, &username, &bytes_A, &len_A);
+
+	if (!_modes[m].stored)
+		_verifier(m, &bytes_s, &len_s, &bytes_v, &len_v);
+
+	ver = srp_verifier_new(SRP_SHA1, ng_type, username, bytes_s, len_s, bytes_v, len_v, bytes_A, len_A, &bytes_B, &len_B, n_hex, g_hex);
+
+	srp_user_process_challenge(usr, bytes_s, len_s, bytes_B, len_B, &bytes_M, &len_M);
+
+	if (!bytes_M) {
+		printf("Error #1\n");
+		exit(1);
+	}
+
+	srp_verifier_verify_session(ver, bytes_M, &bytes_HAMK);
+
+	if (!bytes_HAMK) {
+		printf("Error #2\n");
+		exit(1);
+	}
+
+	srp_user_verify_session(usr, bytes_HAMK);
+
+	if (!srp_user_is_authenticated(usr)) {
+		printf("Error #3\n");
+		exit(1);
+	}
+
+	srp_verifier_delete(ver);
+	srp_user_delete(usr);
+
+	if (!_modes[m].stored) {
+		free((void *) bytes_s);
+		free((void *) bytes_v);
+	}
+}
+
+static void *_worker(void *arg) {
+	struct bench_thread *bt = arg;
+	const unsigned char *bytes_s, *bytes_v;
+	int len_s, len_v;
+
+	/* The stored verifier (and the cached group) are set up before the clock
+	 * starts
+	 */
+	_verifier(bt->m, &bytes_s, &len_s, &bytes_v, &len_v);
+
+	pthread_barrier_wait(&_start);
+
+	while (!_stop) {
+		_handshake(bt->m, bytes_s, len_s, bytes_v, len_v);
+		bt->handshakes ++;
+	}
+
+	free((void *) bytes_s);
+	free((void *) bytes_v);
+
+	return NULL;
+}
+
+/* Returns the aggregate number of handshakes per second of 'nthreads' threads */
+static double _run(unsigned int m, unsigned int nthreads) {
+	struct bench_thread bt[BENCH_THREADS_MAX];
+	uint64_t start, elapsed, handshakes = 0;
+	unsigned int i;
+
+	memset(bt, 0, sizeof(bt));
+
+	_stop = 0;
+	pthread_barrier_init(&_start, NULL, nthreads + 1);
+
+	for (i = 0; i < nthreads; i ++) {
+		bt[i].m = m;
+
+		if (pthread_create(&bt[i].tid, NULL, _worker, &bt[i])) {
+			printf("Error #4\n");
+			exit(1);
+		}
+	}
+
+	pthread_barrier_wait(&_start);
+
+	start = _nsec();
+
+	while ((elapsed = _nsec() - start) < BENCH_MIN_NSEC) {
+		struct timespec ts = { 0, 10000000 };
+
+		nanosleep(&ts, NULL);
+	}
+
+	_stop = 1;
+
+	for (i = 0; i < nthreads; i ++) {
+		pthread_join(bt[i].tid, NULL);
+		handshakes += bt[i].handshakes;
+	}
+
+	pthread_barrier_destroy(&_start);
+
+	return handshakes / (elapsed / 1000000000.0);
+}
+
+int main(int argc, char *argv[]) {
+	unsigned int m, nthreads;
+	double base, rate;
+
+	printf("mode threads handshakes_per_sec speedup\n");
+
+	for (nthreads = 1; nthreads <= BENCH_THREADS_MAX; nthreads *= 2) {
+		base = 0;
+
+		for (m = 0; m < sizeof(_modes) / sizeof(_modes[0]); m ++) {
+			rate = _run(m, nthreads);
+
+			if (!m)
+				base = rate;
+
+			printf("%s %u %.0f %.2fx\n", _modes[m].name, nthreads, rate, rate / base);
+		}
+	}
+
+	return 0;
+}
@@ -0,0 +1,142 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <time.h>
+
+#include <fastlz/fastlz.h>
+#include <minilzo/minilzo.h>
+
+/* Reference decompressors (wildcopy_ref.c) */
+int ref_fastlz_decompress(const void *input, int length, void *output, int maxout);
+int ref_lzo1x_decompress_safe(const lzo_bytep in, lzo_uint in_len, lzo_bytep out, lzo_uintp out_len, lzo_voidp wrkmem);
+
+#define BENCH_MIN_NSEC	200000000ULL
+#define BENCH_MSG_MAX	65536
+
+static const char *_words[] = {
+	"the ", "sensor ", "reported ", "a ", "value ", "of ", "within ", "expected ",
+	"range ", "for ", "device ", "temperature ", "and ", "pressure ", ".\n"
+};
+
+static uint64_t _nsec(void) {
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void _gen(unsigned char *buf, size_t len, const char *type) {
+	size_t i = 0, n;
+	char tmp[128];
+	unsigned int t = 1400000000, seq = 0;
+
+	while (i < len) {
+		if (!strcmp(type, "text")) {
+			n = snprintf(tmp, sizeof(tmp), "%s", _words[rand() % (sizeof(_words) / sizeof(char *))]);
+		} else if (!strcmp(type, "json")) {
+			n = snprintf(tmp, sizeof(tmp), "{\"id\":%u,\"ts\":%u,\"temp\":%d.%d,\"ok\":true},", seq ++, t ++, 20 + rand() % 5, rand() % 10);
+		} else if (!strcmp(type, "telemetry")) {
+			uint32_t rec[4] = { t ++, seq ++, 1000 + rand() % 16, 0x55aa };
+
+			n = sizeof(rec);
+			memcpy(tmp, rec, n);
+		} else {
+			n = 1;
+			tmp[0] = rand();
+		}
+
+		if (n > (len - i))
+			n = len - i;
+
+		memcpy(buf + i, tmp, n);
+		i += n;
+	}
+}
+
+static double _run(const char *codec, int ref, const unsigned char *comp, size_t comp_len, unsigned char *out, size_t out_len) {
+	uint64_t start = _nsec(), elapsed, bytes = 0;
+	lzo_uint len;
+
+	do {
+		if (!strcmp(codec, "fastlz")) {
+			if (ref) {
+				bytes += ref_fastlz_decompress(comp, comp_len, out, out_len);
+			} else {
+				bytes += fastlz_decompress(comp, comp_len, out, out_len);
+			}
+		} else {
+			len = out_len;
+
+			if (ref) {
+				ref_lzo1x_decompress_safe(comp, comp_len, out, &len, NULL);
+			} else {
+				lzo1x_decompress_safe(comp, comp_len, out, &len, NULL);
+			}
+
+			bytes += len;
+		}
+	} while ((elapsed = _nsec() - start) < BENCH_MIN_NSEC);
+
+	return (bytes / 1048576.0) / (elapsed / 1000000000.0);
+}
+
+int main(int argc, char *argv[]) {
+	static unsigned char wrkmem[LZO1X_1_MEM_COMPRESS];
+	static const char *codecs[] = { "fastlz", "lzo1x" };
+	static const char *types[] = { "text", "json", "telemetry", "random" };
+	static const size_t sizes[] = { 1024, 4096, 16384, 65536 };
+	unsigned char *in = malloc(BENCH_MSG_MAX), *comp = malloc(BENCH_MSG_MAX * 2), *out = malloc(BENCH_MSG_MAX);
+	unsigned int c, t, s;
+	size_t comp_len;
+	lzo_uint len;
+	double before, after;
+
+	if (lzo_init() != LZO_E_OK) {
+		printf("Error #1.\n");
+		return 1;
+	}
+
+	printf("codec type size ratio before_mbs after_mbs speedup\n");
+
+	for (c = 0; c < sizeof(codecs) / sizeof(char *); c ++) {
+		for (t = 0; t < sizeof(types) / sizeof(char *); t ++) {
+			for (s = 0; s < sizeof(sizes) / sizeof(size_t); s ++) {
+				srand(s + 1);
+				_gen(in, sizes[s], types[t]);
+
+				if (!strcmp(codecs[c], "fastlz")) {
+					comp_len = fastlz_compress_level(1, in, sizes[s], comp);
+				} else {
+					lzo1x_1_compress(in, sizes[s], comp, &len, wrkmem);
+					comp_len = len;
+				}
+
+				/* Both decompressors must produce the original data */
+				before = _run(codecs[c], 1, comp, comp_len, out, sizes[s]);
+
+				if (memcmp(in, out, sizes[s])) {
+					printf("Error #2: %s %s %zu\n", codecs[c], types[t], sizes[s]);
+					return 1;
+				}
+
+				memset(out, 0, sizes[s]);
+				after = _run(codecs[c], 0, comp, comp_len, out, sizes[s]);
+
+				if (memcmp(in, out, sizes[s])) {
+					printf("Error #3: %s %s %zu\n", codecs[c], types[t], sizes[s]);
+					return 1;
+				}
+
+				printf("%s %s %zu %.3f %.1f %.1f %.2f\n", codecs[c], types[t], sizes[s], (double) comp_len / sizes[s], before, after, after / before);
+			}
+		}
+	}
+
+	free(in);
+	free(comp);
+	free(out);
+
+	return 0;
+}
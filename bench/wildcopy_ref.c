@@ -0,0 +1,21 @@
+/*
+ * Reference (pre wild-copy) FastLZ and LZO1X decompressors, built from the
+ * vendored sources with the wild-copy paths disabled and the public symbols
+ * renamed, so that wildcopy.c can compare them against the installed libraries.
+ */
+
+#define FASTLZ_NO_WILDCOPY
+#define fastlz_compress ref_fastlz_compress
+#define fastlz_compress_level ref_fastlz_compress_level
+#define fastlz_decompress ref_fastlz_decompress
+#include "../deps/fastlz/src/fastlz.c"
+
+#define LZO_NO_WILDCOPY
+#define MINILZO_CFG_SKIP_LZO_PTR 1
+#define MINILZO_CFG_SKIP_LZO_UTIL 1
+#define MINILZO_CFG_SKIP_LZO_STRING 1
+#define MINILZO_CFG_SKIP_LZO_INIT 1
+#define MINILZO_CFG_SKIP_LZO1X_1_COMPRESS 1
+#define MINILZO_CFG_SKIP_LZO1X_DECOMPRESS 1
+#define lzo1x_decompress_safe ref_lzo1x_decompress_safe
+#include "../deps/minilzo/src/minilzo.c"
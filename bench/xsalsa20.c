@@ -0,0 +1,96 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <time.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#include <nacl/crypto_stream.h>
+
+/* Reference XSalsa20 (xsalsa20_ref.c) */
+int ref_crypto_stream_xor(unsigned char *c, const unsigned char *m, unsigned long long mlen, const unsigned char *n, const unsigned char *k);
+
+#define BENCH_MIN_NSEC	200000000ULL
+#define BENCH_MSG_MAX	65536
+
+static uint64_t _nsec(void) {
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static uint64_t _cycles(void) {
+#if defined(__x86_64__) || defined(__i386__)
+	return __rdtsc();
+#else
+	return 0;
+#endif
+}
+
+/* Returns cycles per byte and sets 'mbs' to MB/s */
+static double _run(int ref, unsigned char *out, const unsigned char *in, size_t len, const unsigned char *n, const unsigned char *k, double *mbs) {
+	uint64_t start = _nsec(), elapsed, cyc = _cycles(), bytes = 0;
+
+	do {
+		if (ref) {
+			ref_crypto_stream_xor(out, in, len, n, k);
+		} else {
+			crypto_stream_xor(out, in, len, n, k);
+		}
+
+		bytes += len;
+	} while ((elapsed = _nsec() - start) < BENCH_MIN_NSEC);
+
+	cyc = _cycles() - cyc;
+	*mbs = (bytes / 1048576.0) / (elapsed / 1000000000.0);
+
+	return (double) cyc / bytes;
+}
+
+int main(int argc, char *argv[]) {
+	static const size_t sizes[] = { 64, 256, 512, 1024, 1500, 4096, 16384, 65536 };
+	unsigned char *in = malloc(BENCH_MSG_MAX), *out = malloc(BENCH_MSG_MAX), *ref = malloc(BENCH_MSG_MAX);
+	unsigned char n[crypto_stream_NONCEBYTES], k[crypto_stream_KEYBYTES];
+	unsigned int i, s;
+	double before_cpb, after_cpb, before_mbs, after_mbs;
+
+	srand(1);
+
+	for (i = 0; i < sizeof(n); i ++)
+		n[i] = rand();
+
+	for (i = 0; i < sizeof(k); i ++)
+		k[i] = rand();
+
+	for (i = 0; i < BENCH_MSG_MAX; i ++)
+		in[i] = rand();
+
+	printf("size before_cpb after_cpb before_mbs after_mbs speedup\n");
+
+	for (s = 0; s < sizeof(sizes) / sizeof(size_t); s ++) {
+		/* Both implementations must produce the same stream */
+		ref_crypto_stream_xor(ref, in, sizes[s], n, k);
+		crypto_stream_xor(out, in, sizes[s], n, k);
+
+		if (memcmp(ref, out, sizes[s])) {
+			printf("Error #1: %zu\n", sizes[s]);
+			return 1;
+		}
+
+		before_cpb = _run(1, out, in, sizes[s], n, k, &before_mbs);
+		after_cpb = _run(0, out, in, sizes[s], n, k, &after_mbs);
+
+		printf("%zu %.2f %.2f %.1f %.1f %.2f\n", sizes[s], before_cpb, after_cpb, before_mbs, after_mbs, before_cpb / after_cpb);
+	}
+
+	free(in);
+	free(out);
+	free(ref);
+
+	return 0;
+}
@@ -0,0 +1,13 @@
+/*
+ * Reference (one block at a time) XSalsa20, built from the vendored sources
+ * with the SIMD kernels disabled and the public symbols renamed, so that
+ * xsalsa20.c can compare it against the installed library.
+ */
+
+#define SALSA20_NO_SIMD
+#define crypto_stream_salsa20_xor ref_crypto_stream_salsa20_xor
+#define crypto_stream_xor ref_crypto_stream_xor
+#include "../deps/nacl/src/xsalsa20/salsa20_xor.c"
+
+#define sigma ref_xsalsa20_sigma
+#include "../deps/nacl/src/xsalsa20/xsalsa20_xor.c"
@@ -0,0 +1,164 @@
+/*
+   ChaCha20 stream cipher and ChaCha20-Poly1305 AEAD
+
+   Portable, SSE2, AVX, AVX2 and AVX-512 implementations of the ChaCha20
+   stream cipher (D. J. Bernstein), with the kernel selected at runtime by CPU
+   feature. The keystream is the same as the one produced by chacha-avx and
+   chacha-avx2 (64-bit block counter on state words 12 and 13, 64-bit nonce
+   on words 14 and 15), so any implementation interoperates with any other.
+
+   Copyright 2012-2014 Pedro A. Hortas (pah@ucodev.org)
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#ifndef CRYPTO_CHACHA_H
+#define CRYPTO_CHACHA_H
+
+#if defined (__cplusplus)
+extern "C" {
+#endif
+
+/* Properties */
+#define CHACHA_CRYPTO_KEYBYTES		32
+#define CHACHA_CRYPTO_NONCEBYTES	8
+
+#define CHACHA_CRYPTO_AEAD_KEYBYTES	32
+#define CHACHA_CRYPTO_AEAD_NONCEBYTES	12
+#define CHACHA_CRYPTO_AEAD_TAGBYTES	16
+
+/*
+  chacha_crypto_stream_xor():
+    Encrypts (or decrypts) 'inlen' bytes from 'in' into 'out' with the
+    keystream generated from nonce 'n' and key 'k', starting at block 0.
+    'in' and 'out' may be the same buffer and need no particular alignment.
+    Returns 0.
+*/
+int chacha_crypto_stream_xor(unsigned char *out, const unsigned char *in,
+  unsigned long long inlen, const unsigned char *n, const unsigned char *k);
+
+/*
+  chacha_crypto_stream_xor_ic():
+    Same as chacha_crypto_stream_xor(), but starting at block 'ic' of the
+    keystream (64-bit block counter, wrapping modulo 2^64). Returns 0.
+*/
+int chacha_crypto_stream_xor_ic(unsigned char *out, const unsigned char *in,
+  unsigned long long inlen, const unsigned char *n, unsigned long long ic,
+  const unsigned char *k);
+
+/*
+  chacha_crypto_stream():
+    Writes 'outlen' bytes of keystream into 'out'. Returns 0.
+*/
+int chacha_crypto_stream(unsigned char *out, unsigned long long outlen,
+  const unsigned char *n, const unsigned char *k);
+
+/*
+  chacha_crypto_aead_encrypt():
+    ChaCha20-Poly1305 AEAD (RFC 8439). Encrypts 'mlen' bytes from 'm' into
+    'c' and writes the 16 byte authentication tag of the ciphertext and of
+    the 'adlen' bytes of associated data 'ad' into 'tag'. The Poly1305 key is
+    derived from keystream block 0, so a 12 byte nonce 'n' must never be
+    reused with the same key 'k'. The ciphertext is MACed chunk by chunk,
+    right after it is encrypted and while it is still in L1, with 4 (AVX2)
+    or 8 (AVX-512) Poly1305 lanes when the CPU supports them. 'm' and 'c'
+    may be the same buffer. Returns 0, or -1 if 'mlen' exceeds the RFC 8439
+    limit.
+*/
+int chacha_crypto_aead_encrypt(unsigned char *c, unsigned char *tag,
+  const unsigned char *m, unsigned long long mlen, const unsigned char *ad,
+  unsigned long long adlen, const unsigned char *n, const unsigned char *k);
+
+/*
+  chacha_crypto_aead_decrypt():
+    Verifies 'tag' against the 'clen' bytes of ciphertext 'c' and the
+    associated data 'ad', and decrypts 'c' into 'm'. Returns 0 on success,
+    or -1 if verification fails, in which case 'm' is zeroed.
+*/
+int chacha_crypto_aead_decrypt(unsigned char *m, const unsigned char *c,
+  unsigned long long clen, const unsigned char *tag, const unsigned char *ad,
+  unsigned long long adlen, const unsigned char *n, const unsigned char *k);
+
+/*
+  Batches: messages of different connections (each with its own key and
+  nonce) encrypted together, so that short messages, which leave most lanes
+  of the AVX2 and AVX-512 kernels empty on their own, fill them with the
+  blocks of each other. Each job is the same as a call to the function of
+  the same name without '_batch'. Messages have no ordering requirements and
+  may share buffers only with themselves ('in' and 'out' may be the same).
+*/
+struct chacha_crypto_stream_job {
+  unsigned char *out;
+  const unsigned char *in;
+  unsigned long long inlen;
+  const unsigned char *n;
+  unsigned long long ic;
+  const unsigned char *k;
+};
+
+struct chacha_crypto_aead_job {
+  unsigned char *out;		/* 'c' when encrypting, 'm' when decrypting */
+  unsigned char *tag;		/* Written when encrypting, verified when decrypting */
+  const unsigned char *in;
+  unsigned long long inlen;
+  const unsigned char *ad;
+  unsigned long long adlen;
+  const unsigned char *n;
+  const unsigned char *k;
+  int ret;			/* Result of the job */
+};
+
+/*
+  chacha_crypto_stream_xor_ic_batch():
+    chacha_crypto_stream_xor_ic() of 'njobs' jobs, one block of a different
+    message per lane of the multi-buffer kernels (8 with AVX2, 16 with
+    AVX-512). Returns 0.
+*/
+int chacha_crypto_stream_xor_ic_batch(struct chacha_crypto_stream_job *jobs,
+  unsigned int njobs);
+
+/*
+  chacha_crypto_aead_encrypt_batch():
+  chacha_crypto_aead_decrypt_batch():
+    chacha_crypto_aead_encrypt() (or _decrypt()) of 'njobs' jobs. Besides the
+    keystream, the tags of messages up to 1 KiB long are computed one message
+    per Poly1305 lane (4 with AVX2, 8 with AVX-512). Longer messages are
+    processed on their own. Sets 'ret' of every job, and returns 0 if all of
+    them succeeded, or -1 otherwise.
+*/
+int chacha_crypto_aead_encrypt_batch(struct chacha_crypto_aead_job *jobs,
+  unsigned int njobs);
+int chacha_crypto_aead_decrypt_batch(struct chacha_crypto_aead_job *jobs,
+  unsigned int njobs);
+
+/*
+  chacha_crypto_stream_impl():
+    Returns the name of the kernel in use ("ref", "sse2", "avx", "avx2" or
+    "avx512").
+*/
+const char *chacha_crypto_stream_impl(void);
+
+/*
+  chacha_crypto_stream_set_impl():
+    Forces the kernel named 'name' (see chacha_crypto_stream_impl()) for the
+    whole process, or the fastest one supported by the CPU if 'name' is NULL.
+    Returns 0 on success, or -1 if the kernel is unknown or not supported by
+    the CPU, in which case the current selection is kept.
+*/
+int chacha_crypto_stream_set_impl(const char *name);
+
+#if defined (__cplusplus)
+}
+#endif
+
+#endif
@@ -0,0 +1,1314 @@
+/*
+   ChaCha20 stream cipher
+
+   Copyright 2012-2014 Pedro A. Hortas (pah@ucodev.org)
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#include <string.h>
+#include <stdint.h>
+
+#include "chacha.h"
+
+/*
+ * The SIMD kernels generate whole groups of 4 (SSE2, AVX), 8 (AVX2) or 16
+ * (AVX-512) blocks in parallel, one block per vector lane, and are built
+ * with target attributes so that the library itself needs no -m flags.
+ * Define CHACHA_NO_SIMD to build only the portable kernel, or
+ * CHACHA_NO_AVX512 to leave the AVX-512 kernel out.
+ */
+#if !defined(CHACHA_NO_SIMD) && (defined(__x86_64__) || defined(__i386__)) && \
+	(defined(__clang__) || (__GNUC__ > 4) || ((__GNUC__ == 4) && (__GNUC_MINOR__ >= 9)))
+#define CHACHA_SIMD
+#include <immintrin.h>
+#if !defined(CHACHA_NO_AVX512) && (defined(__clang__) || (__GNUC__ >= 5))
+#define CHACHA_AVX512
+#endif
+#endif
+
+enum {
+	CHACHA_IMPL_REF,
+	CHACHA_IMPL_SSE2,
+	CHACHA_IMPL_AVX,
+	CHACHA_IMPL_AVX2,
+	CHACHA_IMPL_AVX512,
+	CHACHA_IMPL_MAX
+};
+
+static const char *chacha_impl_names[CHACHA_IMPL_MAX] = { "ref", "sse2", "avx", "avx2", "avx512" };
+
+/* Selected kernel, -1 until the first call */
+static int chacha_impl = -1;
+
+static uint32_t chacha_load32(const unsigned char *x) {
+	return (uint32_t) x[0] | ((uint32_t) x[1] << 8) | ((uint32_t) x[2] << 16) | ((uint32_t) x[3] << 24);
+}
+
+static void chacha_store32(unsigned char *x, uint32_t v) {
+	x[0] = v;
+	x[1] = v >> 8;
+	x[2] = v >> 16;
+	x[3] = v >> 24;
+}
+
+/*
+ * Initial state words: constants, key and nonce. Words 12 and 13 (the 64-bit
+ * block counter) are set per block by the kernels.
+ */
+static void chacha_state(uint32_t s[16], const unsigned char *n, const unsigned char *k) {
+	static const unsigned char sigma[16] = "expand 32-byte k";
+	int i;
+
+	for (i = 0; i < 4; i ++)
+		s[i] = chacha_load32(sigma + i * 4);
+
+	for (i = 0; i < 8; i ++)
+		s[4 + i] = chacha_load32(k + i * 4);
+
+	s[12] = 0;
+	s[13] = 0;
+	s[14] = chacha_load32(n + 0);
+	s[15] = chacha_load32(n + 4);
+}
+
+/* ChaCha quarter round and double round on x0..x15 (scalars or vectors) */
+#define CHACHA_QR(ADD, XOR, ROTL, a, b, c, d) \
+	do { \
+		a = ADD(a, b); d = ROTL(XOR(d, a), 16); \
+		c = ADD(c, d); b = ROTL(XOR(b, c), 12); \
+		a = ADD(a, b); d = ROTL(XOR(d, a), 8); \
+		c = ADD(c, d); b = ROTL(XOR(b, c), 7); \
+	} while (0)
+
+#define CHACHA_DOUBLEROUND(ADD, XOR, ROTL) \
+	do { \
+		CHACHA_QR(ADD, XOR, ROTL, x0, x4, x8, x12); \
+		CHACHA_QR(ADD, XOR, ROTL, x1, x5, x9, x13); \
+		CHACHA_QR(ADD, XOR, ROTL, x2, x6, x10, x14); \
+		CHACHA_QR(ADD, XOR, ROTL, x3, x7, x11, x15); \
+		CHACHA_QR(ADD, XOR, ROTL, x0, x5, x10, x15); \
+		CHACHA_QR(ADD, XOR, ROTL, x1, x6, x11, x12); \
+		CHACHA_QR(ADD, XOR, ROTL, x2, x7, x8, x13); \
+		CHACHA_QR(ADD, XOR, ROTL, x3, x4, x9, x14); \
+	} while (0)
+
+#define REF_ADD(a, b) ((uint32_t) ((a) + (b)))
+#define REF_XOR(a, b) ((a) ^ (b))
+#define REF_ROTL(a, r) ((uint32_t) (((a) << (r)) | ((a) >> (32 - (r)))))
+
+/* Keystream block 'counter' */
+static void chacha_block(unsigned char out[64], const uint32_t s[16], unsigned long long counter) {
+	uint32_t x0 = s[0], x1 = s[1], x2 = s[2], x3 = s[3];
+	uint32_t x4 = s[4], x5 = s[5], x6 = s[6], x7 = s[7];
+	uint32_t x8 = s[8], x9 = s[9], x10 = s[10], x11 = s[11];
+	uint32_t x12 = counter, x13 = counter >> 32, x14 = s[14], x15 = s[15];
+	int i;
+
+	for (i = 20; i > 0; i -= 2)
+		CHACHA_DOUBLEROUND(REF_ADD, REF_XOR, REF_ROTL);
+
+	chacha_store32(out + 0, x0 + s[0]);
+	chacha_store32(out + 4, x1 + s[1]);
+	chacha_store32(out + 8, x2 + s[2]);
+	chacha_store32(out + 12, x3 + s[3]);
+	chacha_store32(out + 16, x4 + s[4]);
+	chacha_store32(out + 20, x5 + s[5]);
+	chacha_store32(out + 24, x6 + s[6]);
+	chacha_store32(out + 28, x7 + s[7]);
+	chacha_store32(out + 32, x8 + s[8]);
+	chacha_store32(out + 36, x9 + s[9]);
+	chacha_store32(out + 40, x10 + s[10]);
+	chacha_store32(out + 44, x11 + s[11]);
+	chacha_store32(out + 48, x12 + (uint32_t) counter);
+	chacha_store32(out + 52, x13 + (uint32_t) (counter >> 32));
+	chacha_store32(out + 56, x14 + s[14]);
+	chacha_store32(out + 60, x15 + s[15]);
+}
+
+/*
+ * Multi-buffer queue: keystream blocks of different states (messages of a
+ * batch) waiting for a lane of the multi-buffer kernels, which generate one
+ * block per lane where the other kernels generate consecutive blocks of a
+ * single state
+ */
+#define CHACHA_MB_LANES		16
+
+/* Up to this many blocks queued, the reference block function is faster */
+#define CHACHA_MB_SCALAR	2
+
+typedef struct {
+	uint32_t rows[CHACHA_MB_LANES][16];	/* Input words of each block, counter included */
+	unsigned char *out[CHACHA_MB_LANES];
+	const unsigned char *in[CHACHA_MB_LANES];
+	unsigned int bytes[CHACHA_MB_LANES];	/* 64, but less on the last block of a message */
+	unsigned int n;				/* Blocks queued */
+	unsigned int lanes;			/* Lanes of the widest kernel, 0 if there's none */
+} chacha_mb;
+
+/* XORs 'bytes' (up to 64) bytes of keystream block 'ks' */
+static void chacha_mb_out(unsigned char *out, const unsigned char *in, const unsigned char *ks, unsigned int bytes) {
+	uint64_t a, b;
+	unsigned int i;
+
+	for (i = 0; (i + 8) <= bytes; i += 8) {
+		memcpy(&a, in + i, 8);
+		memcpy(&b, ks + i, 8);
+		a ^= b;
+		memcpy(out + i, &a, 8);
+	}
+
+	for (; i < bytes; i ++)
+		out[i] = in[i] ^ ks[i];
+}
+
+#include "chacha_poly1305.h"
+
+#ifdef CHACHA_SIMD
+
+#define VEC4_ADD(a, b) _mm_add_epi32(a, b)
+#define VEC4_XOR(a, b) _mm_xor_si128(a, b)
+
+/* SSE2 has no byte shuffle: every rotation is two shifts and an or */
+#define SSE2_ROTL(a, r) _mm_or_si128(_mm_slli_epi32(a, r), _mm_srli_epi32(a, 32 - (r)))
+
+/* SSSE3 (implied by AVX) rotates by 16 and 8 with a single byte shuffle */
+#define AVX_ROTL(a, r) AVX_ROTL_##r(a)
+#define AVX_ROTL_16(a) _mm_shuffle_epi8(a, _mm_set_epi8(13, 12, 15, 14, 9, 8, 11, 10, 5, 4, 7, 6, 1, 0, 3, 2))
+#define AVX_ROTL_12(a) SSE2_ROTL(a, 12)
+#define AVX_ROTL_8(a) _mm_shuffle_epi8(a, _mm_set_epi8(14, 13, 12, 15, 10, 9, 8, 11, 6, 5, 4, 7, 2, 1, 0, 3))
+#define AVX_ROTL_7(a) SSE2_ROTL(a, 7)
+
+/* 4x4 transpose of 32-bit words: a..d become words i..i+3 of blocks 0..3 */
+#define VEC4_TRANSPOSE(a, b, c, d) \
+	do { \
+		__m128i t0 = _mm_unpacklo_epi32(a, b), t1 = _mm_unpacklo_epi32(c, d); \
+		__m128i t2 = _mm_unpackhi_epi32(a, b), t3 = _mm_unpackhi_epi32(c, d); \
+		a = _mm_unpacklo_epi64(t0, t1); b = _mm_unpackhi_epi64(t0, t1); \
+		c = _mm_unpacklo_epi64(t2, t3); d = _mm_unpackhi_epi64(t2, t3); \
+	} while (0)
+
+#define VEC4_XOR_STORE(o, v) \
+	_mm_storeu_si128((__m128i *) (out + (o)), _mm_xor_si128(v, _mm_loadu_si128((const __m128i *) (in + (o)))))
+
+#define CHACHA_VEC4_KERNEL	chacha_xor_sse2
+#define CHACHA_VEC4_TARGET	"sse2"
+#define CHACHA_VEC4_ROTL	SSE2_ROTL
+#include "chacha_vec4.h"
+#undef CHACHA_VEC4_KERNEL
+#undef CHACHA_VEC4_TARGET
+#undef CHACHA_VEC4_ROTL
+
+#define CHACHA_VEC4_KERNEL	chacha_xor_avx
+#define CHACHA_VEC4_TARGET	"avx"
+#define CHACHA_VEC4_ROTL	AVX_ROTL
+#include "chacha_vec4.h"
+#undef CHACHA_VEC4_KERNEL
+#undef CHACHA_VEC4_TARGET
+#undef CHACHA_VEC4_ROTL
+
+#define AVX2_ADD(a, b) _mm256_add_epi32(a, b)
+#define AVX2_XOR(a, b) _mm256_xor_si256(a, b)
+#define AVX2_ROTL(a, r) AVX2_ROTL_##r(a)
+#define AVX2_ROTL_16(a) _mm256_shuffle_epi8(a, _mm256_set_epi8(13, 12, 15, 14, 9, 8, 11, 10, 5, 4, 7, 6, 1, 0, 3, 2, \
+	13, 12, 15, 14, 9, 8, 11, 10, 5, 4, 7, 6, 1, 0, 3, 2))
+#define AVX2_ROTL_12(a) _mm256_or_si256(_mm256_slli_epi32(a, 12), _mm256_srli_epi32(a, 20))
+#define AVX2_ROTL_8(a) _mm256_shuffle_epi8(a, _mm256_set_epi8(14, 13, 12, 15, 10, 9, 8, 11, 6, 5, 4, 7, 2, 1, 0, 3, \
+	14, 13, 12, 15, 10, 9, 8, 11, 6, 5, 4, 7, 2, 1, 0, 3))
+#define AVX2_ROTL_7(a) _mm256_or_si256(_mm256_slli_epi32(a, 7), _mm256_srli_epi32(a, 25))
+
+/*
+ * 4x4 transpose within each 128-bit half: a..d become words i..i+3 of blocks
+ * 0..3 (low half) and 4..7 (high half)
+ */
+#define AVX2_TRANSPOSE(a, b, c, d) \
+	do { \
+		__m256i t0 = _mm256_unpacklo_epi32(a, b), t1 = _mm256_unpacklo_epi32(c, d); \
+		__m256i t2 = _mm256_unpackhi_epi32(a, b), t3 = _mm256_unpackhi_epi32(c, d); \
+		a = _mm256_unpacklo_epi64(t0, t1); b = _mm256_unpackhi_epi64(t0, t1); \
+		c = _mm256_unpacklo_epi64(t2, t3); d = _mm256_unpackhi_epi64(t2, t3); \
+	} while (0)
+
+/* Words 0..7 (a, b) or 8..15 of block n and n + 4, written by STORE(o, v) */
+#define AVX2_STORE_PAIR(STORE, o, a, b) \
+	do { \
+		__m256i lo = _mm256_permute2x128_si256(a, b, 0x20), hi = _mm256_permute2x128_si256(a, b, 0x31); \
+		STORE(o, lo); \
+		STORE((o) + 256, hi); \
+	} while (0)
+
+#define AVX2_XOR_STORE_ONE(o, v) \
+	_mm256_storeu_si256((__m256i *) (out + (o)), _mm256_xor_si256(v, _mm256_loadu_si256((const __m256i *) (in + (o)))))
+#define AVX2_KS_STORE_ONE(o, v) \
+	_mm256_storeu_si256((__m256i *) (ks + (o)), v)
+
+#define AVX2_XOR_STORE(o, a, b) AVX2_STORE_PAIR(AVX2_XOR_STORE_ONE, o, a, b)
+#define AVX2_KS_STORE(o, a, b) AVX2_STORE_PAIR(AVX2_KS_STORE_ONE, o, a, b)
+
+/* Processes 'blocks' (a multiple of 8) blocks starting at block 'counter' */
+static __attribute__((target("avx2"))) void chacha_xor_avx2(
+		unsigned char *out,
+		const unsigned char *in,
+		unsigned long long blocks,
+		const uint32_t s[16],
+		unsigned long long counter) {
+	__m256i x0, x1, x2, x3, x4, x5, x6, x7, x8, x9, x10, x11, x12, x13, x14, x15;
+	__m256i j12, j13;
+	int i;
+
+	for (; blocks; blocks -= 8, counter += 8, out += 512, in += 512) {
+		x0 = _mm256_set1_epi32(s[0]); x1 = _mm256_set1_epi32(s[1]); x2 = _mm256_set1_epi32(s[2]); x3 = _mm256_set1_epi32(s[3]);
+		x4 = _mm256_set1_epi32(s[4]); x5 = _mm256_set1_epi32(s[5]); x6 = _mm256_set1_epi32(s[6]); x7 = _mm256_set1_epi32(s[7]);
+		x8 = _mm256_set1_epi32(s[8]); x9 = _mm256_set1_epi32(s[9]); x10 = _mm256_set1_epi32(s[10]); x11 = _mm256_set1_epi32(s[11]);
+		x12 = j12 = _mm256_set_epi32(counter + 7, counter + 6, counter + 5, counter + 4, counter + 3, counter + 2, counter + 1, counter);
+		x13 = j13 = _mm256_set_epi32((counter + 7) >> 32, (counter + 6) >> 32, (counter + 5) >> 32, (counter + 4) >> 32,
+			(counter + 3) >> 32, (counter + 2) >> 32, (counter + 1) >> 32, counter >> 32);
+		x14 = _mm256_set1_epi32(s[14]); x15 = _mm256_set1_epi32(s[15]);
+
+		for (i = 20; i > 0; i -= 2)
+			CHACHA_DOUBLEROUND(AVX2_ADD, AVX2_XOR, AVX2_ROTL);
+
+		x0 = _mm256_add_epi32(x0, _mm256_set1_epi32(s[0])); x1 = _mm256_add_epi32(x1, _mm256_set1_epi32(s[1]));
+		x2 = _mm256_add_epi32(x2, _mm256_set1_epi32(s[2])); x3 = _mm256_add_epi32(x3, _mm256_set1_epi32(s[3]));
+		x4 = _mm256_add_epi32(x4, _mm256_set1_epi32(s[4])); x5 = _mm256_add_epi32(x5, _mm256_set1_epi32(s[5]));
+		x6 = _mm256_add_epi32(x6, _mm256_set1_epi32(s[6])); x7 = _mm256_add_epi32(x7, _mm256_set1_epi32(s[7]));
+		x8 = _mm256_add_epi32(x8, _mm256_set1_epi32(s[8])); x9 = _mm256_add_epi32(x9, _mm256_set1_epi32(s[9]));
+		x10 = _mm256_add_epi32(x10, _mm256_set1_epi32(s[10])); x11 = _mm256_add_epi32(x11, _mm256_set1_epi32(s[11]));
+		x12 = _mm256_add_epi32(x12, j12); x13 = _mm256_add_epi32(x13, j13);
+		x14 = _mm256_add_epi32(x14, _mm256_set1_epi32(s[14])); x15 = _mm256_add_epi32(x15, _mm256_set1_epi32(s[15]));
+
+		AVX2_TRANSPOSE(x0, x1, x2, x3);
+		AVX2_TRANSPOSE(x4, x5, x6, x7);
+		AVX2_TRANSPOSE(x8, x9, x10, x11);
+		AVX2_TRANSPOSE(x12, x13, x14, x15);
+
+		AVX2_XOR_STORE(0, x0, x4); AVX2_XOR_STORE(32, x8, x12);
+		AVX2_XOR_STORE(64, x1, x5); AVX2_XOR_STORE(96, x9, x13);
+		AVX2_XOR_STORE(128, x2, x6); AVX2_XOR_STORE(160, x10, x14);
+		AVX2_XOR_STORE(192, x3, x7); AVX2_XOR_STORE(224, x11, x15);
+	}
+}
+
+/*
+ * One block for each of the first 8 rows of 'mb', XORed into the buffers of
+ * the mb->n queued ones. The rows are gathered into words, one row per lane.
+ */
+static __attribute__((target("avx2"))) void chacha_mb_avx2(chacha_mb *mb) {
+	const __m256i idx = _mm256_setr_epi32(0, 16, 32, 48, 64, 80, 96, 112);
+	const int *rows = (const int *) mb->rows[0];
+	__m256i x0, x1, x2, x3, x4, x5, x6, x7, x8, x9, x10, x11, x12, x13, x14, x15;
+	__m256i j0, j1, j2, j3, j4, j5, j6, j7, j8, j9, j10, j11, j12, j13, j14, j15;
+	unsigned char ks[512];
+	unsigned int l;
+	int i;
+
+	x0 = j0 = _mm256_i32gather_epi32(rows + 0, idx, 4); x1 = j1 = _mm256_i32gather_epi32(rows + 1, idx, 4);
+	x2 = j2 = _mm256_i32gather_epi32(rows + 2, idx, 4); x3 = j3 = _mm256_i32gather_epi32(rows + 3, idx, 4);
+	x4 = j4 = _mm256_i32gather_epi32(rows + 4, idx, 4); x5 = j5 = _mm256_i32gather_epi32(rows + 5, idx, 4);
+	x6 = j6 = _mm256_i32gather_epi32(rows + 6, idx, 4); x7 = j7 = _mm256_i32gather_epi32(rows + 7, idx, 4);
+	x8 = j8 = _mm256_i32gather_epi32(rows + 8, idx, 4); x9 = j9 = _mm256_i32gather_epi32(rows + 9, idx, 4);
+	x10 = j10 = _mm256_i32gather_epi32(rows + 10, idx, 4); x11 = j11 = _mm256_i32gather_epi32(rows + 11, idx, 4);
+	x12 = j12 = _mm256_i32gather_epi32(rows + 12, idx, 4); x13 = j13 = _mm256_i32gather_epi32(rows + 13, idx, 4);
+	x14 = j14 = _mm256_i32gather_epi32(rows + 14, idx, 4); x15 = j15 = _mm256_i32gather_epi32(rows + 15, idx, 4);
+
+	for (i = 20; i > 0; i -= 2)
+		CHACHA_DOUBLEROUND(AVX2_ADD, AVX2_XOR, AVX2_ROTL);
+
+	x0 = _mm256_add_epi32(x0, j0); x1 = _mm256_add_epi32(x1, j1); x2 = _mm256_add_epi32(x2, j2); x3 = _mm256_add_epi32(x3, j3);
+	x4 = _mm256_add_epi32(x4, j4); x5 = _mm256_add_epi32(x5, j5); x6 = _mm256_add_epi32(x6, j6); x7 = _mm256_add_epi32(x7, j7);
+	x8 = _mm256_add_epi32(x8, j8); x9 = _mm256_add_epi32(x9, j9); x10 = _mm256_add_epi32(x10, j10); x11 = _mm256_add_epi32(x11, j11);
+	x12 = _mm256_add_epi32(x12, j12); x13 = _mm256_add_epi32(x13, j13); x14 = _mm256_add_epi32(x14, j14); x15 = _mm256_add_epi32(x15, j15);
+
+	AVX2_TRANSPOSE(x0, x1, x2, x3);
+	AVX2_TRANSPOSE(x4, x5, x6, x7);
+	AVX2_TRANSPOSE(x8, x9, x10, x11);
+	AVX2_TRANSPOSE(x12, x13, x14, x15);
+
+	AVX2_KS_STORE(0, x0, x4); AVX2_KS_STORE(32, x8, x12);
+	AVX2_KS_STORE(64, x1, x5); AVX2_KS_STORE(96, x9, x13);
+	AVX2_KS_STORE(128, x2, x6); AVX2_KS_STORE(160, x10, x14);
+	AVX2_KS_STORE(192, x3, x7); AVX2_KS_STORE(224, x11, x15);
+
+	for (l = 0; l < mb->n; l ++) {
+		if (mb->bytes[l] == 64) {
+			_mm256_storeu_si256((__m256i *) mb->out[l], _mm256_xor_si256(_mm256_loadu_si256((const __m256i *) mb->in[l]),
+				_mm256_loadu_si256((const __m256i *) (ks + l * 64))));
+			_mm256_storeu_si256((__m256i *) (mb->out[l] + 32), _mm256_xor_si256(_mm256_loadu_si256((const __m256i *) (mb->in[l] + 32)),
+				_mm256_loadu_si256((const __m256i *) (ks + l * 64 + 32))));
+		} else {
+			chacha_mb_out(mb->out[l], mb->in[l], ks + l * 64, mb->bytes[l]);
+		}
+	}
+}
+
+#ifdef CHACHA_POLY1305_WIDE
+
+/* Four 64-bit lanes: blocks 0..3 as 26-bit limbs */
+#define POLY_VEC_T		__m256i
+#define POLY_VEC_SET1(v)	_mm256_set1_epi64x(v)
+#define POLY_VEC_LOAD(p)	_mm256_loadu_si256((const __m256i *) (p))
+#define POLY_VEC_STORE(p, v)	_mm256_storeu_si256((__m256i *) (p), v)
+#define POLY_VEC_MUL(a, b)	_mm256_mul_epu32(a, b)
+#define POLY_VEC_ADD(a, b)	_mm256_add_epi64(a, b)
+#define POLY_VEC_AND(a, b)	_mm256_and_si256(a, b)
+#define POLY_VEC_OR(a, b)	_mm256_or_si256(a, b)
+#define POLY_VEC_SRL(a, n)	_mm256_srli_epi64(a, n)
+#define POLY_VEC_SLL(a, n)	_mm256_slli_epi64(a, n)
+#define POLY_VEC_SPLIT(t0, t1, m) \
+	do { \
+		__m256i a = _mm256_loadu_si256((const __m256i *) (m)), b = _mm256_loadu_si256((const __m256i *) ((m) + 32)); \
+		t0 = _mm256_permute4x64_epi64(_mm256_unpacklo_epi64(a, b), 0xd8); \
+		t1 = _mm256_permute4x64_epi64(_mm256_unpackhi_epi64(a, b), 0xd8); \
+	} while (0)
+
+#define POLY_VEC_GATHER(t0, t1, m) \
+	do { \
+		__m256i a = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128((const __m128i *) (m)[0])), \
+			_mm_loadu_si128((const __m128i *) (m)[1]), 1); \
+		__m256i b = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128((const __m128i *) (m)[2])), \
+			_mm_loadu_si128((const __m128i *) (m)[3]), 1); \
+		t0 = _mm256_permute4x64_epi64(_mm256_unpacklo_epi64(a, b), 0xd8); \
+		t1 = _mm256_permute4x64_epi64(_mm256_unpackhi_epi64(a, b), 0xd8); \
+	} while (0)
+
+#define CHACHA_POLY1305_VEC		chacha_poly1305_avx2
+#define CHACHA_POLY1305_MB		chacha_poly1305_mb_avx2
+#define CHACHA_POLY1305_VEC_TARGET	"avx2"
+#define CHACHA_POLY1305_VEC_LANES	4
+#include "chacha_poly1305_vec.h"
+#include "chacha_poly1305_mb.h"
+#undef CHACHA_POLY1305_VEC
+#undef CHACHA_POLY1305_MB
+#undef CHACHA_POLY1305_VEC_TARGET
+#undef CHACHA_POLY1305_VEC_LANES
+
+#undef POLY_VEC_T
+#undef POLY_VEC_SET1
+#undef POLY_VEC_LOAD
+#undef POLY_VEC_STORE
+#undef POLY_VEC_MUL
+#undef POLY_VEC_ADD
+#undef POLY_VEC_AND
+#undef POLY_VEC_OR
+#undef POLY_VEC_SRL
+#undef POLY_VEC_SLL
+#undef POLY_VEC_SPLIT
+#undef POLY_VEC_GATHER
+
+#endif
+
+#ifdef CHACHA_AVX512
+
+/* AVX-512F has native rotates (vprold) for every rotation count */
+#define AVX512_ADD(a, b) _mm512_add_epi32(a, b)
+#define AVX512_XOR(a, b) _mm512_xor_si512(a, b)
+#define AVX512_ROTL(a, r) _mm512_rol_epi32(a, r)
+
+/*
+ * 4x4 transpose within each 128-bit lane: a..d become words i..i+3 of blocks
+ * n, n + 4, n + 8 and n + 12 (lanes 0..3), for n = 0..3 respectively
+ */
+#define AVX512_TRANSPOSE(a, b, c, d) \
+	do { \
+		__m512i t0 = _mm512_unpacklo_epi32(a, b), t1 = _mm512_unpacklo_epi32(c, d); \
+		__m512i t2 = _mm512_unpackhi_epi32(a, b), t3 = _mm512_unpackhi_epi32(c, d); \
+		a = _mm512_unpacklo_epi64(t0, t1); b = _mm512_unpackhi_epi64(t0, t1); \
+		c = _mm512_unpacklo_epi64(t2, t3); d = _mm512_unpackhi_epi64(t2, t3); \
+	} while (0)
+
+/*
+ * Words 0..3 (a), 4..7 (b), 8..11 (c) and 12..15 (d) of block n, n + 4,
+ * n + 8 and n + 12: a 4x4 transpose of 128-bit lanes
+ */
+#define AVX512_STORE_QUAD(STORE, n, a, b, c, d) \
+	do { \
+		__m512i t0 = _mm512_shuffle_i32x4(a, b, 0x44), t1 = _mm512_shuffle_i32x4(c, d, 0x44); \
+		__m512i t2 = _mm512_shuffle_i32x4(a, b, 0xee), t3 = _mm512_shuffle_i32x4(c, d, 0xee); \
+		STORE((n) + 0, _mm512_shuffle_i32x4(t0, t1, 0x88)); \
+		STORE((n) + 4, _mm512_shuffle_i32x4(t0, t1, 0xdd)); \
+		STORE((n) + 8, _mm512_shuffle_i32x4(t2, t3, 0x88)); \
+		STORE((n) + 12, _mm512_shuffle_i32x4(t2, t3, 0xdd)); \
+	} while (0)
+
+#define AVX512_XOR_STORE_BLOCK(n, v) \
+	_mm512_storeu_si512((void *) (out + (n) * 64), _mm512_xor_si512(v, _mm512_loadu_si512((const void *) (in + (n) * 64))))
+#define AVX512_KS_STORE_BLOCK(n, v) \
+	_mm512_storeu_si512((void *) (ks + (n) * 64), v)
+
+#define AVX512_XOR_STORE(n, a, b, c, d) AVX512_STORE_QUAD(AVX512_XOR_STORE_BLOCK, n, a, b, c, d)
+#define AVX512_KS_STORE(n, a, b, c, d) AVX512_STORE_QUAD(AVX512_KS_STORE_BLOCK, n, a, b, c, d)
+
+/* Processes 'blocks' (a multiple of 16) blocks starting at block 'counter' */
+static __attribute__((target("avx512f"))) void chacha_xor_avx512(
+		unsigned char *out,
+		const unsigned char *in,
+		unsigned long long blocks,
+		const uint32_t s[16],
+		unsigned long long counter) {
+	__m512i x0, x1, x2, x3, x4, x5, x6, x7, x8, x9, x10, x11, x12, x13, x14, x15;
+	__m512i j12, j13, lanes = _mm512_set_epi64(7, 6, 5, 4, 3, 2, 1, 0);
+	__m512i lo, hi;
+	int i;
+
+	for (; blocks; blocks -= 16, counter += 16, out += 1024, in += 1024) {
+		x0 = _mm512_set1_epi32(s[0]); x1 = _mm512_set1_epi32(s[1]); x2 = _mm512_set1_epi32(s[2]); x3 = _mm512_set1_epi32(s[3]);
+		x4 = _mm512_set1_epi32(s[4]); x5 = _mm512_set1_epi32(s[5]); x6 = _mm512_set1_epi32(s[6]); x7 = _mm512_set1_epi32(s[7]);
+		x8 = _mm512_set1_epi32(s[8]); x9 = _mm512_set1_epi32(s[9]); x10 = _mm512_set1_epi32(s[10]); x11 = _mm512_set1_epi32(s[11]);
+
+		/* 64-bit counters of blocks 0..7 and 8..15, split in low and high words */
+		lo = _mm512_add_epi64(_mm512_set1_epi64(counter), lanes);
+		hi = _mm512_add_epi64(_mm512_set1_epi64(counter + 8), lanes);
+		x12 = j12 = _mm512_permutex2var_epi32(lo, _mm512_set_epi32(30, 28, 26, 24, 22, 20, 18, 16, 14, 12, 10, 8, 6, 4, 2, 0), hi);
+		x13 = j13 = _mm512_permutex2var_epi32(lo, _mm512_set_epi32(31, 29, 27, 25, 23, 21, 19, 17, 15, 13, 11, 9, 7, 5, 3, 1), hi);
+
+		x14 = _mm512_set1_epi32(s[14]); x15 = _mm512_set1_epi32(s[15]);
+
+		for (i = 20; i > 0; i -= 2)
+			CHACHA_DOUBLEROUND(AVX512_ADD, AVX512_XOR, AVX512_ROTL);
+
+		x0 = _mm512_add_epi32(x0, _mm512_set1_epi32(s[0])); x1 = _mm512_add_epi32(x1, _mm512_set1_epi32(s[1]));
+		x2 = _mm512_add_epi32(x2, _mm512_set1_epi32(s[2])); x3 = _mm512_add_epi32(x3, _mm512_set1_epi32(s[3]));
+		x4 = _mm512_add_epi32(x4, _mm512_set1_epi32(s[4])); x5 = _mm512_add_epi32(x5, _mm512_set1_epi32(s[5]));
+		x6 = _mm512_add_epi32(x6, _mm512_set1_epi32(s[6])); x7 = _mm512_add_epi32(x7, _mm512_set1_epi32(s[7]));
+		x8 = _mm512_add_epi32(x8, _mm512_set1_epi32(s[8])); x9 = _mm512_add_epi32(x9, _mm512_set1_epi32(s[9]));
+		x10 = _mm512_add_epi32(x10, _mm512_set1_epi32(s[10])); x11 = _mm512_add_epi32(x11, _mm512_set1_epi32(s[11]));
+		x12 = _mm512_add_epi32(x12, j12); x13 = _mm512_add_epi32(x13, j13);
+		x14 = _mm512_add_epi32(x14, _mm512_set1_epi32(s[14])); x15 = _mm512_add_epi32(x15, _mm512_set1_epi32(s[15]));
+
+		AVX512_TRANSPOSE(x0, x1, x2, x3);
+		AVX512_TRANSPOSE(x4, x5, x6, x7);
+		AVX512_TRANSPOSE(x8, x9, x10, x11);
+		AVX512_TRANSPOSE(x12, x13, x14, x15);
+
+		AVX512_XOR_STORE(0, x0, x4, x8, x12);
+		AVX512_XOR_STORE(1, x1, x5, x9, x13);
+		AVX512_XOR_STORE(2, x2, x6, x10, x14);
+		AVX512_XOR_STORE(3, x3, x7, x11, x15);
+	}
+}
+
+/* chacha_mb_avx2() with all 16 rows */
+static __attribute__((target("avx512f"))) void chacha_mb_avx512(chacha_mb *mb) {
+	const __m512i idx = _mm512_setr_epi32(0, 16, 32, 48, 64, 80, 96, 112, 128, 144, 160, 176, 192, 208, 224, 240);
+	const int *rows = (const int *) mb->rows[0];
+	__m512i x0, x1, x2, x3, x4, x5, x6, x7, x8, x9, x10, x11, x12, x13, x14, x15;
+	__m512i j0, j1, j2, j3, j4, j5, j6, j7, j8, j9, j10, j11, j12, j13, j14, j15;
+	unsigned char ks[1024];
+	unsigned int l;
+	int i;
+
+	x0 = j0 = _mm512_i32gather_epi32(idx, rows + 0, 4); x1 = j1 = _mm512_i32gather_epi32(idx, rows + 1, 4);
+	x2 = j2 = _mm512_i32gather_epi32(idx, rows + 2, 4); x3 = j3 = _mm512_i32gather_epi32(idx, rows + 3, 4);
+	x4 = j4 = _mm512_i32gather_epi32(idx, rows + 4, 4); x5 = j5 = _mm512_i32gather_epi32(idx, rows + 5, 4);
+	x6 = j6 = _mm512_i32gather_epi32(idx, rows + 6, 4); x7 = j7 = _mm512_i32gather_epi32(idx, rows + 7, 4);
+	x8 = j8 = _mm512_i32gather_epi32(idx, rows + 8, 4); x9 = j9 = _mm512_i32gather_epi32(idx, rows + 9, 4);
+	x10 = j10 = _mm512_i32gather_epi32(idx, rows + 10, 4); x11 = j11 = _mm512_i32gather_epi32(idx, rows + 11, 4);
+	x12 = j12 = _mm512_i32gather_epi32(idx, rows + 12, 4); x13 = j13 = _mm512_i32gather_epi32(idx, rows + 13, 4);
+	x14 = j14 = _mm512_i32gather_epi32(idx, rows + 14, 4); x15 = j15 = _mm512_i32gather_epi32(idx, rows + 15, 4);
+
+	for (i = 20; i > 0; i -= 2)
+		CHACHA_DOUBLEROUND(AVX512_ADD, AVX512_XOR, AVX512_ROTL);
+
+	x0 = _mm512_add_epi32(x0, j0); x1 = _mm512_add_epi32(x1, j1); x2 = _mm512_add_epi32(x2, j2); x3 = _mm512_add_epi32(x3, j3);
+	x4 = _mm512_add_epi32(x4, j4); x5 = _mm512_add_epi32(x5, j5); x6 = _mm512_add_epi32(x6, j6); x7 = _mm512_add_epi32(x7, j7);
+	x8 = _mm512_add_epi32(x8, j8); x9 = _mm512_add_epi32(x9, j9); x10 = _mm512_add_epi32(x10, j10); x11 = _mm512_add_epi32(x11, j11);
+	x12 = _mm512_add_epi32(x12, j12); x13 = _mm512_add_epi32(x13, j13); x14 = _mm512_add_epi32(x14, j14); x15 = _mm512_add_epi32(x15, j15);
+
+	AVX512_TRANSPOSE(x0, x1, x2, x3);
+	AVX512_TRANSPOSE(x4, x5, x6, x7);
+	AVX512_TRANSPOSE(x8, x9, x10, x11);
+	AVX512_TRANSPOSE(x12, x13, x14, x15);
+
+	AVX512_KS_STORE(0, x0, x4, x8, x12);
+	AVX512_KS_STORE(1, x1, x5, x9, x13);
+	AVX512_KS_STORE(2, x2, x6, x10, x14);
+	AVX512_KS_STORE(3, x3, x7, x11, x15);
+
+	for (l = 0; l < mb->n; l ++) {
+		if (mb->bytes[l] == 64) {
+			_mm512_storeu_si512((void *) mb->out[l], _mm512_xor_si512(_mm512_loadu_si512((const void *) mb->in[l]),
+				_mm512_loadu_si512((const void *) (ks + l * 64))));
+		} else {
+			chacha_mb_out(mb->out[l], mb->in[l], ks + l * 64, mb->bytes[l]);
+		}
+	}
+}
+
+#ifdef CHACHA_POLY1305_WIDE
+
+/* Eight 64-bit lanes: blocks 0..7 as 26-bit limbs */
+#define POLY_VEC_T		__m512i
+#define POLY_VEC_SET1(v)	_mm512_set1_epi64(v)
+#define POLY_VEC_LOAD(p)	_mm512_loadu_si512((const void *) (p))
+#define POLY_VEC_STORE(p, v)	_mm512_storeu_si512((void *) (p), v)
+#define POLY_VEC_MUL(a, b)	_mm512_mul_epu32(a, b)
+#define POLY_VEC_ADD(a, b)	_mm512_add_epi64(a, b)
+#define POLY_VEC_AND(a, b)	_mm512_and_si512(a, b)
+#define POLY_VEC_OR(a, b)	_mm512_or_si512(a, b)
+#define POLY_VEC_SRL(a, n)	_mm512_srli_epi64(a, n)
+#define POLY_VEC_SLL(a, n)	_mm512_slli_epi64(a, n)
+#define POLY_VEC_SPLIT(t0, t1, m) \
+	do { \
+		__m512i a = _mm512_loadu_si512((const void *) (m)), b = _mm512_loadu_si512((const void *) ((m) + 64)); \
+		t0 = _mm512_permutex2var_epi64(a, _mm512_set_epi64(14, 12, 10, 8, 6, 4, 2, 0), b); \
+		t1 = _mm512_permutex2var_epi64(a, _mm512_set_epi64(15, 13, 11, 9, 7, 5, 3, 1), b); \
+	} while (0)
+
+#define POLY_VEC_LOAD4(m, i) \
+	_mm512_inserti32x4(_mm512_inserti32x4(_mm512_inserti32x4(_mm512_castsi128_si512(_mm_loadu_si128((const __m128i *) (m)[i])), \
+		_mm_loadu_si128((const __m128i *) (m)[(i) + 1]), 1), _mm_loadu_si128((const __m128i *) (m)[(i) + 2]), 2), \
+		_mm_loadu_si128((const __m128i *) (m)[(i) + 3]), 3)
+#define POLY_VEC_GATHER(t0, t1, m) \
+	do { \
+		__m512i a = POLY_VEC_LOAD4(m, 0), b = POLY_VEC_LOAD4(m, 4); \
+		t0 = _mm512_permutex2var_epi64(a, _mm512_set_epi64(14, 12, 10, 8, 6, 4, 2, 0), b); \
+		t1 = _mm512_permutex2var_epi64(a, _mm512_set_epi64(15, 13, 11, 9, 7, 5, 3, 1), b); \
+	} while (0)
+
+#define CHACHA_POLY1305_VEC		chacha_poly1305_avx512
+#define CHACHA_POLY1305_MB		chacha_poly1305_mb_avx512
+#define CHACHA_POLY1305_VEC_TARGET	"avx512f"
+#define CHACHA_POLY1305_VEC_LANES	8
+#include "chacha_poly1305_vec.h"
+#include "chacha_poly1305_mb.h"
+#undef CHACHA_POLY1305_VEC
+#undef CHACHA_POLY1305_MB
+#undef CHACHA_POLY1305_VEC_TARGET
+#undef CHACHA_POLY1305_VEC_LANES
+
+#undef POLY_VEC_T
+#undef POLY_VEC_SET1
+#undef POLY_VEC_LOAD
+#undef POLY_VEC_STORE
+#undef POLY_VEC_MUL
+#undef POLY_VEC_ADD
+#undef POLY_VEC_AND
+#undef POLY_VEC_OR
+#undef POLY_VEC_SRL
+#undef POLY_VEC_SLL
+#undef POLY_VEC_SPLIT
+#undef POLY_VEC_LOAD4
+#undef POLY_VEC_GATHER
+
+#endif
+
+#endif
+
+#endif
+
+/* Whether the CPU can run kernel 'impl' */
+static int chacha_impl_supported(int impl) {
+#ifdef CHACHA_SIMD
+	__builtin_cpu_init();
+
+	switch (impl) {
+		case CHACHA_IMPL_REF: return 1;
+		case CHACHA_IMPL_SSE2: return __builtin_cpu_supports("sse2");
+		case CHACHA_IMPL_AVX: return __builtin_cpu_supports("avx");
+		case CHACHA_IMPL_AVX2: return __builtin_cpu_supports("avx2");
+#ifdef CHACHA_AVX512
+		case CHACHA_IMPL_AVX512: return __builtin_cpu_supports("avx512f");
+#endif
+	}
+
+	return 0;
+#else
+	return impl == CHACHA_IMPL_REF;
+#endif
+}
+
+static int chacha_select(void) {
+	int impl = chacha_impl;
+
+	if (impl < 0) {
+		for (impl = CHACHA_IMPL_MAX - 1; !chacha_impl_supported(impl); impl --);
+
+		chacha_impl = impl;
+	}
+
+	return impl;
+}
+
+const char *chacha_crypto_stream_impl(void) {
+	return chacha_impl_names[chacha_select()];
+}
+
+int chacha_crypto_stream_set_impl(const char *name) {
+	int impl;
+
+	if (!name) {
+		chacha_impl = -1;
+		chacha_select();
+
+		return 0;
+	}
+
+	for (impl = 0; impl < CHACHA_IMPL_MAX; impl ++) {
+		if (!strcmp(name, chacha_impl_names[impl]))
+			break;
+	}
+
+	if ((impl == CHACHA_IMPL_MAX) || !chacha_impl_supported(impl))
+		return -1;
+
+	chacha_impl = impl;
+
+	return 0;
+}
+
+/* XORs 'inlen' bytes of keystream from block 'ic' of state 's' with the selected kernel */
+static void chacha_xor(
+		unsigned char *out,
+		const unsigned char *in,
+		unsigned long long inlen,
+		const uint32_t s[16],
+		unsigned long long ic) {
+	unsigned long long blocks = 0;
+	unsigned char block[1024];
+	unsigned int i;
+#ifdef CHACHA_SIMD
+	void (*vec4)(unsigned char *, const unsigned char *, unsigned long long, const uint32_t *, unsigned long long);
+	int impl;
+#endif
+
+	if (!inlen)
+		return;
+
+#ifdef CHACHA_SIMD
+	if ((impl = chacha_select()) != CHACHA_IMPL_REF) {
+		vec4 = (impl >= CHACHA_IMPL_AVX) ? chacha_xor_avx : chacha_xor_sse2;
+
+		/* Widest kernel for whole groups of 16, 8 or 4 blocks */
+#ifdef CHACHA_AVX512
+		if (impl >= CHACHA_IMPL_AVX512) {
+			blocks = (inlen / 64) & ~15ULL;
+			chacha_xor_avx512(out, in, blocks, s, ic);
+		} else
+#endif
+		if (impl >= CHACHA_IMPL_AVX2) {
+			blocks = (inlen / 64) & ~7ULL;
+			chacha_xor_avx2(out, in, blocks, s, ic);
+		} else {
+			blocks = (inlen / 64) & ~3ULL;
+			vec4(out, in, blocks, s, ic);
+		}
+
+		inlen -= blocks * 64;
+		out += blocks * 64;
+		in += blocks * 64;
+
+		/* More than one block left: encrypt it on the stack with the
+		 * narrowest kernel that covers it
+		 */
+		if (inlen > 64) {
+			memcpy(block, in, inlen);
+
+#ifdef CHACHA_AVX512
+			if (inlen > 512) {
+				chacha_xor_avx512(block, block, 16, s, ic + blocks);
+			} else
+#endif
+			if (inlen > 256) {
+				chacha_xor_avx2(block, block, 8, s, ic + blocks);
+			} else {
+				vec4(block, block, 4, s, ic + blocks);
+			}
+
+			memcpy(out, block, inlen);
+
+			return;
+		}
+	}
+#endif
+
+	for (; inlen >= 64; inlen -= 64, out += 64, in += 64, blocks ++) {
+		chacha_block(block, s, ic + blocks);
+
+		for (i = 0; i < 64; i ++)
+			out[i] = in[i] ^ block[i];
+	}
+
+	if (inlen) {
+		chacha_block(block, s, ic + blocks);
+
+		for (i = 0; i < inlen; i ++)
+			out[i] = in[i] ^ block[i];
+	}
+}
+
+/* Not optimized away, unlike a memset() of memory that is about to go out of scope */
+static void *(*const volatile chacha_wipe)(void *, int, size_t) = memset;
+
+/* Empties the multi-buffer queue */
+static void chacha_mb_init(chacha_mb *mb) {
+	int impl = chacha_select();
+
+	memset(mb->rows, 0, sizeof(mb->rows));
+
+	mb->n = 0;
+	mb->lanes = 0;
+
+#ifdef CHACHA_SIMD
+#ifdef CHACHA_AVX512
+	if (impl >= CHACHA_IMPL_AVX512) {
+		mb->lanes = 16;
+	} else
+#endif
+	if (impl >= CHACHA_IMPL_AVX2) {
+		mb->lanes = 8;
+	}
+#else
+	(void) impl;
+#endif
+}
+
+/* Generates and XORs every block queued */
+static void chacha_mb_flush(chacha_mb *mb) {
+	unsigned char block[64];
+	unsigned int l;
+
+	if (!mb->n)
+		return;
+
+#ifdef CHACHA_SIMD
+	if (mb->n > CHACHA_MB_SCALAR) {
+#ifdef CHACHA_AVX512
+		if (mb->n > 8) {
+			chacha_mb_avx512(mb);
+		} else
+#endif
+		{
+			chacha_mb_avx2(mb);
+		}
+
+		mb->n = 0;
+
+		return;
+	}
+#endif
+
+	for (l = 0; l < mb->n; l ++) {
+		chacha_block(block, mb->rows[l], ((unsigned long long) mb->rows[l][13] << 32) | mb->rows[l][12]);
+		chacha_mb_out(mb->out[l], mb->in[l], block, mb->bytes[l]);
+	}
+
+	mb->n = 0;
+}
+
+/* Queues block 'counter' of state 's', for 'bytes' bytes from 'in' into 'out' */
+static void chacha_mb_push(
+		chacha_mb *mb,
+		const uint32_t s[16],
+		unsigned long long counter,
+		unsigned char *out,
+		const unsigned char *in,
+		unsigned int bytes) {
+	uint32_t *row = mb->rows[mb->n];
+
+	memcpy(row, s, sizeof(mb->rows[0]));
+	row[12] = (uint32_t) counter;
+	row[13] = (uint32_t) (counter >> 32);
+
+	mb->out[mb->n] = out;
+	mb->in[mb->n] = in;
+	mb->bytes[mb->n] = bytes;
+
+	if (++ mb->n == mb->lanes)
+		chacha_mb_flush(mb);
+}
+
+/*
+ * chacha_xor() of one message of a batch. Whole groups of blocks of the
+ * widest kernel are encrypted right away, and the blocks left over (all of
+ * them, on short messages) are queued for the multi-buffer lanes, to be
+ * filled with the blocks of other messages. The output is only complete after
+ * chacha_mb_flush().
+ */
+static void chacha_mb_xor(
+		chacha_mb *mb,
+		unsigned char *out,
+		const unsigned char *in,
+		unsigned long long inlen,
+		const uint32_t s[16],
+		unsigned long long ic) {
+	unsigned long long done;
+	unsigned int bytes;
+
+	if (!mb->lanes) {
+		chacha_xor(out, in, inlen, s, ic);
+		return;
+	}
+
+	done = inlen - (inlen % (64ULL * mb->lanes));
+
+	chacha_xor(out, in, done, s, ic);
+
+	for (; done < inlen; done += bytes) {
+		bytes = ((inlen - done) < 64) ? (unsigned int) (inlen - done) : 64;
+
+		chacha_mb_push(mb, s, ic + done / 64, out + done, in + done, bytes);
+	}
+}
+
+int chacha_crypto_stream_xor_ic(
+		unsigned char *out,
+		const unsigned char *in,
+		unsigned long long inlen,
+		const unsigned char *n,
+		unsigned long long ic,
+		const unsigned char *k) {
+	uint32_t s[16];
+
+	chacha_state(s, n, k);
+	chacha_xor(out, in, inlen, s, ic);
+
+	return 0;
+}
+
+int chacha_crypto_stream_xor(
+		unsigned char *out,
+		const unsigned char *in,
+		unsigned long long inlen,
+		const unsigned char *n,
+		const unsigned char *k) {
+	return chacha_crypto_stream_xor_ic(out, in, inlen, n, 0, k);
+}
+
+int chacha_crypto_stream(
+		unsigned char *out,
+		unsigned long long outlen,
+		const unsigned char *n,
+		const unsigned char *k) {
+	memset(out, 0, outlen);
+
+	return chacha_crypto_stream_xor(out, out, outlen, n, k);
+}
+
+int chacha_crypto_stream_xor_ic_batch(struct chacha_crypto_stream_job *jobs, unsigned int njobs) {
+	chacha_mb mb;
+	uint32_t s[16];
+	unsigned int i;
+
+	chacha_mb_init(&mb);
+
+	/* The queue keeps a copy of the state of each block, so 's' is reused */
+	for (i = 0; i < njobs; i ++) {
+		chacha_state(s, jobs[i].n, jobs[i].k);
+		chacha_mb_xor(&mb, jobs[i].out, jobs[i].in, jobs[i].inlen, s, jobs[i].ic);
+	}
+
+	chacha_mb_flush(&mb);
+
+	chacha_wipe(&mb, 0, sizeof(mb));
+	chacha_wipe(s, 0, sizeof(s));
+
+	return 0;
+}
+
+/* Longest message allowed by RFC 8439 (32-bit block counter, starting at 1) */
+#define CHACHA_AEAD_MAX_BYTES	(((1ULL << 32) - 1) * 64)
+
+/*
+ * Bytes encrypted at a time: each chunk is MACed right after (or, when
+ * decrypting, right before) the kernel goes through it, while it is in L1.
+ * The first chunk is shorter, as it is encrypted on the stack behind block 0,
+ * and keeps the later ones aligned to the Poly1305 lanes.
+ */
+#define CHACHA_AEAD_CHUNK	2048
+#define CHACHA_AEAD_FIRST	(CHACHA_AEAD_CHUNK - 128)
+
+/* Below this length the setup of the Poly1305 lanes (r^2..r^8) doesn't pay off */
+#define CHACHA_AEAD_WIDE_MIN	256
+
+typedef struct {
+	chacha_poly1305_state st;
+#ifdef CHACHA_POLY1305_WIDE
+	chacha_poly1305_wide w;
+	void (*wide)(chacha_poly1305_wide *, chacha_poly1305_state *, const unsigned char *, unsigned long long);
+#endif
+} chacha_aead_mac;
+
+/* MACs 'bytes' bytes of ciphertext, zero padding the last block (only the last chunk may be partial) */
+static void chacha_aead_mac_chunk(chacha_aead_mac *mac, const unsigned char *c, unsigned long long bytes) {
+#ifdef CHACHA_POLY1305_WIDE
+	unsigned long long full;
+
+	if (mac->wide) {
+		full = bytes - (bytes % (16 * mac->w.lanes));
+
+		mac->wide(&mac->w, &mac->st, c, full);
+
+		if (!(bytes -= full))
+			return;
+
+		c += full;
+
+		chacha_poly1305_wide_fold(&mac->w, &mac->st);
+		mac->wide = NULL;
+	}
+#endif
+
+	chacha_poly1305_padded(&mac->st, c, bytes);
+}
+
+/*
+ * RFC 8439 ChaCha20-Poly1305: the block counter is word 12 and the 96-bit
+ * nonce takes words 13 to 15. As messages never wrap the 32-bit counter, this
+ * is the 64-bit counter of chacha_state() with the first nonce word on top.
+ */
+static void chacha_aead(
+		unsigned char *out,
+		const unsigned char *in,
+		unsigned long long len,
+		const unsigned char *ad,
+		unsigned long long adlen,
+		const unsigned char *n,
+		const unsigned char *k,
+		unsigned char *tag,
+		int enc) {
+	chacha_aead_mac mac;
+	unsigned char first[64 + CHACHA_AEAD_FIRST];
+	unsigned long long counter, done, chunk;
+	uint32_t s[16];
+
+	chacha_state(s, n + 4, k);
+	counter = (unsigned long long) chacha_load32(n) << 32;
+
+	/* Block 0 (the one-time Poly1305 key) and the first chunk in a single
+	 * kernel call, which is all there is to short messages
+	 */
+	done = (len < CHACHA_AEAD_FIRST) ? len : CHACHA_AEAD_FIRST;
+
+	memset(first, 0, 64);
+	memcpy(first + 64, in, done);
+
+	chacha_xor(first, first, 64 + done, s, counter ++);
+
+	chacha_poly1305_init(&mac.st, first);
+	chacha_poly1305_padded(&mac.st, ad, adlen);
+
+#ifdef CHACHA_POLY1305_WIDE
+	mac.wide = NULL;
+
+	/* Same instruction set as the ChaCha kernel */
+	if (len >= CHACHA_AEAD_WIDE_MIN) {
+#ifdef CHACHA_AVX512
+		if (chacha_select() >= CHACHA_IMPL_AVX512) {
+			mac.wide = chacha_poly1305_avx512;
+			chacha_poly1305_wide_init(&mac.w, &mac.st, 8);
+		} else
+#endif
+		if (chacha_select() >= CHACHA_IMPL_AVX2) {
+			mac.wide = chacha_poly1305_avx2;
+			chacha_poly1305_wide_init(&mac.w, &mac.st, 4);
+		}
+	}
+#endif
+
+	chacha_aead_mac_chunk(&mac, enc ? first + 64 : in, done);
+
+	memcpy(out, first + 64, done);
+
+	for (; done < len; done += chunk) {
+		chunk = ((len - done) < CHACHA_AEAD_CHUNK) ? (len - done) : CHACHA_AEAD_CHUNK;
+
+		if (!enc)
+			chacha_aead_mac_chunk(&mac, in + done, chunk);
+
+		chacha_xor(out + done, in + done, chunk, s, counter + done / 64);
+
+		if (enc)
+			chacha_aead_mac_chunk(&mac, out + done, chunk);
+	}
+
+#ifdef CHACHA_POLY1305_WIDE
+	if (mac.wide)
+		chacha_poly1305_wide_fold(&mac.w, &mac.st);
+#endif
+
+	chacha_store32(first + 0, (uint32_t) adlen);
+	chacha_store32(first + 4, (uint32_t) (adlen >> 32));
+	chacha_store32(first + 8, (uint32_t) len);
+	chacha_store32(first + 12, (uint32_t) (len >> 32));
+
+	chacha_poly1305_blocks(&mac.st, first, 16);
+	chacha_poly1305_finish(&mac.st, tag);
+
+	/* The Poly1305 key (and its powers) must not outlive the message */
+	chacha_wipe(&mac, 0, sizeof(mac));
+	chacha_wipe(first, 0, 64);
+}
+
+int chacha_crypto_aead_encrypt(
+		unsigned char *c,
+		unsigned char *tag,
+		const unsigned char *m,
+		unsigned long long mlen,
+		const unsigned char *ad,
+		unsigned long long adlen,
+		const unsigned char *n,
+		const unsigned char *k) {
+	if (mlen > CHACHA_AEAD_MAX_BYTES)
+		return -1;
+
+	chacha_aead(c, m, mlen, ad, adlen, n, k, tag, 1);
+
+	return 0;
+}
+
+int chacha_crypto_aead_decrypt(
+		unsigned char *m,
+		const unsigned char *c,
+		unsigned long long clen,
+		const unsigned char *tag,
+		const unsigned char *ad,
+		unsigned long long adlen,
+		const unsigned char *n,
+		const unsigned char *k) {
+	unsigned char mac[CHACHA_CRYPTO_AEAD_TAGBYTES];
+	unsigned int i, d = 0;
+
+	if (clen > CHACHA_AEAD_MAX_BYTES)
+		return -1;
+
+	chacha_aead(m, c, clen, ad, adlen, n, k, mac, 0);
+
+	/* Constant time tag comparison */
+	for (i = 0; i < sizeof(mac); i ++)
+		d |= mac[i] ^ tag[i];
+
+	if (d) {
+		memset(m, 0, clen);
+		return -1;
+	}
+
+	return 0;
+}
+
+/*
+ * Messages of a batch longer than this are encrypted on their own: they fill
+ * the kernel lanes and the Poly1305 lanes of chacha_poly1305_wide by
+ * themselves, while the multi-message lanes would leave them MACing most of
+ * their blocks alone after the shorter messages of their group are done.
+ */
+#define CHACHA_BATCH_MAX_BYTES	1024
+
+/* Messages of a batch set up and MACed together */
+#define CHACHA_BATCH_WINDOW	32
+
+/* Per message state of a batch */
+typedef struct {
+	struct chacha_crypto_aead_job *job;
+	uint32_t s[16];
+	unsigned long long counter;
+	unsigned char otk[64];
+	unsigned char pad[3][16];	/* Associated data tail, ciphertext tail and lengths */
+	chacha_poly1305_state st;
+	chacha_poly1305_msg msg;
+} chacha_aead_batch_msg;
+
+/*
+ * MACs every message of a batch. With vector support the messages are
+ * sorted by length, longest first, and MACed in groups of one message per
+ * Poly1305 lane, for as many blocks as the shortest message of the group has;
+ * whatever is left of the longer ones is MACed on its own.
+ */
+static void chacha_poly1305_batch(chacha_poly1305_state **st, chacha_poly1305_msg **msg, unsigned int n) {
+	unsigned int i;
+#ifdef CHACHA_POLY1305_WIDE
+	void (*mb)(chacha_poly1305_state **, chacha_poly1305_msg **, unsigned long long) = NULL;
+	chacha_poly1305_state *gst[CHACHA_POLY1305_LANES], *t;
+	chacha_poly1305_msg *gmsg[CHACHA_POLY1305_LANES], *u;
+	unsigned int lanes = 0, j, l;
+
+#ifdef CHACHA_AVX512
+	if (chacha_select() >= CHACHA_IMPL_AVX512) {
+		mb = chacha_poly1305_mb_avx512;
+		lanes = 8;
+	} else
+#endif
+	if (chacha_select() >= CHACHA_IMPL_AVX2) {
+		mb = chacha_poly1305_mb_avx2;
+		lanes = 4;
+	}
+
+	if (mb) {
+		for (i = 1; i < n; i ++) {
+			t = st[i];
+			u = msg[i];
+
+			for (j = i; (j > 0) && (msg[j - 1]->left < u->left); j --) {
+				st[j] = st[j - 1];
+				msg[j] = msg[j - 1];
+			}
+
+			st[j] = t;
+			msg[j] = u;
+		}
+
+		/* A message alone in its group is faster on the scalar path */
+		for (i = 0; (i + 1) < n; i += lanes) {
+			for (l = 0; l < lanes; l ++) {
+				gst[l] = ((i + l) < n) ? st[i + l] : NULL;
+				gmsg[l] = ((i + l) < n) ? msg[i + l] : NULL;
+			}
+
+			mb(gst, gmsg, msg[(((i + lanes) < n) ? (i + lanes) : n) - 1]->left);
+		}
+	}
+#endif
+
+	for (i = 0; i < n; i ++)
+		chacha_poly1305_msg_blocks(st[i], msg[i]);
+}
+
+/* Associated data, ciphertext 'c' and lengths of a message, as runs of blocks */
+static void chacha_aead_batch_runs(chacha_aead_batch_msg *bm, const unsigned char *c) {
+	struct chacha_crypto_aead_job *job = bm->job;
+	unsigned long long adfull = job->adlen & ~15ULL, cfull = job->inlen & ~15ULL;
+
+	memset(&bm->msg, 0, sizeof(bm->msg));
+	memset(bm->pad, 0, sizeof(bm->pad));
+
+	if (job->adlen != adfull)
+		memcpy(bm->pad[0], job->ad + adfull, job->adlen - adfull);
+
+	if (job->inlen != cfull)
+		memcpy(bm->pad[1], c + cfull, job->inlen - cfull);
+
+	chacha_store32(bm->pad[2] + 0, (uint32_t) job->adlen);
+	chacha_store32(bm->pad[2] + 4, (uint32_t) (job->adlen >> 32));
+	chacha_store32(bm->pad[2] + 8, (uint32_t) job->inlen);
+	chacha_store32(bm->pad[2] + 12, (uint32_t) (job->inlen >> 32));
+
+	chacha_poly1305_msg_add(&bm->msg, job->ad, adfull);
+	chacha_poly1305_msg_add(&bm->msg, bm->pad[0], (job->adlen != adfull) ? 16 : 0);
+	chacha_poly1305_msg_add(&bm->msg, c, cfull);
+	chacha_poly1305_msg_add(&bm->msg, bm->pad[1], (job->inlen != cfull) ? 16 : 0);
+	chacha_poly1305_msg_add(&bm->msg, bm->pad[2], 16);
+}
+
+/*
+ * Encrypts (or decrypts) a window of short messages: the keystream of all of
+ * them goes through the multi-buffer queue, block 0 included, and their tags
+ * through chacha_poly1305_batch(). On decryption the tags are verified
+ * before any keystream beyond block 0 is generated.
+ */
+static void chacha_aead_batch_window(chacha_aead_batch_msg *bm, unsigned int n, int enc) {
+	static const unsigned char zero[64];
+	chacha_poly1305_state *st[CHACHA_BATCH_WINDOW];
+	chacha_poly1305_msg *msg[CHACHA_BATCH_WINDOW];
+	struct chacha_crypto_aead_job *job;
+	unsigned char mac[CHACHA_CRYPTO_AEAD_TAGBYTES];
+	chacha_mb mb;
+	unsigned int i, j, d;
+
+	chacha_mb_init(&mb);
+
+	for (i = 0; i < n; i ++) {
+		job = bm[i].job;
+
+		chacha_state(bm[i].s, job->n + 4, job->k);
+		bm[i].counter = (unsigned long long) chacha_load32(job->n) << 32;
+
+		chacha_mb_xor(&mb, bm[i].otk, zero, sizeof(bm[i].otk), bm[i].s, bm[i].counter);
+
+		if (enc)
+			chacha_mb_xor(&mb, job->out, job->in, job->inlen, bm[i].s, bm[i].counter + 1);
+	}
+
+	chacha_mb_flush(&mb);
+
+	for (i = 0; i < n; i ++) {
+		chacha_poly1305_init(&bm[i].st, bm[i].otk);
+		chacha_aead_batch_runs(&bm[i], enc ? bm[i].job->out : bm[i].job->in);
+
+		st[i] = &bm[i].st;
+		msg[i] = &bm[i].msg;
+	}
+
+	chacha_poly1305_batch(st, msg, n);
+
+	for (i = 0; i < n; i ++) {
+		job = bm[i].job;
+		job->ret = 0;
+
+		if (enc) {
+			chacha_poly1305_finish(&bm[i].st, job->tag);
+			continue;
+		}
+
+		chacha_poly1305_finish(&bm[i].st, mac);
+
+		/* Constant time tag comparison */
+		for (j = 0, d = 0; j < sizeof(mac); j ++)
+			d |= mac[j] ^ job->tag[j];
+
+		if (d) {
+			memset(job->out, 0, job->inlen);
+			job->ret = -1;
+			continue;
+		}
+
+		chacha_mb_xor(&mb, job->out, job->in, job->inlen, bm[i].s, bm[i].counter + 1);
+	}
+
+	chacha_mb_flush(&mb);
+
+	chacha_wipe(bm, 0, sizeof(chacha_aead_batch_msg) * n);
+	chacha_wipe(&mb, 0, sizeof(mb));
+}
+
+static int chacha_aead_batch(struct chacha_crypto_aead_job *jobs, unsigned int njobs, int enc) {
+	chacha_aead_batch_msg bm[CHACHA_BATCH_WINDOW];
+	struct chacha_crypto_aead_job *job;
+	unsigned int i, n = 0;
+	int ret = 0;
+
+	for (i = 0; i < njobs; i ++) {
+		job = &jobs[i];
+
+		if (job->inlen > CHACHA_BATCH_MAX_BYTES) {
+			if (enc) {
+				job->ret = chacha_crypto_aead_encrypt(job->out, job->tag, job->in, job->inlen, job->ad, job->adlen, job->n, job->k);
+			} else {
+				job->ret = chacha_crypto_aead_decrypt(job->out, job->in, job->inlen, job->tag, job->ad, job->adlen, job->n, job->k);
+			}
+
+			continue;
+		}
+
+		bm[n ++].job = job;
+
+		if (n == CHACHA_BATCH_WINDOW) {
+			chacha_aead_batch_window(bm, n, enc);
+			n = 0;
+		}
+	}
+
+	if (n)
+		chacha_aead_batch_window(bm, n, enc);
+
+	for (i = 0; i < njobs; i ++)
+		ret |= jobs[i].ret;
+
+	return ret ? -1 : 0;
+}
+
+int chacha_crypto_aead_encrypt_batch(struct chacha_crypto_aead_job *jobs, unsigned int njobs) {
+	return chacha_aead_batch(jobs, njobs, 1);
+}
+
+int chacha_crypto_aead_decrypt_batch(struct chacha_crypto_aead_job *jobs, unsigned int njobs) {
+	return chacha_aead_batch(jobs, njobs, 0);
+}
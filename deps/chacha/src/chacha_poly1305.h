@@ -0,0 +1,412 @@
+/*
+   Poly1305 one-time authenticator for the ChaCha20-Poly1305 AEAD
+
+   Copyright 2012-2014 Pedro A. Hortas (pah@ucodev.org)
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+/*
+ * Included by chacha.c. Only whole 16 byte blocks are processed (the AEAD
+ * zero pads the associated data and the ciphertext), so every block gets the
+ * 2^128 bit.
+ *
+ * Uses 44/44/42 bit limbs when the compiler has a 128-bit integer type, and
+ * 26-bit limbs otherwise. With 44-bit limbs and SIMD, long messages are MACed
+ * by a 4 (AVX2) or 8 (AVX-512) lane vector version (chacha_poly1305_wide),
+ * whose lanes are folded back into the serial state before the tail, and
+ * batches of short messages by the same lanes running one message each
+ * (chacha_poly1305_mb.h).
+ */
+
+#ifdef __SIZEOF_INT128__
+
+#define CHACHA_POLY1305_M42	0x3ffffffffffULL
+#define CHACHA_POLY1305_M44	0xfffffffffffULL
+
+typedef unsigned __int128 chacha_poly1305_u128;
+
+typedef struct {
+	uint64_t r[3];
+	uint64_t h[3];
+	uint64_t pad[2];
+} chacha_poly1305_state;
+
+static uint64_t chacha_poly1305_load64(const unsigned char *p) {
+	return (uint64_t) chacha_load32(p) | ((uint64_t) chacha_load32(p + 4) << 32);
+}
+
+static void chacha_poly1305_init(chacha_poly1305_state *st, const unsigned char k[32]) {
+	uint64_t t0 = chacha_poly1305_load64(k), t1 = chacha_poly1305_load64(k + 8);
+
+	/* r &= 0x0ffffffc0ffffffc0ffffffc0fffffff */
+	st->r[0] = t0 & 0xffc0fffffffULL;
+	st->r[1] = ((t0 >> 44) | (t1 << 20)) & 0xfffffc0ffffULL;
+	st->r[2] = (t1 >> 24) & 0x00ffffffc0fULL;
+
+	st->h[0] = st->h[1] = st->h[2] = 0;
+
+	st->pad[0] = chacha_poly1305_load64(k + 16);
+	st->pad[1] = chacha_poly1305_load64(k + 24);
+}
+
+/* Processes 'bytes' (a multiple of 16) bytes */
+static __inline__ void chacha_poly1305_blocks(chacha_poly1305_state *st, const unsigned char *m, unsigned long long bytes) {
+	uint64_t r0 = st->r[0], r1 = st->r[1], r2 = st->r[2];
+	uint64_t s1 = r1 * (5 << 2), s2 = r2 * (5 << 2);
+	uint64_t h0 = st->h[0], h1 = st->h[1], h2 = st->h[2];
+	uint64_t t0, t1, c;
+	chacha_poly1305_u128 d0, d1, d2;
+
+	for (; bytes >= 16; bytes -= 16, m += 16) {
+		t0 = chacha_poly1305_load64(m);
+		t1 = chacha_poly1305_load64(m + 8);
+
+		h0 += t0 & CHACHA_POLY1305_M44;
+		h1 += ((t0 >> 44) | (t1 << 20)) & CHACHA_POLY1305_M44;
+		h2 += ((t1 >> 24) & CHACHA_POLY1305_M42) | ((uint64_t) 1 << 40);
+
+		/* h = h * r mod 2^130 - 5, partially reduced */
+		d0 = (chacha_poly1305_u128) h0 * r0 + (chacha_poly1305_u128) h1 * s2 + (chacha_poly1305_u128) h2 * s1;
+		d1 = (chacha_poly1305_u128) h0 * r1 + (chacha_poly1305_u128) h1 * r0 + (chacha_poly1305_u128) h2 * s2;
+		d2 = (chacha_poly1305_u128) h0 * r2 + (chacha_poly1305_u128) h1 * r1 + (chacha_poly1305_u128) h2 * r0;
+
+		c = (uint64_t) (d0 >> 44); h0 = (uint64_t) d0 & CHACHA_POLY1305_M44;
+		d1 += c; c = (uint64_t) (d1 >> 44); h1 = (uint64_t) d1 & CHACHA_POLY1305_M44;
+		d2 += c; c = (uint64_t) (d2 >> 42); h2 = (uint64_t) d2 & CHACHA_POLY1305_M42;
+		h0 += c * 5; c = h0 >> 44; h0 &= CHACHA_POLY1305_M44;
+		h1 += c;
+	}
+
+	st->h[0] = h0;
+	st->h[1] = h1;
+	st->h[2] = h2;
+}
+
+static void chacha_poly1305_finish(chacha_poly1305_state *st, unsigned char mac[16]) {
+	uint64_t h0 = st->h[0], h1 = st->h[1], h2 = st->h[2], g0, g1, g2, c, mask;
+
+	/* Full carry: h0, h1 < 2^44, h2 < 2^42 */
+	c = h1 >> 44; h1 &= CHACHA_POLY1305_M44; h2 += c;
+	c = h2 >> 42; h2 &= CHACHA_POLY1305_M42; h0 += c * 5;
+	c = h0 >> 44; h0 &= CHACHA_POLY1305_M44; h1 += c;
+	c = h1 >> 44; h1 &= CHACHA_POLY1305_M44; h2 += c;
+	c = h2 >> 42; h2 &= CHACHA_POLY1305_M42; h0 += c * 5;
+	c = h0 >> 44; h0 &= CHACHA_POLY1305_M44; h1 += c;
+
+	/* h - p, selected if h >= p */
+	g0 = h0 + 5; c = g0 >> 44; g0 &= CHACHA_POLY1305_M44;
+	g1 = h1 + c; c = g1 >> 44; g1 &= CHACHA_POLY1305_M44;
+	g2 = h2 + c - ((uint64_t) 1 << 42);
+
+	mask = (g2 >> 63) - 1;
+	h0 = (h0 & ~mask) | (g0 & mask);
+	h1 = (h1 & ~mask) | (g1 & mask);
+	h2 = (h2 & ~mask) | (g2 & mask);
+
+	/* h + pad mod 2^128 */
+	h0 += st->pad[0] & CHACHA_POLY1305_M44; c = h0 >> 44; h0 &= CHACHA_POLY1305_M44;
+	h1 += (((st->pad[0] >> 44) | (st->pad[1] << 20)) & CHACHA_POLY1305_M44) + c; c = h1 >> 44; h1 &= CHACHA_POLY1305_M44;
+	h2 += ((st->pad[1] >> 24) & CHACHA_POLY1305_M42) + c;
+
+	h0 |= h1 << 44;
+	h1 = (h1 >> 20) | (h2 << 24);
+
+	chacha_store32(mac + 0, (uint32_t) h0);
+	chacha_store32(mac + 4, (uint32_t) (h0 >> 32));
+	chacha_store32(mac + 8, (uint32_t) h1);
+	chacha_store32(mac + 12, (uint32_t) (h1 >> 32));
+}
+
+#ifdef CHACHA_SIMD
+#define CHACHA_POLY1305_WIDE
+#endif
+
+#else
+
+typedef struct {
+	uint32_t r[5];
+	uint32_t h[5];
+	uint32_t pad[4];
+} chacha_poly1305_state;
+
+static void chacha_poly1305_init(chacha_poly1305_state *st, const unsigned char k[32]) {
+	int i;
+
+	/* r &= 0x0ffffffc0ffffffc0ffffffc0fffffff */
+	st->r[0] = (chacha_load32(k + 0)) & 0x3ffffff;
+	st->r[1] = (chacha_load32(k + 3) >> 2) & 0x3ffff03;
+	st->r[2] = (chacha_load32(k + 6) >> 4) & 0x3ffc0ff;
+	st->r[3] = (chacha_load32(k + 9) >> 6) & 0x3f03fff;
+	st->r[4] = (chacha_load32(k + 12) >> 8) & 0x00fffff;
+
+	for (i = 0; i < 5; i ++)
+		st->h[i] = 0;
+
+	for (i = 0; i < 4; i ++)
+		st->pad[i] = chacha_load32(k + 16 + i * 4);
+}
+
+/* Processes 'bytes' (a multiple of 16) bytes */
+static __inline__ void chacha_poly1305_blocks(chacha_poly1305_state *st, const unsigned char *m, unsigned long long bytes) {
+	uint32_t r0 = st->r[0], r1 = st->r[1], r2 = st->r[2], r3 = st->r[3], r4 = st->r[4];
+	uint32_t s1 = r1 * 5, s2 = r2 * 5, s3 = r3 * 5, s4 = r4 * 5;
+	uint32_t h0 = st->h[0], h1 = st->h[1], h2 = st->h[2], h3 = st->h[3], h4 = st->h[4];
+	uint64_t d0, d1, d2, d3, d4;
+	uint32_t c;
+
+	for (; bytes >= 16; bytes -= 16, m += 16) {
+		h0 += (chacha_load32(m + 0)) & 0x3ffffff;
+		h1 += (chacha_load32(m + 3) >> 2) & 0x3ffffff;
+		h2 += (chacha_load32(m + 6) >> 4) & 0x3ffffff;
+		h3 += (chacha_load32(m + 9) >> 6) & 0x3ffffff;
+		h4 += (chacha_load32(m + 12) >> 8) | (1 << 24);
+
+		d0 = (uint64_t) h0 * r0 + (uint64_t) h1 * s4 + (uint64_t) h2 * s3 + (uint64_t) h3 * s2 + (uint64_t) h4 * s1;
+		d1 = (uint64_t) h0 * r1 + (uint64_t) h1 * r0 + (uint64_t) h2 * s4 + (uint64_t) h3 * s3 + (uint64_t) h4 * s2;
+		d2 = (uint64_t) h0 * r2 + (uint64_t) h1 * r1 + (uint64_t) h2 * r0 + (uint64_t) h3 * s4 + (uint64_t) h4 * s3;
+		d3 = (uint64_t) h0 * r3 + (uint64_t) h1 * r2 + (uint64_t) h2 * r1 + (uint64_t) h3 * r0 + (uint64_t) h4 * s4;
+		d4 = (uint64_t) h0 * r4 + (uint64_t) h1 * r3 + (uint64_t) h2 * r2 + (uint64_t) h3 * r1 + (uint64_t) h4 * r0;
+
+		c = (uint32_t) (d0 >> 26); h0 = (uint32_t) d0 & 0x3ffffff;
+		d1 += c; c = (uint32_t) (d1 >> 26); h1 = (uint32_t) d1 & 0x3ffffff;
+		d2 += c; c = (uint32_t) (d2 >> 26); h2 = (uint32_t) d2 & 0x3ffffff;
+		d3 += c; c = (uint32_t) (d3 >> 26); h3 = (uint32_t) d3 & 0x3ffffff;
+		d4 += c; c = (uint32_t) (d4 >> 26); h4 = (uint32_t) d4 & 0x3ffffff;
+		h0 += c * 5; c = h0 >> 26; h0 &= 0x3ffffff;
+		h1 += c;
+	}
+
+	st->h[0] = h0;
+	st->h[1] = h1;
+	st->h[2] = h2;
+	st->h[3] = h3;
+	st->h[4] = h4;
+}
+
+static void chacha_poly1305_finish(chacha_poly1305_state *st, unsigned char mac[16]) {
+	uint32_t h0 = st->h[0], h1 = st->h[1], h2 = st->h[2], h3 = st->h[3], h4 = st->h[4];
+	uint32_t g0, g1, g2, g3, g4, c, mask;
+	uint64_t f;
+
+	/* Full carry */
+	c = h1 >> 26; h1 &= 0x3ffffff; h2 += c;
+	c = h2 >> 26; h2 &= 0x3ffffff; h3 += c;
+	c = h3 >> 26; h3 &= 0x3ffffff; h4 += c;
+	c = h4 >> 26; h4 &= 0x3ffffff; h0 += c * 5;
+	c = h0 >> 26; h0 &= 0x3ffffff; h1 += c;
+
+	/* h - p, selected if h >= p */
+	g0 = h0 + 5; c = g0 >> 26; g0 &= 0x3ffffff;
+	g1 = h1 + c; c = g1 >> 26; g1 &= 0x3ffffff;
+	g2 = h2 + c; c = g2 >> 26; g2 &= 0x3ffffff;
+	g3 = h3 + c; c = g3 >> 26; g3 &= 0x3ffffff;
+	g4 = h4 + c - (1 << 26);
+
+	mask = (g4 >> 31) - 1;
+	h0 = (h0 & ~mask) | (g0 & mask);
+	h1 = (h1 & ~mask) | (g1 & mask);
+	h2 = (h2 & ~mask) | (g2 & mask);
+	h3 = (h3 & ~mask) | (g3 & mask);
+	h4 = (h4 & ~mask) | (g4 & mask);
+
+	/* h as 4 x 32 bits, plus pad mod 2^128 */
+	h0 = (h0) | (h1 << 26);
+	h1 = (h1 >> 6) | (h2 << 20);
+	h2 = (h2 >> 12) | (h3 << 14);
+	h3 = (h3 >> 18) | (h4 << 8);
+
+	f = (uint64_t) h0 + st->pad[0]; chacha_store32(mac + 0, (uint32_t) f);
+	f = (uint64_t) h1 + st->pad[1] + (f >> 32); chacha_store32(mac + 4, (uint32_t) f);
+	f = (uint64_t) h2 + st->pad[2] + (f >> 32); chacha_store32(mac + 8, (uint32_t) f);
+	f = (uint64_t) h3 + st->pad[3] + (f >> 32); chacha_store32(mac + 12, (uint32_t) f);
+}
+
+#endif
+
+/* Processes 'bytes' bytes, zero padding the last block */
+static void chacha_poly1305_padded(chacha_poly1305_state *st, const unsigned char *m, unsigned long long bytes) {
+	unsigned char block[16];
+	unsigned long long full = bytes & ~15ULL;
+
+	chacha_poly1305_blocks(st, m, full);
+
+	if (bytes -= full) {
+		memset(block, 0, sizeof(block));
+		memcpy(block, m + full, bytes);
+
+		chacha_poly1305_blocks(st, block, 16);
+	}
+}
+
+/*
+ * A message MACed as part of a batch: up to CHACHA_POLY1305_RUNS runs of
+ * whole blocks, which the AEAD uses for the associated data, the ciphertext,
+ * their zero padded tails and the lengths block
+ */
+#define CHACHA_POLY1305_RUNS	5
+
+typedef struct {
+	const unsigned char *p[CHACHA_POLY1305_RUNS];
+	unsigned long long n[CHACHA_POLY1305_RUNS];	/* Blocks left in each run */
+	unsigned long long left;			/* Blocks left in the message */
+	unsigned int run;				/* First run with blocks left */
+	unsigned int runs;
+} chacha_poly1305_msg;
+
+/* Appends 'bytes' (a multiple of 16) bytes to the message */
+static void chacha_poly1305_msg_add(chacha_poly1305_msg *msg, const unsigned char *p, unsigned long long bytes) {
+	if (!bytes)
+		return;
+
+	msg->p[msg->runs] = p;
+	msg->n[msg->runs ++] = bytes / 16;
+	msg->left += bytes / 16;
+}
+
+/* Processes the blocks of the message that are left */
+static void chacha_poly1305_msg_blocks(chacha_poly1305_state *st, chacha_poly1305_msg *msg) {
+	for (; msg->run < msg->runs; msg->run ++) {
+		chacha_poly1305_blocks(st, msg->p[msg->run], msg->n[msg->run] * 16);
+		msg->n[msg->run] = 0;
+	}
+
+	msg->left = 0;
+}
+
+#ifdef CHACHA_POLY1305_WIDE
+
+#define CHACHA_POLY1305_M26	0x3ffffffULL
+#define CHACHA_POLY1305_LANES	8
+
+typedef struct {
+	uint64_t h[5][CHACHA_POLY1305_LANES];	/* Lane accumulators, 26-bit limbs, limb major */
+	uint64_t rn[5];				/* r^lanes, 26-bit limbs */
+	uint64_t p[CHACHA_POLY1305_LANES][3];	/* r^(lanes - i), applied to lane i when folding */
+	unsigned int lanes;
+	int started;
+} chacha_poly1305_wide;
+
+/* h = h * r mod 2^130 - 5, partially reduced */
+static void chacha_poly1305_mul(uint64_t h[3], const uint64_t r[3]) {
+	uint64_t s1 = r[1] * (5 << 2), s2 = r[2] * (5 << 2), c;
+	chacha_poly1305_u128 d0, d1, d2;
+
+	d0 = (chacha_poly1305_u128) h[0] * r[0] + (chacha_poly1305_u128) h[1] * s2 + (chacha_poly1305_u128) h[2] * s1;
+	d1 = (chacha_poly1305_u128) h[0] * r[1] + (chacha_poly1305_u128) h[1] * r[0] + (chacha_poly1305_u128) h[2] * s2;
+	d2 = (chacha_poly1305_u128) h[0] * r[2] + (chacha_poly1305_u128) h[1] * r[1] + (chacha_poly1305_u128) h[2] * r[0];
+
+	c = (uint64_t) (d0 >> 44); h[0] = (uint64_t) d0 & CHACHA_POLY1305_M44;
+	d1 += c; c = (uint64_t) (d1 >> 44); h[1] = (uint64_t) d1 & CHACHA_POLY1305_M44;
+	d2 += c; c = (uint64_t) (d2 >> 42); h[2] = (uint64_t) d2 & CHACHA_POLY1305_M42;
+	h[0] += c * 5; c = h[0] >> 44; h[0] &= CHACHA_POLY1305_M44;
+	h[1] += c;
+}
+
+/* Carries h down to h0, h1 < 2^44 and h2 <= 2^42 */
+static void chacha_poly1305_carry(uint64_t h[3]) {
+	uint64_t c;
+
+	c = h[0] >> 44; h[0] &= CHACHA_POLY1305_M44; h[1] += c;
+	c = h[1] >> 44; h[1] &= CHACHA_POLY1305_M44; h[2] += c;
+	c = h[2] >> 42; h[2] &= CHACHA_POLY1305_M42; h[0] += c * 5;
+	c = h[0] >> 44; h[0] &= CHACHA_POLY1305_M44; h[1] += c;
+	c = h[1] >> 44; h[1] &= CHACHA_POLY1305_M44; h[2] += c;
+}
+
+/* 44-bit limbs (carried) to 26-bit limbs */
+static void chacha_poly1305_to26(uint64_t out[5], const uint64_t h[3]) {
+	out[0] = h[0] & CHACHA_POLY1305_M26;
+	out[1] = ((h[0] >> 26) | (h[1] << 18)) & CHACHA_POLY1305_M26;
+	out[2] = (h[1] >> 8) & CHACHA_POLY1305_M26;
+	out[3] = ((h[1] >> 34) | (h[2] << 10)) & CHACHA_POLY1305_M26;
+	out[4] = h[2] >> 16;
+}
+
+/* 26-bit limbs (< 2^28 each) back to 44-bit limbs, carried */
+static void chacha_poly1305_from26(uint64_t h[3], uint64_t l0, uint64_t l1, uint64_t l2, uint64_t l3, uint64_t l4) {
+	h[0] = l0 + (l1 << 26);
+	h[1] = (h[0] >> 44) + (l2 << 8) + (l3 << 34);
+	h[0] &= CHACHA_POLY1305_M44;
+	h[2] = (h[1] >> 44) + (l4 << 16);
+	h[1] &= CHACHA_POLY1305_M44;
+
+	chacha_poly1305_carry(h);
+}
+
+/* Next block of a message (which must have one left) */
+static __inline__ const unsigned char *chacha_poly1305_msg_next(chacha_poly1305_msg *msg) {
+	const unsigned char *p;
+
+	while (!msg->n[msg->run])
+		msg->run ++;
+
+	p = msg->p[msg->run];
+
+	msg->p[msg->run] += 16;
+	msg->n[msg->run] --;
+	msg->left --;
+
+	return p;
+}
+
+/* Prepares 'lanes' lanes for the message MACed so far in 'st' */
+static void chacha_poly1305_wide_init(chacha_poly1305_wide *w, const chacha_poly1305_state *st, unsigned int lanes) {
+	uint64_t p[3];
+	unsigned int i;
+
+	memcpy(p, st->r, sizeof(p));
+
+	for (i = 1; i <= lanes; i ++) {
+		if (i > 1) {
+			chacha_poly1305_mul(p, st->r);
+			chacha_poly1305_carry(p);
+		}
+
+		memcpy(w->p[lanes - i], p, sizeof(p));
+	}
+
+	chacha_poly1305_to26(w->rn, p);
+
+	w->lanes = lanes;
+	w->started = 0;
+}
+
+/*
+ * Adds up the lanes, each multiplied by its power of r, into the serial
+ * state, so that scalar blocks (or a new run of lanes) can follow
+ */
+static void chacha_poly1305_wide_fold(chacha_poly1305_wide *w, chacha_poly1305_state *st) {
+	uint64_t h[3];
+	unsigned int i;
+
+	if (!w->started)
+		return;
+
+	st->h[0] = st->h[1] = st->h[2] = 0;
+
+	for (i = 0; i < w->lanes; i ++) {
+		chacha_poly1305_from26(h, w->h[0][i], w->h[1][i], w->h[2][i], w->h[3][i], w->h[4][i]);
+		chacha_poly1305_mul(h, w->p[i]);
+
+		st->h[0] += h[0];
+		st->h[1] += h[1];
+		st->h[2] += h[2];
+	}
+
+	chacha_poly1305_carry(st->h);
+
+	w->started = 0;
+}
+
+#endif
@@ -0,0 +1,109 @@
+/*
+   Poly1305 - multi-message vector block function template
+
+   Copyright 2012-2014 Pedro A. Hortas (pah@ucodev.org)
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+/*
+ * Included by chacha.c once per instruction set, next to chacha_poly1305_vec.h
+ * and with the same POLY_VEC_* operations, plus CHACHA_POLY1305_MB (the name)
+ * and POLY_VEC_GATHER (one block per lane, from separate pointers).
+ *
+ * Processes the next 'steps' blocks of each of CHACHA_POLY1305_VEC_LANES
+ * independent messages, one message per lane and each with its own r. Every
+ * lane runs the serial h = (h + m) * r of its message, so, unlike the lanes
+ * of chacha_poly1305_wide, there is nothing to fold: the lane goes back to
+ * its state as it is. Lanes whose state is NULL are idle.
+ */
+
+static __attribute__((target(CHACHA_POLY1305_VEC_TARGET))) void CHACHA_POLY1305_MB(
+		chacha_poly1305_state **st,
+		chacha_poly1305_msg **msg,
+		unsigned long long steps) {
+	static const unsigned char zero[16];
+	const POLY_VEC_T mask = POLY_VEC_SET1(CHACHA_POLY1305_M26), hibit = POLY_VEC_SET1(1 << 24);
+	POLY_VEC_T h[5], r[5], s[5], d[5], t0, t1, c;
+	uint64_t hl[5][CHACHA_POLY1305_LANES], rl[5][CHACHA_POLY1305_LANES], t[5], u[3];
+	const unsigned char *m[CHACHA_POLY1305_VEC_LANES];
+	int i, l;
+
+	for (l = 0; l < CHACHA_POLY1305_VEC_LANES; l ++) {
+		for (i = 0; i < 5; i ++)
+			hl[i][l] = rl[i][l] = 0;
+
+		if (!st[l])
+			continue;
+
+		memcpy(u, st[l]->h, sizeof(u));
+		chacha_poly1305_carry(u);
+		chacha_poly1305_to26(t, u);
+
+		for (i = 0; i < 5; i ++)
+			hl[i][l] = t[i];
+
+		chacha_poly1305_to26(t, st[l]->r);
+
+		for (i = 0; i < 5; i ++)
+			rl[i][l] = t[i];
+	}
+
+	for (i = 0; i < 5; i ++) {
+		h[i] = POLY_VEC_LOAD(hl[i]);
+		r[i] = POLY_VEC_LOAD(rl[i]);
+		s[i] = POLY_VEC_ADD(r[i], POLY_VEC_SLL(r[i], 2));
+	}
+
+	for (; steps; steps --) {
+		for (l = 0; l < CHACHA_POLY1305_VEC_LANES; l ++)
+			m[l] = st[l] ? chacha_poly1305_msg_next(msg[l]) : zero;
+
+		/* t0 and t1: low and high 64 bits of the block of each lane */
+		POLY_VEC_GATHER(t0, t1, m);
+
+		h[0] = POLY_VEC_ADD(h[0], POLY_VEC_AND(t0, mask));
+		h[1] = POLY_VEC_ADD(h[1], POLY_VEC_AND(POLY_VEC_SRL(t0, 26), mask));
+		h[2] = POLY_VEC_ADD(h[2], POLY_VEC_AND(POLY_VEC_OR(POLY_VEC_SRL(t0, 52), POLY_VEC_SLL(t1, 12)), mask));
+		h[3] = POLY_VEC_ADD(h[3], POLY_VEC_AND(POLY_VEC_SRL(t1, 14), mask));
+		h[4] = POLY_VEC_ADD(h[4], POLY_VEC_OR(POLY_VEC_SRL(t1, 40), hibit));
+
+#define MUL(a, b) POLY_VEC_MUL(a, b)
+#define ADD(a, b) POLY_VEC_ADD(a, b)
+		d[0] = ADD(ADD(ADD(ADD(MUL(h[0], r[0]), MUL(h[1], s[4])), MUL(h[2], s[3])), MUL(h[3], s[2])), MUL(h[4], s[1]));
+		d[1] = ADD(ADD(ADD(ADD(MUL(h[0], r[1]), MUL(h[1], r[0])), MUL(h[2], s[4])), MUL(h[3], s[3])), MUL(h[4], s[2]));
+		d[2] = ADD(ADD(ADD(ADD(MUL(h[0], r[2]), MUL(h[1], r[1])), MUL(h[2], r[0])), MUL(h[3], s[4])), MUL(h[4], s[3]));
+		d[3] = ADD(ADD(ADD(ADD(MUL(h[0], r[3]), MUL(h[1], r[2])), MUL(h[2], r[1])), MUL(h[3], r[0])), MUL(h[4], s[4]));
+		d[4] = ADD(ADD(ADD(ADD(MUL(h[0], r[4]), MUL(h[1], r[3])), MUL(h[2], r[2])), MUL(h[3], r[1])), MUL(h[4], r[0]));
+#undef MUL
+#undef ADD
+
+		/* Partial reduction: every limb < 2^26, but h1 < 2^27 */
+		c = POLY_VEC_SRL(d[0], 26); h[0] = POLY_VEC_AND(d[0], mask); d[1] = POLY_VEC_ADD(d[1], c);
+		c = POLY_VEC_SRL(d[1], 26); h[1] = POLY_VEC_AND(d[1], mask); d[2] = POLY_VEC_ADD(d[2], c);
+		c = POLY_VEC_SRL(d[2], 26); h[2] = POLY_VEC_AND(d[2], mask); d[3] = POLY_VEC_ADD(d[3], c);
+		c = POLY_VEC_SRL(d[3], 26); h[3] = POLY_VEC_AND(d[3], mask); d[4] = POLY_VEC_ADD(d[4], c);
+		c = POLY_VEC_SRL(d[4], 26); h[4] = POLY_VEC_AND(d[4], mask);
+		h[0] = POLY_VEC_ADD(h[0], POLY_VEC_ADD(c, POLY_VEC_SLL(c, 2)));
+		c = POLY_VEC_SRL(h[0], 26); h[0] = POLY_VEC_AND(h[0], mask);
+		h[1] = POLY_VEC_ADD(h[1], c);
+	}
+
+	for (i = 0; i < 5; i ++)
+		POLY_VEC_STORE(hl[i], h[i]);
+
+	for (l = 0; l < CHACHA_POLY1305_VEC_LANES; l ++) {
+		if (st[l])
+			chacha_poly1305_from26(st[l]->h, hl[0][l], hl[1][l], hl[2][l], hl[3][l], hl[4][l]);
+	}
+}
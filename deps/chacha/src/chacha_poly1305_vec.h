@@ -0,0 +1,100 @@
+/*
+   Poly1305 - multi-lane vector block function template
+
+   Copyright 2012-2014 Pedro A. Hortas (pah@ucodev.org)
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+/*
+ * Included by chacha.c once per instruction set, with CHACHA_POLY1305_VEC,
+ * CHACHA_POLY1305_VEC_TARGET, CHACHA_POLY1305_VEC_LANES and the POLY_VEC_*
+ * type and operations defined.
+ *
+ * Processes 'bytes' (a multiple of 16 * CHACHA_POLY1305_VEC_LANES) bytes of
+ * full blocks. Lane i accumulates blocks i, i + lanes, i + 2 * lanes, ...
+ * multiplying by r^lanes between them, and chacha_poly1305_wide_fold() later
+ * multiplies it by r^(lanes - i), so the lanes add up to the serial h. The
+ * serial h of the message so far goes into lane 0 along with the first block.
+ */
+
+static __attribute__((target(CHACHA_POLY1305_VEC_TARGET))) void CHACHA_POLY1305_VEC(
+		chacha_poly1305_wide *w,
+		chacha_poly1305_state *st,
+		const unsigned char *m,
+		unsigned long long bytes) {
+	const POLY_VEC_T mask = POLY_VEC_SET1(CHACHA_POLY1305_M26), hibit = POLY_VEC_SET1(1 << 24);
+	POLY_VEC_T h[5], r[5], s[5], d[5], t0, t1, c;
+	uint64_t h26[5];
+	int i, started = w->started;
+
+	if (!bytes)
+		return;
+
+	for (i = 0; i < 5; i ++) {
+		r[i] = POLY_VEC_SET1(w->rn[i]);
+		s[i] = POLY_VEC_SET1(w->rn[i] * 5);
+	}
+
+	if (!started) {
+		chacha_poly1305_to26(h26, st->h);
+
+		memset(w->h, 0, sizeof(w->h));
+
+		for (i = 0; i < 5; i ++)
+			w->h[i][0] = h26[i];
+	}
+
+	for (i = 0; i < 5; i ++)
+		h[i] = POLY_VEC_LOAD(w->h[i]);
+
+	for (; bytes; bytes -= 16 * CHACHA_POLY1305_VEC_LANES, m += 16 * CHACHA_POLY1305_VEC_LANES) {
+		if (started) {
+#define MUL(a, b) POLY_VEC_MUL(a, b)
+#define ADD(a, b) POLY_VEC_ADD(a, b)
+			d[0] = ADD(ADD(ADD(ADD(MUL(h[0], r[0]), MUL(h[1], s[4])), MUL(h[2], s[3])), MUL(h[3], s[2])), MUL(h[4], s[1]));
+			d[1] = ADD(ADD(ADD(ADD(MUL(h[0], r[1]), MUL(h[1], r[0])), MUL(h[2], s[4])), MUL(h[3], s[3])), MUL(h[4], s[2]));
+			d[2] = ADD(ADD(ADD(ADD(MUL(h[0], r[2]), MUL(h[1], r[1])), MUL(h[2], r[0])), MUL(h[3], s[4])), MUL(h[4], s[3]));
+			d[3] = ADD(ADD(ADD(ADD(MUL(h[0], r[3]), MUL(h[1], r[2])), MUL(h[2], r[1])), MUL(h[3], r[0])), MUL(h[4], s[4]));
+			d[4] = ADD(ADD(ADD(ADD(MUL(h[0], r[4]), MUL(h[1], r[3])), MUL(h[2], r[2])), MUL(h[3], r[1])), MUL(h[4], r[0]));
+#undef MUL
+#undef ADD
+
+			/* Partial reduction: every limb < 2^26, but h1 < 2^27 */
+			c = POLY_VEC_SRL(d[0], 26); h[0] = POLY_VEC_AND(d[0], mask); d[1] = POLY_VEC_ADD(d[1], c);
+			c = POLY_VEC_SRL(d[1], 26); h[1] = POLY_VEC_AND(d[1], mask); d[2] = POLY_VEC_ADD(d[2], c);
+			c = POLY_VEC_SRL(d[2], 26); h[2] = POLY_VEC_AND(d[2], mask); d[3] = POLY_VEC_ADD(d[3], c);
+			c = POLY_VEC_SRL(d[3], 26); h[3] = POLY_VEC_AND(d[3], mask); d[4] = POLY_VEC_ADD(d[4], c);
+			c = POLY_VEC_SRL(d[4], 26); h[4] = POLY_VEC_AND(d[4], mask);
+			h[0] = POLY_VEC_ADD(h[0], POLY_VEC_ADD(c, POLY_VEC_SLL(c, 2)));
+			c = POLY_VEC_SRL(h[0], 26); h[0] = POLY_VEC_AND(h[0], mask);
+			h[1] = POLY_VEC_ADD(h[1], c);
+		}
+
+		started = 1;
+
+		/* t0 and t1: low and high 64 bits of the block of each lane */
+		POLY_VEC_SPLIT(t0, t1, m);
+
+		h[0] = POLY_VEC_ADD(h[0], POLY_VEC_AND(t0, mask));
+		h[1] = POLY_VEC_ADD(h[1], POLY_VEC_AND(POLY_VEC_SRL(t0, 26), mask));
+		h[2] = POLY_VEC_ADD(h[2], POLY_VEC_AND(POLY_VEC_OR(POLY_VEC_SRL(t0, 52), POLY_VEC_SLL(t1, 12)), mask));
+		h[3] = POLY_VEC_ADD(h[3], POLY_VEC_AND(POLY_VEC_SRL(t1, 14), mask));
+		h[4] = POLY_VEC_ADD(h[4], POLY_VEC_OR(POLY_VEC_SRL(t1, 40), hibit));
+	}
+
+	for (i = 0; i < 5; i ++)
+		POLY_VEC_STORE(w->h[i], h[i]);
+
+	w->started = 1;
+}
@@ -0,0 +1,67 @@
+/*
+   ChaCha20 - 4-way 128-bit kernel template
+
+   Copyright 2012-2014 Pedro A. Hortas (pah@ucodev.org)
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+/*
+ * Included by chacha.c once per instruction set, with CHACHA_VEC4_KERNEL,
+ * CHACHA_VEC4_TARGET and CHACHA_VEC4_ROTL defined.
+ *
+ * Processes 'blocks' (a multiple of 4) blocks starting at block 'counter',
+ * one block per 32-bit lane. Loads and stores are unaligned.
+ */
+
+static __attribute__((target(CHACHA_VEC4_TARGET))) void CHACHA_VEC4_KERNEL(
+		unsigned char *out,
+		const unsigned char *in,
+		unsigned long long blocks,
+		const uint32_t s[16],
+		unsigned long long counter) {
+	__m128i x0, x1, x2, x3, x4, x5, x6, x7, x8, x9, x10, x11, x12, x13, x14, x15;
+	__m128i j12, j13;
+	int i;
+
+	for (; blocks; blocks -= 4, counter += 4, out += 256, in += 256) {
+		x0 = _mm_set1_epi32(s[0]); x1 = _mm_set1_epi32(s[1]); x2 = _mm_set1_epi32(s[2]); x3 = _mm_set1_epi32(s[3]);
+		x4 = _mm_set1_epi32(s[4]); x5 = _mm_set1_epi32(s[5]); x6 = _mm_set1_epi32(s[6]); x7 = _mm_set1_epi32(s[7]);
+		x8 = _mm_set1_epi32(s[8]); x9 = _mm_set1_epi32(s[9]); x10 = _mm_set1_epi32(s[10]); x11 = _mm_set1_epi32(s[11]);
+		x12 = j12 = _mm_set_epi32(counter + 3, counter + 2, counter + 1, counter);
+		x13 = j13 = _mm_set_epi32((counter + 3) >> 32, (counter + 2) >> 32, (counter + 1) >> 32, counter >> 32);
+		x14 = _mm_set1_epi32(s[14]); x15 = _mm_set1_epi32(s[15]);
+
+		for (i = 20; i > 0; i -= 2)
+			CHACHA_DOUBLEROUND(VEC4_ADD, VEC4_XOR, CHACHA_VEC4_ROTL);
+
+		x0 = _mm_add_epi32(x0, _mm_set1_epi32(s[0])); x1 = _mm_add_epi32(x1, _mm_set1_epi32(s[1]));
+		x2 = _mm_add_epi32(x2, _mm_set1_epi32(s[2])); x3 = _mm_add_epi32(x3, _mm_set1_epi32(s[3]));
+		x4 = _mm_add_epi32(x4, _mm_set1_epi32(s[4])); x5 = _mm_add_epi32(x5, _mm_set1_epi32(s[5]));
+		x6 = _mm_add_epi32(x6, _mm_set1_epi32(s[6])); x7 = _mm_add_epi32(x7, _mm_set1_epi32(s[7]));
+		x8 = _mm_add_epi32(x8, _mm_set1_epi32(s[8])); x9 = _mm_add_epi32(x9, _mm_set1_epi32(s[9]));
+		x10 = _mm_add_epi32(x10, _mm_set1_epi32(s[10])); x11 = _mm_add_epi32(x11, _mm_set1_epi32(s[11]));
+		x12 = _mm_add_epi32(x12, j12); x13 = _mm_add_epi32(x13, j13);
+		x14 = _mm_add_epi32(x14, _mm_set1_epi32(s[14])); x15 = _mm_add_epi32(x15, _mm_set1_epi32(s[15]));
+
+		VEC4_TRANSPOSE(x0, x1, x2, x3);
+		VEC4_TRANSPOSE(x4, x5, x6, x7);
+		VEC4_TRANSPOSE(x8, x9, x10, x11);
+		VEC4_TRANSPOSE(x12, x13, x14, x15);
+
+		VEC4_XOR_STORE(0, x0); VEC4_XOR_STORE(16, x4); VEC4_XOR_STORE(32, x8); VEC4_XOR_STORE(48, x12);
+		VEC4_XOR_STORE(64, x1); VEC4_XOR_STORE(80, x5); VEC4_XOR_STORE(96, x9); VEC4_XOR_STORE(112, x13);
+		VEC4_XOR_STORE(128, x2); VEC4_XOR_STORE(144, x6); VEC4_XOR_STORE(160, x10); VEC4_XOR_STORE(176, x14);
+		VEC4_XOR_STORE(192, x3); VEC4_XOR_STORE(208, x7); VEC4_XOR_STORE(224, x11); VEC4_XOR_STORE(240, x15);
+	}
+}
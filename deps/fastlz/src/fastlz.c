@@ -82,6 +82,17 @@
 #endif
 #endif
 
+/*
+ * Wild-copy decompressors (SSE2/AVX2) selected at runtime by CPU feature.
+ * Define FASTLZ_NO_WILDCOPY to build only the portable decompressor.
+ */
+#if !defined(FASTLZ_NO_WILDCOPY) && (defined(__x86_64__) || defined(__i386__)) && \
+    (defined(__clang__) || (__GNUC__ > 4) || ((__GNUC__ == 4) && (__GNUC_MINOR__ >= 9)))
+#define FASTLZ_WILDCOPY
+#include <string.h>
+#include <immintrin.h>
+#endif
+
 /*
  * FIXME: use preprocessor magic to set this on different platforms!
  */
@@ -126,6 +137,81 @@ int fastlz_decompress(const void* input, int length, void* output, int maxout);
 #define HASH_MASK  (HASH_SIZE-1)
 #define HASH_FUNCTION(v,p) { v = FASTLZ_READU16(p); v ^= FASTLZ_READU16(p+1)^(v>>(16-HASH_LOG));v &= HASH_MASK; }
 
+#ifdef FASTLZ_WILDCOPY
+/*
+ * Wild-copy primitives. They may write up to one vector past the requested
+ * length, so callers must ensure that much slack is left in the output.
+ */
+#define FASTLZ_WILD_INLINE static inline __attribute__((always_inline))
+
+FASTLZ_WILD_INLINE void fastlz_copy8(flzuint8* op, const flzuint8* ip)
+{
+  memcpy(op, ip, 8);
+}
+
+FASTLZ_WILD_INLINE __attribute__((target("sse2"))) void fastlz_copy16(flzuint8* op, const flzuint8* ip)
+{
+  _mm_storeu_si128((__m128i*) op, _mm_loadu_si128((const __m128i*) ip));
+}
+
+FASTLZ_WILD_INLINE __attribute__((target("sse2"))) void fastlz_fill16(flzuint8* op, flzuint8* op_end, flzuint8 b)
+{
+  __m128i v = _mm_set1_epi8((char) b);
+  for(; op < op_end; op += 16)
+    _mm_storeu_si128((__m128i*) op, v);
+}
+
+FASTLZ_WILD_INLINE __attribute__((target("avx2"))) void fastlz_copy32(flzuint8* op, const flzuint8* ip)
+{
+  _mm256_storeu_si256((__m256i*) op, _mm256_loadu_si256((const __m256i*) ip));
+}
+
+FASTLZ_WILD_INLINE __attribute__((target("avx2"))) void fastlz_fill32(flzuint8* op, flzuint8* op_end, flzuint8 b)
+{
+  __m256i v = _mm256_set1_epi8((char) b);
+  for(; op < op_end; op += 32)
+    _mm256_storeu_si256((__m256i*) op, v);
+}
+
+/* Copies a match of len bytes in steps of n bytes, with op - ref >= n */
+#define FASTLZ_WILD_MATCH(n,copy) \
+  if(len >= n) \
+  { \
+    flzuint8* cpy = op + len - n; \
+    for(; op < cpy; op += n, ref += n) \
+      copy(op, ref); \
+    copy(cpy, ref - (op - cpy)); \
+    op = cpy + n; \
+  } \
+  else if(op_limit - op >= n) \
+  { \
+    copy(op, ref); \
+    op += len; \
+  } \
+  else \
+  { \
+    for(; len; --len) \
+      *op++ = *ref++; \
+  }
+
+/* 0: portable, 1: SSE2, 2: AVX2 */
+static int fastlz_wild_isa = -1;
+
+static int fastlz_wild_select(void)
+{
+  int isa = fastlz_wild_isa;
+
+  if(FASTLZ_UNEXPECT_CONDITIONAL(isa < 0))
+  {
+    __builtin_cpu_init();
+    isa = __builtin_cpu_supports("avx2") ? 2 : (__builtin_cpu_supports("sse2") ? 1 : 0);
+    fastlz_wild_isa = isa;
+  }
+
+  return isa;
+}
+#endif
+
 #undef FASTLZ_LEVEL
 #define FASTLZ_LEVEL 1
 
@@ -135,6 +221,12 @@ int fastlz_decompress(const void* input, int length, void* output, int maxout);
 #define FASTLZ_DECOMPRESSOR fastlz1_decompress
 static FASTLZ_INLINE int FASTLZ_COMPRESSOR(const void* input, int length, void* output);
 static FASTLZ_INLINE int FASTLZ_DECOMPRESSOR(const void* input, int length, void* output, int maxout);
+#ifdef FASTLZ_WILDCOPY
+#undef FASTLZ_DECOMPRESSOR_SSE2
+#undef FASTLZ_DECOMPRESSOR_AVX2
+#define FASTLZ_DECOMPRESSOR_SSE2 fastlz1_decompress_sse2
+#define FASTLZ_DECOMPRESSOR_AVX2 fastlz1_decompress_avx2
+#endif
 #include "fastlz.c"
 
 #undef FASTLZ_LEVEL
@@ -150,6 +242,12 @@ static FASTLZ_INLINE int FASTLZ_DECOMPRESSOR(const void* input, int length, void
 #define FASTLZ_DECOMPRESSOR fastlz2_decompress
 static FASTLZ_INLINE int FASTLZ_COMPRESSOR(const void* input, int length, void* output);
 static FASTLZ_INLINE int FASTLZ_DECOMPRESSOR(const void* input, int length, void* output, int maxout);
+#ifdef FASTLZ_WILDCOPY
+#undef FASTLZ_DECOMPRESSOR_SSE2
+#undef FASTLZ_DECOMPRESSOR_AVX2
+#define FASTLZ_DECOMPRESSOR_SSE2 fastlz2_decompress_sse2
+#define FASTLZ_DECOMPRESSOR_AVX2 fastlz2_decompress_avx2
+#endif
 #include "fastlz.c"
 
 #ifdef COMPILE_WIN32
@@ -173,6 +271,24 @@ int fastlz_decompress(const void* input, int length, void* output, int maxout)
   /* magic identifier for compression level */
   int level = ((*(const flzuint8*)input) >> 5) + 1;
 
+#ifdef FASTLZ_WILDCOPY
+  switch(fastlz_wild_select())
+  {
+    case 2:
+      if(level == 1)
+        return fastlz1_decompress_avx2(input, length, output, maxout);
+      if(level == 2)
+        return fastlz2_decompress_avx2(input, length, output, maxout);
+      return 0;
+    case 1:
+      if(level == 1)
+        return fastlz1_decompress_sse2(input, length, output, maxout);
+      if(level == 2)
+        return fastlz2_decompress_sse2(input, length, output, maxout);
+      return 0;
+  }
+#endif
+
   if(level == 1)
     return fastlz1_decompress(input, length, output, maxout);
   if(level == 2)
@@ -579,4 +695,30 @@ static FASTLZ_INLINE int FASTLZ_DECOMPRESSOR(const void* input, int length, void
   return op - (flzuint8*)output;
 }
 
+#ifdef FASTLZ_WILDCOPY
+#undef FASTLZ_WILD_DECOMPRESSOR
+#undef FASTLZ_WILD_TARGET
+#undef FASTLZ_WILD_VEC
+#undef FASTLZ_WILD_COPY
+#undef FASTLZ_WILD_FILL
+#define FASTLZ_WILD_DECOMPRESSOR FASTLZ_DECOMPRESSOR_SSE2
+#define FASTLZ_WILD_TARGET "sse2"
+#define FASTLZ_WILD_VEC 16
+#define FASTLZ_WILD_COPY fastlz_copy16
+#define FASTLZ_WILD_FILL fastlz_fill16
+#include "fastlz_wild.h"
+
+#undef FASTLZ_WILD_DECOMPRESSOR
+#undef FASTLZ_WILD_TARGET
+#undef FASTLZ_WILD_VEC
+#undef FASTLZ_WILD_COPY
+#undef FASTLZ_WILD_FILL
+#define FASTLZ_WILD_DECOMPRESSOR FASTLZ_DECOMPRESSOR_AVX2
+#define FASTLZ_WILD_TARGET "avx2"
+#define FASTLZ_WILD_VEC 32
+#define FASTLZ_WILD_COPY fastlz_copy32
+#define FASTLZ_WILD_FILL fastlz_fill32
+#include "fastlz_wild.h"
+#endif
+
 #endif /* !defined(FASTLZ_COMPRESSOR) && !defined(FASTLZ_DECOMPRESSOR) */
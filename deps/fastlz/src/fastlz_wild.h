@@ -0,0 +1,168 @@
+/*
+   FastLZ - Wild-copy decompressor template
+
+   Copyright 2012-2014 Pedro A. Hortas (pah@ucodev.org)
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+/*
+ * Included by fastlz.c once per compression level and instruction set, with
+ * FASTLZ_WILD_DECOMPRESSOR, FASTLZ_WILD_TARGET, FASTLZ_WILD_VEC,
+ * FASTLZ_WILD_COPY and FASTLZ_WILD_FILL defined.
+ *
+ * Decodes the same stream as FASTLZ_DECOMPRESSOR and produces the same
+ * output, but copies literal runs in whole vectors and matches in 16 or 8
+ * byte steps. Copies shorter than a step are done as a full step when there
+ * is room left in the buffers, so bytes past the returned length (but within
+ * maxout) may be overwritten. Near the end of the buffers it falls back to
+ * byte copies.
+ */
+
+static __attribute__((target(FASTLZ_WILD_TARGET))) int FASTLZ_WILD_DECOMPRESSOR(const void* input, int length, void* output, int maxout)
+{
+  const flzuint8* ip = (const flzuint8*) input;
+  const flzuint8* ip_limit  = ip + length;
+  flzuint8* op = (flzuint8*) output;
+  flzuint8* op_limit = op + maxout;
+  flzuint32 ctrl = (*ip++) & 31;
+  int loop = 1;
+
+  do
+  {
+    const flzuint8* ref = op;
+    flzuint32 len = ctrl >> 5;
+    flzuint32 ofs = (ctrl & 31) << 8;
+
+    if(ctrl >= 32)
+    {
+#if FASTLZ_LEVEL==2
+      flzuint8 code;
+#endif
+      len--;
+      ref -= ofs;
+      if (len == 7-1)
+#if FASTLZ_LEVEL==1
+        len += *ip++;
+      ref -= *ip++;
+#else
+        do
+        {
+          code = *ip++;
+          len += code;
+        } while (code==255);
+      code = *ip++;
+      ref -= code;
+
+      /* match from 16-bit distance */
+      if(FASTLZ_UNEXPECT_CONDITIONAL(code==255))
+      if(FASTLZ_EXPECT_CONDITIONAL(ofs==(31 << 8)))
+      {
+        ofs = (*ip++) << 8;
+        ofs += *ip++;
+        ref = op - ofs - MAX_DISTANCE;
+      }
+#endif
+
+      if (FASTLZ_UNEXPECT_CONDITIONAL(op + len + 3 > op_limit))
+        return 0;
+
+      if (FASTLZ_UNEXPECT_CONDITIONAL(ref-1 < (flzuint8 *)output))
+        return 0;
+
+      if(FASTLZ_EXPECT_CONDITIONAL(ip < ip_limit))
+        ctrl = *ip++;
+      else
+        loop = 0;
+
+      /* match length including the 3 implicit bytes */
+      len += 3;
+      ref--;
+
+      if(ref == op - 1)
+      {
+        /* run of a single byte */
+        if(len >= FASTLZ_WILD_VEC)
+        {
+          FASTLZ_WILD_FILL(op, op + len - FASTLZ_WILD_VEC, *ref);
+          FASTLZ_WILD_FILL(op + len - FASTLZ_WILD_VEC, op + len - FASTLZ_WILD_VEC + 1, *ref);
+          op += len;
+        }
+        else if(op_limit - op >= FASTLZ_WILD_VEC)
+        {
+          FASTLZ_WILD_FILL(op, op + 1, *ref);
+          op += len;
+        }
+        else
+        {
+          for(; len; --len)
+            *op++ = *ref;
+        }
+      }
+      else if(op - ref >= 16)
+      {
+        FASTLZ_WILD_MATCH(16, fastlz_copy16);
+      }
+      else if(op - ref >= 8)
+      {
+        FASTLZ_WILD_MATCH(8, fastlz_copy8);
+      }
+      else
+      {
+        /* short period, replicate byte by byte */
+        for(; len; --len)
+          *op++ = *ref++;
+      }
+    }
+    else
+    {
+      ctrl++;
+      if (FASTLZ_UNEXPECT_CONDITIONAL(op + ctrl > op_limit))
+        return 0;
+      if (FASTLZ_UNEXPECT_CONDITIONAL(ip + ctrl > ip_limit))
+        return 0;
+
+      /* literal runs are at most MAX_COPY bytes long */
+      if(((op_limit - op) >= MAX_COPY) && ((ip_limit - ip) >= MAX_COPY))
+      {
+        FASTLZ_WILD_COPY(op, ip);
+#if FASTLZ_WILD_VEC < MAX_COPY
+        FASTLZ_WILD_COPY(op + FASTLZ_WILD_VEC, ip + FASTLZ_WILD_VEC);
+#endif
+        op += ctrl;
+        ip += ctrl;
+      }
+      else if(ctrl >= 16)
+      {
+        /* two possibly overlapping steps ending exactly at the end */
+        fastlz_copy16(op, ip);
+        fastlz_copy16(op + ctrl - 16, ip + ctrl - 16);
+        op += ctrl;
+        ip += ctrl;
+      }
+      else
+      {
+        *op++ = *ip++;
+        for(--ctrl; ctrl; ctrl--)
+          *op++ = *ip++;
+      }
+
+      loop = FASTLZ_EXPECT_CONDITIONAL(ip < ip_limit);
+      if(loop)
+        ctrl = *ip++;
+    }
+  }
+  while(FASTLZ_EXPECT_CONDITIONAL(loop));
+
+  return op - (flzuint8*)output;
+}
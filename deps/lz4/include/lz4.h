@@ -0,0 +1,75 @@
+/*
+   LZ4 block format codec
+
+   Compact implementation of the LZ4 block format, exposing the subset of
+   the upstream LZ4 API (http://code.google.com/p/lz4/) used by libsidp.
+   Compressed blocks are interchangeable with the upstream implementation.
+
+   Copyright 2012-2014 Pedro A. Hortas (pah@ucodev.org)
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#ifndef LZ4_H
+#define LZ4_H
+
+#if defined (__cplusplus)
+extern "C" {
+#endif
+
+/* Maximum input size accepted by the compressors */
+#define LZ4_MAX_INPUT_SIZE	0x7E000000
+
+/* Worst case compressed size for an input of 'isize' bytes */
+#define LZ4_COMPRESSBOUND(isize)	((unsigned) (isize) > (unsigned) LZ4_MAX_INPUT_SIZE ? 0 : (isize) + ((isize) / 255) + 16)
+
+/*
+  LZ4_compressBound():
+    Returns the maximum size that LZ4 compression may output in a "worst case"
+    scenario (input data not compressible), or 0 if the input size is larger
+    than LZ4_MAX_INPUT_SIZE.
+*/
+int LZ4_compressBound(int inputSize);
+
+/*
+  LZ4_compress_default():
+    Compresses 'srcSize' bytes from 'src' into 'dst', which is 'dstCapacity'
+    bytes long. Compression is guaranteed to succeed if 'dstCapacity' >=
+    LZ4_compressBound(srcSize).
+    Returns the number of bytes written into 'dst', or 0 on failure.
+*/
+int LZ4_compress_default(const char *src, char *dst, int srcSize, int dstCapacity);
+
+/*
+  LZ4_compress_fast():
+    Same as LZ4_compress_default(), but allows to select an "acceleration"
+    factor. Larger values trade compression ratio for speed. Values <= 0 are
+    replaced by 1 (default).
+*/
+int LZ4_compress_fast(const char *src, char *dst, int srcSize, int dstCapacity, int acceleration);
+
+/*
+  LZ4_decompress_safe():
+    Decompresses 'compressedSize' bytes from 'src' into 'dst', which is
+    'dstCapacity' bytes long. Malformed input never causes reads or writes
+    outside the provided buffers.
+    Returns the number of bytes decompressed into 'dst', or a negative value
+    if the input is malformed or 'dst' is too small.
+*/
+int LZ4_decompress_safe(const char *src, char *dst, int compressedSize, int dstCapacity);
+
+#if defined (__cplusplus)
+}
+#endif
+
+#endif
@@ -0,0 +1,50 @@
+/*
+   LZ4 HC - High Compression mode of the LZ4 block format codec
+
+   Produces regular LZ4 blocks, decodable with LZ4_decompress_safe(), using a
+   hash chain match finder that spends more CPU for a better ratio.
+
+   Copyright 2012-2014 Pedro A. Hortas (pah@ucodev.org)
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#ifndef LZ4HC_H
+#define LZ4HC_H
+
+#if defined (__cplusplus)
+extern "C" {
+#endif
+
+#include "lz4.h"
+
+/* Compression levels */
+#define LZ4HC_CLEVEL_MIN	3
+#define LZ4HC_CLEVEL_DEFAULT	9
+#define LZ4HC_CLEVEL_MAX	12
+
+/*
+  LZ4_compress_HC():
+    Compresses 'srcSize' bytes from 'src' into 'dst', which is 'dstCapacity'
+    bytes long, using the hash chain match finder. 'compressionLevel' ranges
+    from LZ4HC_CLEVEL_MIN to LZ4HC_CLEVEL_MAX. Values <= 0 select
+    LZ4HC_CLEVEL_DEFAULT and values above LZ4HC_CLEVEL_MAX are clamped.
+    Returns the number of bytes written into 'dst', or 0 on failure.
+*/
+int LZ4_compress_HC(const char *src, char *dst, int srcSize, int dstCapacity, int compressionLevel);
+
+#if defined (__cplusplus)
+}
+#endif
+
+#endif
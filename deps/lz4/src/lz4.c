@@ -0,0 +1,237 @@
+/*
+   LZ4 block format codec
+
+   Copyright 2012-2014 Pedro A. Hortas (pah@ucodev.org)
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "lz4.h"
+#include "lz4common.h"
+
+/* Fast compressor hash table: 4096 entries (16KiB) */
+#define LZ4_HASH_LOG		12
+#define LZ4_HASH_SIZE		(1 << LZ4_HASH_LOG)
+/* Match search step grows by one every 2^LZ4_SKIP_TRIGGER failed attempts */
+#define LZ4_SKIP_TRIGGER	6
+
+static inline uint32_t lz4_hash(uint32_t seq) {
+	return (seq * 2654435761U) >> (32 - LZ4_HASH_LOG);
+}
+
+/* Copies 8 bytes at a time. May write up to 7 bytes past 'dst_end' */
+static inline void lz4_wild_copy(uint8_t *dst, const uint8_t *src, uint8_t *dst_end) {
+	do {
+		memcpy(dst, src, 8);
+		dst += 8;
+		src += 8;
+	} while (dst < dst_end);
+}
+
+int LZ4_compressBound(int inputSize) {
+	return LZ4_COMPRESSBOUND(inputSize);
+}
+
+int LZ4_compress_fast(const char *src, char *dst, int srcSize, int dstCapacity, int acceleration) {
+	uint32_t table[LZ4_HASH_SIZE];
+	const uint8_t *base = (const uint8_t *) src;
+	const uint8_t *ip = base, *anchor = base, *ref;
+	const uint8_t *iend = base + srcSize;
+	const uint8_t *mflimit = iend - LZ4_MFLIMIT;
+	const uint8_t *matchlimit = iend - LZ4_LASTLITERALS;
+	uint8_t *op = (uint8_t *) dst;
+	const uint8_t *oend = op + dstCapacity;
+	uint32_t h, attempts;
+	size_t match_len;
+
+	if ((srcSize < 0) || (srcSize > LZ4_MAX_INPUT_SIZE) || (dstCapacity <= 0))
+		return 0;
+
+	if (acceleration <= 0)
+		acceleration = 1;
+
+	if (srcSize < LZ4_MIN_LENGTH)
+		goto _last_literals;
+
+	memset(table, 0, sizeof(table));
+
+	table[lz4_hash(lz4_read32(ip))] = 0;
+	ip ++;
+
+	for (;;) {
+		/* Find a match */
+		attempts = acceleration << LZ4_SKIP_TRIGGER;
+
+		for (;;) {
+			h = lz4_hash(lz4_read32(ip));
+			ref = base + table[h];
+			table[h] = (uint32_t) (ip - base);
+
+			if (((ip - ref) <= LZ4_MAX_DISTANCE) && (lz4_read32(ref) == lz4_read32(ip)))
+				break;
+
+			ip += attempts ++ >> LZ4_SKIP_TRIGGER;
+
+			if (ip > mflimit)
+				goto _last_literals;
+		}
+
+		/* Extend the match backwards over pending literals */
+		while ((ip > anchor) && (ref > base) && (ip[-1] == ref[-1])) {
+			ip --;
+			ref --;
+		}
+
+		match_len = LZ4_MINMATCH + lz4_count(ip + LZ4_MINMATCH, ref + LZ4_MINMATCH, matchlimit);
+
+		if (!(op = lz4_emit_sequence(op, oend, anchor, ip - anchor, (unsigned int) (ip - ref), match_len)))
+			return 0;
+
+		ip += match_len;
+		anchor = ip;
+
+		if (ip > mflimit)
+			break;
+
+		/* Keep the table fresh with a position inside the match */
+		table[lz4_hash(lz4_read32(ip - 2))] = (uint32_t) (ip - 2 - base);
+	}
+
+_last_literals:
+	if (!(op = lz4_emit_sequence(op, oend, anchor, iend - anchor, 0, 0)))
+		return 0;
+
+	return (int) (op - (uint8_t *) dst);
+}
+
+int LZ4_compress_default(const char *src, char *dst, int srcSize, int dstCapacity) {
+	return LZ4_compress_fast(src, dst, srcSize, dstCapacity, 1);
+}
+
+int LZ4_decompress_safe(const char *src, char *dst, int compressedSize, int dstCapacity) {
+	const uint8_t *ip = (const uint8_t *) src;
+	const uint8_t *iend = ip + compressedSize;
+	uint8_t *op = (uint8_t *) dst;
+	uint8_t *oend = op + dstCapacity;
+	const uint8_t *match;
+	unsigned int token, offset;
+	size_t len, s;
+
+	if ((compressedSize <= 0) || (dstCapacity < 0))
+		return -1;
+
+	for (;;) {
+		if (ip >= iend)
+			return -1;
+
+		token = *ip ++;
+		len = token >> LZ4_ML_BITS;
+
+		/* Fast path: a short literal run followed by a short match, with
+		 * enough room on both buffers to use fixed size copies. Such a
+		 * sequence can't be the last one of a valid block.
+		 */
+		if ((len < LZ4_RUN_MASK) && ((iend - ip) >= 32) && ((oend - op) >= 32)) {
+			memcpy(op, ip, 16);
+			ip += len;
+			op += len;
+
+			offset = ip[0] | (ip[1] << 8);
+			ip += 2;
+
+			len = token & LZ4_ML_MASK;
+
+			if ((len < LZ4_ML_MASK) && (offset >= 8) && (offset <= (size_t) (op - (uint8_t *) dst))) {
+				match = op - offset;
+				memcpy(op, match, 8);
+				memcpy(op + 8, match + 8, 8);
+				memcpy(op + 16, match + 16, 2);
+				op += len + LZ4_MINMATCH;
+
+				continue;
+			}
+
+			goto _match;
+		}
+
+		/* Literals */
+		if (len == LZ4_RUN_MASK) {
+			do {
+				if (ip >= iend)
+					return -1;
+
+				len += (s = *ip ++);
+			} while (s == 255);
+		}
+
+		if ((len > (size_t) (iend - ip)) || (len > (size_t) (oend - op)))
+			return -1;
+
+		if (((len + 8) <= (size_t) (iend - ip)) && ((len + 8) <= (size_t) (oend - op))) {
+			lz4_wild_copy(op, ip, op + len);
+		} else {
+			memmove(op, ip, len);
+		}
+
+		ip += len;
+		op += len;
+
+		/* The last sequence of a block has no match */
+		if (ip == iend)
+			break;
+
+		/* Match */
+		if ((iend - ip) < 2)
+			return -1;
+
+		offset = ip[0] | (ip[1] << 8);
+		ip += 2;
+
+		len = token & LZ4_ML_MASK;
+
+_match:
+		if (!offset || (offset > (size_t) (op - (uint8_t *) dst)))
+			return -1;
+
+		if (len == LZ4_ML_MASK) {
+			do {
+				if (ip >= iend)
+					return -1;
+
+				len += (s = *ip ++);
+			} while (s == 255);
+		}
+
+		len += LZ4_MINMATCH;
+
+		if (len > (size_t) (oend - op))
+			return -1;
+
+		match = op - offset;
+
+		if ((offset >= 8) && ((len + 8) <= (size_t) (oend - op))) {
+			lz4_wild_copy(op, match, op + len);
+			op += len;
+		} else {
+			/* Overlapping match (RLE like) or near the end of output */
+			while (len --)
+				*op ++ = *match ++;
+		}
+	}
+
+	return (int) (op - (uint8_t *) dst);
+}
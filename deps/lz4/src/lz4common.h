@@ -0,0 +1,162 @@
+/*
+   LZ4 block format codec - Internal helpers shared by lz4.c and lz4hc.c
+
+   Copyright 2012-2014 Pedro A. Hortas (pah@ucodev.org)
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#ifndef LZ4COMMON_H
+#define LZ4COMMON_H
+
+#include <string.h>
+#include <stdint.h>
+
+/* Block format constants */
+#define LZ4_MINMATCH		4
+#define LZ4_LASTLITERALS	5	/* The last 5 bytes are always literals */
+#define LZ4_MFLIMIT		12	/* The last match starts at least 12 bytes before the end */
+#define LZ4_MIN_LENGTH		(LZ4_MFLIMIT + 1)
+#define LZ4_MAX_DISTANCE	65535
+#define LZ4_ML_BITS		4
+#define LZ4_ML_MASK		((1U << LZ4_ML_BITS) - 1)
+#define LZ4_RUN_MASK		LZ4_ML_MASK
+
+static inline uint32_t lz4_read32(const void *p) {
+	uint32_t v;
+
+	memcpy(&v, p, sizeof(v));
+
+	return v;
+}
+
+static inline uint64_t lz4_read64(const void *p) {
+	uint64_t v;
+
+	memcpy(&v, p, sizeof(v));
+
+	return v;
+}
+
+static inline int lz4_is_little_endian(void) {
+	const union { uint32_t u; uint8_t c[4]; } one = { 1 };
+
+	return one.c[0];
+}
+
+/* Number of leading bytes that are equal in two 64 bit words */
+static inline unsigned int lz4_common_bytes(uint64_t diff) {
+#if defined(__GNUC__)
+	if (lz4_is_little_endian())
+		return __builtin_ctzll(diff) >> 3;
+
+	return __builtin_clzll(diff) >> 3;
+#else
+	unsigned int n = 0;
+
+	if (lz4_is_little_endian()) {
+		while (!(diff & 0xff)) {
+			diff >>= 8;
+			n ++;
+		}
+	} else {
+		while (!(diff >> 56)) {
+			diff <<= 8;
+			n ++;
+		}
+	}
+
+	return n;
+#endif
+}
+
+/* Length of the common prefix of 'in' and 'match', stopping at 'in_limit' */
+static inline size_t lz4_count(const uint8_t *in, const uint8_t *match, const uint8_t *in_limit) {
+	const uint8_t *start = in;
+	uint64_t diff;
+
+	while (in + 8 <= in_limit) {
+		if ((diff = lz4_read64(match) ^ lz4_read64(in)))
+			return (in - start) + lz4_common_bytes(diff);
+
+		in += 8;
+		match += 8;
+	}
+
+	while ((in < in_limit) && (*match == *in)) {
+		in ++;
+		match ++;
+	}
+
+	return in - start;
+}
+
+/* Writes a variable length field continuation (runs of 255) */
+static inline uint8_t *lz4_write_length(uint8_t *op, size_t len) {
+	for (; len >= 255; len -= 255)
+		*op ++ = 255;
+
+	*op ++ = (uint8_t) len;
+
+	return op;
+}
+
+/*
+ * Emits a sequence: 'lit_len' literals from 'lit' followed by a match of
+ * 'match_len' bytes at 'offset'. When 'match_len' is zero, only the literals
+ * are emitted (last sequence of a block).
+ * Returns the new output pointer, or NULL if 'oend' would be exceeded.
+ */
+static inline uint8_t *lz4_emit_sequence(
+		uint8_t *op,
+		const uint8_t *oend,
+		const uint8_t *lit,
+		size_t lit_len,
+		unsigned int offset,
+		size_t match_len) {
+	uint8_t *token;
+	size_t ml = match_len ? match_len - LZ4_MINMATCH : 0;
+
+	/* Worst case size of this sequence */
+	if ((size_t) (oend - op) < (1 + lit_len + (lit_len / 255) + 1 + 2 + (ml / 255) + 1))
+		return NULL;
+
+	token = op ++;
+
+	if (lit_len >= LZ4_RUN_MASK) {
+		*token = LZ4_RUN_MASK << LZ4_ML_BITS;
+		op = lz4_write_length(op, lit_len - LZ4_RUN_MASK);
+	} else {
+		*token = (uint8_t) (lit_len << LZ4_ML_BITS);
+	}
+
+	memcpy(op, lit, lit_len);
+	op += lit_len;
+
+	if (!match_len)
+		return op;
+
+	*op ++ = (uint8_t) offset;
+	*op ++ = (uint8_t) (offset >> 8);
+
+	if (ml >= LZ4_ML_MASK) {
+		*token |= LZ4_ML_MASK;
+		op = lz4_write_length(op, ml - LZ4_ML_MASK);
+	} else {
+		*token |= (uint8_t) ml;
+	}
+
+	return op;
+}
+
+#endif
@@ -0,0 +1,166 @@
+/*
+   LZ4 HC - High Compression mode of the LZ4 block format codec
+
+   Copyright 2012-2014 Pedro A. Hortas (pah@ucodev.org)
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "lz4hc.h"
+#include "lz4common.h"
+
+/* Hash chain match finder: 32768 heads and one chain link per window byte */
+#define LZ4HC_HASH_LOG		15
+#define LZ4HC_HASH_SIZE		(1 << LZ4HC_HASH_LOG)
+#define LZ4HC_CHAIN_SIZE	(LZ4_MAX_DISTANCE + 1)
+#define LZ4HC_CHAIN_MASK	(LZ4HC_CHAIN_SIZE - 1)
+#define LZ4HC_NONE		0xFFFFFFFFU
+
+struct lz4hc_state {
+	uint32_t head[LZ4HC_HASH_SIZE];
+	uint16_t chain[LZ4HC_CHAIN_SIZE];	/* distance to the previous position with the same hash, 0 ends the chain */
+	uint32_t next;				/* next position to be inserted */
+};
+
+static inline uint32_t lz4hc_hash(uint32_t seq) {
+	return (seq * 2654435761U) >> (32 - LZ4HC_HASH_LOG);
+}
+
+/* Inserts all positions up to (excluding) 'target' into the hash chains */
+static void lz4hc_insert(struct lz4hc_state *st, const uint8_t *base, uint32_t target) {
+	uint32_t pos, h, delta;
+
+	for (pos = st->next; pos < target; pos ++) {
+		h = lz4hc_hash(lz4_read32(base + pos));
+		delta = pos - st->head[h];
+
+		if ((st->head[h] == LZ4HC_NONE) || (delta > LZ4_MAX_DISTANCE))
+			delta = 0;
+
+		st->chain[pos & LZ4HC_CHAIN_MASK] = (uint16_t) delta;
+		st->head[h] = pos;
+	}
+
+	st->next = pos;
+}
+
+/* Returns the longest match length for 'ip' (0 if none) and sets 'match' */
+static size_t lz4hc_find_longest(
+		struct lz4hc_state *st,
+		const uint8_t *base,
+		const uint8_t *ip,
+		const uint8_t *matchlimit,
+		unsigned int attempts,
+		const uint8_t **match) {
+	uint32_t pos = (uint32_t) (ip - base), cand, delta;
+	const uint8_t *ref;
+	size_t len, best = 0;
+
+	lz4hc_insert(st, base, pos);
+
+	cand = st->head[lz4hc_hash(lz4_read32(ip))];
+
+	if (cand == LZ4HC_NONE)
+		return 0;
+
+	while (attempts -- && ((pos - cand) <= LZ4_MAX_DISTANCE)) {
+		ref = base + cand;
+
+		/* Cheap rejection: a longer match must also match at ip[best] */
+		if ((ref[best] == ip[best]) && (lz4_read32(ref) == lz4_read32(ip))) {
+			len = LZ4_MINMATCH + lz4_count(ip + LZ4_MINMATCH, ref + LZ4_MINMATCH, matchlimit);
+
+			if (len > best) {
+				best = len;
+				*match = ref;
+
+				if ((ip + best) == matchlimit)
+					break;
+			}
+		}
+
+		if (!(delta = st->chain[cand & LZ4HC_CHAIN_MASK]) || (delta > cand))
+			break;
+
+		cand -= delta;
+	}
+
+	return best;
+}
+
+int LZ4_compress_HC(const char *src, char *dst, int srcSize, int dstCapacity, int compressionLevel) {
+	struct lz4hc_state *st;
+	const uint8_t *base = (const uint8_t *) src;
+	const uint8_t *ip = base, *anchor = base, *ref = NULL, *ref2 = NULL;
+	const uint8_t *iend = base + srcSize;
+	const uint8_t *mflimit = iend - LZ4_MFLIMIT;
+	const uint8_t *matchlimit = iend - LZ4_LASTLITERALS;
+	uint8_t *op = (uint8_t *) dst;
+	const uint8_t *oend = op + dstCapacity;
+	unsigned int attempts;
+	size_t ml, ml2;
+
+	if ((srcSize < 0) || (srcSize > LZ4_MAX_INPUT_SIZE) || (dstCapacity <= 0))
+		return 0;
+
+	if (compressionLevel <= 0)
+		compressionLevel = LZ4HC_CLEVEL_DEFAULT;
+	else if (compressionLevel > LZ4HC_CLEVEL_MAX)
+		compressionLevel = LZ4HC_CLEVEL_MAX;
+
+	attempts = 1U << (compressionLevel - 1);
+
+	if (srcSize < LZ4_MIN_LENGTH)
+		goto _last_literals;
+
+	if (!(st = malloc(sizeof(struct lz4hc_state))))
+		return 0;
+
+	memset(st->head, 0xff, sizeof(st->head));
+	st->next = 0;
+
+	while (ip <= mflimit) {
+		if ((ml = lz4hc_find_longest(st, base, ip, matchlimit, attempts, &ref)) < LZ4_MINMATCH) {
+			ip ++;
+			continue;
+		}
+
+		/* Lazy evaluation: defer the match if the next position has a longer one */
+		while (((ip + 1) <= mflimit) && ((ml2 = lz4hc_find_longest(st, base, ip + 1, matchlimit, attempts, &ref2)) > ml)) {
+			ip ++;
+			ml = ml2;
+			ref = ref2;
+		}
+
+		if (!(op = lz4_emit_sequence(op, oend, anchor, ip - anchor, (unsigned int) (ip - ref), ml))) {
+			free(st);
+			return 0;
+		}
+
+		ip += ml;
+		anchor = ip;
+	}
+
+	free(st);
+
+_last_literals:
+	if (!(op = lz4_emit_sequence(op, oend, anchor, iend - anchor, 0, 0)))
+		return 0;
+
+	return (int) (op - (uint8_t *) dst);
+}
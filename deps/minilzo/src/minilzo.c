@@ -4096,9 +4096,24 @@ lookbehind_overrun:
 
 #endif
 
+/*
+ * Wild-copy safe decompressors (SSE2/AVX2) selected at runtime by CPU
+ * feature. Define LZO_NO_WILDCOPY to build only the portable decompressor.
+ */
+#if !defined(LZO_NO_WILDCOPY) && !defined(MINILZO_CFG_SKIP_LZO1X_DECOMPRESS_SAFE) && \
+    (defined(__x86_64__) || defined(__i386__)) && \
+    (defined(__clang__) || (__GNUC__ > 4) || ((__GNUC__ == 4) && (__GNUC_MINOR__ >= 9)))
+#define LZO_WILDCOPY 1
+#include <immintrin.h>
+#endif
+
 #define LZO_TEST_OVERRUN 1
 #undef DO_DECOMPRESS
+#if defined(LZO_WILDCOPY)
+#define DO_DECOMPRESS       lzo1x_decompress_safe_generic
+#else
 #define DO_DECOMPRESS       lzo1x_decompress_safe
+#endif
 
 #if !defined(MINILZO_CFG_SKIP_LZO1X_DECOMPRESS_SAFE)
 
@@ -4190,10 +4205,14 @@ lookbehind_overrun:
 #endif
 
 #if defined(DO_DECOMPRESS)
+#if defined(LZO_WILDCOPY)
+static int
+#else
 #ifdef COMPILE_WIN32
 DLLIMPORT
 #endif
 LZO_PUBLIC(int)
+#endif
 DO_DECOMPRESS  ( const lzo_bytep in , lzo_uint  in_len,
                        lzo_bytep out, lzo_uintp out_len,
                        lzo_voidp wrkmem )
@@ -4623,6 +4642,94 @@ lookbehind_overrun:
 #endif
 }
 
+#if defined(LZO_WILDCOPY)
+
+static __lzo_forceinline void lzo_wild_copy8(lzo_bytep op, const lzo_bytep ip)
+{
+    lzo_memcpy(op, ip, 8);
+}
+
+static __lzo_forceinline __attribute__((target("sse2"))) void lzo_wild_copy16(lzo_bytep op, const lzo_bytep ip)
+{
+    _mm_storeu_si128((__m128i *) op, _mm_loadu_si128((const __m128i *) ip));
+}
+
+static __lzo_forceinline __attribute__((target("avx2"))) void lzo_wild_copy32(lzo_bytep op, const lzo_bytep ip)
+{
+    _mm256_storeu_si256((__m256i *) op, _mm256_loadu_si256((const __m256i *) ip));
+}
+
+/* Copies a match of t bytes in steps of n bytes, with op - m_pos >= n */
+#define LZO_WILD_MATCH(n,copy) \
+    if (t >= n) \
+    { \
+        cpy = op + t - n; \
+        while (op < cpy) \
+        { \
+            copy(op, m_pos); \
+            op += n; m_pos += n; \
+        } \
+        m_pos -= pd(op, cpy); \
+        op = cpy; \
+        copy(op, m_pos); \
+        op += n; \
+    } \
+    else if (pd(op_end, op) >= n) \
+    { \
+        copy(op, m_pos); \
+        op += t; \
+    } \
+    else \
+    { \
+        do *op++ = *m_pos++; while (--t > 0); \
+    }
+
+#define LZO_WILD_DECOMPRESS lzo1x_decompress_safe_sse2
+#define LZO_WILD_TARGET     "sse2"
+#define LZO_WILD_VEC        16
+#define LZO_WILD_COPY       lzo_wild_copy16
+#include "minilzo_wild.h"
+
+#undef LZO_WILD_DECOMPRESS
+#undef LZO_WILD_TARGET
+#undef LZO_WILD_VEC
+#undef LZO_WILD_COPY
+#define LZO_WILD_DECOMPRESS lzo1x_decompress_safe_avx2
+#define LZO_WILD_TARGET     "avx2"
+#define LZO_WILD_VEC        32
+#define LZO_WILD_COPY       lzo_wild_copy32
+#include "minilzo_wild.h"
+
+/* 0: portable, 1: SSE2, 2: AVX2 */
+static int lzo_wild_isa = -1;
+
+#ifdef COMPILE_WIN32
+DLLIMPORT
+#endif
+LZO_PUBLIC(int)
+lzo1x_decompress_safe  ( const lzo_bytep in , lzo_uint  in_len,
+                               lzo_bytep out, lzo_uintp out_len,
+                               lzo_voidp wrkmem )
+{
+    int isa = lzo_wild_isa;
+
+    if (__lzo_unlikely(isa < 0))
+    {
+        __builtin_cpu_init();
+        isa = __builtin_cpu_supports("avx2") ? 2 : (__builtin_cpu_supports("sse2") ? 1 : 0);
+        lzo_wild_isa = isa;
+    }
+
+    if (isa == 2)
+        return lzo1x_decompress_safe_avx2(in, in_len, out, out_len, wrkmem);
+    if (isa == 1)
+        return lzo1x_decompress_safe_sse2(in, in_len, out, out_len, wrkmem);
+
+    return lzo1x_decompress_safe_generic(in, in_len, out, out_len, wrkmem);
+}
+
+#endif
+
 #endif
 
 /***** End of minilzo.c *****/
@@ -0,0 +1,240 @@
+/*
+   miniLZO - Wild-copy LZO1X safe decompressor template
+
+   Copyright 2012-2014 Pedro A. Hortas (pah@ucodev.org)
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+/*
+ * Included by minilzo.c once per instruction set, right after
+ * lzo1x_decompress_safe_generic() (so the overrun test macros are still in
+ * effect), with LZO_WILD_DECOMPRESS, LZO_WILD_TARGET, LZO_WILD_VEC and
+ * LZO_WILD_COPY defined.
+ *
+ * Decodes the same stream, returns the same result codes and produces the
+ * same output as lzo1x_decompress_safe_generic(), but copies literal runs in
+ * whole vectors and matches in 16 or 8 byte steps. Copies shorter than a step
+ * are done as a full step when there is room left in the buffers, so bytes
+ * past the returned length (but within the output buffer) may be overwritten.
+ * Near the end of the buffers it falls back to byte copies.
+ */
+
+static __attribute__((target(LZO_WILD_TARGET))) int
+LZO_WILD_DECOMPRESS  ( const lzo_bytep in , lzo_uint  in_len,
+                       lzo_bytep out, lzo_uintp out_len,
+                       lzo_voidp wrkmem )
+{
+    register lzo_bytep op;
+    register const lzo_bytep ip;
+    register lzo_uint t;
+    register const lzo_bytep m_pos;
+    lzo_bytep cpy;
+
+    const lzo_bytep const ip_end = in + in_len;
+    lzo_bytep const op_end = out + *out_len;
+
+    LZO_UNUSED(wrkmem);
+
+    *out_len = 0;
+
+    op = out;
+    ip = in;
+
+    if (*ip > 17)
+    {
+        t = *ip++ - 17;
+        if (t < 4)
+            goto match_next;
+        assert(t > 0); NEED_OP(t); NEED_IP(t+1);
+        do *op++ = *ip++; while (--t > 0);
+        goto first_literal_run;
+    }
+
+    while (TEST_IP && TEST_OP)
+    {
+        t = *ip++;
+        if (t >= 16)
+            goto match;
+        if (t == 0)
+        {
+            NEED_IP(1);
+            while (*ip == 0)
+            {
+                t += 255;
+                ip++;
+                NEED_IP(1);
+            }
+            t += 15 + *ip++;
+        }
+        assert(t > 0); NEED_OP(t+3); NEED_IP(t+4);
+        t += 3;
+        if (t >= LZO_WILD_VEC)
+        {
+            /* whole vectors, then one last vector ending exactly at the end */
+            cpy = op + t - LZO_WILD_VEC;
+            while (op < cpy)
+            {
+                LZO_WILD_COPY(op, ip);
+                op += LZO_WILD_VEC; ip += LZO_WILD_VEC;
+            }
+            ip -= pd(op, cpy);
+            op = cpy;
+            LZO_WILD_COPY(op, ip);
+            op += LZO_WILD_VEC; ip += LZO_WILD_VEC;
+        }
+        else if (pd(op_end, op) >= LZO_WILD_VEC && pd(ip_end, ip) >= LZO_WILD_VEC)
+        {
+            LZO_WILD_COPY(op, ip);
+            op += t; ip += t;
+        }
+        else
+        {
+            do *op++ = *ip++; while (--t > 0);
+        }
+
+first_literal_run:
+
+        t = *ip++;
+        if (t >= 16)
+            goto match;
+        m_pos = op - (1 + M2_MAX_OFFSET);
+        m_pos -= t >> 2;
+        m_pos -= *ip++ << 2;
+        TEST_LB(m_pos); NEED_OP(3);
+        *op++ = *m_pos++; *op++ = *m_pos++; *op++ = *m_pos;
+        goto match_done;
+
+        do {
+match:
+            if (t >= 64)
+            {
+                m_pos = op - 1;
+                m_pos -= (t >> 2) & 7;
+                m_pos -= *ip++ << 3;
+                t = (t >> 5) - 1;
+                TEST_LB(m_pos); assert(t > 0); NEED_OP(t+3-1);
+                goto copy_match;
+            }
+            else if (t >= 32)
+            {
+                t &= 31;
+                if (t == 0)
+                {
+                    NEED_IP(1);
+                    while (*ip == 0)
+                    {
+                        t += 255;
+                        ip++;
+                        NEED_IP(1);
+                    }
+                    t += 31 + *ip++;
+                }
+#if defined(LZO_UNALIGNED_OK_2) && defined(LZO_ABI_LITTLE_ENDIAN)
+                m_pos = op - 1;
+                m_pos -= UA_GET16(ip) >> 2;
+#else
+                m_pos = op - 1;
+                m_pos -= (ip[0] >> 2) + (ip[1] << 6);
+#endif
+                ip += 2;
+            }
+            else if (t >= 16)
+            {
+                m_pos = op;
+                m_pos -= (t & 8) << 11;
+                t &= 7;
+                if (t == 0)
+                {
+                    NEED_IP(1);
+                    while (*ip == 0)
+                    {
+                        t += 255;
+                        ip++;
+                        NEED_IP(1);
+                    }
+                    t += 7 + *ip++;
+                }
+#if defined(LZO_UNALIGNED_OK_2) && defined(LZO_ABI_LITTLE_ENDIAN)
+                m_pos -= UA_GET16(ip) >> 2;
+#else
+                m_pos -= (ip[0] >> 2) + (ip[1] << 6);
+#endif
+                ip += 2;
+                if (m_pos == op)
+                    goto eof_found;
+                m_pos -= 0x4000;
+            }
+            else
+            {
+                m_pos = op - 1;
+                m_pos -= t >> 2;
+                m_pos -= *ip++ << 2;
+                TEST_LB(m_pos); NEED_OP(2);
+                *op++ = *m_pos++; *op++ = *m_pos;
+                goto match_done;
+            }
+
+            TEST_LB(m_pos); assert(t > 0); NEED_OP(t+3-1);
+
+copy_match:
+            t += 3 - 1;
+            /* matches are mostly short and close, so copy them in 16 or 8
+             * byte steps; a step never reads bytes it has not yet written */
+            if (pd(op, m_pos) >= 16)
+            {
+                LZO_WILD_MATCH(16, lzo_wild_copy16)
+            }
+            else if (pd(op, m_pos) >= 8)
+            {
+                LZO_WILD_MATCH(8, lzo_wild_copy8)
+            }
+            else
+            {
+                do *op++ = *m_pos++; while (--t > 0);
+            }
+
+match_done:
+            t = ip[-2] & 3;
+            if (t == 0)
+                break;
+
+match_next:
+            assert(t > 0); assert(t < 4); NEED_OP(t); NEED_IP(t+1);
+            *op++ = *ip++;
+            if (t > 1) { *op++ = *ip++; if (t > 2) { *op++ = *ip++; } }
+            t = *ip++;
+        } while (TEST_IP && TEST_OP);
+    }
+
+    *out_len = pd(op, out);
+    return LZO_E_EOF_NOT_FOUND;
+
+eof_found:
+    assert(t == 1);
+    *out_len = pd(op, out);
+    return (ip == ip_end ? LZO_E_OK :
+           (ip < ip_end  ? LZO_E_INPUT_NOT_CONSUMED : LZO_E_INPUT_OVERRUN));
+
+input_overrun:
+    *out_len = pd(op, out);
+    return LZO_E_INPUT_OVERRUN;
+
+output_overrun:
+    *out_len = pd(op, out);
+    return LZO_E_OUTPUT_OVERRUN;
+
+lookbehind_overrun:
+    *out_len = pd(op, out);
+    return LZO_E_LOOKBEHIND_OVERRUN;
+}
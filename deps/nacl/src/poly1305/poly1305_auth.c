@@ -2,11 +2,337 @@
 20080912
 D. J. Bernstein
 Public domain.
+
+64-bit limb and AVX2 backends: 2014, libsidp. Public domain.
 */
 
 #include "config.h"
 #include "crypto_onetimeauth.h"
 
+/*
+ * Backends, fastest first:
+ *
+ *  - AVX2: four blocks in parallel (26-bit limbs) using precomputed r^1..r^4,
+ *    selected at runtime for messages of at least POLY1305_AVX2_MIN bytes.
+ *  - 64-bit limbs (44/44/42 bits) when the compiler has a 128-bit integer
+ *    type. Also handles the tail left by the AVX2 path.
+ *  - The byte-oriented reference implementation otherwise.
+ *
+ * Define POLY1305_REFERENCE to build only the reference implementation, or
+ * POLY1305_NO_AVX2 to leave out the AVX2 path.
+ */
+#if !defined(POLY1305_REFERENCE) && defined(__SIZEOF_INT128__)
+#define POLY1305_64BIT
+#if !defined(POLY1305_NO_AVX2) && defined(__x86_64__) && \
+    (defined(__clang__) || (__GNUC__ > 4) || ((__GNUC__ == 4) && (__GNUC_MINOR__ >= 9)))
+#define POLY1305_AVX2
+#include <immintrin.h>
+#endif
+#endif
+
+#ifdef POLY1305_64BIT
+
+typedef unsigned long long poly1305_u64;
+typedef unsigned __int128 poly1305_u128;
+
+#define POLY1305_M26 0x3ffffffULL
+#define POLY1305_M42 0x3ffffffffffULL
+#define POLY1305_M44 0xfffffffffffULL
+
+typedef struct {
+  poly1305_u64 r[3];
+  poly1305_u64 h[3];
+  poly1305_u64 pad[2];
+} poly1305_state;
+
+static poly1305_u64 load64(const unsigned char *p)
+{
+  return ((poly1305_u64) p[0]) | ((poly1305_u64) p[1] << 8) |
+         ((poly1305_u64) p[2] << 16) | ((poly1305_u64) p[3] << 24) |
+         ((poly1305_u64) p[4] << 32) | ((poly1305_u64) p[5] << 40) |
+         ((poly1305_u64) p[6] << 48) | ((poly1305_u64) p[7] << 56);
+}
+
+static void store64(unsigned char *p,poly1305_u64 v)
+{
+  unsigned int j;
+  for (j = 0;j < 8;++j) { p[j] = v & 255; v >>= 8; }
+}
+
+static void poly1305_init(poly1305_state *st,const unsigned char *k)
+{
+  poly1305_u64 t0 = load64(k);
+  poly1305_u64 t1 = load64(k + 8);
+
+  /* r &= 0xffffffc0ffffffc0ffffffc0fffffff */
+  st->r[0] = t0 & 0xffc0fffffffULL;
+  st->r[1] = ((t0 >> 44) | (t1 << 20)) & 0xfffffc0ffffULL;
+  st->r[2] = (t1 >> 24) & 0x00ffffffc0fULL;
+
+  st->h[0] = 0;
+  st->h[1] = 0;
+  st->h[2] = 0;
+
+  st->pad[0] = load64(k + 16);
+  st->pad[1] = load64(k + 24);
+}
+
+/* h = h * r mod 2^130 - 5, partially reduced */
+static void poly1305_mul(poly1305_u64 h[3],const poly1305_u64 r[3])
+{
+  poly1305_u64 s1 = r[1] * (5 << 2);
+  poly1305_u64 s2 = r[2] * (5 << 2);
+  poly1305_u128 d0, d1, d2;
+  poly1305_u64 c;
+
+  d0 = (poly1305_u128) h[0] * r[0] + (poly1305_u128) h[1] * s2 + (poly1305_u128) h[2] * s1;
+  d1 = (poly1305_u128) h[0] * r[1] + (poly1305_u128) h[1] * r[0] + (poly1305_u128) h[2] * s2;
+  d2 = (poly1305_u128) h[0] * r[2] + (poly1305_u128) h[1] * r[1] + (poly1305_u128) h[2] * r[0];
+
+  c = (poly1305_u64) (d0 >> 44); h[0] = (poly1305_u64) d0 & POLY1305_M44;
+  d1 += c; c = (poly1305_u64) (d1 >> 44); h[1] = (poly1305_u64) d1 & POLY1305_M44;
+  d2 += c; c = (poly1305_u64) (d2 >> 42); h[2] = (poly1305_u64) d2 & POLY1305_M42;
+  h[0] += c * 5; c = h[0] >> 44; h[0] &= POLY1305_M44;
+  h[1] += c;
+}
+
+/* Propagates the carries so that h0, h1 < 2^44 and h2 < 2^42 */
+static void poly1305_carry(poly1305_u64 h[3])
+{
+  poly1305_u64 c;
+
+  c = h[1] >> 44; h[1] &= POLY1305_M44; h[2] += c;
+  c = h[2] >> 42; h[2] &= POLY1305_M42; h[0] += c * 5;
+  c = h[0] >> 44; h[0] &= POLY1305_M44; h[1] += c;
+  c = h[1] >> 44; h[1] &= POLY1305_M44; h[2] += c;
+  c = h[2] >> 42; h[2] &= POLY1305_M42; h[0] += c * 5;
+  c = h[0] >> 44; h[0] &= POLY1305_M44; h[1] += c;
+}
+
+static void poly1305_blocks(poly1305_state *st,const unsigned char *m,unsigned long long bytes,poly1305_u64 hibit)
+{
+  poly1305_u64 t0, t1;
+
+  while (bytes >= 16) {
+    t0 = load64(m);
+    t1 = load64(m + 8);
+
+    st->h[0] += t0 & POLY1305_M44;
+    st->h[1] += ((t0 >> 44) | (t1 << 20)) & POLY1305_M44;
+    st->h[2] += ((t1 >> 24) & POLY1305_M42) | hibit;
+
+    poly1305_mul(st->h,st->r);
+
+    m += 16;
+    bytes -= 16;
+  }
+}
+
+static void poly1305_finish(poly1305_state *st,unsigned char *out)
+{
+  poly1305_u64 h0, h1, h2, g0, g1, g2, c, mask;
+
+  poly1305_carry(st->h);
+  h0 = st->h[0]; h1 = st->h[1]; h2 = st->h[2];
+
+  /* g = h + -p */
+  g0 = h0 + 5; c = g0 >> 44; g0 &= POLY1305_M44;
+  g1 = h1 + c; c = g1 >> 44; g1 &= POLY1305_M44;
+  g2 = h2 + c - ((poly1305_u64) 1 << 42);
+
+  /* select h if h < p, or h + -p if h >= p */
+  mask = (g2 >> 63) - 1;
+  h0 = (h0 & ~mask) | (g0 & mask);
+  h1 = (h1 & ~mask) | (g1 & mask);
+  h2 = (h2 & ~mask) | (g2 & mask);
+
+  /* h = h + pad */
+  h0 += st->pad[0] & POLY1305_M44; c = h0 >> 44; h0 &= POLY1305_M44;
+  h1 += (((st->pad[0] >> 44) | (st->pad[1] << 20)) & POLY1305_M44) + c; c = h1 >> 44; h1 &= POLY1305_M44;
+  h2 += ((st->pad[1] >> 24) & POLY1305_M42) + c;
+
+  store64(out,h0 | (h1 << 44));
+  store64(out + 8,(h1 >> 20) | (h2 << 24));
+}
+
+#ifdef POLY1305_AVX2
+
+/* Below this size the setup of the parallel path (r^2..r^4) doesn't pay off */
+#define POLY1305_AVX2_MIN 256
+
+/* 0: scalar, 1: AVX2 */
+static int poly1305_avx2_isa = -1;
+
+static int poly1305_avx2_select(void)
+{
+  int isa = poly1305_avx2_isa;
+
+  if (isa < 0) {
+    __builtin_cpu_init();
+    isa = __builtin_cpu_supports("avx2") ? 1 : 0;
+    poly1305_avx2_isa = isa;
+  }
+
+  return isa;
+}
+
+/* 44-bit limbs (carried) to 26-bit limbs */
+static void poly1305_to26(poly1305_u64 out[5],const poly1305_u64 h[3])
+{
+  out[0] = h[0] & POLY1305_M26;
+  out[1] = ((h[0] >> 26) | (h[1] << 18)) & POLY1305_M26;
+  out[2] = (h[1] >> 8) & POLY1305_M26;
+  out[3] = ((h[1] >> 34) | (h[2] << 10)) & POLY1305_M26;
+  out[4] = h[2] >> 16;
+}
+
+/* Loads four blocks, one per lane, as 26-bit limbs with the 2^128 bit set */
+static __attribute__((target("avx2"))) __inline__ void poly1305_avx2_load(__m256i l[5],const unsigned char *m)
+{
+  const __m256i mask = _mm256_set1_epi64x(POLY1305_M26);
+  __m256i a = _mm256_loadu_si256((const __m256i *) m);
+  __m256i b = _mm256_loadu_si256((const __m256i *) (m + 32));
+  __m256i t0, t1;
+
+  /* t0 = low, t1 = high 64 bits of blocks 0..3 */
+  t0 = _mm256_permute4x64_epi64(_mm256_unpacklo_epi64(a,b),0xd8);
+  t1 = _mm256_permute4x64_epi64(_mm256_unpackhi_epi64(a,b),0xd8);
+
+  l[0] = _mm256_and_si256(t0,mask);
+  l[1] = _mm256_and_si256(_mm256_srli_epi64(t0,26),mask);
+  l[2] = _mm256_and_si256(_mm256_or_si256(_mm256_srli_epi64(t0,52),_mm256_slli_epi64(t1,12)),mask);
+  l[3] = _mm256_and_si256(_mm256_srli_epi64(t1,14),mask);
+  l[4] = _mm256_or_si256(_mm256_srli_epi64(t1,40),_mm256_set1_epi64x(1 << 24));
+}
+
+/* h = h * r per lane, with s = 5 * r, partially reduced */
+static __attribute__((target("avx2"))) __inline__ void poly1305_avx2_mul(__m256i h[5],const __m256i r[5],const __m256i s[5])
+{
+  const __m256i mask = _mm256_set1_epi64x(POLY1305_M26);
+  __m256i d0, d1, d2, d3, d4, c;
+
+#define MUL(a,b) _mm256_mul_epu32(a,b)
+#define ADD(a,b) _mm256_add_epi64(a,b)
+  d0 = ADD(ADD(ADD(ADD(MUL(h[0],r[0]),MUL(h[1],s[4])),MUL(h[2],s[3])),MUL(h[3],s[2])),MUL(h[4],s[1]));
+  d1 = ADD(ADD(ADD(ADD(MUL(h[0],r[1]),MUL(h[1],r[0])),MUL(h[2],s[4])),MUL(h[3],s[3])),MUL(h[4],s[2]));
+  d2 = ADD(ADD(ADD(ADD(MUL(h[0],r[2]),MUL(h[1],r[1])),MUL(h[2],r[0])),MUL(h[3],s[4])),MUL(h[4],s[3]));
+  d3 = ADD(ADD(ADD(ADD(MUL(h[0],r[3]),MUL(h[1],r[2])),MUL(h[2],r[1])),MUL(h[3],r[0])),MUL(h[4],s[4]));
+  d4 = ADD(ADD(ADD(ADD(MUL(h[0],r[4]),MUL(h[1],r[3])),MUL(h[2],r[2])),MUL(h[3],r[1])),MUL(h[4],r[0]));
+#undef MUL
+#undef ADD
+
+  c = _mm256_srli_epi64(d0,26); h[0] = _mm256_and_si256(d0,mask); d1 = _mm256_add_epi64(d1,c);
+  c = _mm256_srli_epi64(d1,26); h[1] = _mm256_and_si256(d1,mask); d2 = _mm256_add_epi64(d2,c);
+  c = _mm256_srli_epi64(d2,26); h[2] = _mm256_and_si256(d2,mask); d3 = _mm256_add_epi64(d3,c);
+  c = _mm256_srli_epi64(d3,26); h[3] = _mm256_and_si256(d3,mask); d4 = _mm256_add_epi64(d4,c);
+  c = _mm256_srli_epi64(d4,26); h[4] = _mm256_and_si256(d4,mask);
+  h[0] = _mm256_add_epi64(h[0],_mm256_add_epi64(c,_mm256_slli_epi64(c,2)));
+  c = _mm256_srli_epi64(h[0],26); h[0] = _mm256_and_si256(h[0],mask);
+  h[1] = _mm256_add_epi64(h[1],c);
+}
+
+/*
+ * Processes 'bytes' (a multiple of 64) of full blocks. Lane i accumulates
+ * blocks i, i + 4, i + 8, ... multiplying by r^4 between them, and is
+ * multiplied by r^(4 - i) at the end, so the lanes add up to the serial h.
+ */
+static __attribute__((target("avx2"))) void poly1305_blocks_avx2(poly1305_state *st,const unsigned char *m,unsigned long long bytes)
+{
+  poly1305_u64 p[5][3], p26[5][5], h26[5], lane[4];
+  __m256i h[5], l[5], r4[5], s4[5], rn[5], sn[5];
+  unsigned int i, j;
+
+  /* r^1..r^4 */
+  for (i = 0;i < 3;++i) p[1][i] = st->r[i];
+  for (j = 2;j <= 4;++j) {
+    for (i = 0;i < 3;++i) p[j][i] = p[j - 1][i];
+    poly1305_mul(p[j],st->r);
+    poly1305_carry(p[j]);
+  }
+  for (j = 1;j <= 4;++j) poly1305_to26(p26[j],p[j]);
+
+  for (i = 0;i < 5;++i) {
+    r4[i] = _mm256_set1_epi64x(p26[4][i]);
+    s4[i] = _mm256_set1_epi64x(p26[4][i] * 5);
+    rn[i] = _mm256_set_epi64x(p26[1][i],p26[2][i],p26[3][i],p26[4][i]);
+    sn[i] = _mm256_set_epi64x(p26[1][i] * 5,p26[2][i] * 5,p26[3][i] * 5,p26[4][i] * 5);
+  }
+
+  /* The current h goes into lane 0, along with the first block */
+  poly1305_carry(st->h);
+  poly1305_to26(h26,st->h);
+
+  poly1305_avx2_load(h,m);
+  for (i = 0;i < 5;++i) h[i] = _mm256_add_epi64(h[i],_mm256_set_epi64x(0,0,0,h26[i]));
+  m += 64;
+  bytes -= 64;
+
+  while (bytes >= 64) {
+    poly1305_avx2_mul(h,r4,s4);
+    poly1305_avx2_load(l,m);
+    for (i = 0;i < 5;++i) h[i] = _mm256_add_epi64(h[i],l[i]);
+    m += 64;
+    bytes -= 64;
+  }
+
+  poly1305_avx2_mul(h,rn,sn);
+
+  for (i = 0;i < 5;++i) {
+    _mm256_storeu_si256((__m256i *) lane,h[i]);
+    h26[i] = lane[0] + lane[1] + lane[2] + lane[3];
+  }
+
+  /* 26-bit limbs (< 2^28 each) back to 44-bit limbs */
+  st->h[0] = h26[0] + (h26[1] << 26);
+  st->h[1] = (st->h[0] >> 44) + (h26[2] << 8) + (h26[3] << 34);
+  st->h[0] &= POLY1305_M44;
+  st->h[2] = (st->h[1] >> 44) + (h26[4] << 16);
+  st->h[1] &= POLY1305_M44;
+  poly1305_carry(st->h);
+}
+
+#endif
+
+#ifdef COMPILE_WIN32
+DLLIMPORT
+#endif
+int crypto_onetimeauth(unsigned char *out,const unsigned char *in,unsigned long long inlen,const unsigned char *k)
+{
+  poly1305_state st;
+  unsigned char c[16];
+  unsigned long long bytes;
+  unsigned int j;
+
+  poly1305_init(&st,k);
+
+#ifdef POLY1305_AVX2
+  if ((inlen >= POLY1305_AVX2_MIN) && poly1305_avx2_select()) {
+    bytes = inlen & ~63ULL;
+    poly1305_blocks_avx2(&st,in,bytes);
+    in += bytes; inlen -= bytes;
+  }
+#endif
+
+  bytes = inlen & ~15ULL;
+  poly1305_blocks(&st,in,bytes,(poly1305_u64) 1 << 40);
+  in += bytes; inlen -= bytes;
+
+  /* Last partial block: padded with a 1 byte, no 2^128 bit */
+  if (inlen) {
+    for (j = 0;j < inlen;++j) c[j] = in[j];
+    c[j++] = 1;
+    for (;j < 16;++j) c[j] = 0;
+    poly1305_blocks(&st,c,16,0);
+  }
+
+  poly1305_finish(&st,out);
+
+  return 0;
+}
+
+#else
+
+
 static void add(unsigned int h[17],const unsigned int c[17])
 {
   unsigned int j;
@@ -106,3 +432,5 @@ int crypto_onetimeauth(unsigned char *out,const unsigned char *in,unsigned long
   for (j = 0;j < 16;++j) out[j] = h[j];
   return 0;
 }
+
+#endif
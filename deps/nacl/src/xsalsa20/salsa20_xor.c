@@ -2,19 +2,356 @@
 version 20080913
 D. J. Bernstein
 Public domain.
+
+SSE2/AVX2 multi-block kernels: 2014, libsidp. Public domain.
 */
 
 #include "config.h"
 #include "crypto_stream.h"
 
+/*
+ * Whole groups of 4 (SSE2) or 8 (AVX2) blocks are generated in parallel, one
+ * block per vector lane, and the kernel is selected at runtime by CPU
+ * feature. The remaining blocks go through the reference core, so the output
+ * is the same in every case. Define SALSA20_NO_SIMD to build only the
+ * reference path.
+ */
+#if !defined(SALSA20_NO_SIMD) && (defined(__x86_64__) || defined(__i386__)) && \
+    (defined(__clang__) || (__GNUC__ > 4) || ((__GNUC__ == 4) && (__GNUC_MINOR__ >= 9)))
+#define SALSA20_SIMD
+#include <immintrin.h>
+#endif
+
 typedef unsigned int uint32;
 
 static const unsigned char sigma[17] = "expand 32-byte k";
 
-int crypto_stream_salsa20_xor(
+#ifdef SALSA20_SIMD
+
+static uint32 salsa20_load32(const unsigned char *x)
+{
+  return (uint32) x[0] | ((uint32) x[1] << 8) | ((uint32) x[2] << 16) | ((uint32) x[3] << 24);
+}
+
+/* Below this size a single reference block is faster */
+#define SALSA20_SIMD_MIN 128
+
+/* 0: reference, 1: SSE2, 2: AVX2 */
+static int salsa20_simd_isa = -1;
+
+static int salsa20_simd_select(void)
+{
+  int isa = salsa20_simd_isa;
+
+  if (isa < 0) {
+    __builtin_cpu_init();
+    isa = __builtin_cpu_supports("avx2") ? 2 : (__builtin_cpu_supports("sse2") ? 1 : 0);
+    salsa20_simd_isa = isa;
+  }
+
+  return isa;
+}
+
+/*
+ * Initial state words: sigma, key and nonce. Words 8 and 9 (the 64-bit block
+ * counter) are set per lane by the kernels.
+ */
+static void salsa20_simd_state(uint32 s[16],const unsigned char *n,const unsigned char *k)
+{
+  s[0] = salsa20_load32(sigma + 0);
+  s[1] = salsa20_load32(k + 0);
+  s[2] = salsa20_load32(k + 4);
+  s[3] = salsa20_load32(k + 8);
+  s[4] = salsa20_load32(k + 12);
+  s[5] = salsa20_load32(sigma + 4);
+  s[6] = salsa20_load32(n + 0);
+  s[7] = salsa20_load32(n + 4);
+  s[8] = 0;
+  s[9] = 0;
+  s[10] = salsa20_load32(sigma + 8);
+  s[11] = salsa20_load32(k + 16);
+  s[12] = salsa20_load32(k + 20);
+  s[13] = salsa20_load32(k + 24);
+  s[14] = salsa20_load32(k + 28);
+  s[15] = salsa20_load32(sigma + 12);
+}
+
+/* Salsa20 double round on vectors x0..x15 (one block per lane) */
+#define SALSA20_DOUBLEROUND(ADD,XOR,ROTL) \
+  do { \
+     x4 = XOR( x4,ROTL(ADD( x0,x12), 7)); \
+     x8 = XOR( x8,ROTL(ADD( x4, x0), 9)); \
+    x12 = XOR(x12,ROTL(ADD( x8, x4),13)); \
+     x0 = XOR( x0,ROTL(ADD(x12, x8),18)); \
+     x9 = XOR( x9,ROTL(ADD( x5, x1), 7)); \
+    x13 = XOR(x13,ROTL(ADD( x9, x5), 9)); \
+     x1 = XOR( x1,ROTL(ADD(x13, x9),13)); \
+     x5 = XOR( x5,ROTL(ADD( x1,x13),18)); \
+    x14 = XOR(x14,ROTL(ADD(x10, x6), 7)); \
+     x2 = XOR( x2,ROTL(ADD(x14,x10), 9)); \
+     x6 = XOR( x6,ROTL(ADD( x2,x14),13)); \
+    x10 = XOR(x10,ROTL(ADD( x6, x2),18)); \
+     x3 = XOR( x3,ROTL(ADD(x15,x11), 7)); \
+     x7 = XOR( x7,ROTL(ADD( x3,x15), 9)); \
+    x11 = XOR(x11,ROTL(ADD( x7, x3),13)); \
+    x15 = XOR(x15,ROTL(ADD(x11, x7),18)); \
+     x1 = XOR( x1,ROTL(ADD( x0, x3), 7)); \
+     x2 = XOR( x2,ROTL(ADD( x1, x0), 9)); \
+     x3 = XOR( x3,ROTL(ADD( x2, x1),13)); \
+     x0 = XOR( x0,ROTL(ADD( x3, x2),18)); \
+     x6 = XOR( x6,ROTL(ADD( x5, x4), 7)); \
+     x7 = XOR( x7,ROTL(ADD( x6, x5), 9)); \
+     x4 = XOR( x4,ROTL(ADD( x7, x6),13)); \
+     x5 = XOR( x5,ROTL(ADD( x4, x7),18)); \
+    x11 = XOR(x11,ROTL(ADD(x10, x9), 7)); \
+     x8 = XOR( x8,ROTL(ADD(x11,x10), 9)); \
+     x9 = XOR( x9,ROTL(ADD( x8,x11),13)); \
+    x10 = XOR(x10,ROTL(ADD( x9, x8),18)); \
+    x12 = XOR(x12,ROTL(ADD(x15,x14), 7)); \
+    x13 = XOR(x13,ROTL(ADD(x12,x15), 9)); \
+    x14 = XOR(x14,ROTL(ADD(x13,x12),13)); \
+    x15 = XOR(x15,ROTL(ADD(x14,x13),18)); \
+  } while (0)
+
+#define SSE2_ADD(a,b) _mm_add_epi32(a,b)
+#define SSE2_XOR(a,b) _mm_xor_si128(a,b)
+#define SSE2_ROTL(a,r) _mm_or_si128(_mm_slli_epi32(a,r),_mm_srli_epi32(a,32 - (r)))
+
+/* 4x4 transpose of 32-bit words: a..d become words i..i+3 of blocks 0..3 */
+#define SSE2_TRANSPOSE(a,b,c,d) \
+  do { \
+    __m128i t0 = _mm_unpacklo_epi32(a,b), t1 = _mm_unpacklo_epi32(c,d); \
+    __m128i t2 = _mm_unpackhi_epi32(a,b), t3 = _mm_unpackhi_epi32(c,d); \
+    a = _mm_unpacklo_epi64(t0,t1); b = _mm_unpackhi_epi64(t0,t1); \
+    c = _mm_unpacklo_epi64(t2,t3); d = _mm_unpackhi_epi64(t2,t3); \
+  } while (0)
+
+#define SSE2_XOR_STORE(o,v) \
+  _mm_storeu_si128((__m128i *) (c + (o)),_mm_xor_si128(v,_mm_loadu_si128((const __m128i *) (m + (o)))))
+
+/* Processes 'blocks' (a multiple of 4) blocks starting at block 'counter' */
+static __attribute__((target("sse2"))) void salsa20_xor_sse2(
+        unsigned char *c,
+  const unsigned char *m,unsigned long long blocks,
+  const uint32 s[16],unsigned long long counter
+)
+{
+  __m128i x0, x1, x2, x3, x4, x5, x6, x7, x8, x9, x10, x11, x12, x13, x14, x15;
+  __m128i j8, j9;
+  int i;
+
+  for (;blocks;blocks -= 4,counter += 4,c += 256,m += 256) {
+    x0 = _mm_set1_epi32(s[0]); x1 = _mm_set1_epi32(s[1]); x2 = _mm_set1_epi32(s[2]); x3 = _mm_set1_epi32(s[3]);
+    x4 = _mm_set1_epi32(s[4]); x5 = _mm_set1_epi32(s[5]); x6 = _mm_set1_epi32(s[6]); x7 = _mm_set1_epi32(s[7]);
+    x10 = _mm_set1_epi32(s[10]); x11 = _mm_set1_epi32(s[11]);
+    x12 = _mm_set1_epi32(s[12]); x13 = _mm_set1_epi32(s[13]); x14 = _mm_set1_epi32(s[14]); x15 = _mm_set1_epi32(s[15]);
+    x8 = j8 = _mm_set_epi32(counter + 3,counter + 2,counter + 1,counter);
+    x9 = j9 = _mm_set_epi32((counter + 3) >> 32,(counter + 2) >> 32,(counter + 1) >> 32,counter >> 32);
+
+    for (i = 20;i > 0;i -= 2)
+      SALSA20_DOUBLEROUND(SSE2_ADD,SSE2_XOR,SSE2_ROTL);
+
+    x0 = _mm_add_epi32(x0,_mm_set1_epi32(s[0])); x1 = _mm_add_epi32(x1,_mm_set1_epi32(s[1]));
+    x2 = _mm_add_epi32(x2,_mm_set1_epi32(s[2])); x3 = _mm_add_epi32(x3,_mm_set1_epi32(s[3]));
+    x4 = _mm_add_epi32(x4,_mm_set1_epi32(s[4])); x5 = _mm_add_epi32(x5,_mm_set1_epi32(s[5]));
+    x6 = _mm_add_epi32(x6,_mm_set1_epi32(s[6])); x7 = _mm_add_epi32(x7,_mm_set1_epi32(s[7]));
+    x8 = _mm_add_epi32(x8,j8); x9 = _mm_add_epi32(x9,j9);
+    x10 = _mm_add_epi32(x10,_mm_set1_epi32(s[10])); x11 = _mm_add_epi32(x11,_mm_set1_epi32(s[11]));
+    x12 = _mm_add_epi32(x12,_mm_set1_epi32(s[12])); x13 = _mm_add_epi32(x13,_mm_set1_epi32(s[13]));
+    x14 = _mm_add_epi32(x14,_mm_set1_epi32(s[14])); x15 = _mm_add_epi32(x15,_mm_set1_epi32(s[15]));
+
+    SSE2_TRANSPOSE(x0,x1,x2,x3);
+    SSE2_TRANSPOSE(x4,x5,x6,x7);
+    SSE2_TRANSPOSE(x8,x9,x10,x11);
+    SSE2_TRANSPOSE(x12,x13,x14,x15);
+
+    SSE2_XOR_STORE(0,x0); SSE2_XOR_STORE(16,x4); SSE2_XOR_STORE(32,x8); SSE2_XOR_STORE(48,x12);
+    SSE2_XOR_STORE(64,x1); SSE2_XOR_STORE(80,x5); SSE2_XOR_STORE(96,x9); SSE2_XOR_STORE(112,x13);
+    SSE2_XOR_STORE(128,x2); SSE2_XOR_STORE(144,x6); SSE2_XOR_STORE(160,x10); SSE2_XOR_STORE(176,x14);
+    SSE2_XOR_STORE(192,x3); SSE2_XOR_STORE(208,x7); SSE2_XOR_STORE(224,x11); SSE2_XOR_STORE(240,x15);
+  }
+}
+
+#define AVX2_ADD(a,b) _mm256_add_epi32(a,b)
+#define AVX2_XOR(a,b) _mm256_xor_si256(a,b)
+#define AVX2_ROTL(a,r) _mm256_or_si256(_mm256_slli_epi32(a,r),_mm256_srli_epi32(a,32 - (r)))
+
+/*
+ * 4x4 transpose within each 128-bit half: a..d become words i..i+3 of blocks
+ * 0..3 (low half) and 4..7 (high half)
+ */
+#define AVX2_TRANSPOSE(a,b,c,d) \
+  do { \
+    __m256i t0 = _mm256_unpacklo_epi32(a,b), t1 = _mm256_unpacklo_epi32(c,d); \
+    __m256i t2 = _mm256_unpackhi_epi32(a,b), t3 = _mm256_unpackhi_epi32(c,d); \
+    a = _mm256_unpacklo_epi64(t0,t1); b = _mm256_unpackhi_epi64(t0,t1); \
+    c = _mm256_unpacklo_epi64(t2,t3); d = _mm256_unpackhi_epi64(t2,t3); \
+  } while (0)
+
+/* Words 0..7 (a, b) or 8..15 of block n and n + 4 */
+#define AVX2_XOR_STORE(o,a,b) \
+  do { \
+    __m256i lo = _mm256_permute2x128_si256(a,b,0x20), hi = _mm256_permute2x128_si256(a,b,0x31); \
+    _mm256_storeu_si256((__m256i *) (c + (o)),_mm256_xor_si256(lo,_mm256_loadu_si256((const __m256i *) (m + (o))))); \
+    _mm256_storeu_si256((__m256i *) (c + (o) + 256),_mm256_xor_si256(hi,_mm256_loadu_si256((const __m256i *) (m + (o) + 256)))); \
+  } while (0)
+
+/* Same as AVX2_XOR_STORE(), into the keystream buffer 'ks' */
+#define AVX2_KS_STORE(o,a,b) \
+  do { \
+    _mm256_storeu_si256((__m256i *) (ks + (o)),_mm256_permute2x128_si256(a,b,0x20)); \
+    _mm256_storeu_si256((__m256i *) (ks + (o) + 256),_mm256_permute2x128_si256(a,b,0x31)); \
+  } while (0)
+
+/* Processes 'blocks' (a multiple of 8) blocks starting at block 'counter' */
+static __attribute__((target("avx2"))) void salsa20_xor_avx2(
+        unsigned char *c,
+  const unsigned char *m,unsigned long long blocks,
+  const uint32 s[16],unsigned long long counter
+)
+{
+  __m256i x0, x1, x2, x3, x4, x5, x6, x7, x8, x9, x10, x11, x12, x13, x14, x15;
+  __m256i j8, j9;
+  int i;
+
+  for (;blocks;blocks -= 8,counter += 8,c += 512,m += 512) {
+    x0 = _mm256_set1_epi32(s[0]); x1 = _mm256_set1_epi32(s[1]); x2 = _mm256_set1_epi32(s[2]); x3 = _mm256_set1_epi32(s[3]);
+    x4 = _mm256_set1_epi32(s[4]); x5 = _mm256_set1_epi32(s[5]); x6 = _mm256_set1_epi32(s[6]); x7 = _mm256_set1_epi32(s[7]);
+    x10 = _mm256_set1_epi32(s[10]); x11 = _mm256_set1_epi32(s[11]);
+    x12 = _mm256_set1_epi32(s[12]); x13 = _mm256_set1_epi32(s[13]); x14 = _mm256_set1_epi32(s[14]); x15 = _mm256_set1_epi32(s[15]);
+    x8 = j8 = _mm256_set_epi32(counter + 7,counter + 6,counter + 5,counter + 4,counter + 3,counter + 2,counter + 1,counter);
+    x9 = j9 = _mm256_set_epi32((counter + 7) >> 32,(counter + 6) >> 32,(counter + 5) >> 32,(counter + 4) >> 32,
+                               (counter + 3) >> 32,(counter + 2) >> 32,(counter + 1) >> 32,counter >> 32);
+
+    for (i = 20;i > 0;i -= 2)
+      SALSA20_DOUBLEROUND(AVX2_ADD,AVX2_XOR,AVX2_ROTL);
+
+    x0 = _mm256_add_epi32(x0,_mm256_set1_epi32(s[0])); x1 = _mm256_add_epi32(x1,_mm256_set1_epi32(s[1]));
+    x2 = _mm256_add_epi32(x2,_mm256_set1_epi32(s[2])); x3 = _mm256_add_epi32(x3,_mm256_set1_epi32(s[3]));
+    x4 = _mm256_add_epi32(x4,_mm256_set1_epi32(s[4])); x5 = _mm256_add_epi32(x5,_mm256_set1_epi32(s[5]));
+    x6 = _mm256_add_epi32(x6,_mm256_set1_epi32(s[6])); x7 = _mm256_add_epi32(x7,_mm256_set1_epi32(s[7]));
+    x8 = _mm256_add_epi32(x8,j8); x9 = _mm256_add_epi32(x9,j9);
+    x10 = _mm256_add_epi32(x10,_mm256_set1_epi32(s[10])); x11 = _mm256_add_epi32(x11,_mm256_set1_epi32(s[11]));
+    x12 = _mm256_add_epi32(x12,_mm256_set1_epi32(s[12])); x13 = _mm256_add_epi32(x13,_mm256_set1_epi32(s[13]));
+    x14 = _mm256_add_epi32(x14,_mm256_set1_epi32(s[14])); x15 = _mm256_add_epi32(x15,_mm256_set1_epi32(s[15]));
+
+    AVX2_TRANSPOSE(x0,x1,x2,x3);
+    AVX2_TRANSPOSE(x4,x5,x6,x7);
+    AVX2_TRANSPOSE(x8,x9,x10,x11);
+    AVX2_TRANSPOSE(x12,x13,x14,x15);
+
+    AVX2_XOR_STORE(0,x0,x4); AVX2_XOR_STORE(32,x8,x12);
+    AVX2_XOR_STORE(64,x1,x5); AVX2_XOR_STORE(96,x9,x13);
+    AVX2_XOR_STORE(128,x2,x6); AVX2_XOR_STORE(160,x10,x14);
+    AVX2_XOR_STORE(192,x3,x7); AVX2_XOR_STORE(224,x11,x15);
+  }
+}
+
+/*
+ * Multi-buffer queue: blocks of different keys and nonces (messages of a
+ * batch), generated one per AVX2 lane by salsa20_mb_avx2(), where
+ * salsa20_xor_avx2() generates 8 consecutive blocks of one message
+ */
+typedef struct {
+  uint32 rows[8][16];        /* Input words of each block, counter included */
+  unsigned char *c[8];
+  const unsigned char *m[8];
+  unsigned int bytes[8];     /* 64, but less on the last block of a message */
+  unsigned int n;            /* Blocks queued */
+} salsa20_mb;
+
+/*
+ * One block for each of the 8 rows of 'mb', XORed into the buffers of the
+ * mb->n queued ones. The rows are gathered into words, one row per lane.
+ * Without 'feedforward' the input isn't added back, which makes the first
+ * half of the rounds of HSalsa20.
+ */
+static __attribute__((target("avx2"))) void salsa20_mb_avx2(salsa20_mb *mb,int feedforward)
+{
+  const __m256i idx = _mm256_setr_epi32(0,16,32,48,64,80,96,112);
+  const int *rows = (const int *) mb->rows[0];
+  __m256i x0, x1, x2, x3, x4, x5, x6, x7, x8, x9, x10, x11, x12, x13, x14, x15;
+  __m256i j0, j1, j2, j3, j4, j5, j6, j7, j8, j9, j10, j11, j12, j13, j14, j15;
+  unsigned char ks[512];
+  unsigned int l, i;
+
+  x0 = j0 = _mm256_i32gather_epi32(rows + 0,idx,4); x1 = j1 = _mm256_i32gather_epi32(rows + 1,idx,4);
+  x2 = j2 = _mm256_i32gather_epi32(rows + 2,idx,4); x3 = j3 = _mm256_i32gather_epi32(rows + 3,idx,4);
+  x4 = j4 = _mm256_i32gather_epi32(rows + 4,idx,4); x5 = j5 = _mm256_i32gather_epi32(rows + 5,idx,4);
+  x6 = j6 = _mm256_i32gather_epi32(rows + 6,idx,4); x7 = j7 = _mm256_i32gather_epi32(rows + 7,idx,4);
+  x8 = j8 = _mm256_i32gather_epi32(rows + 8,idx,4); x9 = j9 = _mm256_i32gather_epi32(rows + 9,idx,4);
+  x10 = j10 = _mm256_i32gather_epi32(rows + 10,idx,4); x11 = j11 = _mm256_i32gather_epi32(rows + 11,idx,4);
+  x12 = j12 = _mm256_i32gather_epi32(rows + 12,idx,4); x13 = j13 = _mm256_i32gather_epi32(rows + 13,idx,4);
+  x14 = j14 = _mm256_i32gather_epi32(rows + 14,idx,4); x15 = j15 = _mm256_i32gather_epi32(rows + 15,idx,4);
+
+  for (i = 20;i > 0;i -= 2)
+    SALSA20_DOUBLEROUND(AVX2_ADD,AVX2_XOR,AVX2_ROTL);
+
+  if (feedforward) {
+    x0 = _mm256_add_epi32(x0,j0); x1 = _mm256_add_epi32(x1,j1); x2 = _mm256_add_epi32(x2,j2); x3 = _mm256_add_epi32(x3,j3);
+    x4 = _mm256_add_epi32(x4,j4); x5 = _mm256_add_epi32(x5,j5); x6 = _mm256_add_epi32(x6,j6); x7 = _mm256_add_epi32(x7,j7);
+    x8 = _mm256_add_epi32(x8,j8); x9 = _mm256_add_epi32(x9,j9); x10 = _mm256_add_epi32(x10,j10); x11 = _mm256_add_epi32(x11,j11);
+    x12 = _mm256_add_epi32(x12,j12); x13 = _mm256_add_epi32(x13,j13); x14 = _mm256_add_epi32(x14,j14); x15 = _mm256_add_epi32(x15,j15);
+  }
+
+  AVX2_TRANSPOSE(x0,x1,x2,x3);
+  AVX2_TRANSPOSE(x4,x5,x6,x7);
+  AVX2_TRANSPOSE(x8,x9,x10,x11);
+  AVX2_TRANSPOSE(x12,x13,x14,x15);
+
+  AVX2_KS_STORE(0,x0,x4); AVX2_KS_STORE(32,x8,x12);
+  AVX2_KS_STORE(64,x1,x5); AVX2_KS_STORE(96,x9,x13);
+  AVX2_KS_STORE(128,x2,x6); AVX2_KS_STORE(160,x10,x14);
+  AVX2_KS_STORE(192,x3,x7); AVX2_KS_STORE(224,x11,x15);
+
+  for (l = 0;l < mb->n;++l) {
+    if (mb->bytes[l] == 64) {
+      _mm256_storeu_si256((__m256i *) mb->c[l],_mm256_xor_si256(_mm256_loadu_si256((const __m256i *) mb->m[l]),
+        _mm256_loadu_si256((const __m256i *) (ks + l * 64))));
+      _mm256_storeu_si256((__m256i *) (mb->c[l] + 32),_mm256_xor_si256(_mm256_loadu_si256((const __m256i *) (mb->m[l] + 32)),
+        _mm256_loadu_si256((const __m256i *) (ks + l * 64 + 32))));
+    } else {
+      for (i = 0;i < mb->bytes[l];++i) mb->c[l][i] = mb->m[l][i] ^ ks[l * 64 + i];
+    }
+  }
+
+  mb->n = 0;
+}
+
+/* Queues block 'counter' of state 's', for 'bytes' bytes from 'm' into 'c' */
+static void salsa20_mb_push(
+  salsa20_mb *mb,const uint32 s[16],unsigned long long counter,
+        unsigned char *c,
+  const unsigned char *m,unsigned int bytes
+)
+{
+  unsigned int i;
+
+  for (i = 0;i < 16;++i) mb->rows[mb->n][i] = s[i];
+  mb->rows[mb->n][8] = (uint32) counter;
+  mb->rows[mb->n][9] = (uint32) (counter >> 32);
+
+  mb->c[mb->n] = c;
+  mb->m[mb->n] = m;
+  mb->bytes[mb->n] = bytes;
+
+  if (++mb->n == 8) salsa20_mb_avx2(mb,1);
+}
+
+static void salsa20_mb_init(salsa20_mb *mb)
+{
+  unsigned int i, j;
+
+  for (i = 0;i < 8;++i) for (j = 0;j < 16;++j) mb->rows[i][j] = 0;
+  mb->n = 0;
+}
+
+#endif
+
+int crypto_stream_salsa20_xor_ic(
         unsigned char *c,
   const unsigned char *m,unsigned long long mlen,
-  const unsigned char *n,
+  const unsigned char *n,unsigned long long ic,
   const unsigned char *k
 )
 {
@@ -22,11 +359,47 @@ int crypto_stream_salsa20_xor(
   unsigned char block[64];
   unsigned int i;
   unsigned int u;
+#ifdef SALSA20_SIMD
+  unsigned long long blocks = 0, sse2_blocks;
+  uint32 s[16];
+  unsigned char tail[256];
+  int isa;
+#endif
 
   if (!mlen) return 0;
 
   for (i = 0;i < 8;++i) in[i] = n[i];
-  for (i = 8;i < 16;++i) in[i] = 0;
+  for (i = 8;i < 16;++i) in[i] = (unsigned char) (ic >> (8 * (i - 8)));
+
+#ifdef SALSA20_SIMD
+  if ((mlen >= SALSA20_SIMD_MIN) && (isa = salsa20_simd_select())) {
+    salsa20_simd_state(s,n,k);
+
+    /* AVX2 for groups of 8 blocks, SSE2 for the remaining groups of 4 */
+    if (isa == 2) {
+      blocks = (mlen / 64) & ~7ULL;
+      if (blocks) salsa20_xor_avx2(c,m,blocks,s,ic);
+    }
+
+    if ((sse2_blocks = ((mlen / 64) - blocks) & ~3ULL)) {
+      salsa20_xor_sse2(c + blocks * 64,m + blocks * 64,sse2_blocks,s,ic + blocks);
+      blocks += sse2_blocks;
+    }
+
+    mlen -= blocks * 64;
+    c += blocks * 64;
+    m += blocks * 64;
+
+    /* Less than 4 blocks left: keystream for 4 more, use what's needed */
+    if (mlen) {
+      for (i = 0;i < sizeof(tail);++i) tail[i] = 0;
+      salsa20_xor_sse2(tail,tail,4,s,ic + blocks);
+      for (i = 0;i < mlen;++i) c[i] = m[i] ^ tail[i];
+    }
+
+    return 0;
+  }
+#endif
 
   while (mlen >= 64) {
     crypto_core_salsa20(block,in,k,sigma);
@@ -50,3 +423,105 @@ int crypto_stream_salsa20_xor(
   }
   return 0;
 }
+
+int crypto_stream_salsa20_xor(
+        unsigned char *c,
+  const unsigned char *m,unsigned long long mlen,
+  const unsigned char *n,
+  const unsigned char *k
+)
+{
+  return crypto_stream_salsa20_xor_ic(c,m,mlen,n,0,k);
+}
+
+/*
+ * Whole groups of 8 blocks of a message go through salsa20_xor_avx2(), and
+ * the blocks left over (all of them, on short messages) fill the lanes of
+ * salsa20_mb_avx2() along with those of the other messages
+ */
+int crypto_stream_salsa20_xor_ic_batch(struct crypto_stream_job *jobs,unsigned int njobs)
+{
+  unsigned int i;
+#ifdef SALSA20_SIMD
+  salsa20_mb mb;
+  uint32 s[16];
+  unsigned long long done;
+  unsigned int bytes;
+
+  if (salsa20_simd_select() == 2) {
+    salsa20_mb_init(&mb);
+
+    for (i = 0;i < njobs;++i) {
+      salsa20_simd_state(s,jobs[i].n,jobs[i].k);
+
+      done = jobs[i].mlen & ~511ULL;
+      if (done) salsa20_xor_avx2(jobs[i].c,jobs[i].m,done / 64,s,jobs[i].ic);
+
+      for (;done < jobs[i].mlen;done += bytes) {
+        bytes = ((jobs[i].mlen - done) < 64) ? (unsigned int) (jobs[i].mlen - done) : 64;
+        salsa20_mb_push(&mb,s,jobs[i].ic + done / 64,jobs[i].c + done,jobs[i].m + done,bytes);
+      }
+    }
+
+    if (mb.n) salsa20_mb_avx2(&mb,1);
+
+    return 0;
+  }
+#endif
+
+  for (i = 0;i < njobs;++i)
+    crypto_stream_salsa20_xor_ic(jobs[i].c,jobs[i].m,jobs[i].mlen,jobs[i].n,jobs[i].ic,jobs[i].k);
+
+  return 0;
+}
+
+/*
+ * crypto_core_hsalsa20() of 'n' inputs and keys, with sigma, into 'out'
+ * (32 bytes each). HSalsa20 is the Salsa20 core with the 16 byte input in
+ * place of the nonce and counter and no feed-forward, keeping 8 of its words.
+ */
+int crypto_core_hsalsa20_batch(
+        unsigned char *out,
+  const unsigned char * const *in,
+  const unsigned char * const *k,unsigned int n
+)
+{
+  unsigned int i;
+#ifdef SALSA20_SIMD
+  static const unsigned char zero[64];
+  static const int words[8] = { 0, 5, 10, 15, 6, 7, 8, 9 };
+  unsigned char block[8][64];
+  salsa20_mb mb;
+  unsigned int l, w, j, lanes;
+
+  if (salsa20_simd_select() == 2) {
+    salsa20_mb_init(&mb);
+
+    for (i = 0;i < n;i += 8) {
+      for (l = 0;(l < 8) && ((i + l) < n);++l) {
+        salsa20_simd_state(mb.rows[l],in[i + l],k[i + l]);
+        mb.rows[l][8] = salsa20_load32(in[i + l] + 8);
+        mb.rows[l][9] = salsa20_load32(in[i + l] + 12);
+        mb.c[l] = block[l];
+        mb.m[l] = zero;
+        mb.bytes[l] = 64;
+      }
+
+      mb.n = lanes = l;
+      salsa20_mb_avx2(&mb,0);
+
+      for (l = 0;l < lanes;++l)
+        for (w = 0;w < 8;++w)
+          for (j = 0;j < 4;++j)
+            out[(i + l) * 32 + w * 4 + j] = block[l][words[w] * 4 + j];
+    }
+
+    return 0;
+  }
+#endif
+
+  for (i = 0;i < n;++i)
+    crypto_core_hsalsa20(out + i * 32,in[i],k[i],sigma);
+
+  return 0;
+}
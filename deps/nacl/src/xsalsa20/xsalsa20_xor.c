@@ -23,3 +23,54 @@ int crypto_stream_xor(
   crypto_core_hsalsa20(subkey,n,k,sigma);
   return crypto_stream_salsa20_xor(c,m,mlen,n + 16,subkey);
 }
+
+#ifdef COMPILE_WIN32
+DLLIMPORT
+#endif
+int crypto_stream_xor_ic(
+        unsigned char *c,
+  const unsigned char *m,unsigned long long mlen,
+  const unsigned char *n,unsigned long long ic,
+  const unsigned char *k
+)
+{
+  unsigned char subkey[32];
+  crypto_core_hsalsa20(subkey,n,k,sigma);
+  return crypto_stream_salsa20_xor_ic(c,m,mlen,n + 16,ic,subkey);
+}
+
+/* Jobs whose subkeys are computed at a time */
+#define XSALSA20_BATCH_WINDOW 32
+
+#ifdef COMPILE_WIN32
+DLLIMPORT
+#endif
+int crypto_stream_xor_ic_batch(struct crypto_stream_job *jobs,unsigned int njobs)
+{
+  struct crypto_stream_job sub[XSALSA20_BATCH_WINDOW];
+  const unsigned char *in[XSALSA20_BATCH_WINDOW];
+  const unsigned char *k[XSALSA20_BATCH_WINDOW];
+  unsigned char subkey[XSALSA20_BATCH_WINDOW * 32];
+  unsigned int i, j, n, h;
+
+  for (i = 0;i < njobs;i += n) {
+    n = ((njobs - i) < XSALSA20_BATCH_WINDOW) ? (njobs - i) : XSALSA20_BATCH_WINDOW;
+
+    for (j = 0, h = 0;j < n;++j) {
+      if (!j || (jobs[i + j].n != jobs[i + j - 1].n) || (jobs[i + j].k != jobs[i + j - 1].k)) {
+        in[h] = jobs[i + j].n;
+        k[h] = jobs[i + j].k;
+        ++h;
+      }
+
+      sub[j] = jobs[i + j];
+      sub[j].n = jobs[i + j].n + 16;
+      sub[j].k = subkey + (h - 1) * 32;
+    }
+
+    crypto_core_hsalsa20_batch(subkey,in,k,h);
+    crypto_stream_salsa20_xor_ic_batch(sub,n);
+  }
+
+  return 0;
+}
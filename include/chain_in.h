@@ -30,6 +30,7 @@
 #include "cl_api.h"
 #include "el_api.h"
 #include "sl_api.h"
+#include "dl_api.h"
 
 /* Structures */
 /**
@@ -44,6 +45,17 @@ struct chain_in_data {
 };
 
 /* Prototypes */
+int chain_in_read_hdr(
+		struct sidpconn *conn,
+		void *buf,
+		struct dl_hdr *dl_hdr);
+int chain_in_receive_data(
+		struct sidpconn *conn,
+		const struct dl_hdr *dl_hdr,
+		const void *head,
+		size_t head_len,
+		struct sidppkt *pkt,
+		struct sidpopt *opt);
 int chain_in_receive(
 		struct sidpconn *conn,
 		struct sidppkt *pkt,
@@ -43,10 +43,58 @@ struct chain_out_data {
 	struct sl_data sl;
 };
 
+/**
+ * @struct chain_out_msg
+ * @brief A packet on its way through the stages of the outgoing chain
+ * @see chain_out_dispatch()
+ */
+struct chain_out_msg {
+	struct chain_out_data cod;
+	void *cl_data;		/* Compressed message, until encrypted */
+	void *el_data;		/* Encrypted message */
+	int len;		/* Size of the compressed, then encrypted, message */
+	int adaptive;		/* Adaptive codec selection in use */
+	int nonce_seq;		/* Implicit counter nonces in use */
+	uint64_t ts;
+	struct chain_out_frame *frame;	/* Shared encrypted message (fan-out) */
+};
+
+/**
+ * @struct chain_out_frame
+ * @brief A compressed, or encrypted, message shared by the packets of a
+ * fan-out, released once the last of them is sent
+ * @see chain_out_dispatch_fanout()
+ */
+struct chain_out_frame {
+	void *data;
+	int len;		/* Negative if the message couldn't be encrypted */
+	unsigned int owner;	/* The packet the frame was built for */
+	unsigned int refs;	/* Packets still to be sent with the frame */
+};
+
+/**
+ * @struct chain_out_fanout
+ * @brief State of a fan-out: the packets and the frames they share
+ * @see chain_out_dispatch_fanout()
+ */
+struct chain_out_fanout {
+	struct sidpsend *send;
+	struct chain_out_msg *com;
+	const void **in;		/* Compressed message of each packet */
+	struct chain_out_frame *frame;	/* Compressed, then encrypted, frames */
+	unsigned int nframes;
+	unsigned int *table;		/* Frame lookup (frame index + 1) */
+	unsigned int mask;
+	struct el_batch_job *job;
+	unsigned int *pos;
+};
+
 /* Prototypes */
 int chain_out_dispatch(
 		struct sidpconn *conn,
 		const struct sidppkt *pkt,
 		const struct sidpopt *opt);
+int chain_out_dispatch_batch(struct sidpsend *send, unsigned int count);
+int chain_out_dispatch_fanout(struct sidpsend *send, unsigned int count);
 
 #endif
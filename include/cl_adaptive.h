@@ -0,0 +1,99 @@
+/**
+ * @file cl_adaptive.h
+ * @brief Header file for adaptive.c
+ */
+
+/*
+   Secure Inter-Device Protocol Library
+
+   Copyright 2012-2014 Pedro A. Hortas (pah@ucodev.org)
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+
+#ifndef SIDP_CL_ADAPTIVE_H
+#define SIDP_CL_ADAPTIVE_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+/**
+ * @def CL_ADAPTIVE_MAX_CANDIDATES
+ * @brief Maximum number of (codec, level) pairs tracked per connection
+ */
+#define CL_ADAPTIVE_MAX_CANDIDATES	8
+/**
+ * @def CL_ADAPTIVE_PROBE_INTERVAL
+ * @brief Every Nth message is used to re-measure a non-preferred candidate
+ */
+#define CL_ADAPTIVE_PROBE_INTERVAL	32
+/**
+ * @def CL_ADAPTIVE_EWMA_SHIFT
+ * @brief Weight of new samples in the moving averages (1 / 2^shift)
+ */
+#define CL_ADAPTIVE_EWMA_SHIFT		3
+
+/**
+ * @struct cl_adaptive_candidate
+ * @brief Running statistics for a single (codec, level) pair
+ */
+struct cl_adaptive_candidate {
+	uint16_t compress_type;
+	uint16_t level;
+	uint32_t samples;
+	uint32_t ratio;		/* out/in, 1/1024 units */
+	uint32_t cpu_cost;	/* compression time, 1/256 ns per input byte */
+};
+
+/**
+ * @struct cl_adaptive
+ * @brief Per-connection adaptive codec controller state
+ * @see cl_adaptive_init()
+ */
+struct cl_adaptive {
+	unsigned int count;
+	unsigned int current;
+	unsigned int probe;
+	uint32_t msg_count;
+
+	struct cl_adaptive_candidate cand[CL_ADAPTIVE_MAX_CANDIDATES];
+
+	/* Link statistics */
+	uint32_t link_cost;	/* drain time, 1/256 ns per wire byte */
+	uint64_t link_ts;
+	uint32_t link_queued;
+};
+
+/* Prototypes */
+uint64_t cl_adaptive_timestamp(void);
+int cl_adaptive_init(struct cl_adaptive *cla, uint32_t compress_types);
+void cl_adaptive_select(
+		struct cl_adaptive *cla,
+		int *compress_type,
+		int *level);
+void cl_adaptive_update(
+		struct cl_adaptive *cla,
+		int compress_type,
+		int level,
+		size_t in_len,
+		size_t out_len,
+		uint64_t elapsed);
+void cl_adaptive_update_link(
+		struct cl_adaptive *cla,
+		int fd,
+		size_t wire_len,
+		uint64_t elapsed);
+
+#endif
+
@@ -43,6 +43,27 @@
  * @see cl_data_init()
  */
 #define CL_COMPRESS_TYPE_FASTLZ	3
+/**
+ * @def CL_COMPRESS_TYPE_LZ4
+ * @brief LZ4 compression type
+ * @see cl_data_init()
+ */
+#define CL_COMPRESS_TYPE_LZ4	4
+/**
+ * @def CL_COMPRESS_TYPE_TELEMETRY
+ * @brief Schema driven delta/bit-packing compression type for fixed layout
+ * numeric records
+ * @see cl_data_init()
+ * @see cl_telemetry_schema_init()
+ */
+#define CL_COMPRESS_TYPE_TELEMETRY	5
+
+/**
+ * @def CL_COMPRESS_LEVEL_DEFAULT
+ * @brief Let the codec pick its own compression level
+ * @see cl_data
+ */
+#define CL_COMPRESS_LEVEL_DEFAULT	0
 
 /**
  * @struct cl_data
@@ -53,7 +74,12 @@ struct cl_data {
 	int (*init) (void);
 	size_t (*compress_output_len) (size_t);
 	int (*compress) (void *, const void *, size_t);
+	int (*compress_level) (void *, const void *, size_t, int);
 	int (*decompress) (void *, size_t, const void *, size_t);
+
+	/* Codecs that require a schema to be registered on the connection */
+	int (*compress_schema) (void *, const void *, size_t, const void *);
+	int (*decompress_schema) (void *, size_t, const void *, size_t, const void *);
 };
 
 int cl_data_init(struct cl_data *cld, int compress_type);
@@ -0,0 +1,95 @@
+/**
+ * @file cl_telemetry.h
+ * @brief Header for telemetry.c file
+ */
+
+/*
+   Secure Inter-Device Protocol Library
+
+   Copyright 2012-2014 Pedro A. Hortas (pah@ucodev.org)
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+
+#ifndef SIDP_CL_TELEMETRY_H
+#define SIDP_CL_TELEMETRY_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+/**
+ * @def CL_TELEMETRY_MAX_FIELDS
+ * @brief Maximum number of fields in a telemetry record schema
+ */
+#define CL_TELEMETRY_MAX_FIELDS	32
+/**
+ * @def CL_TELEMETRY_BLOCK_LEN
+ * @brief Number of values bit-packed together with a single bit width
+ */
+#define CL_TELEMETRY_BLOCK_LEN	256
+
+/**
+ * @brief Field types of a telemetry record schema
+ * @see cl_telemetry_schema_init()
+ */
+enum {
+	CL_TELEMETRY_FIELD_U8 = 1,
+	CL_TELEMETRY_FIELD_I8,
+	CL_TELEMETRY_FIELD_U16,
+	CL_TELEMETRY_FIELD_I16,
+	CL_TELEMETRY_FIELD_U32,
+	CL_TELEMETRY_FIELD_I32,
+	CL_TELEMETRY_FIELD_U64,
+	CL_TELEMETRY_FIELD_I64,
+	CL_TELEMETRY_FIELD_F32,
+	CL_TELEMETRY_FIELD_F64
+};
+
+/**
+ * @struct cl_telemetry_schema
+ * @brief Layout of the fixed size records carried by telemetry messages.
+ * Records are packed (no padding) and fields are little-endian.
+ * @see cl_telemetry_schema_init()
+ */
+struct cl_telemetry_schema {
+	uint16_t count;
+	uint16_t record_size;
+	uint16_t fingerprint;
+	uint8_t type[CL_TELEMETRY_MAX_FIELDS];
+	uint8_t width[CL_TELEMETRY_MAX_FIELDS];
+	uint16_t offset[CL_TELEMETRY_MAX_FIELDS];
+};
+
+/* Prototypes */
+
+int cl_telemetry_schema_init(
+		struct cl_telemetry_schema *schema,
+		const uint8_t *types,
+		unsigned int count);
+int cl_telemetry_init(void);
+size_t cl_telemetry_compress_output_len(size_t uncomp_len);
+int cl_telemetry_compress_data(
+		void *out_data,
+		const void *in_data,
+		size_t in_size,
+		const void *schema);
+int cl_telemetry_decompress_data(
+		void *out_data,
+		size_t out_size,
+		const void *in_data,
+		size_t in_size,
+		const void *schema);
+
+#endif
+
@@ -32,6 +32,11 @@ int cl_zlib_compress_data(
 		void *out_data,
 		const void *in_data,
 		size_t in_size);
+int cl_zlib_compress_data_level(
+		void *out_data,
+		const void *in_data,
+		size_t in_size,
+		int level);
 int cl_zlib_decompress_data(
 		void *out_data,
 		size_t out_size,
@@ -0,0 +1,82 @@
+/**
+ * @file dl_compact.h
+ * @brief Header file for compact.c (description layer)
+ */
+
+
+/*
+   Secure Inter-Device Protocol Library
+
+   Copyright 2012-2014 Pedro A. Hortas (pah@ucodev.org)
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+
+#ifndef DL_COMPACT_H
+#define DL_COMPACT_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+#include "dl_api.h"
+
+/**
+ * @def DL_COMPACT_HDR_MIN_LEN
+ * @brief The minimum length of a compact description header: the type field
+ * and two single byte sizes
+ */
+#define DL_COMPACT_HDR_MIN_LEN	3
+/**
+ * @def DL_COMPACT_HDR_MAX_LEN
+ * @brief The maximum length of a compact description header: the type field,
+ * the cipher type and two 3 byte sizes
+ */
+#define DL_COMPACT_HDR_MAX_LEN	8
+
+/*
+ * Compact header type field. The message type is kept in bits 0-1 and the
+ * compress type in bits 2-4.
+ */
+/**
+ * @def DL_COMPACT_SESSION_DEFAULT_FL
+ * @brief Set if the packet carries a default session header. Otherwise the
+ * session identifiers are elided (compact session encapsulation).
+ */
+#define DL_COMPACT_SESSION_DEFAULT_FL	0x20
+/**
+ * @def DL_COMPACT_CIPHER_FL
+ * @brief Set if the cipher type follows the type field. Otherwise, the packet
+ * uses the cipher type of the previous packet sent in the same direction.
+ */
+#define DL_COMPACT_CIPHER_FL		0x40
+/**
+ * @def DL_COMPACT_RESERVED_FL
+ * @brief Reserved. Shall be zero.
+ */
+#define DL_COMPACT_RESERVED_FL		0x80
+
+/* Prototypes */
+int dl_compact_encode(
+		unsigned char *out,
+		const struct dl_hdr *hdr,
+		uint16_t cipher_type_prev);
+size_t dl_compact_missing_len(const unsigned char *in, size_t in_len);
+int dl_compact_decode(
+		struct dl_hdr *hdr,
+		const unsigned char *in,
+		size_t in_len,
+		uint16_t cipher_type_prev);
+
+#endif
+
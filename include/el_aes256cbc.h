@@ -25,6 +25,11 @@
 #ifndef SIDP_EL_AES256_H
 #define SIDP_EL_AES256_H
 
+#include "el_api.h"
+
+#define EL_AES256_KEY_LEN	32
+#define EL_AES256_HMAC_BLOCK_LEN	64
+
 /* Prototypes */
 int el_aes256_init(void);
 int el_aes256_create_key(const unsigned char *key_data, unsigned char *key);
@@ -40,6 +45,18 @@ int el_aes256_decrypt_data(
 		unsigned char *out,
 		const unsigned char *in,
 		size_t in_len);
+int el_aes256_encrypt_data_ctx(
+		struct el_ctx *ctx,
+		const unsigned char *key,
+		unsigned char *out,
+		const unsigned char *in,
+		size_t in_len);
+int el_aes256_decrypt_data_ctx(
+		struct el_ctx *ctx,
+		const unsigned char *key,
+		unsigned char *out,
+		const unsigned char *in,
+		size_t in_len);
 
 #endif
 
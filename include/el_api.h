@@ -26,6 +26,7 @@
 #define EL_API_H
 
 #include <stdio.h>
+#include <stdint.h>
 
 /**
  * @def EL_CIPHER_TYPE_AES256
@@ -41,16 +42,150 @@
 #define EL_CIPHER_TYPE_XSALSA20	2
 /**
  * @def EL_CIPHER_TYPE_CHACHA_AVX
- * @brief ChaCha-AVX cipher type
+ * @brief ChaCha-AVX cipher type (alias of EL_CIPHER_TYPE_CHACHA with a 20 byte
+ * nonce field)
  * @see el_data_init()
  */
 #define EL_CIPHER_TYPE_CHACHA_AVX 3
 /**
  * @def EL_CIPHER_TYPE_CHACHA_AVX2
- * @brief ChaCha-AVX2 cipher type
+ * @brief ChaCha-AVX2 cipher type (alias of EL_CIPHER_TYPE_CHACHA with a 32 byte
+ * authenticator field)
  * @see el_data_init()
  */
 #define EL_CIPHER_TYPE_CHACHA_AVX2 4
+/**
+ * @def EL_CIPHER_TYPE_AES256_GCM
+ * @brief AES-256-GCM (AEAD) cipher type
+ * @see el_data_init()
+ */
+#define EL_CIPHER_TYPE_AES256_GCM 5
+/**
+ * @def EL_CIPHER_TYPE_CHACHA
+ * @brief ChaCha cipher type (kernel selected at runtime by CPU feature)
+ * @see el_data_init()
+ */
+#define EL_CIPHER_TYPE_CHACHA 6
+/**
+ * @def EL_CIPHER_TYPE_CHACHA20_POLY1305
+ * @brief ChaCha20-Poly1305 (RFC 8439 AEAD) cipher type
+ * @see el_data_init()
+ */
+#define EL_CIPHER_TYPE_CHACHA20_POLY1305 7
+/**
+ * @def EL_CIPHER_TYPE_NONE
+ * @brief Null cipher type: no encryption, CRC32C per packet (trusted links
+ * only)
+ * @see el_data_init()
+ */
+#define EL_CIPHER_TYPE_NONE 8
+/**
+ * @def EL_CIPHER_TYPE_NONE_MAC
+ * @brief Keyed null cipher type: no encryption, Poly1305 tag per packet
+ * @see el_data_init()
+ */
+#define EL_CIPHER_TYPE_NONE_MAC 9
+
+/**
+ * @def EL_NONCE_BASE_LEN
+ * @brief Size of the random per-connection, per-direction nonce base sent on
+ * the first packet of a counter nonce sequence. It covers the largest nonce
+ * used by any cipher type.
+ * @see el_nonce
+ */
+#define EL_NONCE_BASE_LEN	24
+
+/**
+ * @def EL_KEYSTREAM_BLOCK_LEN
+ * @brief Keystream block size of the stream ciphers (ChaCha, Salsa20)
+ */
+#define EL_KEYSTREAM_BLOCK_LEN	64
+/**
+ * @def EL_KEYSTREAM_LEN
+ * @brief Keystream precomputed per packet: block 0 (one-time Poly1305 key)
+ * and the keystream of the first 512 bytes of data
+ * @see el_keystream
+ */
+#define EL_KEYSTREAM_LEN	(EL_KEYSTREAM_BLOCK_LEN * 9)
+/**
+ * @def EL_KEYSTREAM_SLOTS
+ * @brief Packets of a connection whose keystream may be precomputed ahead
+ * @see el_precompute_seq()
+ */
+#define EL_KEYSTREAM_SLOTS	8
+/**
+ * @def EL_KEYSTREAM_KEY_LEN
+ * @brief Key size of the stream ciphers with a keystream hook
+ */
+#define EL_KEYSTREAM_KEY_LEN	32
+
+/**
+ * @struct el_keystream
+ * @brief Keystream of an upcoming packet of a counter nonce sequence,
+ * precomputed while the connection is idle. It's only used by a packet sent
+ * with the same cipher type, key and nonce, and is wiped once the packet
+ * counter is consumed.
+ * @see el_precompute_seq()
+ */
+struct el_keystream {
+	int valid;
+	int cipher_type;
+	unsigned char key[EL_KEYSTREAM_KEY_LEN];
+	unsigned char n[EL_NONCE_BASE_LEN];
+	unsigned char ks[EL_KEYSTREAM_LEN];
+};
+
+/**
+ * @struct el_ctx
+ * @brief Per-connection, per-direction cipher state (key schedule, MAC key
+ * state, etc). Created on first use by the ciphers that support it and
+ * released with el_ctx_destroy().
+ * @see el_data
+ */
+struct el_ctx {
+	int cipher_type;
+	void *state;
+	void (*destroy) (void *);
+	/* EL_KEYSTREAM_SLOTS precomputed packets, indexed by counter (outgoing
+	 * only, allocated by el_precompute_seq()) */
+	struct el_keystream *ks;
+};
+
+/**
+ * @struct el_nonce
+ * @brief Per-connection, per-direction counter nonce sequence. Each packet
+ * nonce is the base with the packet counter XORed into its last 8 bytes, so
+ * only the first packet carries a nonce on the wire.
+ * @see el_encrypt_seq()
+ * @see el_decrypt_seq()
+ */
+struct el_nonce {
+	uint64_t seq;
+	unsigned char base[EL_NONCE_BASE_LEN];
+};
+
+/**
+ * @struct el_batch_job
+ * @brief One packet of a batch encrypted by el_encrypt_seq_batch(), usually
+ * from a different connection than the other packets of the batch.
+ * @see el_encrypt_seq_batch()
+ */
+struct el_batch_job {
+	/* Arguments of el_encrypt_seq() */
+	struct el_ctx *ctx;
+	struct el_nonce *nonce;
+	const unsigned char *key;
+	unsigned char *out;
+	const unsigned char *in;
+	size_t in_len;
+	/* Return value of el_encrypt_seq() */
+	int ret;
+
+	/* Set by el_encrypt_seq_batch() for the cipher: the packet nonce and the
+	 * [tag][ciphertext] area of 'out' (NULL if the job was already failed) */
+	unsigned char n[EL_NONCE_BASE_LEN];
+	unsigned char *body;
+};
 
 /**
  * @struct el_data
@@ -58,15 +193,58 @@
  * @see el_data_init()
  */
 struct el_data {
+	int cipher_type;
 	int (*init) (void);
 	int (*create_key) (const unsigned char *, unsigned char *);
 	size_t (*encrypt_output_len) (size_t);
 	size_t (*decrypt_output_len) (size_t);
 	int (*encrypt) (const unsigned char *, unsigned char *, const unsigned char *, size_t);
 	int (*decrypt) (const unsigned char *, unsigned char *, const unsigned char *, size_t);
+	/* Ciphers that keep per-connection state across packets */
+	int (*encrypt_ctx) (struct el_ctx *, const unsigned char *, unsigned char *, const unsigned char *, size_t);
+	int (*decrypt_ctx) (struct el_ctx *, const unsigned char *, unsigned char *, const unsigned char *, size_t);
+	/* Ciphers able to take the nonce from the caller ([tag][ciphertext] layout) */
+	size_t nonce_len;
+	int (*encrypt_nonce) (struct el_ctx *, const unsigned char *, const unsigned char *, unsigned char *, const unsigned char *, size_t);
+	int (*decrypt_nonce) (struct el_ctx *, const unsigned char *, const unsigned char *, unsigned char *, const unsigned char *, size_t);
+	/* Ciphers able to encrypt the packets of several connections at once */
+	void (*encrypt_nonce_batch) (struct el_batch_job *, unsigned int);
+	/* Stream ciphers able to precompute the keystream of a packet, and to
+	 * encrypt it as encrypt_nonce does from that keystream */
+	int (*keystream) (const unsigned char *, const unsigned char *, struct el_keystream *);
+	int (*encrypt_keystream) (const struct el_keystream *, const unsigned char *, const unsigned char *, unsigned char *, const unsigned char *, size_t);
 };
 
 int el_data_init(struct el_data *eld, int cipher_type);
+void el_ctx_destroy(struct el_ctx *ctx);
+size_t el_encrypt_seq_output_len(const struct el_data *eld, size_t plain_data_len);
+int el_encrypt_seq(
+		const struct el_data *eld,
+		struct el_ctx *ctx,
+		struct el_nonce *nonce,
+		const unsigned char *key,
+		unsigned char *out,
+		const unsigned char *in,
+		size_t in_len);
+int el_encrypt_seq_batch(
+		const struct el_data *eld,
+		struct el_batch_job *jobs,
+		unsigned int njobs);
+int el_precompute_seq(
+		const struct el_data *eld,
+		struct el_ctx *ctx,
+		const struct el_nonce *nonce,
+		const unsigned char *key,
+		unsigned int npkts);
+void el_keystream_xor(unsigned char *out, const unsigned char *in, const unsigned char *ks, size_t len);
+int el_decrypt_seq(
+		const struct el_data *eld,
+		struct el_ctx *ctx,
+		struct el_nonce *nonce,
+		const unsigned char *key,
+		unsigned char *out,
+		const unsigned char *in,
+		size_t in_len);
 
 #endif
 
@@ -0,0 +1,82 @@
+/**
+ * @file el_chacha.h
+ * @brief Header to chacha.c
+ */
+
+/*
+   Secure Inter-Device Protocol Library
+
+   Copyright 2012-2014 Pedro A. Hortas (pah@ucodev.org)
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+
+#ifndef SIDP_EL_CHACHA_H
+#define SIDP_EL_CHACHA_H
+
+#include "el_api.h"
+
+#define EL_CHACHA_KEY_LEN	32
+#define EL_CHACHA_NONCE_LEN	8
+#define EL_CHACHA_TAG_LEN	16
+
+/* Wire layout of the ChaCha-AVX and ChaCha-AVX2 aliases */
+#define EL_CHACHA_AVX_NONCE_LEN		20
+#define EL_CHACHA_AVX2_NONCE_LEN	8
+#define EL_CHACHA_AVX_TAG_LEN		32
+
+/* Prototypes */
+int el_chacha_init(void);
+int el_chacha_create_key(const unsigned char *key_data, unsigned char *key);
+size_t el_chacha_encrypt_output_len(size_t plain_data_len);
+size_t el_chacha_decrypt_output_len(size_t enc_data_len);
+int el_chacha_encrypt_data(
+		const unsigned char *key,
+		unsigned char *out,
+		const unsigned char *in,
+		size_t in_len);
+int el_chacha_decrypt_data(
+		const unsigned char *key,
+		unsigned char *out,
+		const unsigned char *in,
+		size_t in_len);
+int el_chacha_encrypt_data_nonce(
+		struct el_ctx *ctx,
+		const unsigned char *key,
+		const unsigned char *nonce,
+		unsigned char *out,
+		const unsigned char *in,
+		size_t in_len);
+int el_chacha_decrypt_data_nonce(
+		struct el_ctx *ctx,
+		const unsigned char *key,
+		const unsigned char *nonce,
+		unsigned char *out,
+		const unsigned char *in,
+		size_t in_len);
+void el_chacha_encrypt_data_nonce_batch(struct el_batch_job *jobs, unsigned int njobs);
+int el_chacha_keystream(
+		const unsigned char *key,
+		const unsigned char *nonce,
+		struct el_keystream *ks);
+int el_chacha_encrypt_data_keystream(
+		const struct el_keystream *ks,
+		const unsigned char *key,
+		const unsigned char *nonce,
+		unsigned char *out,
+		const unsigned char *in,
+		size_t in_len);
+
+#endif
+
@@ -0,0 +1,66 @@
+/*!
+ * @file el_chacha20poly1305.h
+ * @brief Header for chacha20poly1305.c
+ */
+
+/*
+   Secure Inter-Device Protocol Library
+
+   Copyright 2012-2014 Pedro A. Hortas (pah@ucodev.org)
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+
+#ifndef SIDP_EL_CHACHA20_POLY1305_H
+#define SIDP_EL_CHACHA20_POLY1305_H
+
+#include "el_api.h"
+
+#define EL_CHACHA20_POLY1305_KEY_LEN	32
+#define EL_CHACHA20_POLY1305_NONCE_LEN	12
+#define EL_CHACHA20_POLY1305_TAG_LEN	16
+
+/* Prototypes */
+int el_chacha20_poly1305_init(void);
+int el_chacha20_poly1305_create_key(const unsigned char *key_data, unsigned char *key);
+size_t el_chacha20_poly1305_encrypt_output_len(size_t plain_data_len);
+size_t el_chacha20_poly1305_decrypt_output_len(size_t enc_data_len);
+int el_chacha20_poly1305_encrypt_data(
+		const unsigned char *key,
+		unsigned char *out,
+		const unsigned char *in,
+		size_t in_len);
+int el_chacha20_poly1305_decrypt_data(
+		const unsigned char *key,
+		unsigned char *out,
+		const unsigned char *in,
+		size_t in_len);
+int el_chacha20_poly1305_encrypt_data_nonce(
+		struct el_ctx *ctx,
+		const unsigned char *key,
+		const unsigned char *nonce,
+		unsigned char *out,
+		const unsigned char *in,
+		size_t in_len);
+int el_chacha20_poly1305_decrypt_data_nonce(
+		struct el_ctx *ctx,
+		const unsigned char *key,
+		const unsigned char *nonce,
+		unsigned char *out,
+		const unsigned char *in,
+		size_t in_len);
+void el_chacha20_poly1305_encrypt_data_nonce_batch(struct el_batch_job *jobs, unsigned int njobs);
+
+#endif
+
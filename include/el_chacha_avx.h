@@ -1,6 +1,6 @@
 /**
  * @file el_chacha_avx.h
- * @brief Header to chacha_avx.c
+ * @brief ChaCha-AVX aliases (implemented in chacha.c)
  */
 
 /*
@@ -25,6 +25,9 @@
 #ifndef SIDP_EL_CHACHA_AVX_H
 #define SIDP_EL_CHACHA_AVX_H
 
+/* Counter nonce primitives are shared with the ChaCha cipher type */
+#include "el_chacha.h"
+
 /* Prototypes */
 int el_chacha_avx_init(void);
 int el_chacha_avx_create_key(const unsigned char *key_data, unsigned char *key);
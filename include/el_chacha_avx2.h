@@ -1,6 +1,6 @@
 /**
  * @file el_chacha_avx2.h
- * @brief Header to chacha_avx2.c
+ * @brief ChaCha-AVX2 aliases (implemented in chacha.c)
  */
 
 /*
@@ -25,6 +25,9 @@
 #ifndef SIDP_EL_CHACHA_AVX2_H
 #define SIDP_EL_CHACHA_AVX2_H
 
+/* Counter nonce primitives are shared with the ChaCha cipher type */
+#include "el_chacha.h"
+
 /* Prototypes */
 int el_chacha_avx2_init(void);
 int el_chacha_avx2_create_key(const unsigned char *key_data, unsigned char *key);
@@ -25,6 +25,11 @@
 #ifndef SIDP_EL_XSALSA20_H
 #define SIDP_EL_XSALSA20_H
 
+#include "el_api.h"
+
+#define EL_XSALSA20_NONCE_LEN	24
+#define EL_XSALSA20_TAG_LEN	16
+
 /* Prototypes */
 int el_xsalsa20_init(void);
 int el_xsalsa20_create_key(const unsigned char *key_data, unsigned char *key);
@@ -40,6 +45,32 @@ int el_xsalsa20_decrypt_data(
 		unsigned char *out,
 		const unsigned char *in,
 		size_t in_len);
+int el_xsalsa20_encrypt_data_nonce(
+		struct el_ctx *ctx,
+		const unsigned char *key,
+		const unsigned char *nonce,
+		unsigned char *out,
+		const unsigned char *in,
+		size_t in_len);
+int el_xsalsa20_decrypt_data_nonce(
+		struct el_ctx *ctx,
+		const unsigned char *key,
+		const unsigned char *nonce,
+		unsigned char *out,
+		const unsigned char *in,
+		size_t in_len);
+void el_xsalsa20_encrypt_data_nonce_batch(struct el_batch_job *jobs, unsigned int njobs);
+int el_xsalsa20_keystream(
+		const unsigned char *key,
+		const unsigned char *nonce,
+		struct el_keystream *ks);
+int el_xsalsa20_encrypt_data_keystream(
+		const struct el_keystream *ks,
+		const unsigned char *key,
+		const unsigned char *nonce,
+		unsigned char *out,
+		const unsigned char *in,
+		size_t in_len);
 
 #endif
 
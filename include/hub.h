@@ -0,0 +1,114 @@
+/**
+ * @file hub.h
+ * @brief Header file for hub.c
+ */
+
+
+/*
+   Secure Inter-Device Protocol Library
+
+   Copyright 2012-2014 Pedro A. Hortas (pah@ucodev.org)
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+
+#ifndef SIDP_HUB_H
+#define SIDP_HUB_H
+
+#include <stdint.h>
+
+#ifdef COMPILE_POSIX
+#include <pthread.h>
+#elif defined(COMPILE_WIN32)
+#include <windows.h>
+#endif
+
+#include "sidp.h"
+
+/**
+ * @def SIDP_HUB_SIZE_DEFAULT
+ * @brief Default number of buckets of the hub routing table
+ */
+#define SIDP_HUB_SIZE_DEFAULT	4096
+
+/**
+ * @brief Hub flags, to be used on sidp_hub_init()
+ * @see sidp_hub_init()
+ */
+enum {
+	SIDP_HUB_NO_SPLICE_FL,		/* Relay through user space buffers */
+	SIDP_HUB_NO_RELAY_FL		/* Always decrypt and encrypt again */
+};
+
+/* Structures */
+/**
+ * @struct sidp_hub_route
+ * @brief A device reachable through the hub
+ */
+struct sidp_hub_route {
+	uint32_t dev;
+	struct sidpconn *conn;
+
+	/* Serializes the packets written to 'conn' */
+#ifdef COMPILE_POSIX
+	pthread_mutex_t lock;
+#elif defined(COMPILE_WIN32)
+	CRITICAL_SECTION lock;
+#endif
+
+	struct sidp_hub_route *next;
+};
+
+/**
+ * @struct sidp_hub
+ * @brief Routing hub: forwards the DATA packets received from a device to the
+ * connection of the destination device
+ * @see sidp_hub_forward()
+ */
+struct sidp_hub {
+	struct sidp_hub_route **table;
+	unsigned int bits;
+	uint32_t flags;
+
+#ifdef COMPILE_POSIX
+	pthread_rwlock_t lock;
+#elif defined(COMPILE_WIN32)
+	SRWLOCK lock;
+#endif
+};
+
+/* Prototypes */
+#ifdef COMPILE_WIN32
+DLLIMPORT
+#endif
+int sidp_hub_init(struct sidp_hub *hub, unsigned int size, uint32_t flags);
+#ifdef COMPILE_WIN32
+DLLIMPORT
+#endif
+void sidp_hub_destroy(struct sidp_hub *hub);
+#ifdef COMPILE_WIN32
+DLLIMPORT
+#endif
+int sidp_hub_add(struct sidp_hub *hub, uint32_t dev, struct sidpconn *conn);
+#ifdef COMPILE_WIN32
+DLLIMPORT
+#endif
+int sidp_hub_del(struct sidp_hub *hub, uint32_t dev);
+#ifdef COMPILE_WIN32
+DLLIMPORT
+#endif
+int sidp_hub_forward(struct sidp_hub *hub, struct sidpconn *from);
+
+#endif
+
@@ -0,0 +1,44 @@
+/**
+ * @file rng.h
+ * @brief Header to rng.c
+ */
+
+/*
+   Secure Inter-Device Protocol Library
+
+   Copyright 2012-2014 Pedro A. Hortas (pah@ucodev.org)
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+
+#ifndef SIDP_RNG_H
+#define SIDP_RNG_H
+
+#include <stdio.h>
+
+#include "sidp.h"
+
+/* Keystream bytes buffered per thread, served to small requests */
+#define SIDP_RNG_BUF_LEN	1024
+/* Bytes generated by a thread before its generator is reseeded */
+#define SIDP_RNG_RESEED_LEN	(1024 * 1024)
+
+/* Prototypes */
+#ifdef COMPILE_WIN32
+DLLIMPORT
+#endif
+int sidp_rng_bytes(void *buf, size_t len);
+
+#endif
+
@@ -31,6 +31,10 @@
 #ifdef COMPILE_WIN32
 DLLIMPORT
 #endif
+int sidp_seq_data_set_opt(struct sidpconn *conn, struct sidpopt *opt);
+#ifdef COMPILE_WIN32
+DLLIMPORT
+#endif
 int sidp_seq_data_send(
 		struct sidpconn *conn,
 		const void *data,
@@ -38,10 +42,23 @@ int sidp_seq_data_send(
 #ifdef COMPILE_WIN32
 DLLIMPORT
 #endif
+int sidp_seq_data_publish(
+		struct sidpconn **conn,
+		unsigned int count,
+		const void *data,
+		size_t len,
+		int *ret);
+#ifdef COMPILE_WIN32
+DLLIMPORT
+#endif
 int sidp_seq_data_recv(
 		struct sidpconn *conn,
 		void *data,
 		size_t *len);
+#ifdef COMPILE_WIN32
+DLLIMPORT
+#endif
+int sidp_seq_data_precompute(struct sidpconn *conn);
 
 
 #endif
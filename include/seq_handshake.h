@@ -0,0 +1,168 @@
+/**
+ * @file seq_handshake.h
+ * @brief Header file to seq_handshake.c
+ */
+
+/*
+   Secure Inter-Device Protocol Library
+
+   Copyright 2012-2014 Pedro A. Hortas (pah@ucodev.org)
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+
+#ifndef SIDP_SEQ_HANDSHAKE_H
+#define SIDP_SEQ_HANDSHAKE_H
+
+#include <stdint.h>
+#include <time.h>
+
+#include "sidp.h"
+#include "seq_init.h"
+
+/**
+ * @def SIDP_HANDSHAKE_VERSION
+ * @brief Version of the handshake sequence message format
+ */
+#define SIDP_HANDSHAKE_VERSION		1
+/**
+ * @def SIDP_HANDSHAKE_FIELD_MAX_LEN
+ * @brief Maximum length of a SRP field (A, s, B, M, HAMK) of a handshake
+ * sequence message
+ */
+#define SIDP_HANDSHAKE_FIELD_MAX_LEN	512
+/**
+ * @def SIDP_HANDSHAKE_MSG_MAX_LEN
+ * @brief Maximum length of a handshake sequence message
+ */
+#define SIDP_HANDSHAKE_MSG_MAX_LEN	1024
+/**
+ * @def SIDP_HANDSHAKE_NONCE_LEN
+ * @brief Length of the nonces of a resumption handshake
+ */
+#define SIDP_HANDSHAKE_NONCE_LEN	16
+/**
+ * @def SIDP_HANDSHAKE_MAC_LEN
+ * @brief Length of the MACs (HMAC-SHA256) of a resumption handshake
+ */
+#define SIDP_HANDSHAKE_MAC_LEN		32
+/**
+ * @def SIDP_TICKET_KEY_LEN
+ * @brief Length of the key used by the host to encrypt resumption tickets
+ */
+#define SIDP_TICKET_KEY_LEN		32
+/**
+ * @def SIDP_TICKET_SECRET_LEN
+ * @brief Length of the resumption secret derived from the SRP session key
+ */
+#define SIDP_TICKET_SECRET_LEN		32
+/**
+ * @def SIDP_TICKET_MAX_LEN
+ * @brief Maximum length of an (encrypted) resumption ticket
+ */
+#define SIDP_TICKET_MAX_LEN		256
+
+/**
+ * @struct hs_data
+ * @brief SIDP Handshake Sequence data exchange structure. Messages are
+ * composed of fixed size fields followed by 16-bit length-prefixed fields,
+ * all in network byte order.
+ */
+struct hs_data {
+	unsigned char buf[SIDP_HANDSHAKE_MSG_MAX_LEN];
+	size_t len;	/* Message length */
+	size_t pos;	/* Decoding position */
+};
+
+/**
+ * @struct sidp_ticket
+ * @brief Resumption ticket kept by the user between connections. The ticket
+ * is issued by the host on a full handshake of a persistent connection and
+ * presented on the next one to skip the SRP exchange.
+ * @see sidp_conn_set_ticket()
+ */
+struct sidp_ticket {
+	unsigned char data[SIDP_TICKET_MAX_LEN];	/* Opaque to the user */
+	uint16_t len;					/* 0 if none */
+	unsigned char secret[SIDP_TICKET_SECRET_LEN];
+	time_t expires;
+};
+
+/**
+ * @struct sidp_ticket_key
+ * @brief Key used by the host to issue and open resumption tickets
+ * @see sidp_ticket_key_init()
+ * @see sidp_conn_set_ticket_key()
+ */
+struct sidp_ticket_key {
+	unsigned char key[SIDP_TICKET_KEY_LEN];
+	unsigned int lifetime;	/* Seconds */
+};
+
+/**
+ * @struct hs_hello
+ * @brief Decoded HELLO message of the handshake sequence. The SRP, ticket
+ * and nonce fields point into the received struct hs_data.
+ */
+struct hs_hello {
+	struct init_data init_data;
+	uint32_t flags;
+	char username[SIDP_USER_MAX_LEN + 1];
+	const unsigned char *bytes_A;
+	size_t len_A;
+	const unsigned char *ticket;
+	size_t len_ticket;
+	const unsigned char *nonce;
+	size_t len_nonce;
+};
+
+/**
+ * @struct hs_ticket
+ * @brief Contents of an opened resumption ticket
+ */
+struct hs_ticket {
+	uint32_t flags;
+	unsigned char secret[SIDP_TICKET_SECRET_LEN];
+};
+
+/* Prototypes */
+#ifdef COMPILE_WIN32
+DLLIMPORT
+#endif
+int sidp_ticket_key_init(
+		struct sidp_ticket_key *ticket_key,
+		const unsigned char *key_data,
+		unsigned int lifetime);
+#ifdef COMPILE_WIN32
+DLLIMPORT
+#endif
+int sidp_seq_handshake_user(
+		struct sidpconn *conn,
+		const char *user,
+		const unsigned char *pass);
+#ifdef COMPILE_WIN32
+DLLIMPORT
+#endif
+int sidp_seq_handshake_host(
+		struct sidpconn *conn,
+		const char *user,
+		const unsigned char *pass);
+#ifdef COMPILE_WIN32
+DLLIMPORT
+#endif
+int sidp_seq_handshake_host_c(
+		struct sidpconn *conn,
+		int (*get_password) (const char *, unsigned char *, size_t));
+
+#endif
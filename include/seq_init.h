@@ -44,6 +44,18 @@ struct init_data {
 #ifdef COMPILE_WIN32
 DLLIMPORT
 #endif
+int sidp_seq_init_user_validate(
+		const struct sidpconn *conn,
+		const struct init_data *init_data);
+#ifdef COMPILE_WIN32
+DLLIMPORT
+#endif
+int sidp_seq_init_host_process(
+		struct sidpconn *conn,
+		struct init_data *init_data);
+#ifdef COMPILE_WIN32
+DLLIMPORT
+#endif
 int sidp_seq_init_user(struct sidpconn *conn);
 #ifdef COMPILE_WIN32
 DLLIMPORT
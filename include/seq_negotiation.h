@@ -41,6 +41,16 @@ struct neg_data {
 #ifdef COMPILE_WIN32
 DLLIMPORT
 #endif
+uint32_t sidp_seq_negotiation_support_flags(const struct sidpconn *conn);
+#ifdef COMPILE_WIN32
+DLLIMPORT
+#endif
+int sidp_seq_negotiation_set_flags(
+		struct sidpconn *conn,
+		uint32_t flags);
+#ifdef COMPILE_WIN32
+DLLIMPORT
+#endif
 int sidp_seq_negotiation_user(struct sidpconn *conn);
 #ifdef COMPILE_WIN32
 DLLIMPORT
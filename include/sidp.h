@@ -40,6 +40,8 @@
 #include "sl_api.h"
 #include "dl_api.h"
 #include "cl_api.h"
+#include "cl_adaptive.h"
+#include "cl_telemetry.h"
 
 /**
  * @def SIDP_PKT_MAX_LEN
@@ -94,7 +96,17 @@ enum {
 	SIDP_SUPPORT_COMPRESS_LZO_FL,
 	SIDP_SUPPORT_COMPRESS_ZLIB_FL,
 	SIDP_SUPPORT_COMPRESS_FASTLZ_FL,
-	SIDP_SUPPORT_ENCAP_DEFAULT_FL
+	SIDP_SUPPORT_ENCAP_DEFAULT_FL,
+	SIDP_SUPPORT_COMPRESS_ADAPTIVE_FL,
+	SIDP_SUPPORT_COMPRESS_LZ4_FL,
+	SIDP_SUPPORT_COMPRESS_TELEMETRY_FL,
+	SIDP_SUPPORT_CIPHER_AES256_GCM_FL,
+	SIDP_SUPPORT_CIPHER_CHACHA_FL,
+	SIDP_SUPPORT_NONCE_COUNTER_FL,
+	SIDP_SUPPORT_CIPHER_CHACHA20_POLY1305_FL,
+	SIDP_SUPPORT_CIPHER_NONE_FL,
+	SIDP_SUPPORT_CIPHER_NONE_MAC_FL,
+	SIDP_SUPPORT_ENCAP_COMPACT_FL
 };
 /**
  * @brief Negotiate flags for sidp structure
@@ -107,7 +119,17 @@ enum {
 	SIDP_NEGOTIATE_COMPRESS_LZO_FL,
 	SIDP_NEGOTIATE_COMPRESS_ZLIB_FL,
 	SIDP_NEGOTIATE_COMPRESS_FASTLZ_FL,
-	SIDP_NEGOTIATE_ENCAP_DEFAULT_FL
+	SIDP_NEGOTIATE_ENCAP_DEFAULT_FL,
+	SIDP_NEGOTIATE_COMPRESS_ADAPTIVE_FL,
+	SIDP_NEGOTIATE_COMPRESS_LZ4_FL,
+	SIDP_NEGOTIATE_COMPRESS_TELEMETRY_FL,
+	SIDP_NEGOTIATE_CIPHER_AES256_GCM_FL,
+	SIDP_NEGOTIATE_CIPHER_CHACHA_FL,
+	SIDP_NEGOTIATE_NONCE_COUNTER_FL,
+	SIDP_NEGOTIATE_CIPHER_CHACHA20_POLY1305_FL,
+	SIDP_NEGOTIATE_CIPHER_NONE_FL,
+	SIDP_NEGOTIATE_CIPHER_NONE_MAC_FL,
+	SIDP_NEGOTIATE_ENCAP_COMPACT_FL
 };
 /**
  * @brief Status flags for sidp structure
@@ -147,6 +169,31 @@ struct sidpconn {
 
 	uint32_t bytes_out;
 	uint32_t bytes_in;
+
+	/* Adaptive compression controller */
+	struct cl_adaptive cl_adaptive;
+
+	/* Record schema used by the telemetry compression type */
+	struct cl_telemetry_schema cl_schema;
+
+	/* Encryption Layer state kept across packets (outgoing / incoming) */
+	struct el_ctx el_out;
+	struct el_ctx el_in;
+
+	/* Counter nonce sequences (outgoing / incoming) */
+	struct el_nonce el_nonce_out;
+	struct el_nonce el_nonce_in;
+
+	/* Cipher type of the last compact framed packet (outgoing / incoming) */
+	uint16_t dl_cipher_out;
+	uint16_t dl_cipher_in;
+
+	/* Resumption ticket (user) and ticket key (host) of the handshake */
+	struct sidp_ticket *ticket;
+	const struct sidp_ticket_key *ticket_key;
+
+	/* SRP verifier store of the host authentication */
+	struct sidp_vstore *vstore;
 };
 
 /**
@@ -173,10 +220,24 @@ struct sidpopt {
 	uint16_t compress_type;
 	uint16_t cipher_type;
 	uint16_t msg_type;
+	uint16_t compress_level;
 
 	unsigned char key[SIDP_KEY_MAX_LEN + 1];
 };
 
+/**
+ * @brief A packet to be sent with sidp_pkt_send_batch() or
+ * sidp_pkt_send_fanout()
+ * @see sidp_pkt_send_batch()
+ * @see sidp_pkt_send_fanout()
+ */
+struct sidpsend {
+	struct sidpconn *conn;
+	const struct sidppkt *pkt;
+	const struct sidpopt *opt;
+	int ret;	/* Set to what sidp_pkt_send() would have returned */
+};
+
 /* Prototypes */
 /* API */
 #ifdef COMPILE_WIN32
@@ -207,6 +268,14 @@ int sidp_pkt_send(
 #ifdef COMPILE_WIN32
 DLLIMPORT
 #endif
+int sidp_pkt_send_batch(struct sidpsend *send, unsigned int count);
+#ifdef COMPILE_WIN32
+DLLIMPORT
+#endif
+int sidp_pkt_send_fanout(struct sidpsend *send, unsigned int count);
+#ifdef COMPILE_WIN32
+DLLIMPORT
+#endif
 int sidp_pkt_recv(
 		struct sidpconn *conn,
 		struct sidppkt *pkt,
@@ -236,6 +305,27 @@ void sidp_conn_set_support_flags(struct sidpconn *conn, uint32_t flags);
 #ifdef COMPILE_WIN32
 DLLIMPORT
 #endif
+int sidp_conn_set_schema(
+		struct sidpconn *conn,
+		const uint8_t *types,
+		unsigned int count);
+#ifdef COMPILE_WIN32
+DLLIMPORT
+#endif
+void sidp_conn_set_ticket(struct sidpconn *conn, struct sidp_ticket *ticket);
+#ifdef COMPILE_WIN32
+DLLIMPORT
+#endif
+void sidp_conn_set_ticket_key(
+		struct sidpconn *conn,
+		const struct sidp_ticket_key *ticket_key);
+#ifdef COMPILE_WIN32
+DLLIMPORT
+#endif
+void sidp_conn_set_vstore(struct sidpconn *conn, struct sidp_vstore *vstore);
+#ifdef COMPILE_WIN32
+DLLIMPORT
+#endif
 int sidp_conn_close(struct sidpconn *conn);
 #ifdef COMPILE_WIN32
 DLLIMPORT
@@ -292,6 +382,9 @@ time_t sidp_conn_stat_last_read(const struct sidpconn *conn);
 #include "seq_data.h"
 #include "seq_negotiation.h"
 #include "seq_init.h"
+#include "seq_handshake.h"
+#include "hub.h"
+#include "vstore.h"
 
 
 #endif
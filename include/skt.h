@@ -47,5 +47,11 @@
 /* Prototypes */
 int sidp_read_nb(struct sidpconn *conn, void *buf, size_t len);
 int sidp_write_nb(struct sidpconn *conn, const void *buf, size_t len);
+int sidp_writev_nb(
+		struct sidpconn *conn,
+		const void *hdr,
+		size_t hdr_len,
+		const void *data,
+		size_t data_len);
 
 #endif
@@ -28,6 +28,7 @@
 #include <stdio.h>
 
 #include "sl_default.h"
+#include "sl_compact.h"
 
 /**
  * @def SL_ENCAP_TYPE_DEFAULT
@@ -35,6 +36,12 @@
  * @see sl_data_init()
  */
 #define SL_ENCAP_TYPE_DEFAULT	1
+/**
+ * @def SL_ENCAP_TYPE_COMPACT
+ * @brief Compact session encapsulation type (session identifiers elided)
+ * @see sl_data_init()
+ */
+#define SL_ENCAP_TYPE_COMPACT	2
 
 /**
  * @struct sl_hdr
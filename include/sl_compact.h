@@ -0,0 +1,47 @@
+/**
+ * @file sl_compact.h
+ * @brief Header file for compact.c (session layer)
+ */
+
+
+/*
+   Secure Inter-Device Protocol Library
+
+   Copyright 2012-2014 Pedro A. Hortas (pah@ucodev.org)
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+
+#ifndef SL_COMPACT_H
+#define SL_COMPACT_H
+
+#include <stdio.h>
+
+/* Prototypes */
+int sl_compact_init(void);
+size_t sl_compact_encap_output_len(size_t in_len);
+size_t sl_compact_decap_output_len(size_t in_len);
+int sl_compact_encap_data(
+		void *out,
+		void *in,
+		size_t in_len,
+		const void *hdr);
+int sl_compact_decap_data(
+		void *out,
+		void *in,
+		size_t in_len,
+		void *hdr);
+
+#endif
+
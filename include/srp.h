@@ -80,22 +80,15 @@ typedef enum
 } SRP_HashAlgorithm;
 
 
-/* This library will automatically seed the OpenSSL random number generator
- * using cryptographically sound random data on Windows & Linux. If this is
- * undesirable behavior or the host OS does not provide a /dev/urandom file, 
- * this function may be called to seed the random number generator with 
- * alternate data. 
+/* Salts and ephemeral values are drawn from the per-thread generator of
+ * libsidp (see rng.h), which seeds itself from the operating system.
  * 
- * Passing a null pointer to this function will cause this library to skip
- * seeding the random number generator.
+ * This function only adds 'random_data' to the OpenSSL random number
+ * generator, which is still used internally by OpenSSL and as a fallback if
+ * the per-thread generator fails. Passing a null pointer does nothing.
  * 
  * Notes: 
- *    * This function is optional on Windows & Linux.
- * 
- *    * This function is mandatory on all other platforms. Although it
- *      will appear to work on other platforms, this library uses the current
- *      time of day to seed the random number generator. This is well known to
- *      be insecure. 
+ *    * This function is optional.
  * 
  *    * When using this function, ensure the provided random data is
  *      cryptographically strong.
@@ -107,6 +100,8 @@ void srp_random_seed( const unsigned char * random_data, int data_length );
  * 
  * The caller is responsible for freeing the memory allocated for bytes_s and bytes_v
  * 
+ * On failure, bytes_s and bytes_v will be set to NULL and len_s and len_v will be set to 0
+ * 
  * The n_hex and g_hex parameters should be 0 unless SRP_NG_CUSTOM is used for ng_type.
  * If provided, they must contain ASCII text of the hexidecimal notation.
  */
@@ -120,7 +115,8 @@ void srp_create_salted_verification_key( SRP_HashAlgorithm alg,
 
 /* Out: bytes_B, len_B.
  * 
- * On failure, bytes_B will be set to NULL and len_B will be set to 0
+ * On failure, bytes_B will be set to NULL and len_B will be set to 0. If the group
+ * can't be set up, NULL is returned as well.
  * 
  * The n_hex and g_hex parameters should be 0 unless SRP_NG_CUSTOM is used for ng_type
  */
@@ -154,7 +150,10 @@ void                  srp_verifier_verify_session( struct SRPVerifier * ver,
 
 /*******************************************************************************/
 
-/* The n_hex and g_hex parameters should be 0 unless SRP_NG_CUSTOM is used for ng_type */
+/* The n_hex and g_hex parameters should be 0 unless SRP_NG_CUSTOM is used for ng_type
+ * 
+ * Returns NULL on failure
+ */
 struct SRPUser *      srp_user_new( SRP_HashAlgorithm alg, SRP_NGType ng_type, const char * username,
                                     const unsigned char * bytes_password, int len_password,
                                     const char * n_hex, const char * g_hex );
@@ -0,0 +1,144 @@
+/**
+ * @file vstore.h
+ * @brief Header file to vstore.c
+ */
+
+/*
+   Secure Inter-Device Protocol Library
+
+   Copyright 2012-2014 Pedro A. Hortas (pah@ucodev.org)
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+
+#ifndef SIDP_VSTORE_H
+#define SIDP_VSTORE_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#ifdef COMPILE_POSIX
+#include <pthread.h>
+#elif defined(COMPILE_WIN32)
+#include <windows.h>
+#endif
+
+#include "sidp.h"
+
+/**
+ * @def SIDP_VSTORE_SIZE_DEFAULT
+ * @brief Default number of slots of a verifier store
+ */
+#define SIDP_VSTORE_SIZE_DEFAULT	1024
+/**
+ * @def SIDP_VSTORE_SALT_MAX_LEN
+ * @brief Maximum length of a stored SRP salt
+ */
+#define SIDP_VSTORE_SALT_MAX_LEN	16
+/**
+ * @def SIDP_VSTORE_VERIFIER_MAX_LEN
+ * @brief Maximum length of a stored SRP verifier
+ */
+#define SIDP_VSTORE_VERIFIER_MAX_LEN	512
+/**
+ * @def SIDP_VSTORE_MAGIC
+ * @brief Magic of the verifier store file format
+ */
+#define SIDP_VSTORE_MAGIC		"SIDPVST1"
+
+/* Structures */
+/**
+ * @struct sidp_vstore_header
+ * @brief Verifier store header, followed by the slots. The in-memory and the
+ * file layouts are the same, so a store file is looked up in place once
+ * mapped. Integers are in network byte order.
+ */
+struct sidp_vstore_header {
+	char magic[8];
+	uint32_t alg;		/* SRP hash algorithm */
+	uint32_t ng_type;	/* SRP group */
+	uint32_t bits;		/* log2 of the number of slots */
+	uint32_t count;		/* Used slots */
+};
+
+/**
+ * @struct sidp_vstore_slot
+ * @brief A (salt, verifier) pair, keyed by username. Slots with an empty
+ * username are free.
+ */
+struct sidp_vstore_slot {
+	uint16_t len_s;
+	uint16_t len_v;
+	char username[SIDP_USER_MAX_LEN + 1];
+	unsigned char bytes_s[SIDP_VSTORE_SALT_MAX_LEN];
+	unsigned char bytes_v[SIDP_VSTORE_VERIFIER_MAX_LEN];
+};
+
+/**
+ * @struct sidp_vstore
+ * @brief SRP verifier store: open addressing hash table of the salts and
+ * verifiers of the users, so that the host doesn't compute them from the
+ * password on every connection
+ * @see sidp_conn_set_vstore()
+ */
+struct sidp_vstore {
+	struct sidp_vstore_header *header;
+	struct sidp_vstore_slot *slots;
+	size_t size;		/* Header and slots, in bytes */
+	int mapped;		/* Read-only file mapping */
+
+#ifdef COMPILE_POSIX
+	pthread_rwlock_t lock;
+#elif defined(COMPILE_WIN32)
+	SRWLOCK lock;
+#endif
+};
+
+/* Prototypes */
+#ifdef COMPILE_WIN32
+DLLIMPORT
+#endif
+int sidp_vstore_init(struct sidp_vstore *vstore, unsigned int size);
+#ifdef COMPILE_WIN32
+DLLIMPORT
+#endif
+int sidp_vstore_load(struct sidp_vstore *vstore, const char *path);
+#ifdef COMPILE_WIN32
+DLLIMPORT
+#endif
+int sidp_vstore_save(struct sidp_vstore *vstore, const char *path);
+#ifdef COMPILE_WIN32
+DLLIMPORT
+#endif
+void sidp_vstore_destroy(struct sidp_vstore *vstore);
+#ifdef COMPILE_WIN32
+DLLIMPORT
+#endif
+int sidp_vstore_set(
+		struct sidp_vstore *vstore,
+		const char *user,
+		const unsigned char *pass);
+#ifdef COMPILE_WIN32
+DLLIMPORT
+#endif
+int sidp_vstore_verifier(
+		struct sidp_vstore *vstore,
+		const char *user,
+		const unsigned char *pass,
+		const unsigned char **bytes_s,
+		int *len_s,
+		const unsigned char **bytes_v,
+		int *len_v);
+
+#endif
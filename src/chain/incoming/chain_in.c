@@ -37,11 +37,13 @@
 
 #include "skt.h"
 #include "sidp.h"
+#include "bitops.h"
 
 #include "cl_api.h"
 #include "el_api.h"
 #include "sl_api.h"
 #include "dl_api.h"
+#include "dl_compact.h"
 
 #include "chain_in.h"
 
@@ -49,12 +51,13 @@
  * @brief Initializes incoming chain 'cid' for packet 'pkt' with options 'opt'
  * @see sidp_send_pkt()
  * @param cid The 'struct chain_in_data' to be initialized
- * @param pkt The SIDP packet to be received
+ * @param conn The SIDP connection descriptor the packet is received from
  * @param opt The SIDP packet options
  * @return 0 on success, -1 on error
  */
 static int chain_in_init(
 		struct chain_in_data *cid,
+		const struct sidpconn *conn,
 		const struct sidpopt *opt) {
 
 	/* Reset memory */
@@ -65,6 +68,15 @@ static int chain_in_init(
 		if (cl_data_init(&cid->cl, opt->compress_type) < 0)
 			return -1;
 
+		/* The cipher type is taken from the packet header, so a null
+		 * cipher is refused unless it was negotiated for this connection
+		 */
+		if ((opt->cipher_type == EL_CIPHER_TYPE_NONE) && !test_bit(&conn->negotiate_flags, SIDP_NEGOTIATE_CIPHER_NONE_FL))
+			return -1;
+
+		if ((opt->cipher_type == EL_CIPHER_TYPE_NONE_MAC) && !test_bit(&conn->negotiate_flags, SIDP_NEGOTIATE_CIPHER_NONE_MAC_FL))
+			return -1;
+
 		if (el_data_init(&cid->el, opt->cipher_type) < 0)
 			return -1;
 	}
@@ -77,18 +89,103 @@ static int chain_in_init(
 }
 
 /**
- * @brief Receives a packet into 'pkt' with options 'opt' from 
- * SIDP connection descriptor 'conn'
- * @see chain_in_init()
- * @see sidp_send_pkt()
+ * @brief Reads the compact description header of the next packet from 'conn'
+ * into 'buf', without reading past its end
+ * @see dl_compact_decode()
+ * @param conn The SIDP connection descriptor structure
+ * @param buf The buffer receiving the raw header
+ * @param dl_hdr The decomposed header, in host byte order
+ * @return The length of the raw header on success, negative on error
+ */
+static int chain_in_read_hdr_compact(
+		struct sidpconn *conn,
+		unsigned char *buf,
+		struct dl_hdr *dl_hdr) {
+	size_t len = 0, missing = DL_COMPACT_HDR_MIN_LEN;
+	int rlen;
+
+	do {
+		if ((len + missing) > DL_COMPACT_HDR_MAX_LEN)
+			return -2;
+
+		if ((rlen = sidp_read_nb(conn, buf + len, missing)) < 0)
+			return -1;
+
+		if (((unsigned int) rlen) != missing)
+			return -2;
+
+		len += missing;
+	} while ((missing = dl_compact_missing_len(buf, len)));
+
+	if (dl_compact_decode(dl_hdr, buf, len, conn->dl_cipher_in) < 0)
+		return -2;
+
+	/* Following packets may omit the cipher type if it doesn't change */
+	conn->dl_cipher_in = dl_hdr->cipher_type;
+
+	return len;
+}
+
+/**
+ * @brief Reads the description header of the next packet from 'conn' into
+ * 'buf', in the format negotiated for the connection (default or compact)
+ * @see sidp_pkt_raw_recv()
+ * @param conn The SIDP connection descriptor structure
+ * @param buf The buffer receiving the raw header (at least
+ * sizeof(struct dl_hdr) bytes long)
+ * @param dl_hdr The decomposed header, in host byte order
+ * @return The length of the raw header on success, -1 on read error, -2 if
+ * the header is truncated or malformed
+ */
+int chain_in_read_hdr(
+		struct sidpconn *conn,
+		void *buf,
+		struct dl_hdr *dl_hdr) {
+	int rlen;
+
+	if (test_bit(&conn->negotiate_flags, SIDP_NEGOTIATE_ENCAP_COMPACT_FL))
+		return chain_in_read_hdr_compact(conn, (unsigned char *) buf, dl_hdr);
+
+	/* Read the incoming description layer */
+	if ((rlen = sidp_read_nb(conn, buf, sizeof(struct dl_hdr))) < 0)
+		return -1;
+
+	/* If the read() size is different than the header size, return error */
+	if (((unsigned int) rlen) != sizeof(struct dl_hdr))
+		return -2;
+
+	/* decompose description header */
+	memcpy(dl_hdr, buf, sizeof(struct dl_hdr));
+
+	dl_hdr->session_type = ntohs(dl_hdr->session_type);
+	dl_hdr->cipher_type = ntohs(dl_hdr->cipher_type);
+	dl_hdr->compress_type = ntohs(dl_hdr->compress_type);
+	dl_hdr->msg_type = ntohs(dl_hdr->msg_type);
+	dl_hdr->inf_size = ntohs(dl_hdr->inf_size);
+	dl_hdr->def_size = ntohs(dl_hdr->def_size);
+
+	return rlen;
+}
+
+/**
+ * @brief Receives the packet described by 'dl_hdr', whose description header
+ * was already read from 'conn', into 'pkt' with options 'opt'
+ * @see chain_in_read_hdr()
+ * @see chain_in_receive()
  * @param conn The SIDP connection descriptor structure
- * @param cod The initialized 'struct chain_in_data'
+ * @param dl_hdr The description header of the packet, in host byte order
+ * @param head The first bytes of the packet data following the description
+ * header, if they were already read from 'conn' (NULL otherwise)
+ * @param head_len The length of 'head'
  * @param pkt The SIDP packet to be received
  * @param opt The SIDP packet options
  * @return Number of bytes received on success, -1 on error
  */
-int chain_in_receive(
+int chain_in_receive_data(
 		struct sidpconn *conn,
+		const struct dl_hdr *dl_hdr,
+		const void *head,
+		size_t head_len,
 		struct sidppkt *pkt,
 		struct sidpopt *opt) {
 	uint32_t def_size;
@@ -99,23 +196,17 @@ int chain_in_receive(
 	char *raw_data = NULL;
 	struct chain_in_data cid;
 	struct sl_hdr sl_hdr;
-	struct dl_hdr dl_hdr;
-
-	/* Read the incoming description layer */
-	if ((rlen = sidp_read_nb(conn, &dl_hdr, sizeof(struct dl_hdr))) < 0)
-		return -1;
-
-	/* If the read() size is different than the header size, return error */
-	if (((unsigned int) rlen) != sizeof(struct dl_hdr))
-		return -2;
 
 	/* decompose description header */
-	opt->session_type = ntohs(dl_hdr.session_type);
-	opt->cipher_type = ntohs(dl_hdr.cipher_type);
-	opt->compress_type = ntohs(dl_hdr.compress_type);
-	opt->msg_type = ntohs(dl_hdr.msg_type);
-	pkt->msg_size = ntohs(dl_hdr.inf_size);
-	def_size = ntohs(dl_hdr.def_size);
+	opt->session_type = dl_hdr->session_type;
+	opt->cipher_type = dl_hdr->cipher_type;
+	opt->compress_type = dl_hdr->compress_type;
+	opt->msg_type = dl_hdr->msg_type;
+	pkt->msg_size = dl_hdr->inf_size;
+	def_size = dl_hdr->def_size;
+
+	if (head_len > def_size)
+		return -3;
 
 	/* If inflate size exceeds SIDP_PKT_MSG_MAX_LEN or
 	 * if the deflate size, plus the session and descriptor headers,
@@ -125,7 +216,7 @@ int chain_in_receive(
 		return -3;
 
 	/* Initialize incoming chain */
-	if (chain_in_init(&cid, opt) < 0)
+	if (chain_in_init(&cid, conn, opt) < 0)
 		return -4;
 
 	/* Allocate enough memory for all layer decomposition */
@@ -136,14 +227,17 @@ int chain_in_receive(
 	el_data = raw_data + def_size + sizeof(struct sl_hdr);
 	cl_data = el_data + def_size;
 
+	if (head_len)
+		memcpy(sl_data, head, head_len);
+
 	/* Read the remaining packet data */
-	if ((rlen = sidp_read_nb(conn, sl_data, def_size)) < 0) {
+	if ((rlen = sidp_read_nb(conn, sl_data + head_len, def_size - head_len)) < 0) {
 		free(raw_data);
 		return -6;
 	}
 
 	/* If the read() size is different than expected, return error */
-	if (((unsigned int) rlen) != def_size) {
+	if (((unsigned int) rlen) != (def_size - head_len)) {
 		free(raw_data);
 		return -7;
 	}
@@ -159,6 +253,13 @@ int chain_in_receive(
 		pkt->sdev = ntohl(sl_hdr.default_hdr.sdev);
 		pkt->ddev = ntohl(sl_hdr.default_hdr.ddev);
 		pkt->sid = ntohl(sl_hdr.default_hdr.session_id);
+	} else if (opt->session_type == SL_ENCAP_TYPE_COMPACT) {
+		/* Session identifiers are elided. They're the ones the remote
+		 * end-point agreed on during the init sequence.
+		 */
+		pkt->sdev = conn->ddev;
+		pkt->ddev = conn->sdev;
+		pkt->sid = conn->sid;
 	} else {
 		free(raw_data);
 		return -9;
@@ -166,8 +267,16 @@ int chain_in_receive(
 
 	/* If msg is of type DATA, we need to decrypt and decompress it */
 	if (opt->msg_type == SIDP_MSG_TYPE_DATA) {
-		/* Decrypt message */
-		if ((len = cid.el.decrypt(opt->key, (unsigned char *) cl_data, (unsigned char *) el_data, len)) < 0) {
+		/* Decrypt message, reusing the connection cipher state if supported */
+		if (test_bit(&conn->negotiate_flags, SIDP_NEGOTIATE_NONCE_COUNTER_FL) && cid.el.decrypt_nonce) {
+			len = el_decrypt_seq(&cid.el, &conn->el_in, &conn->el_nonce_in, opt->key, (unsigned char *) cl_data, (unsigned char *) el_data, len);
+		} else if (cid.el.decrypt_ctx) {
+			len = cid.el.decrypt_ctx(&conn->el_in, opt->key, (unsigned char *) cl_data, (unsigned char *) el_data, len);
+		} else {
+			len = cid.el.decrypt(opt->key, (unsigned char *) cl_data, (unsigned char *) el_data, len);
+		}
+
+		if (len < 0) {
 			free(raw_data);
 			return -10;
 		}
@@ -179,7 +288,13 @@ int chain_in_receive(
 		}
 
 		/* Decompress message */
-		if ((len = cid.cl.decompress(pkt->msg, pkt->msg_size, cl_data, len)) < 0) {
+		if (cid.cl.decompress_schema) {
+			len = cid.cl.decompress_schema(pkt->msg, pkt->msg_size, cl_data, len, &conn->cl_schema);
+		} else {
+			len = cid.cl.decompress(pkt->msg, pkt->msg_size, cl_data, len);
+		}
+
+		if (len < 0) {
 			free(pkt->msg);
 			free(raw_data);
 			return -12;
@@ -218,3 +333,28 @@ int chain_in_receive(
 	return len;
 }
 
+/**
+ * @brief Receives a packet into 'pkt' with options 'opt' from 
+ * SIDP connection descriptor 'conn'
+ * @see chain_in_init()
+ * @see sidp_send_pkt()
+ * @param conn The SIDP connection descriptor structure
+ * @param pkt The SIDP packet to be received
+ * @param opt The SIDP packet options
+ * @return Number of bytes received on success, -1 on error
+ */
+int chain_in_receive(
+		struct sidpconn *conn,
+		struct sidppkt *pkt,
+		struct sidpopt *opt) {
+	int rlen;
+	struct dl_hdr dl_hdr;
+	unsigned char dl_raw[sizeof(struct dl_hdr)];
+
+	/* Read the incoming description layer */
+	if ((rlen = chain_in_read_hdr(conn, dl_raw, &dl_hdr)) < 0)
+		return rlen;
+
+	return chain_in_receive_data(conn, &dl_hdr, NULL, 0, pkt, opt);
+}
+
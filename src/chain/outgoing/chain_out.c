@@ -37,11 +37,13 @@
 
 #include "skt.h"
 #include "sidp.h"
+#include "bitops.h"
 
 #include "cl_api.h"
 #include "el_api.h"
 #include "sl_api.h"
 #include "dl_api.h"
+#include "dl_compact.h"
 
 #include "chain_out.h"
 
@@ -77,98 +79,300 @@ static int chain_out_init(
 }
 
 /**
- * @brief Dispatches the packet 'pkt' with options 'opt' through
- * file descriptor 'fd'
- * @see chain_out_init()
- * @see sidp_send_pkt()
+ * @brief Releases the buffers still held by 'com'
+ * @param com The packet being dispatched
+ */
+static void chain_out_msg_release(struct chain_out_msg *com) {
+	if (com->cl_data)
+		free(com->cl_data);
+
+	if (com->el_data)
+		free(com->el_data);
+
+	com->cl_data = NULL;
+	com->el_data = NULL;
+}
+
+/**
+ * @brief Compresses the message of DATA packet 'pkt' into 'out', feeding the
+ * cost to the adaptive codec selection of 'conn' when in use
  * @param conn The SIDP connections descriptor structure
- * @param cod The initialized 'struct chain_out_data'
  * @param pkt The SIDP packet to be dispached
  * @param opt The SIDP packet options
- * @return Number of bytes sent on success, -1 on error
+ * @param com The packet state, with its layers initialized
+ * @param out The compressed message, of at least compress_output_len() bytes
+ * @return The size of the compressed message on success, negative on error
  */
-int chain_out_dispatch(
+static int chain_out_compress(
 		struct sidpconn *conn,
 		const struct sidppkt *pkt,
-		const struct sidpopt *opt) {
-	int wlen, len = 0;
-	void *cl_data = NULL;
-	void *el_data = NULL;
-	void *sl_data = NULL;
-	struct chain_out_data cod;
-	struct sl_hdr sl_hdr;
-	struct dl_hdr dl_hdr;
+		const struct sidpopt *opt,
+		struct chain_out_msg *com,
+		void *out) {
+	int len;
+
+	/* Measure compression cost when the codec is adaptively selected */
+	if ((com->adaptive = test_bit(&conn->negotiate_flags, SIDP_NEGOTIATE_COMPRESS_ADAPTIVE_FL)))
+		com->ts = cl_adaptive_timestamp();
+
+	if (com->cod.cl.compress_schema) {
+		len = com->cod.cl.compress_schema(out, pkt->msg, pkt->msg_size, &conn->cl_schema);
+	} else if (opt->compress_level) {
+		len = com->cod.cl.compress_level(out, pkt->msg, pkt->msg_size, opt->compress_level);
+	} else {
+		len = com->cod.cl.compress(out, pkt->msg, pkt->msg_size);
+	}
+
+	if ((len >= 0) && com->adaptive)
+		cl_adaptive_update(&conn->cl_adaptive, opt->compress_type, opt->compress_level, pkt->msg_size, len, cl_adaptive_timestamp() - com->ts);
+
+	return len;
+}
+
+/**
+ * @brief First stage of the outgoing chain: initializes the layers for packet
+ * 'pkt' and compresses its message, if it's of type DATA, allocating the
+ * buffer it will be encrypted into.
+ * @see chain_out_encrypt()
+ * @param conn The SIDP connections descriptor structure
+ * @param pkt The SIDP packet to be dispached
+ * @param opt The SIDP packet options
+ * @param com The packet state to be initialized
+ * @return 0 on success, negative on error (see chain_out_dispatch())
+ */
+static int chain_out_prepare(
+		struct sidpconn *conn,
+		const struct sidppkt *pkt,
+		const struct sidpopt *opt,
+		struct chain_out_msg *com) {
+	com->cl_data = NULL;
+	com->el_data = NULL;
+	com->len = 0;
+	com->adaptive = 0;
+	com->nonce_seq = 0;
+	com->ts = 0;
+	com->frame = NULL;
 
 	/* Return error if msg size exceeds SIDP_PKT_MAX_LEN */
 	if (pkt->msg_size > SIDP_PKT_MSG_MAX_LEN)
 		return -1;
 
 	/* Initialize outgoing chain */
-	if (chain_out_init(&cod, opt) < 0)
+	if (chain_out_init(&com->cod, opt) < 0)
 		return -2;
 
 	/* If msg is of type DATA, we need to compress and encrypt it */
 	if (opt->msg_type == SIDP_MSG_TYPE_DATA) {
 		/* Allocate enough memory for msg compression */
-		if (!(cl_data = malloc(cod.cl.compress_output_len(pkt->msg_size))))
+		if (!(com->cl_data = malloc(com->cod.cl.compress_output_len(pkt->msg_size))))
 			return -3;
 
 		/* Compress message */
-		if ((len = cod.cl.compress(cl_data, pkt->msg, pkt->msg_size)) < 0) {
-			free(cl_data);
+		if ((com->len = chain_out_compress(conn, pkt, opt, com, com->cl_data)) < 0) {
+			chain_out_msg_release(com);
 			return -4;
 		}
 
+		/* Use implicit counter nonces if negotiated and supported by the cipher */
+		com->nonce_seq = test_bit(&conn->negotiate_flags, SIDP_NEGOTIATE_NONCE_COUNTER_FL) && com->cod.el.encrypt_nonce;
+
 		/* Allocate enough memory for msg encryption */
-		if (!(el_data = malloc(cod.el.encrypt_output_len(len)))) {
-			free(cl_data);
+		if (!(com->el_data = malloc(com->nonce_seq ? el_encrypt_seq_output_len(&com->cod.el, com->len) : com->cod.el.encrypt_output_len(com->len)))) {
+			chain_out_msg_release(com);
 			return -5;
 		}
-
-		/* Encrypt message */
-		if ((len = cod.el.encrypt(opt->key, (unsigned char *) el_data, (const unsigned char *) cl_data, len)) < 0) {
-			free(cl_data);
-			free(el_data);
-			return -6;
-		}
-
-		/* Free allocated memory used for compression */
-		free(cl_data);
 	} else if ((opt->msg_type != SIDP_MSG_TYPE_AUTH) && (opt->msg_type != SIDP_MSG_TYPE_NEGOTIATE) && (opt->msg_type != SIDP_MSG_TYPE_INIT)) {
 		/* Return error on unrecognized message types */
 		return -7;
 	}
 
+	return 0;
+}
+
+/**
+ * @brief Encrypts the compressed message 'in' of a DATA packet into 'out'
+ * @param conn The SIDP connections descriptor structure
+ * @param opt The SIDP packet options
+ * @param com The packet state, as left by chain_out_prepare()
+ * @param out The encrypted message
+ * @param in The compressed message
+ * @param in_len The size of the compressed message
+ * @return The size of the encrypted message on success, negative on error
+ */
+static int chain_out_encrypt_data(
+		struct sidpconn *conn,
+		const struct sidpopt *opt,
+		struct chain_out_msg *com,
+		void *out,
+		const void *in,
+		int in_len) {
+	/* Encrypt message, reusing the connection cipher state if supported */
+	if (com->nonce_seq)
+		return el_encrypt_seq(&com->cod.el, &conn->el_out, &conn->el_nonce_out, opt->key, (unsigned char *) out, (const unsigned char *) in, in_len);
+
+	if (com->cod.el.encrypt_ctx)
+		return com->cod.el.encrypt_ctx(&conn->el_out, opt->key, (unsigned char *) out, (const unsigned char *) in, in_len);
+
+	return com->cod.el.encrypt(opt->key, (unsigned char *) out, (const unsigned char *) in, in_len);
+}
+
+/**
+ * @brief Second stage of the outgoing chain: encrypts the compressed message
+ * of a DATA packet
+ * @see chain_out_prepare()
+ * @param conn The SIDP connections descriptor structure
+ * @param opt The SIDP packet options
+ * @param com The packet state, as left by chain_out_prepare()
+ * @return 0 on success, negative on error (see chain_out_dispatch())
+ */
+static int chain_out_encrypt(
+		struct sidpconn *conn,
+		const struct sidpopt *opt,
+		struct chain_out_msg *com) {
+	int len;
+
+	len = chain_out_encrypt_data(conn, opt, com, com->el_data, com->cl_data, com->len);
+
+	/* Free allocated memory used for compression */
+	free(com->cl_data);
+	com->cl_data = NULL;
+
+	if (len < 0) {
+		chain_out_msg_release(com);
+		return -6;
+	}
+
+	com->len = len;
+
+	return 0;
+}
+
+/**
+ * @brief Crafts the session header of packet 'pkt' for 'conn'
+ * @param conn The SIDP connections descriptor structure
+ * @param pkt The SIDP packet to be dispached
+ * @param opt The SIDP packet options
+ * @param sl_hdr The session header to be crafted
+ * @return 0 on success, -9 if the session type can't be used for 'pkt'
+ */
+static int chain_out_sl_hdr(
+		const struct sidpconn *conn,
+		const struct sidppkt *pkt,
+		const struct sidpopt *opt,
+		struct sl_hdr *sl_hdr) {
+	if (opt->session_type == SL_ENCAP_TYPE_DEFAULT) {
+		sl_hdr->default_hdr.sdev = htonl(pkt->sdev);
+		sl_hdr->default_hdr.ddev = htonl(pkt->ddev);
+		sl_hdr->default_hdr.session_id = htonl(pkt->sid);
+	} else if (opt->session_type == SL_ENCAP_TYPE_COMPACT) {
+		/* Session identifiers are elided and restored by the remote
+		 * end-point from its connection, so they can't differ from the
+		 * ones agreed on during the init sequence. Routing connections
+		 * always carry them (see sidp_seq_data_set_opt()).
+		 */
+		if ((conn->type == SIDP_CONN_TYPE_ROUTING) || (pkt->sdev != conn->sdev) || (pkt->ddev != conn->ddev) || (pkt->sid != conn->sid))
+			return -9;
+	} else {
+		/* If session type isn't recognized, return error. */
+		return -9;
+	}
+
+	return 0;
+}
+
+/**
+ * @brief Crafts the description header of packet 'pkt', whose session layer
+ * data of length 'len' is at 'sl_data', and places it right before that data
+ * @param conn The SIDP connections descriptor structure
+ * @param pkt The SIDP packet to be dispached
+ * @param opt The SIDP packet options
+ * @param len The size of the session layer data
+ * @param sl_data The session layer data, preceded by at least
+ * sizeof(struct dl_hdr) bytes of room for the header
+ * @return The size of the header on success, -14 if it can't be encoded
+ */
+static int chain_out_dl_hdr(
+		const struct sidpconn *conn,
+		const struct sidppkt *pkt,
+		const struct sidpopt *opt,
+		int len,
+		char *sl_data) {
+	unsigned char dl_compact[DL_COMPACT_HDR_MAX_LEN];
+	struct dl_hdr dl_hdr;
+	int hdr_len;
+
+	if (test_bit(&conn->negotiate_flags, SIDP_NEGOTIATE_ENCAP_COMPACT_FL)) {
+		dl_hdr.inf_size = pkt->msg_size;
+		dl_hdr.def_size = len;
+		dl_hdr.session_type = opt->session_type;
+		dl_hdr.cipher_type = opt->cipher_type;
+		dl_hdr.compress_type = opt->compress_type;
+		dl_hdr.msg_type = opt->msg_type;
+
+		if ((hdr_len = dl_compact_encode(dl_compact, &dl_hdr, conn->dl_cipher_out)) < 0)
+			return -14;
+
+		memcpy(sl_data - hdr_len, dl_compact, hdr_len);
+	} else {
+		dl_hdr.inf_size = htons(pkt->msg_size);
+		dl_hdr.def_size = htons(len);
+		dl_hdr.session_type = htons(opt->session_type);
+		dl_hdr.cipher_type = htons(opt->cipher_type);
+		dl_hdr.compress_type = htons(opt->compress_type);
+		dl_hdr.msg_type = htons(opt->msg_type);
+
+		hdr_len = sizeof(struct dl_hdr);
+
+		memcpy(sl_data - hdr_len, &dl_hdr, sizeof(struct dl_hdr));
+	}
+
+	return hdr_len;
+}
+
+/**
+ * @brief Last stage of the outgoing chain: encapsulates the (encrypted)
+ * message with the session and datagram headers and writes the packet
+ * @see chain_out_encrypt()
+ * @param conn The SIDP connections descriptor structure
+ * @param pkt The SIDP packet to be dispached
+ * @param opt The SIDP packet options
+ * @param com The packet state. Its buffers are released.
+ * @return pkt->msg_size on success, negative on error (see
+ * chain_out_dispatch())
+ */
+static int chain_out_send(
+		struct sidpconn *conn,
+		const struct sidppkt *pkt,
+		const struct sidpopt *opt,
+		struct chain_out_msg *com) {
+	int ret, wlen, hdr_len, len = com->len;
+	void *sl_data = NULL;
+	char *raw_data = NULL;
+	struct sl_hdr sl_hdr;
+
 	/* Compose session layer. This is common for all msg types */
 
 	/* Allocate enough memory for msg session encapsulation and
 	 * for metadata indicating the deflated size, inflated size and
 	 * session type used in the packet.
 	 */
-	if (!(sl_data = malloc(cod.sl.encap_output_len((len ? len : pkt->msg_size) + sizeof(struct dl_hdr))))) {
-		free(el_data);
+	if (!(sl_data = malloc(com->cod.sl.encap_output_len((len ? len : pkt->msg_size) + sizeof(struct dl_hdr))))) {
+		chain_out_msg_release(com);
 		return -8;
 	}
 
 	/* Craft session header */
-	if (opt->session_type == SL_ENCAP_TYPE_DEFAULT) {
-		sl_hdr.default_hdr.sdev = htonl(pkt->sdev);
-		sl_hdr.default_hdr.ddev = htonl(pkt->ddev);
-		sl_hdr.default_hdr.session_id = htonl(pkt->sid);
-	} else {
-		/* If session type isn't recognized, return error. */
-		if (el_data)
-			free(el_data);
+	if ((ret = chain_out_sl_hdr(conn, pkt, opt, &sl_hdr)) < 0) {
+		chain_out_msg_release(com);
 
 		free(sl_data);
 
-		return -9;
+		return ret;
 	}
 
 	/* Encapsulate packet with session layer */
-	if ((len = cod.sl.encap(((char *) sl_data) + sizeof(struct dl_hdr), el_data ? el_data : pkt->msg, len ? len : pkt->msg_size, &sl_hdr)) < 0) {
-		if (el_data)
-			free(el_data);
+	if ((len = com->cod.sl.encap(((char *) sl_data) + sizeof(struct dl_hdr), com->el_data ? com->el_data : pkt->msg, len ? len : pkt->msg_size, &sl_hdr)) < 0) {
+		chain_out_msg_release(com);
 
 		free(sl_data);
 
@@ -176,38 +380,638 @@ int chain_out_dispatch(
 	}
 
 	/* If we used encryption, release the used memory */
-	if (el_data)
-		free(el_data);
-
-	/* Craft sidp packet header */
-	dl_hdr.inf_size = htons(pkt->msg_size);
-	dl_hdr.def_size = htons(len);
-	dl_hdr.session_type = htons(opt->session_type);
-	dl_hdr.cipher_type = htons(opt->cipher_type);
-	dl_hdr.compress_type = htons(opt->compress_type);
-	dl_hdr.msg_type = htons(opt->msg_type);
-
-	memcpy(sl_data, &dl_hdr, sizeof(struct dl_hdr));
+	chain_out_msg_release(com);
 
 	/* Validate that total packet size isn't greater than excepted */
-	if ((len + sizeof(struct dl_hdr)) > SIDP_PKT_MAX_LEN)
+	if ((len + sizeof(struct dl_hdr)) > SIDP_PKT_MAX_LEN) {
+		free(sl_data);
 		return -11;
+	}
+
+	/* Craft sidp packet header, right before the session layer data */
+	if ((hdr_len = chain_out_dl_hdr(conn, pkt, opt, len, ((char *) sl_data) + sizeof(struct dl_hdr))) < 0) {
+		free(sl_data);
+		return hdr_len;
+	}
+
+	raw_data = ((char *) sl_data) + sizeof(struct dl_hdr) - hdr_len;
+
+	if (com->adaptive)
+		com->ts = cl_adaptive_timestamp();
 
 	/* Dispatch packet */
-	if ((wlen = sidp_write_nb(conn, sl_data, len + sizeof(struct dl_hdr))) < 0) {
+	if ((wlen = sidp_write_nb(conn, raw_data, len + hdr_len)) < 0) {
 		free(sl_data);
 		return -12;
 	}
 
+	/* Feed the link drain rate to the adaptive codec selection */
+	if (com->adaptive)
+		cl_adaptive_update_link(&conn->cl_adaptive, conn->fd, wlen, cl_adaptive_timestamp() - com->ts);
+
 	/* If the written data size is different than expected, return error */
-	if (wlen != (len + sizeof(struct dl_hdr))) {
+	if (wlen != (len + hdr_len)) {
 		free(sl_data);
 		return -13;
 	}
 
+	/* The remote end-point now knows the cipher type of this packet */
+	if (test_bit(&conn->negotiate_flags, SIDP_NEGOTIATE_ENCAP_COMPACT_FL))
+		conn->dl_cipher_out = opt->cipher_type;
+
 	/* Free packet memory */
 	free(sl_data);
 
 	return pkt->msg_size;
 }
 
+/**
+ * @brief Last stage of a fan-out: writes DATA packet 'pkt' with its encrypted
+ * message 'body', possibly shared with other packets, right after the headers
+ * crafted for 'conn', without copying it
+ * @see chain_out_send()
+ * @param conn The SIDP connections descriptor structure
+ * @param pkt The SIDP packet to be dispached
+ * @param opt The SIDP packet options
+ * @param com The packet state. Its buffers are released.
+ * @param body The encrypted message
+ * @param body_len The size of the encrypted message
+ * @return pkt->msg_size on success, negative on error (see
+ * chain_out_dispatch())
+ */
+static int chain_out_send_frame(
+		struct sidpconn *conn,
+		const struct sidppkt *pkt,
+		const struct sidpopt *opt,
+		struct chain_out_msg *com,
+		const void *body,
+		int body_len) {
+	char hdr[sizeof(struct dl_hdr) + sizeof(struct sl_hdr)];
+	int ret, wlen, hdr_len, sl_len;
+	struct sl_hdr sl_hdr;
+
+	/* Craft session header */
+	if ((ret = chain_out_sl_hdr(conn, pkt, opt, &sl_hdr)) < 0) {
+		chain_out_msg_release(com);
+		return ret;
+	}
+
+	/* Session headers are prefixed to the message, so encapsulating an
+	 * empty message yields the header alone */
+	if ((sl_len = com->cod.sl.encap(hdr + sizeof(struct dl_hdr), body, 0, &sl_hdr)) < 0) {
+		chain_out_msg_release(com);
+		return -10;
+	}
+
+	/* Validate that total packet size isn't greater than excepted */
+	if ((sl_len + body_len + sizeof(struct dl_hdr)) > SIDP_PKT_MAX_LEN) {
+		chain_out_msg_release(com);
+		return -11;
+	}
+
+	/* Craft sidp packet header, right before the session header */
+	if ((hdr_len = chain_out_dl_hdr(conn, pkt, opt, sl_len + body_len, hdr + sizeof(struct dl_hdr))) < 0) {
+		chain_out_msg_release(com);
+		return hdr_len;
+	}
+
+	if (com->adaptive)
+		com->ts = cl_adaptive_timestamp();
+
+	/* Dispatch packet */
+	wlen = sidp_writev_nb(conn, hdr + sizeof(struct dl_hdr) - hdr_len, hdr_len + sl_len, body, body_len);
+
+	/* Release the message, if it was encrypted for this packet only */
+	chain_out_msg_release(com);
+
+	if (wlen < 0)
+		return -12;
+
+	/* Feed the link drain rate to the adaptive codec selection */
+	if (com->adaptive)
+		cl_adaptive_update_link(&conn->cl_adaptive, conn->fd, wlen, cl_adaptive_timestamp() - com->ts);
+
+	/* If the written data size is different than expected, return error */
+	if (wlen != (hdr_len + sl_len + body_len))
+		return -13;
+
+	/* The remote end-point now knows the cipher type of this packet */
+	if (test_bit(&conn->negotiate_flags, SIDP_NEGOTIATE_ENCAP_COMPACT_FL))
+		conn->dl_cipher_out = opt->cipher_type;
+
+	return pkt->msg_size;
+}
+
+/**
+ * @brief Dispatches the packet 'pkt' with options 'opt' through
+ * file descriptor 'fd'
+ * @see chain_out_init()
+ * @see sidp_send_pkt()
+ * @param conn The SIDP connections descriptor structure
+ * @param pkt The SIDP packet to be dispached
+ * @param opt The SIDP packet options
+ * @return Number of bytes sent on success, -1 on error
+ */
+int chain_out_dispatch(
+		struct sidpconn *conn,
+		const struct sidppkt *pkt,
+		const struct sidpopt *opt) {
+	struct chain_out_msg com;
+	int ret;
+
+	if ((ret = chain_out_prepare(conn, pkt, opt, &com)) < 0)
+		return ret;
+
+	if (com.cl_data && ((ret = chain_out_encrypt(conn, opt, &com)) < 0))
+		return ret;
+
+	return chain_out_send(conn, pkt, opt, &com);
+}
+
+/**
+ * @brief Fails the packets of a batch that follow packet 'i' on the same
+ * connection, once packet 'i' failed. With counter nonces a failed packet may
+ * have consumed its counter, and any packet written after a failed (or short)
+ * write would corrupt the stream, so the remote end-point must not receive any
+ * further packet of the batch from the connection.
+ * @param send The packets of the batch. The 'ret' field of the failed ones is
+ * set to -15.
+ * @param com The state of each packet (zeroed or initialized). The buffers of
+ * the failed ones are released.
+ * @param in The message of each packet still to be encrypted, or NULL. Cleared
+ * for the failed ones.
+ * @param count The number of packets
+ * @param i The packet that failed
+ */
+static void chain_out_batch_abort(
+		struct sidpsend *send,
+		struct chain_out_msg *com,
+		const void **in,
+		unsigned int count,
+		unsigned int i) {
+	unsigned int j;
+
+	for (j = i + 1; j < count; j ++) {
+		if ((send[j].conn != send[i].conn) || (send[j].ret < 0))
+			continue;
+
+		chain_out_msg_release(&com[j]);
+		in[j] = NULL;
+		send[j].ret = -15;
+	}
+}
+
+/**
+ * @brief Encrypts together the DATA packets of a batch that use counter
+ * nonces with the same cipher type. The packets of a connection keep their
+ * order, and so their counters. A failed packet fails the packets that follow
+ * it on the same connection.
+ * @see el_encrypt_seq_batch()
+ * @see chain_out_batch_abort()
+ * @param send The packets of the batch. The 'ret' field of those that fail
+ * is set.
+ * @param com The state of each packet
+ * @param in The compressed message of each packet to be encrypted, or NULL.
+ * Cleared as they are encrypted.
+ * @param count The number of packets
+ * @param job Room for 'count' encryption jobs
+ * @param pos Room for 'count' packet indexes
+ */
+static void chain_out_encrypt_seq_batch(
+		struct sidpsend *send,
+		struct chain_out_msg *com,
+		const void **in,
+		unsigned int count,
+		struct el_batch_job *job,
+		unsigned int *pos) {
+	unsigned int i, j, n;
+
+	for (i = 0; i < count; i ++) {
+		if (!in[i])
+			continue;
+
+		for (j = i, n = 0; j < count; j ++) {
+			if (!in[j] || (send[j].opt->cipher_type != send[i].opt->cipher_type))
+				continue;
+
+			job[n].ctx = &send[j].conn->el_out;
+			job[n].nonce = &send[j].conn->el_nonce_out;
+			job[n].key = send[j].opt->key;
+			job[n].out = (unsigned char *) com[j].el_data;
+			job[n].in = (const unsigned char *) in[j];
+			job[n].in_len = com[j].len;
+
+			pos[n ++] = j;
+		}
+
+		el_encrypt_seq_batch(&com[i].cod.el, job, n);
+
+		for (j = 0; j < n; j ++) {
+			in[pos[j]] = NULL;
+
+			/* Already failed by an earlier packet of the connection */
+			if (send[pos[j]].ret < 0)
+				continue;
+
+			if (job[j].ret < 0) {
+				chain_out_msg_release(&com[pos[j]]);
+				send[pos[j]].ret = -6;
+
+				chain_out_batch_abort(send, com, in, count, pos[j]);
+			} else {
+				com[pos[j]].len = job[j].ret;
+			}
+		}
+	}
+}
+
+/**
+ * @brief Dispatches a batch of packets, in order, as chain_out_dispatch()
+ * would, but encrypting together the DATA packets that use counter nonces
+ * with the same cipher type. Once a packet fails, the packets that follow it on
+ * the same connection aren't sent and their 'ret' is set to -15.
+ * @see chain_out_dispatch()
+ * @see el_encrypt_seq_batch()
+ * @see chain_out_batch_abort()
+ * @param send The packets to be dispatched, with 'ret' set on return
+ * @param count The number of packets
+ * @return Number of packets sent on success, -1 on error
+ */
+int chain_out_dispatch_batch(struct sidpsend *send, unsigned int count) {
+	struct chain_out_msg *com;
+	struct el_batch_job *job;
+	unsigned int *pos;
+	const void **in;
+	unsigned int i;
+	int sent = 0;
+
+	if (!count)
+		return 0;
+
+	com = calloc(count, sizeof(struct chain_out_msg));
+	job = malloc(count * sizeof(struct el_batch_job));
+	pos = malloc(count * sizeof(unsigned int));
+	in = malloc(count * sizeof(const void *));
+
+	if (!com || !job || !pos || !in) {
+		free(in);
+		free(pos);
+		free(job);
+		free(com);
+		return -1;
+	}
+
+	for (i = 0; i < count; i ++)
+		send[i].ret = 0;
+
+	/* Compress all messages, in order, as the codec state is per connection */
+	for (i = 0; i < count; i ++) {
+		in[i] = NULL;
+
+		/* Already failed by an earlier packet of the connection */
+		if (send[i].ret < 0)
+			continue;
+
+		if ((send[i].ret = chain_out_prepare(send[i].conn, send[i].pkt, send[i].opt, &com[i])) < 0) {
+			chain_out_batch_abort(send, com, in, count, i);
+			continue;
+		}
+
+		in[i] = com[i].nonce_seq ? com[i].cl_data : NULL;
+	}
+
+	/* Encrypt the counter nonce packets of each cipher type in one go */
+	chain_out_encrypt_seq_batch(send, com, in, count, job, pos);
+
+	/* Encrypt the remaining DATA packets and send everything */
+	for (i = 0; i < count; i ++) {
+		if (send[i].ret < 0)
+			continue;
+
+		/* Already encrypted in the batch */
+		if (com[i].nonce_seq && com[i].cl_data) {
+			free(com[i].cl_data);
+			com[i].cl_data = NULL;
+		}
+
+		if (com[i].cl_data && ((send[i].ret = chain_out_encrypt(send[i].conn, send[i].opt, &com[i])) < 0)) {
+			chain_out_batch_abort(send, com, in, count, i);
+			continue;
+		}
+
+		if ((send[i].ret = chain_out_send(send[i].conn, send[i].pkt, send[i].opt, &com[i])) < 0) {
+			chain_out_batch_abort(send, com, in, count, i);
+			continue;
+		}
+
+		sent ++;
+	}
+
+	free(in);
+	free(pos);
+	free(job);
+	free(com);
+
+	return sent;
+}
+
+/**
+ * @brief Hashes 'len' bytes of 'data' into 'h' (FNV-1a)
+ * @param h The hash so far
+ * @param data The bytes to be hashed
+ * @param len The number of bytes
+ * @return The updated hash
+ */
+static uint32_t chain_out_fanout_hash(uint32_t h, const void *data, size_t len) {
+	const unsigned char *p = (const unsigned char *) data;
+
+	while (len --)
+		h = (h ^ *p ++) * 16777619U;
+
+	return h;
+}
+
+/**
+ * @brief Checks if DATA packets 'a' and 'b' compress into the same message:
+ * same message buffer, codec, level and, for telemetry, record schema
+ * @param a A packet of the fan-out
+ * @param b Another packet of the fan-out
+ * @return 1 if they do, 0 otherwise
+ */
+static int chain_out_fanout_cl_match(const struct sidpsend *a, const struct sidpsend *b) {
+	if ((a->pkt->msg != b->pkt->msg) || (a->pkt->msg_size != b->pkt->msg_size))
+		return 0;
+
+	if ((a->opt->compress_type != b->opt->compress_type) || (a->opt->compress_level != b->opt->compress_level))
+		return 0;
+
+	/* Telemetry records are coded with the schema of each connection */
+	if (a->opt->compress_type == CL_COMPRESS_TYPE_TELEMETRY) {
+		if (a->conn->cl_schema.count != b->conn->cl_schema.count)
+			return 0;
+
+		if (memcmp(a->conn->cl_schema.type, b->conn->cl_schema.type, a->conn->cl_schema.count))
+			return 0;
+	}
+
+	return 1;
+}
+
+/**
+ * @brief Checks if DATA packets 'a' and 'b', whose messages compressed into
+ * the same frame, can share its encryption: same cipher type and key
+ * @param a A packet of the fan-out
+ * @param b Another packet of the fan-out
+ * @return 1 if they can, 0 otherwise
+ */
+static int chain_out_fanout_el_match(const struct sidpsend *a, const struct sidpsend *b) {
+	if (a->opt->cipher_type != b->opt->cipher_type)
+		return 0;
+
+	return !memcmp(a->opt->key, b->opt->key, sizeof(a->opt->key));
+}
+
+/**
+ * @brief First stage of a fan-out, for DATA packet 'i': initializes its
+ * layers and compresses its message, unless a previous packet already
+ * compressed it the same way, in which case the frame is shared
+ * @see chain_out_prepare()
+ * @param cof The fan-out state
+ * @param i The packet index
+ * @return 0 on success, negative on error (see chain_out_dispatch())
+ */
+static int chain_out_fanout_compress(struct chain_out_fanout *cof, unsigned int i) {
+	struct sidpsend *send = &cof->send[i];
+	struct chain_out_msg *com = &cof->com[i];
+	struct chain_out_frame *frame;
+	uint32_t h = 2166136261U;
+	uintptr_t msg = (uintptr_t) send->pkt->msg;
+	unsigned int slot;
+
+	com->cl_data = NULL;
+	com->el_data = NULL;
+	com->len = 0;
+	com->adaptive = 0;
+	com->nonce_seq = 0;
+	com->ts = 0;
+	com->frame = NULL;
+
+	/* Return error if msg size exceeds SIDP_PKT_MAX_LEN */
+	if (send->pkt->msg_size > SIDP_PKT_MSG_MAX_LEN)
+		return -1;
+
+	/* Initialize outgoing chain */
+	if (chain_out_init(&com->cod, send->opt) < 0)
+		return -2;
+
+	h = chain_out_fanout_hash(h, &msg, sizeof(msg));
+	h = chain_out_fanout_hash(h, &send->pkt->msg_size, sizeof(send->pkt->msg_size));
+	h = chain_out_fanout_hash(h, &send->opt->compress_type, sizeof(send->opt->compress_type));
+	h = chain_out_fanout_hash(h, &send->opt->compress_level, sizeof(send->opt->compress_level));
+
+	for (slot = h & cof->mask; cof->table[slot]; slot = (slot + 1) & cof->mask) {
+		frame = &cof->frame[cof->table[slot] - 1];
+
+		if (chain_out_fanout_cl_match(&cof->send[frame->owner], send)) {
+			/* The link drain rate is still measured for this packet */
+			com->adaptive = test_bit(&send->conn->negotiate_flags, SIDP_NEGOTIATE_COMPRESS_ADAPTIVE_FL);
+			com->len = frame->len;
+			cof->in[i] = frame->data;
+
+			return 0;
+		}
+	}
+
+	/* First packet compressing the message this way */
+	frame = &cof->frame[cof->nframes];
+
+	if (!(frame->data = malloc(com->cod.cl.compress_output_len(send->pkt->msg_size))))
+		return -3;
+
+	if ((frame->len = chain_out_compress(send->conn, send->pkt, send->opt, com, frame->data)) < 0) {
+		free(frame->data);
+		return -4;
+	}
+
+	frame->owner = i;
+	frame->refs = 0;
+
+	cof->table[slot] = ++ cof->nframes;
+
+	com->len = frame->len;
+	cof->in[i] = frame->data;
+
+	return 0;
+}
+
+/**
+ * @brief Second stage of a fan-out, for DATA packet 'i': allocates the buffer
+ * its message will be encrypted into, if it uses counter nonces, or encrypts
+ * it, unless a previous packet with the same compressed message, cipher type
+ * and key already did so, in which case the frame is shared
+ * @see chain_out_encrypt()
+ * @param cof The fan-out state
+ * @param i The packet index
+ * @return 0 on success, negative on error (see chain_out_dispatch())
+ */
+static int chain_out_fanout_encrypt(struct chain_out_fanout *cof, unsigned int i) {
+	struct sidpsend *send = &cof->send[i];
+	struct chain_out_msg *com = &cof->com[i];
+	struct chain_out_frame *frame;
+	uint32_t h = 2166136261U;
+	uintptr_t in = (uintptr_t) cof->in[i];
+	unsigned int slot;
+
+	/* Counter nonces are per connection, so are their messages */
+	if ((com->nonce_seq = test_bit(&send->conn->negotiate_flags, SIDP_NEGOTIATE_NONCE_COUNTER_FL) && com->cod.el.encrypt_nonce)) {
+		if (!(com->el_data = malloc(el_encrypt_seq_output_len(&com->cod.el, com->len)))) {
+			cof->in[i] = NULL;
+			return -5;
+		}
+
+		return 0;
+	}
+
+	h = chain_out_fanout_hash(h, &in, sizeof(in));
+	h = chain_out_fanout_hash(h, &send->opt->cipher_type, sizeof(send->opt->cipher_type));
+	h = chain_out_fanout_hash(h, send->opt->key, sizeof(send->opt->key));
+
+	cof->in[i] = NULL;
+
+	for (slot = h & cof->mask; cof->table[slot]; slot = (slot + 1) & cof->mask) {
+		frame = &cof->frame[cof->table[slot] - 1];
+
+		if (chain_out_fanout_cl_match(&cof->send[frame->owner], send) && chain_out_fanout_el_match(&cof->send[frame->owner], send))
+			break;
+	}
+
+	if (!cof->table[slot]) {
+		/* First packet encrypting the message with this cipher and key */
+		frame = &cof->frame[cof->nframes];
+
+		if (!(frame->data = malloc(com->cod.el.encrypt_output_len(com->len))))
+			return -5;
+
+		frame->len = chain_out_encrypt_data(send->conn, send->opt, com, frame->data, (const void *) in, com->len);
+		frame->owner = i;
+		frame->refs = 0;
+
+		cof->table[slot] = ++ cof->nframes;
+	}
+
+	frame->refs ++;
+	com->frame = frame;
+
+	return 0;
+}
+
+/**
+ * @brief Dispatches a batch of packets, in order, as chain_out_dispatch()
+ * would, but DATA packets carrying the same message buffer share its
+ * compression, and those also sharing the cipher type and key (and not using
+ * counter nonces) share a single encrypted frame, written to each connection
+ * after its own headers. Counter nonce packets are encrypted together, as
+ * chain_out_dispatch_batch() does, and a failed packet fails the packets that
+ * follow it on the same connection, as there.
+ * @see chain_out_dispatch()
+ * @see chain_out_dispatch_batch()
+ * @param send The packets to be dispatched, with 'ret' set on return
+ * @param count The number of packets
+ * @return Number of packets sent on success, -1 on error
+ */
+int chain_out_dispatch_fanout(struct sidpsend *send, unsigned int count) {
+	struct chain_out_fanout cof;
+	struct chain_out_frame *frame;
+	unsigned int i, size, cl_frames;
+	int sent = 0;
+
+	if (!count)
+		return 0;
+
+	/* Twice as many slots as frames of a stage keep the probes short */
+	for (size = 1; size < (2 * count); size <<= 1);
+
+	cof.send = send;
+	cof.nframes = 0;
+	cof.mask = size - 1;
+	cof.com = malloc(count * sizeof(struct chain_out_msg));
+	cof.in = malloc(count * sizeof(const void *));
+	cof.frame = malloc(2 * count * sizeof(struct chain_out_frame));
+	cof.table = calloc(size, sizeof(unsigned int));
+	cof.job = malloc(count * sizeof(struct el_batch_job));
+	cof.pos = malloc(count * sizeof(unsigned int));
+
+	if (!cof.com || !cof.in || !cof.frame || !cof.table || !cof.job || !cof.pos) {
+		free(cof.pos);
+		free(cof.job);
+		free(cof.table);
+		free(cof.frame);
+		free(cof.in);
+		free(cof.com);
+		return -1;
+	}
+
+	/* Compress each distinct message once, in order, as the codec state is
+	 * per connection */
+	for (i = 0; i < count; i ++) {
+		cof.in[i] = NULL;
+
+		if (send[i].opt->msg_type == SIDP_MSG_TYPE_DATA) {
+			send[i].ret = chain_out_fanout_compress(&cof, i);
+		} else {
+			send[i].ret = chain_out_prepare(send[i].conn, send[i].pkt, send[i].opt, &cof.com[i]);
+		}
+	}
+
+	cl_frames = cof.nframes;
+
+	memset(cof.table, 0, size * sizeof(unsigned int));
+
+	/* Encrypt each distinct compressed message once per cipher type and key,
+	 * except for counter nonce packets, encrypted together afterwards */
+	for (i = 0; i < count; i ++) {
+		if ((send[i].ret >= 0) && cof.in[i])
+			send[i].ret = chain_out_fanout_encrypt(&cof, i);
+	}
+
+	chain_out_encrypt_seq_batch(send, cof.com, cof.in, count, cof.job, cof.pos);
+
+	/* The compressed frames are no longer needed */
+	for (i = 0; i < cl_frames; i ++)
+		free(cof.frame[i].data);
+
+	/* Send everything, releasing each shared frame after its last packet */
+	for (i = 0; i < count; i ++) {
+		frame = cof.com[i].frame;
+
+		if (send[i].ret < 0) {
+			chain_out_msg_release(&cof.com[i]);
+		} else if (frame && (frame->len < 0)) {
+			send[i].ret = -6;
+		} else if (frame) {
+			send[i].ret = chain_out_send_frame(send[i].conn, send[i].pkt, send[i].opt, &cof.com[i], frame->data, frame->len);
+		} else if (send[i].opt->msg_type == SIDP_MSG_TYPE_DATA) {
+			send[i].ret = chain_out_send_frame(send[i].conn, send[i].pkt, send[i].opt, &cof.com[i], cof.com[i].el_data, cof.com[i].len);
+		} else {
+			send[i].ret = chain_out_send(send[i].conn, send[i].pkt, send[i].opt, &cof.com[i]);
+		}
+
+		if (send[i].ret >= 0) {
+			sent ++;
+		} else if (send[i].ret != -15) {
+			chain_out_batch_abort(send, cof.com, cof.in, count, i);
+		}
+
+		if (frame && !(-- frame->refs))
+			free(frame->data);
+	}
+
+	free(cof.pos);
+	free(cof.job);
+	free(cof.table);
+	free(cof.frame);
+	free(cof.in);
+	free(cof.com);
+
+	return sent;
+}
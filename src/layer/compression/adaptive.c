@@ -0,0 +1,249 @@
+/**
+ * @file adaptive.c
+ * @brief SIDP Compression Layer - Adaptive codec and level selection
+ */
+
+/*
+   Secure Inter-Device Protocol Library
+
+   Copyright 2012-2014 Pedro A. Hortas (pah@ucodev.org)
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+
+#ifdef COMPILE_POSIX
+#include <time.h>
+#ifdef __linux__
+#include <sys/ioctl.h>
+#include <linux/sockios.h>
+#endif
+#elif defined(COMPILE_WIN32)
+#include <windows.h>
+#endif
+
+#include "cl_api.h"
+#include "cl_adaptive.h"
+
+/* Candidate (codec, level) pairs, from the cheapest to the tightest */
+static const struct {
+	uint16_t compress_type;
+	uint16_t level;
+} cl_adaptive_levels[] = {
+	{ CL_COMPRESS_TYPE_LZ4, CL_COMPRESS_LEVEL_DEFAULT },
+	{ CL_COMPRESS_TYPE_LZO, CL_COMPRESS_LEVEL_DEFAULT },
+	{ CL_COMPRESS_TYPE_FASTLZ, 1 },
+	{ CL_COMPRESS_TYPE_FASTLZ, 2 },
+	{ CL_COMPRESS_TYPE_LZ4, 9 },
+	{ CL_COMPRESS_TYPE_ZLIB, 1 },
+	{ CL_COMPRESS_TYPE_ZLIB, 6 },
+	{ CL_COMPRESS_TYPE_ZLIB, 9 },
+	{ 0, 0 }
+};
+
+/**
+ * @brief Moves the running average 'avg' towards 'sample'
+ */
+static void cl_adaptive_ewma(uint32_t *avg, uint32_t sample) {
+	int64_t delta = (int64_t) sample - (int64_t) *avg;
+
+	*avg = (uint32_t) ((int64_t) *avg + (delta / (1 << CL_ADAPTIVE_EWMA_SHIFT)));
+}
+
+/**
+ * @brief Monotonic timestamp used to measure the compression and link costs
+ * @return The current timestamp in nanoseconds
+ */
+uint64_t cl_adaptive_timestamp(void) {
+#ifdef COMPILE_WIN32
+	LARGE_INTEGER freq, count;
+
+	QueryPerformanceFrequency(&freq);
+	QueryPerformanceCounter(&count);
+
+	return (uint64_t) ((count.QuadPart * 1000000000.0) / freq.QuadPart);
+#else
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ((uint64_t) ts.tv_sec * 1000000000ULL) + ts.tv_nsec;
+#endif
+}
+
+/**
+ * @brief Initializes the adaptive controller with the mutually supported
+ * codecs.
+ * @param cla The adaptive controller to be initialized
+ * @param compress_types Bitmask of usable codecs (1 << CL_COMPRESS_TYPE_*)
+ * @return 0 on success, -1 if no usable codec is available.
+ */
+int cl_adaptive_init(struct cl_adaptive *cla, uint32_t compress_types) {
+	unsigned int i;
+
+	memset(cla, 0, sizeof(struct cl_adaptive));
+
+	for (i = 0; cl_adaptive_levels[i].compress_type; i ++) {
+		if (!(compress_types & (1 << cl_adaptive_levels[i].compress_type)))
+			continue;
+
+		if (cla->count == CL_ADAPTIVE_MAX_CANDIDATES)
+			break;
+
+		cla->cand[cla->count].compress_type = cl_adaptive_levels[i].compress_type;
+		cla->cand[cla->count].level = cl_adaptive_levels[i].level;
+		cla->count ++;
+	}
+
+	return -!cla->count;
+}
+
+/**
+ * @brief Selects the codec and level to be used for the next message.
+ * Candidates that were never measured are used first. After that, the
+ * candidate with the lowest estimated cost per input byte (compression time
+ * plus the time the link takes to drain the compressed output) is used,
+ * except for every CL_ADAPTIVE_PROBE_INTERVAL message, which re-measures one
+ * of the other candidates so that the estimates follow the current CPU load.
+ * @param cla The adaptive controller
+ * @param compress_type The selected codec (CL_COMPRESS_TYPE_*)
+ * @param level The selected compression level
+ */
+void cl_adaptive_select(
+		struct cl_adaptive *cla,
+		int *compress_type,
+		int *level) {
+	unsigned int i;
+	uint64_t cost, best_cost = UINT64_MAX;
+
+	cla->msg_count ++;
+
+	for (i = 0; i < cla->count; i ++) {
+		if (!cla->cand[i].samples)
+			break;
+	}
+
+	if (i == cla->count) {
+		if (!(cla->msg_count % CL_ADAPTIVE_PROBE_INTERVAL)) {
+			cla->probe = (cla->probe + 1) % cla->count;
+			i = cla->probe;
+		} else {
+			for (i = 0; i < cla->count; i ++) {
+				cost = cla->cand[i].cpu_cost + (((uint64_t) cla->cand[i].ratio * cla->link_cost) >> 10);
+
+				if (cost < best_cost) {
+					best_cost = cost;
+					cla->current = i;
+				}
+			}
+
+			i = cla->current;
+		}
+	}
+
+	*compress_type = cla->cand[i].compress_type;
+	*level = cla->cand[i].level;
+}
+
+/**
+ * @brief Accounts a compression result for the used (codec, level) pair
+ * @param cla The adaptive controller
+ * @param compress_type The codec used
+ * @param level The level used
+ * @param in_len The size of the uncompressed data
+ * @param out_len The size of the compressed data
+ * @param elapsed Time taken by the compression, in nanoseconds
+ */
+void cl_adaptive_update(
+		struct cl_adaptive *cla,
+		int compress_type,
+		int level,
+		size_t in_len,
+		size_t out_len,
+		uint64_t elapsed) {
+	unsigned int i;
+	uint32_t ratio, cpu_cost;
+	struct cl_adaptive_candidate *cand;
+
+	if (!in_len)
+		return;
+
+	for (i = 0; i < cla->count; i ++) {
+		if ((cla->cand[i].compress_type == compress_type) && (cla->cand[i].level == level))
+			break;
+	}
+
+	if (i == cla->count)
+		return;
+
+	cand = &cla->cand[i];
+
+	ratio = (uint32_t) (((uint64_t) out_len << 10) / in_len);
+	cpu_cost = (uint32_t) ((elapsed << 8) / in_len);
+
+	if (!cand->samples ++) {
+		cand->ratio = ratio;
+		cand->cpu_cost = cpu_cost;
+	} else {
+		cl_adaptive_ewma(&cand->ratio, ratio);
+		cl_adaptive_ewma(&cand->cpu_cost, cpu_cost);
+	}
+}
+
+/**
+ * @brief Accounts a packet write on the connection link.
+ * On Linux the socket send queue is inspected: while data written before this
+ * packet is still queued, the link is the bottleneck and the drain rate since
+ * the previous packet is sampled. When the queue kept up, the link cost decays
+ * towards zero so that CPU time dominates the codec selection. On other
+ * platforms, the time spent blocked in the write is used instead.
+ * @param cla The adaptive controller
+ * @param fd The connection file descriptor
+ * @param wire_len The number of bytes written
+ * @param elapsed Time taken by the write, in nanoseconds
+ */
+void cl_adaptive_update_link(
+		struct cl_adaptive *cla,
+		int fd,
+		size_t wire_len,
+		uint64_t elapsed) {
+	uint32_t sample = 0;
+#if defined(SIOCOUTQ)
+	int queued = 0;
+	uint32_t backlog, drained;
+	uint64_t now = cl_adaptive_timestamp();
+
+	if ((ioctl(fd, SIOCOUTQ, &queued) < 0) || (queued < 0))
+		queued = 0;
+
+	backlog = ((size_t) queued > wire_len) ? (uint32_t) (queued - wire_len) : 0;
+
+	if (backlog && cla->link_ts && (cla->link_queued > backlog)) {
+		drained = cla->link_queued - backlog;
+		sample = (uint32_t) (((now - cla->link_ts) << 8) / drained);
+	}
+
+	cla->link_ts = now;
+	cla->link_queued = queued;
+#else
+	if (wire_len)
+		sample = (uint32_t) ((elapsed << 8) / wire_len);
+#endif
+
+	cl_adaptive_ewma(&cla->link_cost, sample);
+}
+
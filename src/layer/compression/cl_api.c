@@ -29,6 +29,8 @@
 #include "cl_lzo.h"
 #endif
 #include "cl_fastlz.h"
+#include "cl_lz4.h"
+#include "cl_telemetry.h"
 #ifndef COMPILE_WIN32
 #include "cl_zlib.h"
 #endif
@@ -51,14 +53,31 @@ int cl_data_init(struct cl_data *cld, int compress_type) {
 		cld->init = cl_fastlz_init;
 		cld->compress_output_len = cl_fastlz_compress_output_len;
 		cld->compress = cl_fastlz_compress_data;
+		cld->compress_level = cl_fastlz_compress_data_level;
 		cld->decompress = cl_fastlz_decompress_data;
 
+		return cld->init();
+	} else if (compress_type == CL_COMPRESS_TYPE_LZ4) {
+		cld->init = cl_lz4_init;
+		cld->compress_output_len = cl_lz4_compress_output_len;
+		cld->compress = cl_lz4_compress_data;
+		cld->compress_level = cl_lz4_compress_data_level;
+		cld->decompress = cl_lz4_decompress_data;
+
+		return cld->init();
+	} else if (compress_type == CL_COMPRESS_TYPE_TELEMETRY) {
+		cld->init = cl_telemetry_init;
+		cld->compress_output_len = cl_telemetry_compress_output_len;
+		cld->compress_schema = cl_telemetry_compress_data;
+		cld->decompress_schema = cl_telemetry_decompress_data;
+
 		return cld->init();
 #ifdef WITH_LZO_SUPPORT
 	} else if (compress_type == CL_COMPRESS_TYPE_LZO) {
 		cld->init = cl_lzo_init;
 		cld->compress_output_len = cl_lzo_compress_output_len;
 		cld->compress = cl_lzo_compress_data;
+		cld->compress_level = cl_lzo_compress_data_level;
 		cld->decompress = cl_lzo_decompress_data;
 
 		return cld->init();
@@ -68,6 +87,7 @@ int cl_data_init(struct cl_data *cld, int compress_type) {
 		cld->init = cl_zlib_init;
 		cld->compress_output_len = cl_zlib_compress_output_len;
 		cld->compress = cl_zlib_compress_data;
+		cld->compress_level = cl_zlib_compress_data_level;
 		cld->decompress = cl_zlib_decompress_data;
 
 		return cld->init();
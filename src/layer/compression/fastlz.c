@@ -31,6 +31,7 @@
 
 #include <fastlz/fastlz.h>
 
+#include "cl_api.h"
 #include "cl_fastlz.h"
 
 /**
@@ -67,12 +68,36 @@ int cl_fastlz_compress_data(
 		void *out_data,
 		const void *in_data,
 		size_t in_size) {
+	return cl_fastlz_compress_data_level(out_data, in_data, in_size, CL_COMPRESS_LEVEL_DEFAULT);
+}
+
+/**
+ * @brief FastLZ compress data function with explicit compression level
+ * @see cl_fastlz_compress_data()
+ * @param out_data Output buffer containing the compressed data.
+ * @param in_data Input buffer contataining the uncompressed data.
+ * @param in_size The size of uncompressed data.
+ * @param level FastLZ level (1 or 2). CL_COMPRESS_LEVEL_DEFAULT lets FastLZ
+ * pick the level based on the input size.
+ * @return The size of compressed data or -1 on error.
+ */
+int cl_fastlz_compress_data_level(
+		void *out_data,
+		const void *in_data,
+		size_t in_size,
+		int level) {
 
 	uint8_t status;
 	int out_len;
 
 	/* Compress data */
-	if ((out_len = fastlz_compress(in_data, in_size, ((unsigned char *) out_data) + 1)) < 0)
+	if (level == CL_COMPRESS_LEVEL_DEFAULT) {
+		out_len = fastlz_compress(in_data, in_size, ((unsigned char *) out_data) + 1);
+	} else {
+		out_len = fastlz_compress_level(level > 1 ? 2 : 1, in_data, in_size, ((unsigned char *) out_data) + 1);
+	}
+
+	if (out_len < 0)
 		return -1;
 
 	/* Validate whether data was compressed or not */
@@ -0,0 +1,148 @@
+/**
+ * @file lz4.c
+ * @brief SIDP Compression Layer - LZ4 Compress/Decompress Interface
+ */
+
+/*
+   Secure Inter-Device Protocol Library
+
+   Copyright 2012-2014 Pedro A. Hortas (pah@ucodev.org)
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include <lz4/lz4.h>
+#include <lz4/lz4hc.h>
+
+#include "cl_api.h"
+#include "cl_lz4.h"
+
+/**
+ * @brief LZ4 initialization function.
+ * Shall be called before any other cl_lz4_*() function.
+ * @return 0 on success, -1 on failure
+ */
+int cl_lz4_init(void) {
+	return 0;
+}
+
+/**
+ * @brief LZ4 compressed data length
+ * @see cl_lz4_compress_data()
+ * @param uncomp_len The size of uncompressed data
+ * @return The required size for the 'out' param of the
+ * cl_lz4_compress_data() function.
+ */
+size_t cl_lz4_compress_output_len(size_t uncomp_len) {
+	return LZ4_COMPRESSBOUND(uncomp_len) + 1;
+}
+
+/**
+ * @brief LZ4 compress data function
+ * @see cl_lz4_compress_output_len()
+ * @see cl_lz4_decompress_data()
+ * @param out_data Output buffer containing the compressed data.
+ * @param in_data Input buffer contataining the uncompressed data.
+ * @param in_size The size of uncompressed data.
+ * @return The size of compressed data or -1 on error.
+ */
+int cl_lz4_compress_data(
+		void *out_data,
+		const void *in_data,
+		size_t in_size) {
+	return cl_lz4_compress_data_level(out_data, in_data, in_size, CL_COMPRESS_LEVEL_DEFAULT);
+}
+
+/**
+ * @brief LZ4 compress data function with explicit compression level
+ * @see cl_lz4_compress_data()
+ * @param out_data Output buffer containing the compressed data.
+ * @param in_data Input buffer contataining the uncompressed data.
+ * @param in_size The size of uncompressed data.
+ * @param level Levels below LZ4HC_CLEVEL_MIN (including
+ * CL_COMPRESS_LEVEL_DEFAULT) use the fast LZ4 compressor. Levels from
+ * LZ4HC_CLEVEL_MIN to LZ4HC_CLEVEL_MAX use LZ4 HC. The output is decoded by
+ * the same decompressor regardless of the level.
+ * @return The size of compressed data or -1 on error.
+ */
+int cl_lz4_compress_data_level(
+		void *out_data,
+		const void *in_data,
+		size_t in_size,
+		int level) {
+
+	uint8_t status;
+	int out_len, out_max = LZ4_COMPRESSBOUND(in_size);
+
+	/* Compress data */
+	if (level < LZ4HC_CLEVEL_MIN) {
+		out_len = LZ4_compress_default(in_data, ((char *) out_data) + 1, in_size, out_max);
+	} else {
+		out_len = LZ4_compress_HC(in_data, ((char *) out_data) + 1, in_size, out_max, level);
+	}
+
+	/* Validate whether data was compressed or not */
+	if ((out_len <= 0) || (out_len >= (signed) in_size)) {
+		memcpy(((char *) out_data) + 1, in_data, in_size);
+		out_len = in_size;
+		status = 0;
+	} else {
+		status = 1;
+	}
+
+	/* Set compression status */
+	((uint8_t *) out_data)[0] = status;
+
+	return out_len + 1;
+}
+
+/**
+ * @brief LZ4 decompress data function
+ * @see cl_lz4_init()
+ * @see cl_lz4_compress_data()
+ * @param out_data Output buffer containing the decompressed data.
+ * @param in_data Input buffer contataining the compressed data.
+ * @param in_size The size of compressed data.
+ * @return The size of decompressed data or -1 on error.
+ */
+int cl_lz4_decompress_data(
+		void *out_data,
+		size_t out_size,
+		const void *in_data,
+		size_t in_size) {
+
+	int out_len;
+
+	/* Check if data is compressed */
+	if (!((uint8_t *) in_data)[0]) {
+		if ((in_size - 1) > out_size)
+			return -1;
+
+		memcpy(out_data, ((char *) in_data) + 1, in_size - 1);
+
+		return in_size - 1;
+	}
+
+	/* Decompress data */
+	if ((out_len = LZ4_decompress_safe(((char *) in_data) + 1, out_data, in_size - 1, out_size)) < 0)
+		return -1;
+
+	return out_len;
+}
+
@@ -44,6 +44,7 @@
 #  define lzo_malloc malloc
 #endif
 
+#include "cl_api.h"
 #include "cl_lzo.h"
 
 /**
@@ -80,6 +81,24 @@ int cl_lzo_compress_data(
 		void *out_data,
 		const void *in_data,
 		size_t in_size) {
+	return cl_lzo_compress_data_level(out_data, in_data, in_size, CL_COMPRESS_LEVEL_DEFAULT);
+}
+
+/**
+ * @brief LZO compress data function with explicit compression level
+ * @see cl_lzo_compress_data()
+ * @param out_data Output buffer containing the compressed data.
+ * @param in_data Input buffer contataining the uncompressed data.
+ * @param in_size The size of uncompressed data.
+ * @param level Compression level. Only LZO1X-1 is available, so this value
+ * is currently ignored.
+ * @return The size of compressed data or -1 on error.
+ */
+int cl_lzo_compress_data_level(
+		void *out_data,
+		const void *in_data,
+		size_t in_size,
+		int level) {
 
 	uint8_t status;
 	lzo_bytep in = (lzo_bytep) in_data;
@@ -0,0 +1,644 @@
+/**
+ * @file telemetry.c
+ * @brief SIDP Compression Layer - Telemetry record Compress/Decompress Interface
+ */
+
+/*
+   Secure Inter-Device Protocol Library
+
+   Copyright 2012-2014 Pedro A. Hortas (pah@ucodev.org)
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+/*
+ * Compressed message layout (after the compression status byte):
+ *
+ *   fingerprint (16 bits) | record count (32 bits) | field streams | tail
+ *
+ * Each field is encoded as a column: the value of the first record is
+ * stored as is, and the value of every other record is replaced by its
+ * difference to the same field of the previous record, zigzag mapped so that
+ * small negative differences become small integers, and bit-packed. 64 bit
+ * fields are split into two 32 bit streams (low, high).
+ *
+ * Streams are bit-packed in blocks of CL_TELEMETRY_BLOCK_LEN values, each
+ * preceded by its bit width. Full blocks use an 8 lane vertical layout
+ * (value i belongs to lane i % 8, and each lane is packed into its own
+ * sequence of 32 bit words, interleaved with the other lanes) so that they
+ * can be packed and unpacked with SSE2 or AVX2 shifts. The remaining values
+ * are packed as a plain little-endian bit stream. The bytes of the message
+ * that don't make up a whole record are appended as they are.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__clang__) || (__GNUC__ > 4) || ((__GNUC__ == 4) && (__GNUC_MINOR__ >= 9)))
+#define CL_TELEMETRY_X86_SIMD	1
+#include <immintrin.h>
+#endif
+
+#include "cl_api.h"
+#include "cl_telemetry.h"
+
+/* Fingerprint (16 bits) and record count (32 bits) */
+#define CL_TELEMETRY_HDR_LEN	6
+
+static void cl_telemetry_pack_block_scalar(uint8_t *out, const uint32_t *in, unsigned int bits);
+static void cl_telemetry_unpack_block_scalar(uint32_t *out, const uint8_t *in, unsigned int bits);
+
+/* Block kernels, selected by cl_telemetry_init() */
+static void (*cl_telemetry_pack_block) (uint8_t *, const uint32_t *, unsigned int) = cl_telemetry_pack_block_scalar;
+static void (*cl_telemetry_unpack_block) (uint32_t *, const uint8_t *, unsigned int) = cl_telemetry_unpack_block_scalar;
+
+static inline int cl_telemetry_is_little_endian(void) {
+	const union { uint32_t u; uint8_t c[4]; } one = { 1 };
+
+	return one.c[0];
+}
+
+static inline uint32_t cl_telemetry_load32(const uint8_t *p) {
+	return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t) p[3] << 24);
+}
+
+static inline void cl_telemetry_store32(uint8_t *p, uint32_t v) {
+	p[0] = (uint8_t) v;
+	p[1] = (uint8_t) (v >> 8);
+	p[2] = (uint8_t) (v >> 16);
+	p[3] = (uint8_t) (v >> 24);
+}
+
+/* Loads a little-endian field of 'width' bytes */
+static inline uint64_t cl_telemetry_load_field(const uint8_t *p, unsigned int width) {
+	uint64_t v = 0;
+	unsigned int i;
+
+	if (cl_telemetry_is_little_endian()) {
+		memcpy(&v, p, width);
+	} else {
+		for (i = 0; i < width; i ++)
+			v |= ((uint64_t) p[i]) << (i << 3);
+	}
+
+	return v;
+}
+
+/* Stores a little-endian field of 'width' bytes */
+static inline void cl_telemetry_store_field(uint8_t *p, uint64_t v, unsigned int width) {
+	unsigned int i;
+
+	if (cl_telemetry_is_little_endian()) {
+		memcpy(p, &v, width);
+	} else {
+		for (i = 0; i < width; i ++)
+			p[i] = (uint8_t) (v >> (i << 3));
+	}
+}
+
+/* Number of bits required by the largest of 'n' values */
+static unsigned int cl_telemetry_bits(const uint32_t *in, size_t n) {
+	uint32_t acc = 0;
+	unsigned int bits = 0;
+
+	while (n --)
+		acc |= *in ++;
+
+	for (; acc; acc >>= 1)
+		bits ++;
+
+	return bits;
+}
+
+/*
+ * Block kernels. A block holds CL_TELEMETRY_BLOCK_LEN values as 32 rows of 8
+ * lanes. Packed word k of lane l is stored at 32 bit word (k * 8) + l.
+ */
+static void cl_telemetry_pack_block_scalar(uint8_t *out, const uint32_t *in, unsigned int bits) {
+	unsigned int lane, row, shift, k;
+	uint32_t acc, v;
+
+	for (lane = 0; lane < 8; lane ++) {
+		for (row = 0, acc = 0, shift = 0, k = 0; row < 32; row ++) {
+			v = in[(row << 3) + lane];
+			acc |= v << shift;
+			shift += bits;
+
+			if (shift >= 32) {
+				cl_telemetry_store32(out + (((k << 3) + lane) << 2), acc);
+				k ++;
+				shift -= 32;
+				acc = shift ? v >> (bits - shift) : 0;
+			}
+		}
+	}
+}
+
+static void cl_telemetry_unpack_block_scalar(uint32_t *out, const uint8_t *in, unsigned int bits) {
+	unsigned int lane, row, pos, k, s;
+	uint32_t v, mask = (bits == 32) ? 0xffffffff : ((1U << bits) - 1);
+
+	for (lane = 0; lane < 8; lane ++) {
+		for (row = 0; row < 32; row ++) {
+			pos = row * bits;
+			k = pos >> 5;
+			s = pos & 31;
+
+			v = cl_telemetry_load32(in + (((k << 3) + lane) << 2)) >> s;
+
+			if ((s + bits) > 32)
+				v |= cl_telemetry_load32(in + ((((k + 1) << 3) + lane) << 2)) << (32 - s);
+
+			out[(row << 3) + lane] = v & mask;
+		}
+	}
+}
+
+#ifdef CL_TELEMETRY_X86_SIMD
+__attribute__((target("sse2")))
+static void cl_telemetry_pack_block_sse2(uint8_t *out, const uint32_t *in, unsigned int bits) {
+	__m128i acc0 = _mm_setzero_si128(), acc1 = _mm_setzero_si128(), v0, v1, cnt;
+	unsigned int row, shift = 0;
+
+	for (row = 0; row < 32; row ++, in += 8) {
+		v0 = _mm_loadu_si128((const __m128i *) in);
+		v1 = _mm_loadu_si128((const __m128i *) (in + 4));
+
+		cnt = _mm_cvtsi32_si128(shift);
+		acc0 = _mm_or_si128(acc0, _mm_sll_epi32(v0, cnt));
+		acc1 = _mm_or_si128(acc1, _mm_sll_epi32(v1, cnt));
+		shift += bits;
+
+		if (shift >= 32) {
+			_mm_storeu_si128((__m128i *) out, acc0);
+			_mm_storeu_si128((__m128i *) (out + 16), acc1);
+			out += 32;
+			shift -= 32;
+
+			/* Shift counts above 31 yield zero */
+			cnt = _mm_cvtsi32_si128(shift ? bits - shift : 32);
+			acc0 = _mm_srl_epi32(v0, cnt);
+			acc1 = _mm_srl_epi32(v1, cnt);
+		}
+	}
+}
+
+__attribute__((target("sse2")))
+static void cl_telemetry_unpack_block_sse2(uint32_t *out, const uint8_t *in, unsigned int bits) {
+	__m128i mask = _mm_set1_epi32((bits == 32) ? -1 : (int) ((1U << bits) - 1));
+	__m128i v0, v1;
+	const uint8_t *w;
+	unsigned int row, pos, s;
+
+	for (row = 0; row < 32; row ++, out += 8) {
+		pos = row * bits;
+		s = pos & 31;
+		w = in + ((pos >> 5) << 5);
+
+		v0 = _mm_srl_epi32(_mm_loadu_si128((const __m128i *) w), _mm_cvtsi32_si128(s));
+		v1 = _mm_srl_epi32(_mm_loadu_si128((const __m128i *) (w + 16)), _mm_cvtsi32_si128(s));
+
+		if ((s + bits) > 32) {
+			v0 = _mm_or_si128(v0, _mm_sll_epi32(_mm_loadu_si128((const __m128i *) (w + 32)), _mm_cvtsi32_si128(32 - s)));
+			v1 = _mm_or_si128(v1, _mm_sll_epi32(_mm_loadu_si128((const __m128i *) (w + 48)), _mm_cvtsi32_si128(32 - s)));
+		}
+
+		_mm_storeu_si128((__m128i *) out, _mm_and_si128(v0, mask));
+		_mm_storeu_si128((__m128i *) (out + 4), _mm_and_si128(v1, mask));
+	}
+}
+
+__attribute__((target("avx2")))
+static void cl_telemetry_pack_block_avx2(uint8_t *out, const uint32_t *in, unsigned int bits) {
+	__m256i acc = _mm256_setzero_si256(), v;
+	unsigned int row, shift = 0;
+
+	for (row = 0; row < 32; row ++, in += 8) {
+		v = _mm256_loadu_si256((const __m256i *) in);
+
+		acc = _mm256_or_si256(acc, _mm256_sll_epi32(v, _mm_cvtsi32_si128(shift)));
+		shift += bits;
+
+		if (shift >= 32) {
+			_mm256_storeu_si256((__m256i *) out, acc);
+			out += 32;
+			shift -= 32;
+
+			/* Shift counts above 31 yield zero */
+			acc = _mm256_srl_epi32(v, _mm_cvtsi32_si128(shift ? bits - shift : 32));
+		}
+	}
+}
+
+__attribute__((target("avx2")))
+static void cl_telemetry_unpack_block_avx2(uint32_t *out, const uint8_t *in, unsigned int bits) {
+	__m256i mask = _mm256_set1_epi32((bits == 32) ? -1 : (int) ((1U << bits) - 1));
+	__m256i v;
+	const uint8_t *w;
+	unsigned int row, pos, s;
+
+	for (row = 0; row < 32; row ++, out += 8) {
+		pos = row * bits;
+		s = pos & 31;
+		w = in + ((pos >> 5) << 5);
+
+		v = _mm256_srl_epi32(_mm256_loadu_si256((const __m256i *) w), _mm_cvtsi32_si128(s));
+
+		if ((s + bits) > 32)
+			v = _mm256_or_si256(v, _mm256_sll_epi32(_mm256_loadu_si256((const __m256i *) (w + 32)), _mm_cvtsi32_si128(32 - s)));
+
+		_mm256_storeu_si256((__m256i *) out, _mm256_and_si256(v, mask));
+	}
+}
+#endif
+
+/*
+ * Packs 'n' values into 'op'.
+ * Returns the new output pointer, or NULL if 'oend' would be exceeded.
+ */
+static uint8_t *cl_telemetry_pack_stream(
+		uint8_t *op,
+		const uint8_t *oend,
+		const uint32_t *in,
+		size_t n) {
+	unsigned int bits, nacc = 0;
+	uint64_t acc = 0;
+	size_t i;
+
+	for (; n >= CL_TELEMETRY_BLOCK_LEN; n -= CL_TELEMETRY_BLOCK_LEN, in += CL_TELEMETRY_BLOCK_LEN) {
+		bits = cl_telemetry_bits(in, CL_TELEMETRY_BLOCK_LEN);
+
+		if ((size_t) (oend - op) < (1 + (bits << 5)))
+			return NULL;
+
+		*op ++ = (uint8_t) bits;
+
+		if (bits)
+			cl_telemetry_pack_block(op, in, bits);
+
+		op += bits << 5;
+	}
+
+	if (!n)
+		return op;
+
+	bits = cl_telemetry_bits(in, n);
+
+	if ((size_t) (oend - op) < (1 + (((n * bits) + 7) >> 3)))
+		return NULL;
+
+	*op ++ = (uint8_t) bits;
+
+	for (i = 0; i < n; i ++) {
+		acc |= ((uint64_t) in[i]) << nacc;
+
+		for (nacc += bits; nacc >= 8; nacc -= 8, acc >>= 8)
+			*op ++ = (uint8_t) acc;
+	}
+
+	if (nacc)
+		*op ++ = (uint8_t) acc;
+
+	return op;
+}
+
+/*
+ * Unpacks 'n' values from 'ip'.
+ * Returns the new input pointer, or NULL if the input is malformed.
+ */
+static const uint8_t *cl_telemetry_unpack_stream(
+		uint32_t *out,
+		size_t n,
+		const uint8_t *ip,
+		const uint8_t *iend) {
+	unsigned int bits, nacc = 0;
+	uint32_t mask;
+	uint64_t acc = 0;
+	size_t i;
+
+	for (; n >= CL_TELEMETRY_BLOCK_LEN; n -= CL_TELEMETRY_BLOCK_LEN, out += CL_TELEMETRY_BLOCK_LEN) {
+		if ((ip >= iend) || ((bits = *ip ++) > 32) || ((size_t) (iend - ip) < (bits << 5)))
+			return NULL;
+
+		if (bits) {
+			cl_telemetry_unpack_block(out, ip, bits);
+		} else {
+			memset(out, 0, CL_TELEMETRY_BLOCK_LEN * sizeof(uint32_t));
+		}
+
+		ip += bits << 5;
+	}
+
+	if (!n)
+		return ip;
+
+	if ((ip >= iend) || ((bits = *ip ++) > 32) || ((size_t) (iend - ip) < (((n * bits) + 7) >> 3)))
+		return NULL;
+
+	mask = (bits == 32) ? 0xffffffff : ((1U << bits) - 1);
+
+	for (i = 0; i < n; i ++) {
+		for (; nacc < bits; nacc += 8)
+			acc |= ((uint64_t) *ip ++) << nacc;
+
+		out[i] = (uint32_t) acc & mask;
+		acc >>= bits;
+		nacc -= bits;
+	}
+
+	return ip;
+}
+
+/**
+ * @brief Initializes a telemetry record schema
+ * @param schema The schema to be initialized
+ * @param types Array of 'count' field types (CL_TELEMETRY_FIELD_*), in the
+ * same order as they appear in the record.
+ * @param count Number of fields per record
+ * @return 0 on success, -1 on invalid field count or type.
+ */
+int cl_telemetry_schema_init(
+		struct cl_telemetry_schema *schema,
+		const uint8_t *types,
+		unsigned int count) {
+	static const uint8_t widths[] = { 0, 1, 1, 2, 2, 4, 4, 8, 8, 4, 8 };
+	uint32_t fp = 2166136261U;
+	unsigned int i;
+
+	memset(schema, 0, sizeof(struct cl_telemetry_schema));
+
+	if (!count || (count > CL_TELEMETRY_MAX_FIELDS))
+		return -1;
+
+	for (i = 0; i < count; i ++) {
+		if (!types[i] || (types[i] > CL_TELEMETRY_FIELD_F64)) {
+			memset(schema, 0, sizeof(struct cl_telemetry_schema));
+			return -1;
+		}
+
+		schema->type[i] = types[i];
+		schema->width[i] = widths[types[i]];
+		schema->offset[i] = schema->record_size;
+		schema->record_size += schema->width[i];
+
+		/* FNV-1a over the field types */
+		fp = (fp ^ types[i]) * 16777619U;
+	}
+
+	schema->count = count;
+	schema->fingerprint = (uint16_t) ((fp >> 16) ^ fp);
+
+	return 0;
+}
+
+/**
+ * @brief Telemetry initialization function.
+ * Shall be called before any other cl_telemetry_*() function. Selects the
+ * bit-packing kernels based on the CPU features.
+ * @return 0 on success, -1 on failure
+ */
+int cl_telemetry_init(void) {
+#ifdef CL_TELEMETRY_X86_SIMD
+	__builtin_cpu_init();
+
+	if (__builtin_cpu_supports("avx2")) {
+		cl_telemetry_pack_block = cl_telemetry_pack_block_avx2;
+		cl_telemetry_unpack_block = cl_telemetry_unpack_block_avx2;
+	} else if (__builtin_cpu_supports("sse2")) {
+		cl_telemetry_pack_block = cl_telemetry_pack_block_sse2;
+		cl_telemetry_unpack_block = cl_telemetry_unpack_block_sse2;
+	}
+#endif
+	return 0;
+}
+
+/**
+ * @brief Telemetry compressed data length
+ * @see cl_telemetry_compress_data()
+ * @param uncomp_len The size of uncompressed data
+ * @return The required size for the 'out' param of the
+ * cl_telemetry_compress_data() function.
+ */
+size_t cl_telemetry_compress_output_len(size_t uncomp_len) {
+	/* Data is stored uncompressed when packing doesn't make it smaller */
+	return uncomp_len + 1;
+}
+
+/**
+ * @brief Telemetry compress data function
+ * @see cl_telemetry_compress_output_len()
+ * @see cl_telemetry_decompress_data()
+ * @param out_data Output buffer containing the compressed data.
+ * @param in_data Input buffer contataining the uncompressed data.
+ * @param in_size The size of uncompressed data.
+ * @param schema The 'struct cl_telemetry_schema' describing the records.
+ * @return The size of compressed data or -1 on error.
+ */
+int cl_telemetry_compress_data(
+		void *out_data,
+		const void *in_data,
+		size_t in_size,
+		const void *schema) {
+
+	const struct cl_telemetry_schema *s = schema;
+	const uint8_t *rec;
+	uint8_t *op = ((uint8_t *) out_data) + 1;
+	const uint8_t *oend = op + in_size;
+	uint32_t *lo = NULL, *hi;
+	uint64_t v, d, prev, mask, sign;
+	size_t n, r, tail;
+	unsigned int f, width;
+
+	/* Without a schema or a whole record, just store data */
+	if (!s || !s->count || !(n = in_size / s->record_size) || (n > UINT32_MAX) || ((size_t) (oend - op) < CL_TELEMETRY_HDR_LEN))
+		goto _store;
+
+	if (!(lo = malloc(n * sizeof(uint32_t) * 2)))
+		return -1;
+
+	hi = lo + n;
+
+	op[0] = (uint8_t) s->fingerprint;
+	op[1] = (uint8_t) (s->fingerprint >> 8);
+	cl_telemetry_store32(op + 2, (uint32_t) n);
+	op += CL_TELEMETRY_HDR_LEN;
+
+	for (f = 0; f < s->count; f ++) {
+		width = s->width[f];
+		mask = (width == 8) ? ~0ULL : ((1ULL << (width << 3)) - 1);
+		sign = 1ULL << ((width << 3) - 1);
+
+		/* The first record is the base for the deltas */
+		rec = ((const uint8_t *) in_data) + s->offset[f];
+
+		if ((size_t) (oend - op) < width)
+			goto _store;
+
+		memcpy(op, rec, width);
+		op += width;
+
+		prev = cl_telemetry_load_field(rec, width);
+
+		/* Delta against the previous record and zigzag map */
+		for (r = 1, rec += s->record_size; r < n; r ++, rec += s->record_size) {
+			v = cl_telemetry_load_field(rec, width);
+			d = (((v - prev) & mask) ^ sign) - sign;
+			prev = v;
+
+			d = ((d << 1) ^ (uint64_t) ((int64_t) d >> 63)) & mask;
+
+			lo[r - 1] = (uint32_t) d;
+			hi[r - 1] = (uint32_t) (d >> 32);
+		}
+
+		if (!(op = cl_telemetry_pack_stream(op, oend, lo, n - 1)))
+			goto _store;
+
+		if ((width == 8) && !(op = cl_telemetry_pack_stream(op, oend, hi, n - 1)))
+			goto _store;
+	}
+
+	free(lo);
+	lo = NULL;
+
+	/* Append the bytes that don't make up a whole record */
+	tail = in_size - (n * s->record_size);
+
+	if ((size_t) (oend - op) <= tail)
+		goto _store;
+
+	memcpy(op, ((const uint8_t *) in_data) + (n * s->record_size), tail);
+	op += tail;
+
+	/* Set compression status */
+	((uint8_t *) out_data)[0] = 1;
+
+	return op - (uint8_t *) out_data;
+
+_store:
+	free(lo);
+
+	memcpy(((uint8_t *) out_data) + 1, in_data, in_size);
+	((uint8_t *) out_data)[0] = 0;
+
+	return in_size + 1;
+}
+
+/**
+ * @brief Telemetry decompress data function
+ * @see cl_telemetry_init()
+ * @see cl_telemetry_compress_data()
+ * @param out_data Output buffer containing the decompressed data.
+ * @param in_data Input buffer contataining the compressed data.
+ * @param in_size The size of compressed data.
+ * @param schema The 'struct cl_telemetry_schema' describing the records.
+ * @return The size of decompressed data or -1 on error.
+ */
+int cl_telemetry_decompress_data(
+		void *out_data,
+		size_t out_size,
+		const void *in_data,
+		size_t in_size,
+		const void *schema) {
+
+	const struct cl_telemetry_schema *s = schema;
+	const uint8_t *ip = ((const uint8_t *) in_data) + 1;
+	const uint8_t *iend = ((const uint8_t *) in_data) + in_size;
+	uint8_t *rec;
+	uint32_t *lo, *hi;
+	uint64_t v, d, prev, mask;
+	size_t n, r, tail;
+	unsigned int f, width;
+
+	if (!in_size)
+		return -1;
+
+	/* Check if data is compressed */
+	if (!((uint8_t *) in_data)[0]) {
+		if ((in_size - 1) > out_size)
+			return -1;
+
+		memcpy(out_data, ip, in_size - 1);
+
+		return in_size - 1;
+	}
+
+	/* Both end-points must use the same schema */
+	if (!s || !s->count || ((size_t) (iend - ip) < CL_TELEMETRY_HDR_LEN) || ((ip[0] | (ip[1] << 8)) != s->fingerprint))
+		return -1;
+
+	n = cl_telemetry_load32(ip + 2);
+	ip += CL_TELEMETRY_HDR_LEN;
+
+	if (!n || (n > (out_size / s->record_size)))
+		return -1;
+
+	if (!(lo = malloc(n * sizeof(uint32_t) * 2)))
+		return -1;
+
+	hi = lo + n;
+
+	for (f = 0; f < s->count; f ++) {
+		width = s->width[f];
+		mask = (width == 8) ? ~0ULL : ((1ULL << (width << 3)) - 1);
+
+		/* The first record is the base for the deltas */
+		rec = ((uint8_t *) out_data) + s->offset[f];
+
+		if ((size_t) (iend - ip) < width)
+			goto _error;
+
+		memcpy(rec, ip, width);
+		prev = cl_telemetry_load_field(ip, width);
+		ip += width;
+
+		if (!(ip = cl_telemetry_unpack_stream(lo, n - 1, ip, iend)))
+			goto _error;
+
+		if (width == 8) {
+			if (!(ip = cl_telemetry_unpack_stream(hi, n - 1, ip, iend)))
+				goto _error;
+		} else {
+			memset(hi, 0, (n - 1) * sizeof(uint32_t));
+		}
+
+		/* Undo zigzag mapping and delta */
+		for (r = 1, rec += s->record_size; r < n; r ++, rec += s->record_size) {
+			d = ((uint64_t) hi[r - 1] << 32) | lo[r - 1];
+			v = (prev + ((d >> 1) ^ (0 - (d & 1)))) & mask;
+			prev = v;
+
+			cl_telemetry_store_field(rec, v, width);
+		}
+	}
+
+	free(lo);
+
+	/* Bytes that don't make up a whole record */
+	tail = iend - ip;
+
+	if (((n * s->record_size) + tail) > out_size)
+		return -1;
+
+	memcpy(((uint8_t *) out_data) + (n * s->record_size), ip, tail);
+
+	return (n * s->record_size) + tail;
+
+_error:
+	free(lo);
+
+	return -1;
+}
+
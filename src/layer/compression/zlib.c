@@ -29,6 +29,7 @@
 
 #include <zlib.h>
 
+#include "cl_api.h"
 #include "cl_zlib.h"
 
 /**
@@ -49,7 +50,8 @@ int cl_zlib_init(void) {
  * function.
  */
 size_t cl_zlib_compress_output_len(size_t uncomp_len) {
-	return uncomp_len;
+	/* Uncompressed data plus the compression status byte */
+	return uncomp_len + 1;
 }
 
 /**
@@ -65,6 +67,24 @@ int cl_zlib_compress_data(
 		void *out_data,
 		const void *in_data,
 		size_t in_size) {
+	return cl_zlib_compress_data_level(out_data, in_data, in_size, CL_COMPRESS_LEVEL_DEFAULT);
+}
+
+/**
+ * @brief zlib compress data function with explicit compression level
+ * @see cl_zlib_compress_data()
+ * @param out_data Output buffer containing the compressed data.
+ * @param in_data Input buffer contataining the uncompressed data.
+ * @param in_size The size of uncompressed data.
+ * @param level zlib compression level (1 to 9). CL_COMPRESS_LEVEL_DEFAULT
+ * selects Z_DEFAULT_COMPRESSION.
+ * @return The size of compressed data or -1 on error.
+ */
+int cl_zlib_compress_data_level(
+		void *out_data,
+		const void *in_data,
+		size_t in_size,
+		int level) {
 
 	uint8_t status;
 	size_t out_len;
@@ -74,7 +94,13 @@ int cl_zlib_compress_data(
 	strm.zfree = Z_NULL;
 	strm.opaque = Z_NULL;
 
-	if (deflateInit(&strm, Z_DEFAULT_COMPRESSION) != Z_OK)
+	if (level == CL_COMPRESS_LEVEL_DEFAULT) {
+		level = Z_DEFAULT_COMPRESSION;
+	} else if (level > Z_BEST_COMPRESSION) {
+		level = Z_BEST_COMPRESSION;
+	}
+
+	if (deflateInit(&strm, level) != Z_OK)
 		return -1;
 
 	strm.next_in = (unsigned char *) in_data;
@@ -0,0 +1,196 @@
+/**
+ * @file compact.c
+ * @brief SIDP - Compact description header
+ *
+ * A compact header is composed of a one byte type field, followed by the
+ * cipher type (only when it differs from the previous packet's), and by the
+ * deflated and inflated sizes, encoded as varints (7 bits per byte, least
+ * significant group first, the high bit set on all but the last byte).
+ * A DATA packet of up to 127 bytes thus needs a 3 byte header, instead of
+ * the 20 bytes of 'struct dl_hdr'.
+ */ 
+
+
+/*
+   Secure Inter-Device Protocol Library
+
+   Copyright 2012-2014 Pedro A. Hortas (pah@ucodev.org)
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+
+#include <stdio.h>
+#include <stdint.h>
+
+#include "sl_api.h"
+#include "dl_api.h"
+#include "dl_compact.h"
+
+/**
+ * @brief Encodes 'value' as a varint into 'out'
+ * @param out The output buffer (at least 3 bytes long)
+ * @param value The value to be encoded
+ * @return The number of bytes written
+ */
+static size_t dl_compact_varint_encode(unsigned char *out, uint32_t value) {
+	size_t len = 0;
+
+	while (value > 0x7f) {
+		out[len ++] = (unsigned char) (value & 0x7f) | 0x80;
+		value >>= 7;
+	}
+
+	out[len ++] = (unsigned char) value;
+
+	return len;
+}
+
+/**
+ * @brief Decodes a varint of up to 3 bytes from 'in' into 'value'
+ * @param value The decoded value
+ * @param in The input buffer
+ * @param in_len The number of bytes available in 'in'
+ * @return The number of bytes consumed, or -1 if the varint is truncated or
+ * doesn't fit 16 bits
+ */
+static int dl_compact_varint_decode(uint32_t *value, const unsigned char *in, size_t in_len) {
+	size_t i;
+
+	for (i = 0, *value = 0; (i < in_len) && (i < 3); i ++) {
+		*value |= ((uint32_t) (in[i] & 0x7f)) << (7 * i);
+
+		if (!(in[i] & 0x80))
+			return (*value > 0xffff) ? -1 : (int) (i + 1);
+	}
+
+	return -1;
+}
+
+/**
+ * @brief Encodes the description header 'hdr' in the compact format
+ * @see dl_compact_decode()
+ * @param out The output buffer (at least DL_COMPACT_HDR_MAX_LEN bytes long)
+ * @param hdr The description header, in host byte order
+ * @param cipher_type_prev The cipher type of the previous packet sent through
+ * the same connection (0 if none)
+ * @return The length of the compact header on success, -1 if 'hdr' can't be
+ * represented in the compact format.
+ */
+int dl_compact_encode(
+		unsigned char *out,
+		const struct dl_hdr *hdr,
+		uint16_t cipher_type_prev) {
+	size_t len = 1;
+
+	if ((hdr->msg_type > 0x03) || (hdr->compress_type > 0x07) || (hdr->cipher_type > 0xff))
+		return -1;
+
+	if ((hdr->def_size > 0xffff) || (hdr->inf_size > 0xffff))
+		return -1;
+
+	out[0] = (unsigned char) (hdr->msg_type | (hdr->compress_type << 2));
+
+	if (hdr->session_type == SL_ENCAP_TYPE_DEFAULT) {
+		out[0] |= DL_COMPACT_SESSION_DEFAULT_FL;
+	} else if (hdr->session_type != SL_ENCAP_TYPE_COMPACT) {
+		return -1;
+	}
+
+	if (hdr->cipher_type != cipher_type_prev) {
+		out[0] |= DL_COMPACT_CIPHER_FL;
+		out[len ++] = (unsigned char) hdr->cipher_type;
+	}
+
+	len += dl_compact_varint_encode(&out[len], hdr->def_size);
+	len += dl_compact_varint_encode(&out[len], hdr->inf_size);
+
+	return len;
+}
+
+/**
+ * @brief Computes how many bytes of a compact header are still missing,
+ * so that it can be read from a stream without reading past its end
+ * @see dl_compact_decode()
+ * @param in The bytes of the header received so far
+ * @param in_len The number of bytes in 'in'
+ * @return The minimum number of bytes still required to complete the header,
+ * 0 if it's complete.
+ */
+size_t dl_compact_missing_len(const unsigned char *in, size_t in_len) {
+	size_t i, fields, done = 1;
+
+	if (!in_len)
+		return DL_COMPACT_HDR_MIN_LEN;
+
+	/* Type field, optional cipher type and two varints */
+	fields = (in[0] & DL_COMPACT_CIPHER_FL) ? 4 : 3;
+
+	for (i = 1; i < in_len; i ++) {
+		/* The cipher type is a single byte, the varints end on a
+		 * byte with the high bit cleared
+		 */
+		if (((i == 1) && (in[0] & DL_COMPACT_CIPHER_FL)) || !(in[i] & 0x80))
+			done ++;
+	}
+
+	return (done >= fields) ? 0 : fields - done;
+}
+
+/**
+ * @brief Decodes the compact description header in 'in' into 'hdr'
+ * @see dl_compact_encode()
+ * @param hdr The decoded description header, in host byte order
+ * @param in The compact header
+ * @param in_len The length of 'in'
+ * @param cipher_type_prev The cipher type of the previous packet received
+ * from the same connection (0 if none)
+ * @return The length of the compact header on success, -1 on error.
+ */
+int dl_compact_decode(
+		struct dl_hdr *hdr,
+		const unsigned char *in,
+		size_t in_len,
+		uint16_t cipher_type_prev) {
+	size_t len = 1;
+	int ret;
+
+	if (!in_len || (in[0] & DL_COMPACT_RESERVED_FL))
+		return -1;
+
+	hdr->msg_type = in[0] & 0x03;
+	hdr->compress_type = (in[0] >> 2) & 0x07;
+	hdr->session_type = (in[0] & DL_COMPACT_SESSION_DEFAULT_FL) ? SL_ENCAP_TYPE_DEFAULT : SL_ENCAP_TYPE_COMPACT;
+	hdr->cipher_type = cipher_type_prev;
+	hdr->reserved = 0;
+
+	if (in[0] & DL_COMPACT_CIPHER_FL) {
+		if (len >= in_len)
+			return -1;
+
+		hdr->cipher_type = in[len ++];
+	}
+
+	if ((ret = dl_compact_varint_decode(&hdr->def_size, &in[len], in_len - len)) < 0)
+		return -1;
+
+	len += ret;
+
+	if ((ret = dl_compact_varint_decode(&hdr->inf_size, &in[len], in_len - len)) < 0)
+		return -1;
+
+	len += ret;
+
+	return len;
+}
+
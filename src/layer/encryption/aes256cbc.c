@@ -26,12 +26,139 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include <openssl/crypto.h>
 #include <openssl/evp.h>
-#include <openssl/hmac.h>
-#include <openssl/rand.h>
+
+#include "rng.h"
 
 #include "el_aes256cbc.h"
 
+#if OPENSSL_VERSION_NUMBER < 0x10100000L
+ #define EVP_MD_CTX_new EVP_MD_CTX_create
+ #define EVP_MD_CTX_free EVP_MD_CTX_destroy
+#endif
+
+/*
+ * Per-connection, per-direction state. The AES key schedule and the HMAC
+ * inner/outer SHA-256 states (key ^ ipad, key ^ opad) are computed once per
+ * key, so each packet only needs a new IV and a copy of the digest states.
+ */
+struct el_aes256_state {
+	unsigned char key[EL_AES256_KEY_LEN];
+	int keyed;
+	EVP_CIPHER_CTX *cipher;
+	EVP_MD_CTX *hmac_inner;
+	EVP_MD_CTX *hmac_outer;
+	EVP_MD_CTX *hmac;
+};
+
+static void el_aes256_state_destroy(void *state) {
+	struct el_aes256_state *st = state;
+
+	if (st->cipher)
+		EVP_CIPHER_CTX_free(st->cipher);
+
+	if (st->hmac_inner)
+		EVP_MD_CTX_free(st->hmac_inner);
+
+	if (st->hmac_outer)
+		EVP_MD_CTX_free(st->hmac_outer);
+
+	if (st->hmac)
+		EVP_MD_CTX_free(st->hmac);
+
+	OPENSSL_cleanse(st, sizeof(struct el_aes256_state));
+
+	free(st);
+}
+
+static int el_aes256_hmac_pad(EVP_MD_CTX *md_ctx, const unsigned char *key, unsigned char pad) {
+	unsigned char block[EL_AES256_HMAC_BLOCK_LEN];
+	int i, ret;
+
+	/* The key is shorter than the SHA-256 block, so it's zero padded */
+	for (i = 0; i < EL_AES256_HMAC_BLOCK_LEN; i ++)
+		block[i] = (i < EL_AES256_KEY_LEN ? key[i] : 0) ^ pad;
+
+	ret = EVP_DigestInit_ex(md_ctx, EVP_sha256(), NULL) && EVP_DigestUpdate(md_ctx, block, sizeof(block));
+
+	OPENSSL_cleanse(block, sizeof(block));
+
+	return ret ? 0 : -1;
+}
+
+/*
+ * Returns the state held by 'ctx', creating it if needed. The key schedule and
+ * HMAC key state are only recomputed when 'key' differs from the one in use.
+ */
+static struct el_aes256_state *el_aes256_state_get(struct el_ctx *ctx, const unsigned char *key, int enc) {
+	struct el_aes256_state *st = ctx->state;
+
+	if (!st || (ctx->cipher_type != EL_CIPHER_TYPE_AES256)) {
+		el_ctx_destroy(ctx);
+
+		if (!(st = calloc(1, sizeof(struct el_aes256_state))))
+			return NULL;
+
+		st->cipher = EVP_CIPHER_CTX_new();
+		st->hmac_inner = EVP_MD_CTX_new();
+		st->hmac_outer = EVP_MD_CTX_new();
+		st->hmac = EVP_MD_CTX_new();
+
+		if (!st->cipher || !st->hmac_inner || !st->hmac_outer || !st->hmac) {
+			el_aes256_state_destroy(st);
+			return NULL;
+		}
+
+		ctx->cipher_type = EL_CIPHER_TYPE_AES256;
+		ctx->state = st;
+		ctx->destroy = el_aes256_state_destroy;
+	}
+
+	if (st->keyed && !memcmp(st->key, key, EL_AES256_KEY_LEN))
+		return st;
+
+	st->keyed = 0;
+
+	if (enc) {
+		if (!EVP_EncryptInit_ex(st->cipher, EVP_aes_256_cbc(), NULL, key, NULL))
+			return NULL;
+	} else {
+		if (!EVP_DecryptInit_ex(st->cipher, EVP_aes_256_cbc(), NULL, key, NULL))
+			return NULL;
+	}
+
+	if (el_aes256_hmac_pad(st->hmac_inner, key, 0x36) < 0)
+		return NULL;
+
+	if (el_aes256_hmac_pad(st->hmac_outer, key, 0x5c) < 0)
+		return NULL;
+
+	memcpy(st->key, key, EL_AES256_KEY_LEN);
+	st->keyed = 1;
+
+	return st;
+}
+
+static int el_aes256_hmac(struct el_aes256_state *st, const unsigned char *data, size_t len, unsigned char *md, unsigned int *mdlen) {
+	unsigned char ihash[EVP_MAX_MD_SIZE];
+	unsigned int ilen;
+
+	if (!EVP_MD_CTX_copy_ex(st->hmac, st->hmac_inner))
+		return -1;
+
+	if (!EVP_DigestUpdate(st->hmac, data, len) || !EVP_DigestFinal_ex(st->hmac, ihash, &ilen))
+		return -1;
+
+	if (!EVP_MD_CTX_copy_ex(st->hmac, st->hmac_outer))
+		return -1;
+
+	if (!EVP_DigestUpdate(st->hmac, ihash, ilen) || !EVP_DigestFinal_ex(st->hmac, md, mdlen))
+		return -1;
+
+	return 0;
+}
+
 /**
  * @brief AES256 Initialization function.
  * @return 0 on success, -1 on error.
@@ -84,6 +211,7 @@ size_t el_aes256_decrypt_output_len(size_t enc_data_len) {
  * @brief AES256 data encryption
  * @see el_aes256_create_key()
  * @see el_aes256_decrypt_data()
+ * @see el_aes256_encrypt_data_ctx()
  * @param key The key generated by el_aes256_create_key()
  * @param out Output buffer containing the encrypted data
  * @param in Input buffer containing the plain-text data
@@ -95,7 +223,64 @@ int el_aes256_encrypt_data(
 		unsigned char *out,
 		const unsigned char *in,
 		size_t in_len) {
-	EVP_CIPHER_CTX e_ctx;
+	struct el_ctx ctx;
+	int ret;
+
+	memset(&ctx, 0, sizeof(struct el_ctx));
+
+	ret = el_aes256_encrypt_data_ctx(&ctx, key, out, in, in_len);
+
+	el_ctx_destroy(&ctx);
+
+	return ret;
+}
+
+/**
+ * @brief AES256 data decryption
+ * @see el_aes256_create_key()
+ * @see el_aes256_encrypt_data()
+ * @see el_aes256_decrypt_data_ctx()
+ * @param key The key generated by el_aes256_create_key()
+ * @param out Output buffer containing the decrypted data
+ * @param in Input buffer containing the encrypted data
+ * @param in_len The size of encrypted data buffer
+ * @return The size of decrypted data buffer (output) or -1 on error
+ */
+int el_aes256_decrypt_data(
+		const unsigned char *key,
+		unsigned char *out,
+		const unsigned char *in,
+		size_t in_len) {
+	struct el_ctx ctx;
+	int ret;
+
+	memset(&ctx, 0, sizeof(struct el_ctx));
+
+	ret = el_aes256_decrypt_data_ctx(&ctx, key, out, in, in_len);
+
+	el_ctx_destroy(&ctx);
+
+	return ret;
+}
+
+/**
+ * @brief AES256 data encryption, reusing the cipher and HMAC state kept in
+ * 'ctx' across calls
+ * @see el_aes256_encrypt_data()
+ * @param ctx Per-connection, per-direction state (zeroed before first use)
+ * @param key The key generated by el_aes256_create_key()
+ * @param out Output buffer containing the encrypted data
+ * @param in Input buffer containing the plain-text data
+ * @param in_len The size of the plain-text data buffer
+ * @return The size of encrypted data buffer (output) or -1 on error
+ */
+int el_aes256_encrypt_data_ctx(
+		struct el_ctx *ctx,
+		const unsigned char *key,
+		unsigned char *out,
+		const unsigned char *in,
+		size_t in_len) {
+	struct el_aes256_state *st;
 	unsigned int mdlen;
 	int clen, flen;
 	
@@ -105,52 +290,48 @@ int el_aes256_encrypt_data(
 	/* Just in case */
 	memset(out, 0, EVP_MAX_MD_SIZE + EVP_MAX_IV_LENGTH);
 
-	if (!RAND_bytes(iv, EVP_MAX_IV_LENGTH))
+	if (sidp_rng_bytes(iv, EVP_MAX_IV_LENGTH) < 0)
 		return -1;
 
-	EVP_CIPHER_CTX_init(&e_ctx);
+	if (!(st = el_aes256_state_get(ctx, key, 1)))
+		return -2;
 
-	if (!EVP_EncryptInit_ex(&e_ctx, EVP_aes_256_cbc(), NULL, key, iv)) {
-		EVP_CIPHER_CTX_cleanup(&e_ctx);
+	/* Keep the key schedule, only reset the IV */
+	if (!EVP_EncryptInit_ex(st->cipher, NULL, NULL, NULL, iv))
 		return -2;
-	}
 
-	if (!EVP_EncryptUpdate(&e_ctx, enctext, &clen, in, in_len)) {
-		EVP_CIPHER_CTX_cleanup(&e_ctx);
+	if (!EVP_EncryptUpdate(st->cipher, enctext, &clen, in, in_len))
 		return -3;
-	}
 
-	if (!EVP_EncryptFinal_ex(&e_ctx, enctext + clen, &flen)) {
-		EVP_CIPHER_CTX_cleanup(&e_ctx);
+	if (!EVP_EncryptFinal_ex(st->cipher, enctext + clen, &flen))
 		return -4;
-	}
-
-	EVP_CIPHER_CTX_cleanup(&e_ctx);
 
 	clen += flen;
 
-	if (!HMAC(EVP_sha256(), key, EVP_MAX_KEY_LENGTH, out + EVP_MAX_MD_SIZE, clen + EVP_MAX_IV_LENGTH, out, &mdlen))
+	if (el_aes256_hmac(st, out + EVP_MAX_MD_SIZE, clen + EVP_MAX_IV_LENGTH, out, &mdlen) < 0)
 		return -5;
 
 	return clen + EVP_MAX_MD_SIZE + EVP_MAX_IV_LENGTH;
 }
 
 /**
- * @brief AES256 data decryption
- * @see el_aes256_create_key()
- * @see el_aes256_encrypt_data()
+ * @brief AES256 data decryption, reusing the cipher and HMAC state kept in
+ * 'ctx' across calls
+ * @see el_aes256_decrypt_data()
+ * @param ctx Per-connection, per-direction state (zeroed before first use)
  * @param key The key generated by el_aes256_create_key()
  * @param out Output buffer containing the decrypted data
  * @param in Input buffer containing the encrypted data
  * @param in_len The size of encrypted data buffer
  * @return The size of decrypted data buffer (output) or -1 on error
  */
-int el_aes256_decrypt_data(
+int el_aes256_decrypt_data_ctx(
+		struct el_ctx *ctx,
 		const unsigned char *key,
 		unsigned char *out,
 		const unsigned char *in,
 		size_t in_len) {
-	EVP_CIPHER_CTX e_ctx;
+	struct el_aes256_state *st;
 	unsigned char hmac[EVP_MAX_MD_SIZE];
 	unsigned int mdlen;
 	int mlen, flen;
@@ -158,28 +339,27 @@ int el_aes256_decrypt_data(
 	const unsigned char *enctext = in + EVP_MAX_MD_SIZE + EVP_MAX_IV_LENGTH;
 	const unsigned char *iv = in + EVP_MAX_MD_SIZE;
 
-	if (!HMAC(EVP_sha256(), key, EVP_MAX_KEY_LENGTH, in + EVP_MAX_MD_SIZE, in_len - EVP_MAX_MD_SIZE, hmac, &mdlen))
+	if (in_len < (EVP_MAX_MD_SIZE + EVP_MAX_IV_LENGTH))
 		return -1;
 
-	/* Switch to constant-time comparison function */
-	if (memcmp(in, hmac, mdlen))
-		return -2;
+	if (!(st = el_aes256_state_get(ctx, key, 0)))
+		return -1;
 
-	EVP_CIPHER_CTX_init(&e_ctx);
+	if (el_aes256_hmac(st, in + EVP_MAX_MD_SIZE, in_len - EVP_MAX_MD_SIZE, hmac, &mdlen) < 0)
+		return -1;
+
+	if (CRYPTO_memcmp(in, hmac, mdlen))
+		return -2;
 
-	if (!EVP_DecryptInit_ex(&e_ctx, EVP_aes_256_cbc(), NULL, key, iv)) {
-		EVP_CIPHER_CTX_cleanup(&e_ctx);
+	/* Keep the key schedule, only reset the IV */
+	if (!EVP_DecryptInit_ex(st->cipher, NULL, NULL, NULL, iv))
 		return -3;
-	}
 
-	if (!EVP_DecryptUpdate(&e_ctx, out, &mlen, enctext, in_len - EVP_MAX_MD_SIZE - EVP_MAX_IV_LENGTH)) {
-		EVP_CIPHER_CTX_cleanup(&e_ctx);
+	if (!EVP_DecryptUpdate(st->cipher, out, &mlen, enctext, in_len - EVP_MAX_MD_SIZE - EVP_MAX_IV_LENGTH))
 		return -4;
-	}
-
-	EVP_DecryptFinal_ex(&e_ctx, out + mlen, &flen);
 
-	EVP_CIPHER_CTX_cleanup(&e_ctx);
+	if (!EVP_DecryptFinal_ex(st->cipher, out + mlen, &flen))
+		flen = 0;
 
 	return mlen + flen;
 }
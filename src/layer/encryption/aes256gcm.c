@@ -0,0 +1,360 @@
+/**
+ * @file aes256gcm.c
+ * @brief SIDP Encryption Layer - AES256-GCM Encrypt/Decrypt Interface
+ */
+
+/*
+   Secure Inter-Device Protocol Library
+
+   Copyright 2012-2014 Pedro A. Hortas (pah@ucodev.org)
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <openssl/crypto.h>
+#include <openssl/evp.h>
+
+#include "rng.h"
+
+#include "el_aes256gcm.h"
+
+/*
+ * Encrypted data layout:
+ *
+ *  [ nonce (12 bytes) | tag (16 bytes) | ciphertext (same size as plain) ]
+ *
+ * The nonce field is left out when the nonce is supplied by the caller (see
+ * el_aes256_gcm_encrypt_data_nonce()).
+ *
+ * Encryption and authentication are done in a single pass by OpenSSL, which
+ * uses AES-NI and PCLMULQDQ when the CPU supports them.
+ */
+#define EL_AES256_GCM_HDR_LEN	(EL_AES256_GCM_NONCE_LEN + EL_AES256_GCM_TAG_LEN)
+
+/* Per-connection, per-direction state: keyed cipher context */
+struct el_aes256_gcm_state {
+	unsigned char key[EL_AES256_GCM_KEY_LEN];
+	int keyed;
+	EVP_CIPHER_CTX *cipher;
+};
+
+static void el_aes256_gcm_state_destroy(void *state) {
+	struct el_aes256_gcm_state *st = state;
+
+	if (st->cipher)
+		EVP_CIPHER_CTX_free(st->cipher);
+
+	OPENSSL_cleanse(st, sizeof(struct el_aes256_gcm_state));
+
+	free(st);
+}
+
+/*
+ * Returns the state held by 'ctx', creating it if needed. The key schedule is
+ * only recomputed when 'key' differs from the one in use.
+ */
+static struct el_aes256_gcm_state *el_aes256_gcm_state_get(struct el_ctx *ctx, const unsigned char *key, int enc) {
+	struct el_aes256_gcm_state *st = ctx->state;
+
+	if (!st || (ctx->cipher_type != EL_CIPHER_TYPE_AES256_GCM)) {
+		el_ctx_destroy(ctx);
+
+		if (!(st = calloc(1, sizeof(struct el_aes256_gcm_state))))
+			return NULL;
+
+		if (!(st->cipher = EVP_CIPHER_CTX_new())) {
+			el_aes256_gcm_state_destroy(st);
+			return NULL;
+		}
+
+		ctx->cipher_type = EL_CIPHER_TYPE_AES256_GCM;
+		ctx->state = st;
+		ctx->destroy = el_aes256_gcm_state_destroy;
+	}
+
+	if (st->keyed && !memcmp(st->key, key, EL_AES256_GCM_KEY_LEN))
+		return st;
+
+	st->keyed = 0;
+
+	if (!EVP_CipherInit_ex(st->cipher, EVP_aes_256_gcm(), NULL, NULL, NULL, enc))
+		return NULL;
+
+	if (!EVP_CIPHER_CTX_ctrl(st->cipher, EVP_CTRL_GCM_SET_IVLEN, EL_AES256_GCM_NONCE_LEN, NULL))
+		return NULL;
+
+	if (!EVP_CipherInit_ex(st->cipher, NULL, NULL, key, NULL, enc))
+		return NULL;
+
+	memcpy(st->key, key, EL_AES256_GCM_KEY_LEN);
+	st->keyed = 1;
+
+	return st;
+}
+
+/**
+ * @brief AES256-GCM Initialization function.
+ * @return 0 on success, -1 on error.
+ */
+int el_aes256_gcm_init(void) {
+	/* Nothing to do */
+	return 0;
+}
+
+/**
+ * @brief AES256-GCM Create Key function
+ * @see el_aes256_gcm_encrypt_data()
+ * @see el_aes256_gcm_decrypt_data()
+ * @param key_data The data that will be used to create the key (eg. user+pass)
+ * @param key The key generated, based on key_data value
+ * @return 0 on success, -1 on error.
+ */
+int el_aes256_gcm_create_key(const unsigned char *key_data, unsigned char *key) {
+	int ret, nrounds = 5;
+	unsigned char iv[32];
+
+	ret = EVP_BytesToKey(EVP_aes_256_gcm(), EVP_sha256(), NULL, key_data, strlen((char *) key_data), nrounds, key, iv);
+
+	return -(ret != 32);
+}
+
+/**
+ * @brief AES256-GCM encrypted data size
+ * @see el_aes256_gcm_decrypt_output_len()
+ * @param plain_data_len The size of the plain-text data
+ * @return The required size for the 'out' param of the
+ * el_aes256_gcm_encrypt_data() function.
+ */
+size_t el_aes256_gcm_encrypt_output_len(size_t plain_data_len) {
+	return plain_data_len + EL_AES256_GCM_HDR_LEN;
+}
+
+/**
+ * @brief AES256-GCM decrypted data size
+ * @see el_aes256_gcm_encrypt_output_len()
+ * @param enc_data_len The size of encrypted data
+ * @return The required size for the 'out' param of the
+ * el_aes256_gcm_decrypt_data() function
+ */
+size_t el_aes256_gcm_decrypt_output_len(size_t enc_data_len) {
+	return enc_data_len - EL_AES256_GCM_HDR_LEN;
+}
+
+/**
+ * @brief AES256-GCM data encryption
+ * @see el_aes256_gcm_create_key()
+ * @see el_aes256_gcm_decrypt_data()
+ * @see el_aes256_gcm_encrypt_data_ctx()
+ * @param key The key generated by el_aes256_gcm_create_key()
+ * @param out Output buffer containing the encrypted data
+ * @param in Input buffer containing the plain-text data
+ * @param in_len The size of the plain-text data buffer
+ * @return The size of encrypted data buffer (output) or -1 on error
+ */
+int el_aes256_gcm_encrypt_data(
+		const unsigned char *key,
+		unsigned char *out,
+		const unsigned char *in,
+		size_t in_len) {
+	struct el_ctx ctx;
+	int ret;
+
+	memset(&ctx, 0, sizeof(struct el_ctx));
+
+	ret = el_aes256_gcm_encrypt_data_ctx(&ctx, key, out, in, in_len);
+
+	el_ctx_destroy(&ctx);
+
+	return ret;
+}
+
+/**
+ * @brief AES256-GCM data decryption
+ * @see el_aes256_gcm_create_key()
+ * @see el_aes256_gcm_encrypt_data()
+ * @see el_aes256_gcm_decrypt_data_ctx()
+ * @param key The key generated by el_aes256_gcm_create_key()
+ * @param out Output buffer containing the decrypted data
+ * @param in Input buffer containing the encrypted data
+ * @param in_len The size of encrypted data buffer
+ * @return The size of decrypted data buffer (output) or -1 on error
+ */
+int el_aes256_gcm_decrypt_data(
+		const unsigned char *key,
+		unsigned char *out,
+		const unsigned char *in,
+		size_t in_len) {
+	struct el_ctx ctx;
+	int ret;
+
+	memset(&ctx, 0, sizeof(struct el_ctx));
+
+	ret = el_aes256_gcm_decrypt_data_ctx(&ctx, key, out, in, in_len);
+
+	el_ctx_destroy(&ctx);
+
+	return ret;
+}
+
+/**
+ * @brief AES256-GCM data encryption, reusing the keyed cipher context kept
+ * in 'ctx' across calls
+ * @see el_aes256_gcm_encrypt_data()
+ * @param ctx Per-connection, per-direction state (zeroed before first use)
+ * @param key The key generated by el_aes256_gcm_create_key()
+ * @param out Output buffer containing the encrypted data
+ * @param in Input buffer containing the plain-text data
+ * @param in_len The size of the plain-text data buffer
+ * @return The size of encrypted data buffer (output) or -1 on error
+ */
+int el_aes256_gcm_encrypt_data_ctx(
+		struct el_ctx *ctx,
+		const unsigned char *key,
+		unsigned char *out,
+		const unsigned char *in,
+		size_t in_len) {
+	int ret;
+
+	if (sidp_rng_bytes(out, EL_AES256_GCM_NONCE_LEN) < 0)
+		return -1;
+
+	if ((ret = el_aes256_gcm_encrypt_data_nonce(ctx, key, out, out + EL_AES256_GCM_NONCE_LEN, in, in_len)) < 0)
+		return ret;
+
+	return ret + EL_AES256_GCM_NONCE_LEN;
+}
+
+/**
+ * @brief AES256-GCM data decryption, reusing the keyed cipher context kept
+ * in 'ctx' across calls
+ * @see el_aes256_gcm_decrypt_data()
+ * @param ctx Per-connection, per-direction state (zeroed before first use)
+ * @param key The key generated by el_aes256_gcm_create_key()
+ * @param out Output buffer containing the decrypted data
+ * @param in Input buffer containing the encrypted data
+ * @param in_len The size of encrypted data buffer
+ * @return The size of decrypted data buffer (output) or -1 on error
+ */
+int el_aes256_gcm_decrypt_data_ctx(
+		struct el_ctx *ctx,
+		const unsigned char *key,
+		unsigned char *out,
+		const unsigned char *in,
+		size_t in_len) {
+	if (in_len < EL_AES256_GCM_HDR_LEN)
+		return -1;
+
+	return el_aes256_gcm_decrypt_data_nonce(ctx, key, in, out, in + EL_AES256_GCM_NONCE_LEN, in_len - EL_AES256_GCM_NONCE_LEN);
+}
+
+/**
+ * @brief AES256-GCM data encryption with a caller supplied nonce. The nonce
+ * isn't written to the output, which is laid out as [tag][ciphertext].
+ * @see el_encrypt_seq()
+ * @param ctx Per-connection, per-direction state (zeroed before first use)
+ * @param key The key generated by el_aes256_gcm_create_key()
+ * @param nonce EL_AES256_GCM_NONCE_LEN bytes, never reused with the same key
+ * @param out Output buffer containing the encrypted data
+ * @param in Input buffer containing the plain-text data
+ * @param in_len The size of the plain-text data buffer
+ * @return The size of encrypted data buffer (output) or negative on error
+ */
+int el_aes256_gcm_encrypt_data_nonce(
+		struct el_ctx *ctx,
+		const unsigned char *key,
+		const unsigned char *nonce,
+		unsigned char *out,
+		const unsigned char *in,
+		size_t in_len) {
+	struct el_aes256_gcm_state *st;
+	int clen, flen;
+
+	unsigned char *tag = out;
+	unsigned char *enctext = out + EL_AES256_GCM_TAG_LEN;
+
+	if (!(st = el_aes256_gcm_state_get(ctx, key, 1)))
+		return -2;
+
+	/* Keep the key schedule, only set the nonce */
+	if (!EVP_EncryptInit_ex(st->cipher, NULL, NULL, NULL, nonce))
+		return -2;
+
+	if (!EVP_EncryptUpdate(st->cipher, enctext, &clen, in, in_len))
+		return -3;
+
+	if (!EVP_EncryptFinal_ex(st->cipher, enctext + clen, &flen))
+		return -4;
+
+	if (!EVP_CIPHER_CTX_ctrl(st->cipher, EVP_CTRL_GCM_GET_TAG, EL_AES256_GCM_TAG_LEN, tag))
+		return -5;
+
+	return clen + flen + EL_AES256_GCM_TAG_LEN;
+}
+
+/**
+ * @brief AES256-GCM data decryption with a caller supplied nonce, for data
+ * laid out as [tag][ciphertext]
+ * @see el_decrypt_seq()
+ * @param ctx Per-connection, per-direction state (zeroed before first use)
+ * @param key The key generated by el_aes256_gcm_create_key()
+ * @param nonce The EL_AES256_GCM_NONCE_LEN bytes used on encryption
+ * @param out Output buffer containing the decrypted data
+ * @param in Input buffer containing the encrypted data
+ * @param in_len The size of encrypted data buffer
+ * @return The size of decrypted data buffer (output) or negative on error
+ */
+int el_aes256_gcm_decrypt_data_nonce(
+		struct el_ctx *ctx,
+		const unsigned char *key,
+		const unsigned char *nonce,
+		unsigned char *out,
+		const unsigned char *in,
+		size_t in_len) {
+	struct el_aes256_gcm_state *st;
+	unsigned char tag[EL_AES256_GCM_TAG_LEN];
+	int mlen, flen;
+
+	const unsigned char *enctext = in + EL_AES256_GCM_TAG_LEN;
+
+	if (in_len < EL_AES256_GCM_TAG_LEN)
+		return -1;
+
+	if (!(st = el_aes256_gcm_state_get(ctx, key, 0)))
+		return -1;
+
+	/* Keep the key schedule, only set the nonce */
+	if (!EVP_DecryptInit_ex(st->cipher, NULL, NULL, NULL, nonce))
+		return -3;
+
+	if (!EVP_DecryptUpdate(st->cipher, out, &mlen, enctext, in_len - EL_AES256_GCM_TAG_LEN))
+		return -4;
+
+	memcpy(tag, in, EL_AES256_GCM_TAG_LEN);
+
+	if (!EVP_CIPHER_CTX_ctrl(st->cipher, EVP_CTRL_GCM_SET_TAG, EL_AES256_GCM_TAG_LEN, tag))
+		return -5;
+
+	/* Tag verification */
+	if (EVP_DecryptFinal_ex(st->cipher, out + mlen, &flen) <= 0) {
+		OPENSSL_cleanse(out, mlen);
+		return -2;
+	}
+
+	return mlen + flen;
+}
@@ -0,0 +1,609 @@
+/**
+ * @file chacha.c
+ * @brief SIDP Encryption Layer - ChaCha Encrypt/Decrypt Interface
+ */
+
+/*
+   Secure Inter-Device Protocol Library
+
+   Copyright 2012-2014 Pedro A. Hortas (pah@ucodev.org)
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* XXX: Get rid of openssl from chacha code asap */
+#include <openssl/crypto.h>
+#include <openssl/evp.h>
+
+
+#include <chacha/chacha.h>
+#include <nacl/crypto_onetimeauth.h>
+
+
+#include "rng.h"
+
+#include "el_chacha.h"
+#include "el_chacha_avx.h"
+#include "el_chacha_avx2.h"
+
+/*
+ * All ChaCha cipher types share the same keystream (libchacha picks the
+ * fastest kernel for the running CPU) and only differ on the wire: the
+ * ChaCha-AVX and ChaCha-AVX2 types keep their original nonce field sizes
+ * and a 32 byte authenticator field, of which the Poly1305 tag takes the
+ * first 16 bytes. They also keep keying Poly1305 with the connection key,
+ * while the ChaCha type takes a one-time key from keystream block 0.
+ */
+
+/* Packets handed to libchacha per batch call */
+#define EL_CHACHA_BATCH_LEN	16
+
+/**
+ * @brief Encrypts 'in' into 'out' and authenticates the ciphertext into 'tag'
+ * @param nonce EL_CHACHA_NONCE_LEN bytes
+ * @param mac_key The Poly1305 key
+ * @param ic The keystream block the encryption starts at
+ * @param tag_len The size of the authenticator field (the tag is zero padded)
+ * @return 0 on success, negative on error
+ */
+static int el_chacha_seal(
+		const unsigned char *key,
+		const unsigned char *nonce,
+		const unsigned char *mac_key,
+		unsigned long long ic,
+		unsigned char *tag,
+		size_t tag_len,
+		unsigned char *out,
+		const unsigned char *in,
+		size_t in_len) {
+	if (chacha_crypto_stream_xor_ic(out, in, in_len, nonce, ic, key) < 0)
+		return -2;
+
+	if (crypto_onetimeauth(tag, out, in_len, mac_key) < 0)
+		return -3;
+
+	memset(tag + crypto_onetimeauth_BYTES, 0, tag_len - crypto_onetimeauth_BYTES);
+
+	return 0;
+}
+
+/**
+ * @brief Verifies 'tag' against the ciphertext in 'in' and decrypts it into
+ * 'out'
+ * @param nonce EL_CHACHA_NONCE_LEN bytes
+ * @param mac_key The Poly1305 key
+ * @param ic The keystream block the decryption starts at
+ * @return 0 on success, negative on error
+ */
+static int el_chacha_open(
+		const unsigned char *key,
+		const unsigned char *nonce,
+		const unsigned char *mac_key,
+		unsigned long long ic,
+		const unsigned char *tag,
+		unsigned char *out,
+		const unsigned char *in,
+		size_t in_len) {
+	if (crypto_onetimeauth_verify(tag, in, in_len, mac_key) < 0)
+		return -1;
+
+	if (chacha_crypto_stream_xor_ic(out, in, in_len, nonce, ic, key) < 0)
+		return -2;
+
+	return 0;
+}
+
+/**
+ * @brief Encrypts 'in' into 'out' as [nonce][tag][ciphertext]
+ * @param nonce_len The size of the nonce field
+ * @param tag_len The size of the authenticator field
+ * @param legacy If set, Poly1305 is keyed with 'key' and the data is encrypted
+ * from keystream block 0 (the ChaCha-AVX and ChaCha-AVX2 wire format).
+ * Otherwise the Poly1305 key is taken from keystream block 0 and the data is
+ * encrypted from block 1.
+ * @return The size of encrypted data buffer (output) or negative on error
+ */
+static int el_chacha_encrypt_layout(
+		const unsigned char *key,
+		unsigned char *out,
+		const unsigned char *in,
+		size_t in_len,
+		size_t nonce_len,
+		size_t tag_len,
+		int legacy) {
+	unsigned char otk[crypto_onetimeauth_KEYBYTES];
+	int ret;
+
+	/* XXX: Get rid of openssl from chacha code asap */
+	if (sidp_rng_bytes(out, nonce_len) < 0)
+		return -1;
+
+	/* Only the first 8 bytes of the nonce field are used by the keystream */
+	if (legacy) {
+		ret = el_chacha_seal(key, out, key, 0, out + nonce_len, tag_len, out + nonce_len + tag_len, in, in_len);
+	} else {
+		if (chacha_crypto_stream(otk, sizeof(otk), out, key) < 0)
+			return -1;
+
+		ret = el_chacha_seal(key, out, otk, 1, out + nonce_len, tag_len, out + nonce_len + tag_len, in, in_len);
+
+		OPENSSL_cleanse(otk, sizeof(otk));
+	}
+
+	if (ret < 0)
+		return ret;
+
+	return in_len + nonce_len + tag_len;
+}
+
+/**
+ * @brief Verifies and decrypts a [nonce][tag][ciphertext] buffer
+ * @param nonce_len The size of the nonce field
+ * @param tag_len The size of the authenticator field
+ * @param legacy Same as on el_chacha_encrypt_layout()
+ * @return The size of decrypted data buffer (output) or negative on error
+ */
+static int el_chacha_decrypt_layout(
+		const unsigned char *key,
+		unsigned char *out,
+		const unsigned char *in,
+		size_t in_len,
+		size_t nonce_len,
+		size_t tag_len,
+		int legacy) {
+	unsigned char otk[crypto_onetimeauth_KEYBYTES];
+	int ret;
+
+	if (in_len < (nonce_len + tag_len))
+		return -1;
+
+	if (legacy) {
+		ret = el_chacha_open(key, in, key, 0, in + nonce_len, out, in + nonce_len + tag_len, in_len - nonce_len - tag_len);
+	} else {
+		if (chacha_crypto_stream(otk, sizeof(otk), in, key) < 0)
+			return -1;
+
+		ret = el_chacha_open(key, in, otk, 1, in + nonce_len, out, in + nonce_len + tag_len, in_len - nonce_len - tag_len);
+
+		OPENSSL_cleanse(otk, sizeof(otk));
+	}
+
+	if (ret < 0)
+		return ret;
+
+	return in_len - nonce_len - tag_len;
+}
+
+/**
+ * @brief ChaCha Initialization function.
+ * @return 0 on success, -1 on error.
+ */
+int el_chacha_init(void) {
+	/* Nothing to do. The kernel is selected on first use */
+	return 0;
+}
+
+/**
+ * @brief ChaCha Create Key function
+ * @see el_chacha_encrypt_data()
+ * @see el_chacha_decrypt_data()
+ * @param key_data The data that will be used to create the key (eg. user+pass)
+ * @param key The key generated, based on key_data value
+ * @return 0 on success, -1 on error.
+ */
+int el_chacha_create_key(const unsigned char *key_data, unsigned char *key) {
+	int ret, nrounds = 5;
+	unsigned char iv[32];
+
+	/* XXX: Get rid of openssl from chacha code asap */
+	ret = EVP_BytesToKey(EVP_aes_256_cbc(), EVP_sha256(), NULL, key_data, strlen((char *) key_data), nrounds, key, iv);
+
+	return -(ret != EL_CHACHA_KEY_LEN);
+}
+
+/**
+ * @brief ChaCha encrypted data size
+ * @see el_chacha_decrypt_output_len()
+ * @param plain_data_len The size of the plain-text data
+ * @return The required size for the 'out' param of the
+ * el_chacha_encrypt_data() function.
+ */
+size_t el_chacha_encrypt_output_len(size_t plain_data_len) {
+	return plain_data_len + EL_CHACHA_NONCE_LEN + EL_CHACHA_TAG_LEN;
+}
+
+/**
+ * @brief ChaCha decrypted data size
+ * @see el_chacha_encrypt_output_len()
+ * @param enc_data_len The size of encrypted data
+ * @return The required size for the 'out' param of the
+ * el_chacha_decrypt_data() function.
+ */
+size_t el_chacha_decrypt_output_len(size_t enc_data_len) {
+	return enc_data_len - (EL_CHACHA_NONCE_LEN + EL_CHACHA_TAG_LEN);
+}
+
+/**
+ * @brief ChaCha data encryption
+ * @see el_chacha_create_key()
+ * @see el_chacha_decrypt_data()
+ * @param key The key generated by el_chacha_create_key()
+ * @param out Output buffer containing the encrypted data
+ * @param in Input buffer containing the plain-text data
+ * @param in_len The size of the plain-text data buffer
+ * @return The size of encrypted data buffer (output) or negative on error
+ */
+int el_chacha_encrypt_data(
+		const unsigned char *key,
+		unsigned char *out,
+		const unsigned char *in,
+		size_t in_len) {
+	return el_chacha_encrypt_layout(key, out, in, in_len, EL_CHACHA_NONCE_LEN, EL_CHACHA_TAG_LEN, 0);
+}
+
+/**
+ * @brief ChaCha data decryption
+ * @see el_chacha_create_key()
+ * @see el_chacha_encrypt_data()
+ * @param key The key generated by el_chacha_create_key()
+ * @param out Output buffer containing the decrypted data
+ * @param in Input buffer containing the encrypted data
+ * @param in_len The size of encrypted data buffer
+ * @return The size of decrypted data buffer (output) or negative on error
+ */
+int el_chacha_decrypt_data(
+		const unsigned char *key,
+		unsigned char *out,
+		const unsigned char *in,
+		size_t in_len) {
+	return el_chacha_decrypt_layout(key, out, in, in_len, EL_CHACHA_NONCE_LEN, EL_CHACHA_TAG_LEN, 0);
+}
+
+/**
+ * @brief ChaCha data encryption with a caller supplied nonce. The nonce isn't
+ * written to the output, which is laid out as [tag][ciphertext]. Shared by
+ * the ChaCha-AVX and ChaCha-AVX2 aliases.
+ *
+ * The Poly1305 key is taken from keystream block 0 and the data is encrypted
+ * from block 1, so the tag is bound to the nonce and a packet replayed under
+ * another nonce fails authentication.
+ *
+ * @see el_encrypt_seq()
+ * @param ctx Unused (no per-connection state is kept)
+ * @param key The key generated by el_chacha_create_key()
+ * @param nonce EL_CHACHA_NONCE_LEN bytes, never reused with the same key
+ * @param out Output buffer containing the encrypted data
+ * @param in Input buffer containing the plain-text data
+ * @param in_len The size of the plain-text data buffer
+ * @return The size of encrypted data buffer (output) or negative on error
+ */
+int el_chacha_encrypt_data_nonce(
+		struct el_ctx *ctx,
+		const unsigned char *key,
+		const unsigned char *nonce,
+		unsigned char *out,
+		const unsigned char *in,
+		size_t in_len) {
+	unsigned char otk[crypto_onetimeauth_KEYBYTES];
+	int ret;
+
+	if (chacha_crypto_stream(otk, sizeof(otk), nonce, key) < 0)
+		return -1;
+
+	ret = el_chacha_seal(key, nonce, otk, 1, out, EL_CHACHA_TAG_LEN, out + EL_CHACHA_TAG_LEN, in, in_len);
+
+	OPENSSL_cleanse(otk, sizeof(otk));
+
+	if (ret < 0)
+		return ret;
+
+	return in_len + EL_CHACHA_TAG_LEN;
+}
+
+/**
+ * @brief ChaCha encryption of a batch of packets, each laid out as
+ * el_chacha_encrypt_data_nonce() does. The Poly1305 keys and the data of all
+ * the packets are encrypted with a single libchacha batch, which puts blocks
+ * of different packets side by side in the SIMD lanes. The tags are still
+ * computed one packet at a time.
+ * @see el_encrypt_seq_batch()
+ * @param jobs The packets (those with a NULL 'body' are skipped)
+ * @param njobs The number of packets
+ */
+void el_chacha_encrypt_data_nonce_batch(struct el_batch_job *jobs, unsigned int njobs) {
+	struct chacha_crypto_stream_job stream[EL_CHACHA_BATCH_LEN * 2];
+	struct el_batch_job *job[EL_CHACHA_BATCH_LEN];
+	unsigned char otk[EL_CHACHA_BATCH_LEN][crypto_onetimeauth_KEYBYTES];
+	unsigned int i = 0, j, n;
+
+	while (i < njobs) {
+		for (n = 0; (i < njobs) && (n < EL_CHACHA_BATCH_LEN); i ++) {
+			if (!jobs[i].body)
+				continue;
+
+			job[n] = &jobs[i];
+
+			/* Poly1305 key from keystream block 0 */
+			memset(otk[n], 0, sizeof(otk[n]));
+
+			stream[n * 2].out = otk[n];
+			stream[n * 2].in = otk[n];
+			stream[n * 2].inlen = sizeof(otk[n]);
+			stream[n * 2].n = jobs[i].n;
+			stream[n * 2].ic = 0;
+			stream[n * 2].k = jobs[i].key;
+
+			/* Data from block 1 */
+			stream[n * 2 + 1].out = jobs[i].body + EL_CHACHA_TAG_LEN;
+			stream[n * 2 + 1].in = jobs[i].in;
+			stream[n * 2 + 1].inlen = jobs[i].in_len;
+			stream[n * 2 + 1].n = jobs[i].n;
+			stream[n * 2 + 1].ic = 1;
+			stream[n * 2 + 1].k = jobs[i].key;
+
+			n ++;
+		}
+
+		if (chacha_crypto_stream_xor_ic_batch(stream, n * 2) < 0) {
+			for (j = 0; j < n; j ++)
+				job[j]->ret = -2;
+		} else {
+			for (j = 0; j < n; j ++) {
+				if (crypto_onetimeauth(job[j]->body, job[j]->body + EL_CHACHA_TAG_LEN, job[j]->in_len, otk[j]) < 0) {
+					job[j]->ret = -3;
+				} else {
+					job[j]->ret = job[j]->in_len + EL_CHACHA_TAG_LEN;
+				}
+			}
+		}
+
+		OPENSSL_cleanse(otk, sizeof(otk));
+	}
+}
+
+/**
+ * @brief Precomputes the ChaCha keystream of a packet encrypted by
+ * el_chacha_encrypt_data_nonce(): block 0 (the Poly1305 key) and the blocks
+ * the data starts with
+ * @see el_precompute_seq()
+ * @param key The key generated by el_chacha_create_key()
+ * @param nonce The nonce the packet will be sent with
+ * @param ks The keystream slot to be filled
+ * @return 0 on success, negative on error
+ */
+int el_chacha_keystream(
+		const unsigned char *key,
+		const unsigned char *nonce,
+		struct el_keystream *ks) {
+	return -(chacha_crypto_stream(ks->ks, EL_KEYSTREAM_LEN, nonce, key) < 0);
+}
+
+/**
+ * @brief Same as el_chacha_encrypt_data_nonce(), from the keystream
+ * precomputed by el_chacha_keystream(). Data past the precomputed keystream is
+ * encrypted as usual.
+ * @see el_encrypt_seq()
+ * @param ks The precomputed keystream of 'nonce'
+ * @param key The key generated by el_chacha_create_key()
+ * @param nonce EL_CHACHA_NONCE_LEN bytes, never reused with the same key
+ * @param out Output buffer containing the encrypted data
+ * @param in Input buffer containing the plain-text data
+ * @param in_len The size of the plain-text data buffer
+ * @return The size of encrypted data buffer (output) or negative on error
+ */
+int el_chacha_encrypt_data_keystream(
+		const struct el_keystream *ks,
+		const unsigned char *key,
+		const unsigned char *nonce,
+		unsigned char *out,
+		const unsigned char *in,
+		size_t in_len) {
+	size_t pre = EL_KEYSTREAM_LEN - EL_KEYSTREAM_BLOCK_LEN;
+
+	if (in_len < pre)
+		pre = in_len;
+
+	el_keystream_xor(out + EL_CHACHA_TAG_LEN, in, ks->ks + EL_KEYSTREAM_BLOCK_LEN, pre);
+
+	if ((in_len > pre) && (chacha_crypto_stream_xor_ic(out + EL_CHACHA_TAG_LEN + pre, in + pre, in_len - pre, nonce, EL_KEYSTREAM_LEN / EL_KEYSTREAM_BLOCK_LEN, key) < 0))
+		return -2;
+
+	if (crypto_onetimeauth(out, out + EL_CHACHA_TAG_LEN, in_len, ks->ks) < 0)
+		return -3;
+
+	return in_len + EL_CHACHA_TAG_LEN;
+}
+
+/**
+ * @brief ChaCha data decryption with a caller supplied nonce, for data laid
+ * out as [tag][ciphertext]
+ * @see el_decrypt_seq()
+ * @param ctx Unused (no per-connection state is kept)
+ * @param key The key generated by el_chacha_create_key()
+ * @param nonce The EL_CHACHA_NONCE_LEN bytes used on encryption
+ * @param out Output buffer containing the decrypted data
+ * @param in Input buffer containing the encrypted data
+ * @param in_len The size of encrypted data buffer
+ * @return The size of decrypted data buffer (output) or negative on error
+ */
+int el_chacha_decrypt_data_nonce(
+		struct el_ctx *ctx,
+		const unsigned char *key,
+		const unsigned char *nonce,
+		unsigned char *out,
+		const unsigned char *in,
+		size_t in_len) {
+	unsigned char otk[crypto_onetimeauth_KEYBYTES];
+	int ret;
+
+	if (in_len < EL_CHACHA_TAG_LEN)
+		return -1;
+
+	if (chacha_crypto_stream(otk, sizeof(otk), nonce, key) < 0)
+		return -1;
+
+	ret = el_chacha_open(key, nonce, otk, 1, in, out, in + EL_CHACHA_TAG_LEN, in_len - EL_CHACHA_TAG_LEN);
+
+	OPENSSL_cleanse(otk, sizeof(otk));
+
+	if (ret < 0)
+		return ret;
+
+	return in_len - EL_CHACHA_TAG_LEN;
+}
+
+/**
+ * @brief ChaCha-AVX Initialization function (alias of el_chacha_init()).
+ * @return 0 on success, -1 on error.
+ */
+int el_chacha_avx_init(void) {
+	return el_chacha_init();
+}
+
+/**
+ * @brief ChaCha-AVX Create Key function (alias of el_chacha_create_key()).
+ * @param key_data The data that will be used to create the key (eg. user+pass)
+ * @param key The key generated, based on key_data value
+ * @return 0 on success, -1 on error.
+ */
+int el_chacha_avx_create_key(const unsigned char *key_data, unsigned char *key) {
+	return el_chacha_create_key(key_data, key);
+}
+
+/**
+ * @brief ChaCha-AVX encrypted data size
+ * @param plain_data_len The size of the plain-text data
+ * @return The required size for the 'out' param of the
+ * el_chacha_avx_encrypt_data() function.
+ */
+size_t el_chacha_avx_encrypt_output_len(size_t plain_data_len) {
+	return plain_data_len + EL_CHACHA_AVX_NONCE_LEN + EL_CHACHA_AVX_TAG_LEN;
+}
+
+/**
+ * @brief ChaCha-AVX decrypted data size
+ * @param enc_data_len The size of encrypted data
+ * @return The required size for the 'out' param of the
+ * el_chacha_avx_decrypt_data() function.
+ */
+size_t el_chacha_avx_decrypt_output_len(size_t enc_data_len) {
+	return enc_data_len - (EL_CHACHA_AVX_NONCE_LEN + EL_CHACHA_AVX_TAG_LEN);
+}
+
+/**
+ * @brief ChaCha-AVX data encryption (ChaCha-AVX wire layout)
+ * @param key The key generated by el_chacha_avx_create_key()
+ * @param out Output buffer containing the encrypted data
+ * @param in Input buffer containing the plain-text data
+ * @param in_len The size of the plain-text data buffer
+ * @return The size of encrypted data buffer (output) or negative on error
+ */
+int el_chacha_avx_encrypt_data(
+		const unsigned char *key,
+		unsigned char *out,
+		const unsigned char *in,
+		size_t in_len) {
+	return el_chacha_encrypt_layout(key, out, in, in_len, EL_CHACHA_AVX_NONCE_LEN, EL_CHACHA_AVX_TAG_LEN, 1);
+}
+
+/**
+ * @brief ChaCha-AVX data decryption (ChaCha-AVX wire layout)
+ * @param key The key generated by el_chacha_avx_create_key()
+ * @param out Output buffer containing the decrypted data
+ * @param in Input buffer containing the encrypted data
+ * @param in_len The size of encrypted data buffer
+ * @return The size of decrypted data buffer (output) or negative on error
+ */
+int el_chacha_avx_decrypt_data(
+		const unsigned char *key,
+		unsigned char *out,
+		const unsigned char *in,
+		size_t in_len) {
+	return el_chacha_decrypt_layout(key, out, in, in_len, EL_CHACHA_AVX_NONCE_LEN, EL_CHACHA_AVX_TAG_LEN, 1);
+}
+
+/**
+ * @brief ChaCha-AVX2 Initialization function (alias of el_chacha_init()).
+ * @return 0 on success, -1 on error.
+ */
+int el_chacha_avx2_init(void) {
+	return el_chacha_init();
+}
+
+/**
+ * @brief ChaCha-AVX2 Create Key function (alias of el_chacha_create_key()).
+ * @param key_data The data that will be used to create the key (eg. user+pass)
+ * @param key The key generated, based on key_data value
+ * @return 0 on success, -1 on error.
+ */
+int el_chacha_avx2_create_key(const unsigned char *key_data, unsigned char *key) {
+	return el_chacha_create_key(key_data, key);
+}
+
+/**
+ * @brief ChaCha-AVX2 encrypted data size
+ * @param plain_data_len The size of the plain-text data
+ * @return The required size for the 'out' param of the
+ * el_chacha_avx2_encrypt_data() function.
+ */
+size_t el_chacha_avx2_encrypt_output_len(size_t plain_data_len) {
+	return plain_data_len + EL_CHACHA_AVX2_NONCE_LEN + EL_CHACHA_AVX_TAG_LEN;
+}
+
+/**
+ * @brief ChaCha-AVX2 decrypted data size
+ * @param enc_data_len The size of encrypted data
+ * @return The required size for the 'out' param of the
+ * el_chacha_avx2_decrypt_data() function.
+ */
+size_t el_chacha_avx2_decrypt_output_len(size_t enc_data_len) {
+	return enc_data_len - (EL_CHACHA_AVX2_NONCE_LEN + EL_CHACHA_AVX_TAG_LEN);
+}
+
+/**
+ * @brief ChaCha-AVX2 data encryption (ChaCha-AVX2 wire layout)
+ * @param key The key generated by el_chacha_avx2_create_key()
+ * @param out Output buffer containing the encrypted data
+ * @param in Input buffer containing the plain-text data
+ * @param in_len The size of the plain-text data buffer
+ * @return The size of encrypted data buffer (output) or negative on error
+ */
+int el_chacha_avx2_encrypt_data(
+		const unsigned char *key,
+		unsigned char *out,
+		const unsigned char *in,
+		size_t in_len) {
+	return el_chacha_encrypt_layout(key, out, in, in_len, EL_CHACHA_AVX2_NONCE_LEN, EL_CHACHA_AVX_TAG_LEN, 1);
+}
+
+/**
+ * @brief ChaCha-AVX2 data decryption (ChaCha-AVX2 wire layout)
+ * @param key The key generated by el_chacha_avx2_create_key()
+ * @param out Output buffer containing the decrypted data
+ * @param in Input buffer containing the encrypted data
+ * @param in_len The size of encrypted data buffer
+ * @return The size of decrypted data buffer (output) or negative on error
+ */
+int el_chacha_avx2_decrypt_data(
+		const unsigned char *key,
+		unsigned char *out,
+		const unsigned char *in,
+		size_t in_len) {
+	return el_chacha_decrypt_layout(key, out, in, in_len, EL_CHACHA_AVX2_NONCE_LEN, EL_CHACHA_AVX_TAG_LEN, 1);
+}
+
@@ -0,0 +1,244 @@
+/**
+ * @file chacha20poly1305.c
+ * @brief SIDP Encryption Layer - ChaCha20-Poly1305 Encrypt/Decrypt Interface
+ */
+
+/*
+   Secure Inter-Device Protocol Library
+
+   Copyright 2012-2014 Pedro A. Hortas (pah@ucodev.org)
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <openssl/evp.h>
+
+#include <chacha/chacha.h>
+
+#include "rng.h"
+
+#include "el_chacha20poly1305.h"
+
+/*
+ * Encrypted data layout:
+ *
+ *  [ nonce (12 bytes) | tag (16 bytes) | ciphertext (same size as plain) ]
+ *
+ * The nonce field is left out when the nonce is supplied by the caller (see
+ * el_chacha20_poly1305_encrypt_data_nonce()).
+ *
+ * This is the RFC 8439 AEAD, with no associated data: the Poly1305 key is
+ * taken from keystream block 0 of each nonce, and libchacha MACs every chunk
+ * of ciphertext right after encrypting it, while it is still in L1, instead
+ * of going over the whole packet a second time.
+ */
+#define EL_CHACHA20_POLY1305_HDR_LEN	(EL_CHACHA20_POLY1305_NONCE_LEN + EL_CHACHA20_POLY1305_TAG_LEN)
+
+/* Packets handed to libchacha per batch call */
+#define EL_CHACHA20_POLY1305_BATCH_LEN	32
+
+/**
+ * @brief ChaCha20-Poly1305 Initialization function.
+ * @return 0 on success, -1 on error.
+ */
+int el_chacha20_poly1305_init(void) {
+	/* Nothing to do. The kernel is selected on first use */
+	return 0;
+}
+
+/**
+ * @brief ChaCha20-Poly1305 Create Key function
+ * @see el_chacha20_poly1305_encrypt_data()
+ * @see el_chacha20_poly1305_decrypt_data()
+ * @param key_data The data that will be used to create the key (eg. user+pass)
+ * @param key The key generated, based on key_data value
+ * @return 0 on success, -1 on error.
+ */
+int el_chacha20_poly1305_create_key(const unsigned char *key_data, unsigned char *key) {
+	int ret, nrounds = 5;
+	unsigned char iv[32];
+
+	ret = EVP_BytesToKey(EVP_aes_256_cbc(), EVP_sha256(), NULL, key_data, strlen((char *) key_data), nrounds, key, iv);
+
+	return -(ret != EL_CHACHA20_POLY1305_KEY_LEN);
+}
+
+/**
+ * @brief ChaCha20-Poly1305 encrypted data size
+ * @see el_chacha20_poly1305_decrypt_output_len()
+ * @param plain_data_len The size of the plain-text data
+ * @return The required size for the 'out' param of the
+ * el_chacha20_poly1305_encrypt_data() function.
+ */
+size_t el_chacha20_poly1305_encrypt_output_len(size_t plain_data_len) {
+	return plain_data_len + EL_CHACHA20_POLY1305_HDR_LEN;
+}
+
+/**
+ * @brief ChaCha20-Poly1305 decrypted data size
+ * @see el_chacha20_poly1305_encrypt_output_len()
+ * @param enc_data_len The size of encrypted data
+ * @return The required size for the 'out' param of the
+ * el_chacha20_poly1305_decrypt_data() function.
+ */
+size_t el_chacha20_poly1305_decrypt_output_len(size_t enc_data_len) {
+	return enc_data_len - EL_CHACHA20_POLY1305_HDR_LEN;
+}
+
+/**
+ * @brief ChaCha20-Poly1305 data encryption
+ * @see el_chacha20_poly1305_create_key()
+ * @see el_chacha20_poly1305_decrypt_data()
+ * @param key The key generated by el_chacha20_poly1305_create_key()
+ * @param out Output buffer containing the encrypted data
+ * @param in Input buffer containing the plain-text data
+ * @param in_len The size of the plain-text data buffer
+ * @return The size of encrypted data buffer (output) or negative on error
+ */
+int el_chacha20_poly1305_encrypt_data(
+		const unsigned char *key,
+		unsigned char *out,
+		const unsigned char *in,
+		size_t in_len) {
+	int ret;
+
+	if (sidp_rng_bytes(out, EL_CHACHA20_POLY1305_NONCE_LEN) < 0)
+		return -1;
+
+	if ((ret = el_chacha20_poly1305_encrypt_data_nonce(NULL, key, out, out + EL_CHACHA20_POLY1305_NONCE_LEN, in, in_len)) < 0)
+		return ret;
+
+	return ret + EL_CHACHA20_POLY1305_NONCE_LEN;
+}
+
+/**
+ * @brief ChaCha20-Poly1305 data decryption
+ * @see el_chacha20_poly1305_create_key()
+ * @see el_chacha20_poly1305_encrypt_data()
+ * @param key The key generated by el_chacha20_poly1305_create_key()
+ * @param out Output buffer containing the decrypted data
+ * @param in Input buffer containing the encrypted data
+ * @param in_len The size of encrypted data buffer
+ * @return The size of decrypted data buffer (output) or negative on error
+ */
+int el_chacha20_poly1305_decrypt_data(
+		const unsigned char *key,
+		unsigned char *out,
+		const unsigned char *in,
+		size_t in_len) {
+	if (in_len < EL_CHACHA20_POLY1305_HDR_LEN)
+		return -1;
+
+	return el_chacha20_poly1305_decrypt_data_nonce(NULL, key, in, out, in + EL_CHACHA20_POLY1305_NONCE_LEN, in_len - EL_CHACHA20_POLY1305_NONCE_LEN);
+}
+
+/**
+ * @brief ChaCha20-Poly1305 data encryption with a caller supplied nonce. The
+ * nonce isn't written to the output, which is laid out as [tag][ciphertext].
+ * @see el_encrypt_seq()
+ * @param ctx Unused (no per-connection state is kept)
+ * @param key The key generated by el_chacha20_poly1305_create_key()
+ * @param nonce EL_CHACHA20_POLY1305_NONCE_LEN bytes, never reused with the
+ * same key
+ * @param out Output buffer containing the encrypted data
+ * @param in Input buffer containing the plain-text data
+ * @param in_len The size of the plain-text data buffer
+ * @return The size of encrypted data buffer (output) or negative on error
+ */
+int el_chacha20_poly1305_encrypt_data_nonce(
+		struct el_ctx *ctx,
+		const unsigned char *key,
+		const unsigned char *nonce,
+		unsigned char *out,
+		const unsigned char *in,
+		size_t in_len) {
+	if (chacha_crypto_aead_encrypt(out + EL_CHACHA20_POLY1305_TAG_LEN, out, in, in_len, NULL, 0, nonce, key) < 0)
+		return -2;
+
+	return in_len + EL_CHACHA20_POLY1305_TAG_LEN;
+}
+
+/**
+ * @brief ChaCha20-Poly1305 data decryption with a caller supplied nonce, for
+ * data laid out as [tag][ciphertext]
+ * @see el_decrypt_seq()
+ * @param ctx Unused (no per-connection state is kept)
+ * @param key The key generated by el_chacha20_poly1305_create_key()
+ * @param nonce The EL_CHACHA20_POLY1305_NONCE_LEN bytes used on encryption
+ * @param out Output buffer containing the decrypted data
+ * @param in Input buffer containing the encrypted data
+ * @param in_len The size of encrypted data buffer
+ * @return The size of decrypted data buffer (output) or negative on error
+ */
+int el_chacha20_poly1305_decrypt_data_nonce(
+		struct el_ctx *ctx,
+		const unsigned char *key,
+		const unsigned char *nonce,
+		unsigned char *out,
+		const unsigned char *in,
+		size_t in_len) {
+	if (in_len < EL_CHACHA20_POLY1305_TAG_LEN)
+		return -1;
+
+	/* Tag verification */
+	if (chacha_crypto_aead_decrypt(out, in + EL_CHACHA20_POLY1305_TAG_LEN, in_len - EL_CHACHA20_POLY1305_TAG_LEN, in, NULL, 0, nonce, key) < 0)
+		return -2;
+
+	return in_len - EL_CHACHA20_POLY1305_TAG_LEN;
+}
+
+/**
+ * @brief ChaCha20-Poly1305 encryption of a batch of packets, each laid out as
+ * el_chacha20_poly1305_encrypt_data_nonce() does. libchacha fills the lanes
+ * of its keystream and Poly1305 kernels with the blocks of different packets.
+ * @see el_encrypt_seq_batch()
+ * @param jobs The packets (those with a NULL 'body' are skipped)
+ * @param njobs The number of packets
+ */
+void el_chacha20_poly1305_encrypt_data_nonce_batch(struct el_batch_job *jobs, unsigned int njobs) {
+	struct chacha_crypto_aead_job aead[EL_CHACHA20_POLY1305_BATCH_LEN];
+	struct el_batch_job *job[EL_CHACHA20_POLY1305_BATCH_LEN];
+	unsigned int i = 0, j, n;
+
+	while (i < njobs) {
+		for (n = 0; (i < njobs) && (n < EL_CHACHA20_POLY1305_BATCH_LEN); i ++) {
+			if (!jobs[i].body)
+				continue;
+
+			job[n] = &jobs[i];
+
+			aead[n].out = jobs[i].body + EL_CHACHA20_POLY1305_TAG_LEN;
+			aead[n].tag = jobs[i].body;
+			aead[n].in = jobs[i].in;
+			aead[n].inlen = jobs[i].in_len;
+			aead[n].ad = NULL;
+			aead[n].adlen = 0;
+			aead[n].n = jobs[i].n;
+			aead[n].k = jobs[i].key;
+
+			n ++;
+		}
+
+		chacha_crypto_aead_encrypt_batch(aead, n);
+
+		for (j = 0; j < n; j ++)
+			job[j]->ret = (aead[j].ret < 0) ? -2 : (int) (job[j]->in_len + EL_CHACHA20_POLY1305_TAG_LEN);
+	}
+}
+
@@ -23,24 +23,43 @@
 
 
 #include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
 #include <string.h>
 
+#include <openssl/crypto.h>
+
+#include "rng.h"
+
 #include "el_aes256cbc.h"
+#include "el_aes256gcm.h"
 #if !defined(NO_XSALSA20)
 #include "el_xsalsa20.h"
 #endif
+#if !defined(NO_CHACHA)
+#include "el_chacha.h"
+#endif
 #if !defined(NO_CHACHA_AVX)
 #include "el_chacha_avx.h"
 #endif
 #if !defined(NO_CHACHA_AVX2)
 #include "el_chacha_avx2.h"
 #endif
+#if !defined(NO_CHACHA20_POLY1305)
+#include "el_chacha20poly1305.h"
+#endif
+#include "el_null.h"
 #include "el_api.h"
 
 /**
  * @brief Encryption Layer interface initializer
  * @see EL_CIPHER_TYPE_AES256
+ * @see EL_CIPHER_TYPE_AES256_GCM
  * @see EL_CIPHER_TYPE_XSALSA20
+ * @see EL_CIPHER_TYPE_CHACHA
+ * @see EL_CIPHER_TYPE_CHACHA20_POLY1305
+ * @see EL_CIPHER_TYPE_NONE
+ * @see EL_CIPHER_TYPE_NONE_MAC
  * @see el_data
  * @param eld A 'struct el_data' to be initialized
  * @param cipher_type The type of cipher to be used (e.g. AES256, XSalsa20, etc)
@@ -49,6 +68,8 @@
 int el_data_init(struct el_data *eld, int cipher_type) {
 	memset(eld, 0, sizeof(struct el_data));
 
+	eld->cipher_type = cipher_type;
+
 	if (cipher_type == EL_CIPHER_TYPE_AES256) {
 		eld->init = el_aes256_init;
 		eld->create_key = el_aes256_create_key;
@@ -56,6 +77,22 @@ int el_data_init(struct el_data *eld, int cipher_type) {
 		eld->decrypt_output_len = el_aes256_decrypt_output_len;
 		eld->encrypt = el_aes256_encrypt_data;
 		eld->decrypt = el_aes256_decrypt_data;
+		eld->encrypt_ctx = el_aes256_encrypt_data_ctx;
+		eld->decrypt_ctx = el_aes256_decrypt_data_ctx;
+
+		return eld->init();
+	} else if (cipher_type == EL_CIPHER_TYPE_AES256_GCM) {
+		eld->init = el_aes256_gcm_init;
+		eld->create_key = el_aes256_gcm_create_key;
+		eld->encrypt_output_len = el_aes256_gcm_encrypt_output_len;
+		eld->decrypt_output_len = el_aes256_gcm_decrypt_output_len;
+		eld->encrypt = el_aes256_gcm_encrypt_data;
+		eld->decrypt = el_aes256_gcm_decrypt_data;
+		eld->encrypt_ctx = el_aes256_gcm_encrypt_data_ctx;
+		eld->decrypt_ctx = el_aes256_gcm_decrypt_data_ctx;
+		eld->nonce_len = EL_AES256_GCM_NONCE_LEN;
+		eld->encrypt_nonce = el_aes256_gcm_encrypt_data_nonce;
+		eld->decrypt_nonce = el_aes256_gcm_decrypt_data_nonce;
 
 		return eld->init();
 #if !defined(NO_XSALSA20)
@@ -66,6 +103,44 @@ int el_data_init(struct el_data *eld, int cipher_type) {
 		eld->decrypt_output_len = el_xsalsa20_decrypt_output_len;
 		eld->encrypt = el_xsalsa20_encrypt_data;
 		eld->decrypt = el_xsalsa20_decrypt_data;
+		eld->nonce_len = EL_XSALSA20_NONCE_LEN;
+		eld->encrypt_nonce = el_xsalsa20_encrypt_data_nonce;
+		eld->decrypt_nonce = el_xsalsa20_decrypt_data_nonce;
+		eld->encrypt_nonce_batch = el_xsalsa20_encrypt_data_nonce_batch;
+		eld->keystream = el_xsalsa20_keystream;
+		eld->encrypt_keystream = el_xsalsa20_encrypt_data_keystream;
+
+		return eld->init();
+#endif
+#if !defined(NO_CHACHA)
+	} else if (cipher_type == EL_CIPHER_TYPE_CHACHA) {
+		eld->init = el_chacha_init;
+		eld->create_key = el_chacha_create_key;
+		eld->encrypt_output_len = el_chacha_encrypt_output_len;
+		eld->decrypt_output_len = el_chacha_decrypt_output_len;
+		eld->encrypt = el_chacha_encrypt_data;
+		eld->decrypt = el_chacha_decrypt_data;
+		eld->nonce_len = EL_CHACHA_NONCE_LEN;
+		eld->encrypt_nonce = el_chacha_encrypt_data_nonce;
+		eld->decrypt_nonce = el_chacha_decrypt_data_nonce;
+		eld->encrypt_nonce_batch = el_chacha_encrypt_data_nonce_batch;
+		eld->keystream = el_chacha_keystream;
+		eld->encrypt_keystream = el_chacha_encrypt_data_keystream;
+
+		return eld->init();
+#endif
+#if !defined(NO_CHACHA20_POLY1305)
+	} else if (cipher_type == EL_CIPHER_TYPE_CHACHA20_POLY1305) {
+		eld->init = el_chacha20_poly1305_init;
+		eld->create_key = el_chacha20_poly1305_create_key;
+		eld->encrypt_output_len = el_chacha20_poly1305_encrypt_output_len;
+		eld->decrypt_output_len = el_chacha20_poly1305_decrypt_output_len;
+		eld->encrypt = el_chacha20_poly1305_encrypt_data;
+		eld->decrypt = el_chacha20_poly1305_decrypt_data;
+		eld->nonce_len = EL_CHACHA20_POLY1305_NONCE_LEN;
+		eld->encrypt_nonce = el_chacha20_poly1305_encrypt_data_nonce;
+		eld->decrypt_nonce = el_chacha20_poly1305_decrypt_data_nonce;
+		eld->encrypt_nonce_batch = el_chacha20_poly1305_encrypt_data_nonce_batch;
 
 		return eld->init();
 #endif
@@ -77,6 +152,12 @@ int el_data_init(struct el_data *eld, int cipher_type) {
 		eld->decrypt_output_len = el_chacha_avx_decrypt_output_len;
 		eld->encrypt = el_chacha_avx_encrypt_data;
 		eld->decrypt = el_chacha_avx_decrypt_data;
+		eld->nonce_len = EL_CHACHA_NONCE_LEN;
+		eld->encrypt_nonce = el_chacha_encrypt_data_nonce;
+		eld->decrypt_nonce = el_chacha_decrypt_data_nonce;
+		eld->encrypt_nonce_batch = el_chacha_encrypt_data_nonce_batch;
+		eld->keystream = el_chacha_keystream;
+		eld->encrypt_keystream = el_chacha_encrypt_data_keystream;
 
 		return eld->init();
 #endif
@@ -88,11 +169,426 @@ int el_data_init(struct el_data *eld, int cipher_type) {
 		eld->decrypt_output_len = el_chacha_avx2_decrypt_output_len;
 		eld->encrypt = el_chacha_avx2_encrypt_data;
 		eld->decrypt = el_chacha_avx2_decrypt_data;
+		eld->nonce_len = EL_CHACHA_NONCE_LEN;
+		eld->encrypt_nonce = el_chacha_encrypt_data_nonce;
+		eld->decrypt_nonce = el_chacha_decrypt_data_nonce;
+		eld->encrypt_nonce_batch = el_chacha_encrypt_data_nonce_batch;
+		eld->keystream = el_chacha_keystream;
+		eld->encrypt_keystream = el_chacha_encrypt_data_keystream;
 
 		return eld->init();
 #endif
+	} else if (cipher_type == EL_CIPHER_TYPE_NONE) {
+		eld->init = el_null_init;
+		eld->create_key = el_null_create_key;
+		eld->encrypt_output_len = el_null_encrypt_output_len;
+		eld->decrypt_output_len = el_null_decrypt_output_len;
+		eld->encrypt = el_null_encrypt_data;
+		eld->decrypt = el_null_decrypt_data;
+
+		return eld->init();
+	} else if (cipher_type == EL_CIPHER_TYPE_NONE_MAC) {
+		eld->init = el_null_init;
+		eld->create_key = el_null_create_key;
+		eld->encrypt_output_len = el_null_mac_encrypt_output_len;
+		eld->decrypt_output_len = el_null_mac_decrypt_output_len;
+		eld->encrypt = el_null_mac_encrypt_data;
+		eld->decrypt = el_null_mac_decrypt_data;
+		eld->nonce_len = EL_NULL_MAC_NONCE_LEN;
+		eld->encrypt_nonce = el_null_mac_encrypt_data_nonce;
+		eld->decrypt_nonce = el_null_mac_decrypt_data_nonce;
+
+		return eld->init();
 	}
 
 	return -1;
 }
 
+/**
+ * @brief Releases the per-connection cipher state held by an el_ctx
+ * @see el_ctx
+ * @param ctx The 'struct el_ctx' to be released. It's left zeroed and may be
+ * reused.
+ */
+void el_ctx_destroy(struct el_ctx *ctx) {
+	if (ctx->state && ctx->destroy)
+		ctx->destroy(ctx->state);
+
+	if (ctx->ks) {
+		OPENSSL_cleanse(ctx->ks, sizeof(struct el_keystream) * EL_KEYSTREAM_SLOTS);
+		free(ctx->ks);
+	}
+
+	memset(ctx, 0, sizeof(struct el_ctx));
+}
+
+
+/**
+ * @brief Builds the nonce of packet 'seq' of a counter nonce sequence
+ * @param nonce The counter nonce sequence
+ * @param seq The packet counter
+ * @param n Output buffer for the packet nonce
+ * @param nonce_len The nonce size of the cipher in use (8 bytes at least)
+ */
+static void el_nonce_build_seq(const struct el_nonce *nonce, uint64_t seq, unsigned char *n, size_t nonce_len) {
+	int i;
+
+	memcpy(n, nonce->base, nonce_len);
+
+	/* XOR the big-endian packet counter into the last 8 bytes */
+	for (i = 0; i < 8; i ++)
+		n[nonce_len - 1 - i] ^= (unsigned char) (seq >> (i * 8));
+}
+
+/**
+ * @brief Builds the nonce of the current packet of a counter nonce sequence
+ * @param nonce The counter nonce sequence
+ * @param n Output buffer for the packet nonce
+ * @param nonce_len The nonce size of the cipher in use (8 bytes at least)
+ */
+static void el_nonce_build(const struct el_nonce *nonce, unsigned char *n, size_t nonce_len) {
+	el_nonce_build_seq(nonce, nonce->seq, n, nonce_len);
+}
+
+/**
+ * @brief Checks if the keystream slot 'ks' was precomputed for packet nonce
+ * 'n' under 'key' with the cipher of 'eld'. The key or the cipher of a
+ * connection may change between the precomputation and the packet being sent
+ * (e.g. sidp_conn_set_key() or a renegotiation), in which case the slot is
+ * stale.
+ * @param ks The keystream slot
+ * @param eld The Encryption Layer interface in use
+ * @param key The encryption key
+ * @param n The packet nonce
+ * @return 1 if the keystream may be used, 0 otherwise
+ */
+static int el_keystream_match(const struct el_keystream *ks, const struct el_data *eld, const unsigned char *key, const unsigned char *n) {
+	if (!ks->valid || (ks->cipher_type != eld->cipher_type))
+		return 0;
+
+	if (CRYPTO_memcmp(ks->key, key, EL_KEYSTREAM_KEY_LEN))
+		return 0;
+
+	return !CRYPTO_memcmp(ks->n, n, eld->nonce_len);
+}
+
+/**
+ * @brief Wipes the keystream slot of packet 'seq', once its counter is
+ * consumed, whether the keystream was used or not
+ * @param ctx Per-connection outgoing cipher state
+ * @param seq The packet counter
+ */
+static void el_keystream_consume(struct el_ctx *ctx, uint64_t seq) {
+	if (ctx && ctx->ks)
+		OPENSSL_cleanse(&ctx->ks[seq % EL_KEYSTREAM_SLOTS], sizeof(struct el_keystream));
+}
+
+/**
+ * @brief Encrypted data size when using a counter nonce sequence
+ * @see el_encrypt_seq()
+ * @param eld The Encryption Layer interface in use
+ * @param plain_data_len The size of the plain-text data
+ * @return The required size for the 'out' param of el_encrypt_seq(). This is
+ * an upper bound: only the first packet carries the nonce base.
+ */
+size_t el_encrypt_seq_output_len(const struct el_data *eld, size_t plain_data_len) {
+	return eld->encrypt_output_len(plain_data_len) + EL_NONCE_BASE_LEN;
+}
+
+/**
+ * @brief Data encryption with an implicit counter nonce
+ *
+ * The first packet of the sequence draws a random nonce base and carries it
+ * as [base][tag][ciphertext]. Every following packet is sent as
+ * [tag][ciphertext], with its nonce derived from the base and the packet
+ * counter, so no random data is required on the packet path.
+ *
+ * @see el_decrypt_seq()
+ * @param eld The Encryption Layer interface in use (must set encrypt_nonce)
+ * @param ctx Per-connection, per-direction cipher state
+ * @param nonce Per-connection, per-direction nonce sequence (zeroed before
+ * first use)
+ * @param key The encryption key
+ * @param out Output buffer, el_encrypt_seq_output_len() bytes long
+ * @param in Input buffer containing the plain-text data
+ * @param in_len The size of the plain-text data buffer
+ * @return The size of encrypted data buffer (output) or negative on error
+ */
+int el_encrypt_seq(
+		const struct el_data *eld,
+		struct el_ctx *ctx,
+		struct el_nonce *nonce,
+		const unsigned char *key,
+		unsigned char *out,
+		const unsigned char *in,
+		size_t in_len) {
+	unsigned char n[EL_NONCE_BASE_LEN];
+	struct el_keystream *ks;
+	size_t base_len = 0;
+	int ret;
+
+	if (!eld->encrypt_nonce)
+		return -1;
+
+	/* A nonce sequence is never wrapped */
+	if (nonce->seq == UINT64_MAX)
+		return -1;
+
+	if (!nonce->seq) {
+		if (sidp_rng_bytes(nonce->base, EL_NONCE_BASE_LEN) < 0)
+			return -1;
+
+		memcpy(out, nonce->base, EL_NONCE_BASE_LEN);
+		base_len = EL_NONCE_BASE_LEN;
+	}
+
+	el_nonce_build(nonce, n, eld->nonce_len);
+
+	/* Use the keystream precomputed for this packet, if any */
+	ks = ctx->ks ? &ctx->ks[nonce->seq % EL_KEYSTREAM_SLOTS] : NULL;
+
+	if (ks && eld->encrypt_keystream && el_keystream_match(ks, eld, key, n)) {
+		ret = eld->encrypt_keystream(ks, key, n, out + base_len, in, in_len);
+	} else {
+		ret = eld->encrypt_nonce(ctx, key, n, out + base_len, in, in_len);
+	}
+
+	el_keystream_consume(ctx, nonce->seq);
+
+	if (ret < 0)
+		return ret;
+
+	nonce->seq ++;
+
+	return ret + base_len;
+}
+
+/**
+ * @brief el_encrypt_seq() of several packets at once
+ *
+ * Short packets leave most lanes of the SIMD kernels idle when encrypted one
+ * at a time. Ciphers that set encrypt_nonce_batch encrypt the packets of the
+ * batch together, a block of a different packet per lane; the others have
+ * them encrypted one by one.
+ *
+ * Jobs may share a nonce sequence (several packets of the same connection),
+ * in which case they're given consecutive counters in the order they appear
+ * in 'jobs'. The counter of a packet is consumed even if its encryption
+ * fails, so a connection with a failed job must not send any further packet
+ * of the batch (nor of the sequence).
+ *
+ * @see el_encrypt_seq()
+ * @param eld The Encryption Layer interface in use (must set encrypt_nonce)
+ * @param jobs The packets, with 'ret' set on return to what el_encrypt_seq()
+ * would have returned for each of them
+ * @param njobs The number of packets
+ * @return 0 if all the packets were encrypted, -1 otherwise
+ */
+int el_encrypt_seq_batch(
+		const struct el_data *eld,
+		struct el_batch_job *jobs,
+		unsigned int njobs) {
+	struct el_batch_job *job;
+	unsigned int i;
+	int ret = 0;
+
+	if (!eld->encrypt_nonce)
+		return -1;
+
+	for (i = 0; i < njobs; i ++) {
+		job = &jobs[i];
+		job->body = NULL;
+		job->ret = -1;
+
+		if (job->nonce->seq == UINT64_MAX)
+			continue;
+
+		job->body = job->out;
+
+		if (!job->nonce->seq) {
+			if (sidp_rng_bytes(job->nonce->base, EL_NONCE_BASE_LEN) < 0) {
+				job->body = NULL;
+				continue;
+			}
+
+			memcpy(job->out, job->nonce->base, EL_NONCE_BASE_LEN);
+			job->body += EL_NONCE_BASE_LEN;
+		}
+
+		el_nonce_build(job->nonce, job->n, eld->nonce_len);
+
+		/* Batched packets don't use the precomputed keystream */
+		el_keystream_consume(job->ctx, job->nonce->seq);
+
+		job->nonce->seq ++;
+	}
+
+	if (eld->encrypt_nonce_batch) {
+		eld->encrypt_nonce_batch(jobs, njobs);
+	} else {
+		for (i = 0; i < njobs; i ++) {
+			job = &jobs[i];
+
+			if (job->body)
+				job->ret = eld->encrypt_nonce(job->ctx, job->key, job->n, job->body, job->in, job->in_len);
+		}
+	}
+
+	for (i = 0; i < njobs; i ++) {
+		job = &jobs[i];
+
+		if (!job->body || job->ret < 0) {
+			ret = -1;
+			continue;
+		}
+
+		job->ret += job->body - job->out;
+	}
+
+	return ret;
+}
+
+/**
+ * @brief Precomputes the keystream of the next 'npkts' packets of a counter
+ * nonce sequence
+ *
+ * Meant to be called while the connection is idle: el_encrypt_seq() then
+ * encrypts a packet whose keystream is ready with a XOR, leaving only the
+ * Poly1305 tag to be computed on the packet path. A precomputed keystream is
+ * only used if the packet is sent with the same 'key' and cipher type, and is
+ * wiped once the packet counter is consumed or on el_ctx_destroy().
+ *
+ * Nothing is precomputed before the first packet of the sequence (its nonce
+ * base is only drawn when it's sent), nor for ciphers without a keystream
+ * hook.
+ *
+ * @see el_encrypt_seq()
+ * @param eld The Encryption Layer interface in use
+ * @param ctx Per-connection outgoing cipher state, which keeps the keystream
+ * @param nonce Per-connection outgoing nonce sequence
+ * @param key The encryption key
+ * @param npkts The number of upcoming packets (EL_KEYSTREAM_SLOTS at most)
+ * @return The number of packets whose keystream was computed (0 if they were
+ * all ready already), or negative on error
+ */
+int el_precompute_seq(
+		const struct el_data *eld,
+		struct el_ctx *ctx,
+		const struct el_nonce *nonce,
+		const unsigned char *key,
+		unsigned int npkts) {
+	unsigned char n[EL_NONCE_BASE_LEN];
+	struct el_keystream *ks;
+	uint64_t seq;
+	unsigned int i;
+	int count = 0;
+
+	if (!eld->keystream || !eld->encrypt_keystream || !nonce->seq)
+		return 0;
+
+	if (npkts > EL_KEYSTREAM_SLOTS)
+		npkts = EL_KEYSTREAM_SLOTS;
+
+	if (!ctx->ks && !(ctx->ks = calloc(EL_KEYSTREAM_SLOTS, sizeof(struct el_keystream))))
+		return -1;
+
+	for (i = 0, seq = nonce->seq; (i < npkts) && (seq != UINT64_MAX); i ++, seq ++) {
+		ks = &ctx->ks[seq % EL_KEYSTREAM_SLOTS];
+
+		el_nonce_build_seq(nonce, seq, n, eld->nonce_len);
+
+		if (el_keystream_match(ks, eld, key, n))
+			continue;
+
+		if (eld->keystream(key, n, ks) < 0) {
+			OPENSSL_cleanse(ks, sizeof(struct el_keystream));
+			return -1;
+		}
+
+		ks->cipher_type = eld->cipher_type;
+		memcpy(ks->key, key, EL_KEYSTREAM_KEY_LEN);
+		memcpy(ks->n, n, eld->nonce_len);
+		ks->valid = 1;
+
+		count ++;
+	}
+
+	return count;
+}
+
+/**
+ * @brief XORs 'len' bytes of 'in' with keystream 'ks' into 'out'
+ * @see el_keystream
+ * @param out Output buffer (may be 'in')
+ * @param in Input buffer
+ * @param ks Keystream
+ * @param len Number of bytes
+ */
+void el_keystream_xor(unsigned char *out, const unsigned char *in, const unsigned char *ks, size_t len) {
+	uint64_t w, k;
+	size_t i = 0;
+
+	for (; (i + 8) <= len; i += 8) {
+		memcpy(&w, in + i, 8);
+		memcpy(&k, ks + i, 8);
+		w ^= k;
+		memcpy(out + i, &w, 8);
+	}
+
+	for (; i < len; i ++)
+		out[i] = in[i] ^ ks[i];
+}
+
+/**
+ * @brief Data decryption with an implicit counter nonce
+ *
+ * The expected packet counter is kept by the receiver, so a replayed,
+ * reordered or dropped packet is decrypted with the wrong nonce and fails
+ * authentication. The sequence is only advanced on success.
+ *
+ * @see el_encrypt_seq()
+ * @param eld The Encryption Layer interface in use (must set decrypt_nonce)
+ * @param ctx Per-connection, per-direction cipher state
+ * @param nonce Per-connection, per-direction nonce sequence (zeroed before
+ * first use)
+ * @param key The encryption key
+ * @param out Output buffer containing the decrypted data
+ * @param in Input buffer containing the encrypted data
+ * @param in_len The size of encrypted data buffer
+ * @return The size of decrypted data buffer (output) or negative on error
+ */
+int el_decrypt_seq(
+		const struct el_data *eld,
+		struct el_ctx *ctx,
+		struct el_nonce *nonce,
+		const unsigned char *key,
+		unsigned char *out,
+		const unsigned char *in,
+		size_t in_len) {
+	unsigned char n[EL_NONCE_BASE_LEN];
+	size_t base_len = 0;
+	int ret;
+
+	if (!eld->decrypt_nonce)
+		return -1;
+
+	if (nonce->seq == UINT64_MAX)
+		return -1;
+
+	if (!nonce->seq) {
+		if (in_len < EL_NONCE_BASE_LEN)
+			return -1;
+
+		memcpy(nonce->base, in, EL_NONCE_BASE_LEN);
+		base_len = EL_NONCE_BASE_LEN;
+	}
+
+	el_nonce_build(nonce, n, eld->nonce_len);
+
+	if ((ret = eld->decrypt_nonce(ctx, key, n, out, in + base_len, in_len - base_len)) < 0)
+		return ret;
+
+	nonce->seq ++;
+
+	return ret;
+}
@@ -0,0 +1,436 @@
+/**
+ * @file null.c
+ * @brief SIDP Encryption Layer - Integrity-only (null) cipher types
+ */
+
+/*
+   Secure Inter-Device Protocol Library
+
+   Copyright 2012-2014 Pedro A. Hortas (pah@ucodev.org)
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <openssl/crypto.h>
+#include <openssl/evp.h>
+
+#include <nacl/crypto_stream.h>
+#include <nacl/crypto_onetimeauth.h>
+
+#include "rng.h"
+
+#include "el_null.h"
+
+/*
+ * Null cipher types, for links that are already private (loopback, or
+ * tunnels that encrypt on their own). The data is sent in the clear:
+ *
+ *  EL_CIPHER_TYPE_NONE:
+ *   [ crc32c (4 bytes, big-endian) | data ]
+ *
+ *  EL_CIPHER_TYPE_NONE_MAC:
+ *   [ nonce (24 bytes) | tag (16 bytes) | data ]
+ *
+ * CRC32C only detects corruption. The keyed variant also detects tampering:
+ * the Poly1305 key of each packet is the first 32 bytes of the XSalsa20
+ * keystream of its nonce, so the nonce field is left out with counter nonces
+ * (see el_encrypt_seq()).
+ */
+
+#if defined(__GNUC__) && (__GNUC__ >= 5) && defined(__x86_64__) && !defined(EL_NULL_NO_SSE42)
+ #include <nmmintrin.h>
+ #define EL_NULL_CRC32C_SSE42	1
+#endif
+
+/* CRC32C (Castagnoli, reflected polynomial 0x82f63b78) */
+static const uint32_t el_null_crc32c_table[256] = {
+	0x00000000, 0xf26b8303, 0xe13b70f7, 0x1350f3f4, 0xc79a971f, 0x35f1141c,
+	0x26a1e7e8, 0xd4ca64eb, 0x8ad958cf, 0x78b2dbcc, 0x6be22838, 0x9989ab3b,
+	0x4d43cfd0, 0xbf284cd3, 0xac78bf27, 0x5e133c24, 0x105ec76f, 0xe235446c,
+	0xf165b798, 0x030e349b, 0xd7c45070, 0x25afd373, 0x36ff2087, 0xc494a384,
+	0x9a879fa0, 0x68ec1ca3, 0x7bbcef57, 0x89d76c54, 0x5d1d08bf, 0xaf768bbc,
+	0xbc267848, 0x4e4dfb4b, 0x20bd8ede, 0xd2d60ddd, 0xc186fe29, 0x33ed7d2a,
+	0xe72719c1, 0x154c9ac2, 0x061c6936, 0xf477ea35, 0xaa64d611, 0x580f5512,
+	0x4b5fa6e6, 0xb93425e5, 0x6dfe410e, 0x9f95c20d, 0x8cc531f9, 0x7eaeb2fa,
+	0x30e349b1, 0xc288cab2, 0xd1d83946, 0x23b3ba45, 0xf779deae, 0x05125dad,
+	0x1642ae59, 0xe4292d5a, 0xba3a117e, 0x4851927d, 0x5b016189, 0xa96ae28a,
+	0x7da08661, 0x8fcb0562, 0x9c9bf696, 0x6ef07595, 0x417b1dbc, 0xb3109ebf,
+	0xa0406d4b, 0x522bee48, 0x86e18aa3, 0x748a09a0, 0x67dafa54, 0x95b17957,
+	0xcba24573, 0x39c9c670, 0x2a993584, 0xd8f2b687, 0x0c38d26c, 0xfe53516f,
+	0xed03a29b, 0x1f682198, 0x5125dad3, 0xa34e59d0, 0xb01eaa24, 0x42752927,
+	0x96bf4dcc, 0x64d4cecf, 0x77843d3b, 0x85efbe38, 0xdbfc821c, 0x2997011f,
+	0x3ac7f2eb, 0xc8ac71e8, 0x1c661503, 0xee0d9600, 0xfd5d65f4, 0x0f36e6f7,
+	0x61c69362, 0x93ad1061, 0x80fde395, 0x72966096, 0xa65c047d, 0x5437877e,
+	0x4767748a, 0xb50cf789, 0xeb1fcbad, 0x197448ae, 0x0a24bb5a, 0xf84f3859,
+	0x2c855cb2, 0xdeeedfb1, 0xcdbe2c45, 0x3fd5af46, 0x7198540d, 0x83f3d70e,
+	0x90a324fa, 0x62c8a7f9, 0xb602c312, 0x44694011, 0x5739b3e5, 0xa55230e6,
+	0xfb410cc2, 0x092a8fc1, 0x1a7a7c35, 0xe811ff36, 0x3cdb9bdd, 0xceb018de,
+	0xdde0eb2a, 0x2f8b6829, 0x82f63b78, 0x709db87b, 0x63cd4b8f, 0x91a6c88c,
+	0x456cac67, 0xb7072f64, 0xa457dc90, 0x563c5f93, 0x082f63b7, 0xfa44e0b4,
+	0xe9141340, 0x1b7f9043, 0xcfb5f4a8, 0x3dde77ab, 0x2e8e845f, 0xdce5075c,
+	0x92a8fc17, 0x60c37f14, 0x73938ce0, 0x81f80fe3, 0x55326b08, 0xa759e80b,
+	0xb4091bff, 0x466298fc, 0x1871a4d8, 0xea1a27db, 0xf94ad42f, 0x0b21572c,
+	0xdfeb33c7, 0x2d80b0c4, 0x3ed04330, 0xccbbc033, 0xa24bb5a6, 0x502036a5,
+	0x4370c551, 0xb11b4652, 0x65d122b9, 0x97baa1ba, 0x84ea524e, 0x7681d14d,
+	0x2892ed69, 0xdaf96e6a, 0xc9a99d9e, 0x3bc21e9d, 0xef087a76, 0x1d63f975,
+	0x0e330a81, 0xfc588982, 0xb21572c9, 0x407ef1ca, 0x532e023e, 0xa145813d,
+	0x758fe5d6, 0x87e466d5, 0x94b49521, 0x66df1622, 0x38cc2a06, 0xcaa7a905,
+	0xd9f75af1, 0x2b9cd9f2, 0xff56bd19, 0x0d3d3e1a, 0x1e6dcdee, 0xec064eed,
+	0xc38d26c4, 0x31e6a5c7, 0x22b65633, 0xd0ddd530, 0x0417b1db, 0xf67c32d8,
+	0xe52cc12c, 0x1747422f, 0x49547e0b, 0xbb3ffd08, 0xa86f0efc, 0x5a048dff,
+	0x8ecee914, 0x7ca56a17, 0x6ff599e3, 0x9d9e1ae0, 0xd3d3e1ab, 0x21b862a8,
+	0x32e8915c, 0xc083125f, 0x144976b4, 0xe622f5b7, 0xf5720643, 0x07198540,
+	0x590ab964, 0xab613a67, 0xb831c993, 0x4a5a4a90, 0x9e902e7b, 0x6cfbad78,
+	0x7fab5e8c, 0x8dc0dd8f, 0xe330a81a, 0x115b2b19, 0x020bd8ed, 0xf0605bee,
+	0x24aa3f05, 0xd6c1bc06, 0xc5914ff2, 0x37faccf1, 0x69e9f0d5, 0x9b8273d6,
+	0x88d28022, 0x7ab90321, 0xae7367ca, 0x5c18e4c9, 0x4f48173d, 0xbd23943e,
+	0xf36e6f75, 0x0105ec76, 0x12551f82, 0xe03e9c81, 0x34f4f86a, 0xc69f7b69,
+	0xd5cf889d, 0x27a40b9e, 0x79b737ba, 0x8bdcb4b9, 0x988c474d, 0x6ae7c44e,
+	0xbe2da0a5, 0x4c4623a6, 0x5f16d052, 0xad7d5351
+};
+
+/**
+ * @brief Copies 'len' bytes from 'in' into 'out' while computing their
+ * CRC32C, one byte at a time
+ * @param crc The CRC32C of the preceding data (pre-inverted)
+ * @return The updated CRC32C (pre-inverted)
+ */
+static uint32_t el_null_crc32c_copy_ref(uint32_t crc, unsigned char *out, const unsigned char *in, size_t len) {
+	size_t i;
+
+	for (i = 0; i < len; i ++) {
+		out[i] = in[i];
+		crc = el_null_crc32c_table[(crc ^ in[i]) & 0xff] ^ (crc >> 8);
+	}
+
+	return crc;
+}
+
+#ifdef EL_NULL_CRC32C_SSE42
+/**
+ * @brief SSE4.2 version of el_null_crc32c_copy_ref(), 8 bytes per crc32
+ * instruction
+ */
+static __attribute__((target("sse4.2"))) uint32_t el_null_crc32c_copy_sse42(uint32_t crc, unsigned char *out, const unsigned char *in, size_t len) {
+	uint64_t c = crc, w;
+
+	for (; len >= 8; len -= 8, in += 8, out += 8) {
+		memcpy(&w, in, 8);
+		memcpy(out, &w, 8);
+		c = _mm_crc32_u64(c, w);
+	}
+
+	for (crc = c; len; len --)
+		crc = _mm_crc32_u8(crc, (*out ++ = *in ++));
+
+	return crc;
+}
+#endif
+
+/**
+ * @brief Copies 'len' bytes from 'in' into 'out' and returns their CRC32C
+ */
+static uint32_t el_null_crc32c_copy(unsigned char *out, const unsigned char *in, size_t len) {
+#ifdef EL_NULL_CRC32C_SSE42
+	if (__builtin_cpu_supports("sse4.2"))
+		return ~el_null_crc32c_copy_sse42(~0U, out, in, len);
+#endif
+
+	return ~el_null_crc32c_copy_ref(~0U, out, in, len);
+}
+
+/**
+ * @brief Computes the Poly1305 tag of 'in' keyed by 'key' and 'nonce'
+ * @param nonce EL_NULL_MAC_NONCE_LEN bytes, never reused with the same key
+ * @param tag EL_NULL_MAC_TAG_LEN bytes
+ * @return 0 on success, negative on error
+ */
+static int el_null_mac_tag(
+		const unsigned char *key,
+		const unsigned char *nonce,
+		unsigned char *tag,
+		const unsigned char *in,
+		size_t in_len) {
+	unsigned char otk[crypto_onetimeauth_KEYBYTES] = { 0 };
+	int ret = 0;
+
+	if (crypto_stream_xor(otk, otk, sizeof(otk), nonce, key) < 0)
+		return -1;
+
+	if (crypto_onetimeauth(tag, in, in_len, otk) < 0)
+		ret = -1;
+
+	OPENSSL_cleanse(otk, sizeof(otk));
+
+	return ret;
+}
+
+/**
+ * @brief Verifies the Poly1305 tag of 'in' keyed by 'key' and 'nonce'
+ * @return 0 if 'tag' is valid, negative otherwise
+ */
+static int el_null_mac_verify(
+		const unsigned char *key,
+		const unsigned char *nonce,
+		const unsigned char *tag,
+		const unsigned char *in,
+		size_t in_len) {
+	unsigned char otk[crypto_onetimeauth_KEYBYTES] = { 0 };
+	int ret = 0;
+
+	if (crypto_stream_xor(otk, otk, sizeof(otk), nonce, key) < 0)
+		return -1;
+
+	if (crypto_onetimeauth_verify(tag, in, in_len, otk) < 0)
+		ret = -1;
+
+	OPENSSL_cleanse(otk, sizeof(otk));
+
+	return ret;
+}
+
+/**
+ * @brief Null cipher Initialization function.
+ * @return 0 on success, -1 on error.
+ */
+int el_null_init(void) {
+	/* Nothing to do */
+	return 0;
+}
+
+/**
+ * @brief Null cipher Create Key function. The key is only used by the keyed
+ * variant (EL_CIPHER_TYPE_NONE_MAC).
+ * @param key_data The data that will be used to create the key (eg. user+pass)
+ * @param key The key generated, based on key_data value
+ * @return 0 on success, -1 on error.
+ */
+int el_null_create_key(const unsigned char *key_data, unsigned char *key) {
+	int ret, nrounds = 5;
+	unsigned char iv[32];
+
+	ret = EVP_BytesToKey(EVP_aes_256_cbc(), EVP_sha256(), NULL, key_data, strlen((char *) key_data), nrounds, key, iv);
+
+	return -(ret != EL_NULL_KEY_LEN);
+}
+
+/**
+ * @brief Null cipher (CRC32C) output data size
+ * @see el_null_decrypt_output_len()
+ * @param plain_data_len The size of the plain-text data
+ * @return The required size for the 'out' param of the
+ * el_null_encrypt_data() function.
+ */
+size_t el_null_encrypt_output_len(size_t plain_data_len) {
+	return plain_data_len + EL_NULL_CRC_LEN;
+}
+
+/**
+ * @brief Null cipher (CRC32C) data size
+ * @see el_null_encrypt_output_len()
+ * @param enc_data_len The size of the checksummed data
+ * @return The required size for the 'out' param of the
+ * el_null_decrypt_data() function.
+ */
+size_t el_null_decrypt_output_len(size_t enc_data_len) {
+	return enc_data_len - EL_NULL_CRC_LEN;
+}
+
+/**
+ * @brief Null cipher (CRC32C): copies 'in' into 'out', prefixed by its
+ * checksum
+ * @see el_null_decrypt_data()
+ * @param key Unused
+ * @param out Output buffer containing the checksummed data
+ * @param in Input buffer containing the plain-text data
+ * @param in_len The size of the plain-text data buffer
+ * @return The size of the output buffer or negative on error
+ */
+int el_null_encrypt_data(
+		const unsigned char *key,
+		unsigned char *out,
+		const unsigned char *in,
+		size_t in_len) {
+	uint32_t crc = el_null_crc32c_copy(out + EL_NULL_CRC_LEN, in, in_len);
+
+	out[0] = crc >> 24;
+	out[1] = crc >> 16;
+	out[2] = crc >> 8;
+	out[3] = crc;
+
+	return in_len + EL_NULL_CRC_LEN;
+}
+
+/**
+ * @brief Null cipher (CRC32C): verifies the checksum of 'in' while copying
+ * its data into 'out'
+ * @see el_null_encrypt_data()
+ * @param key Unused
+ * @param out Output buffer containing the plain-text data
+ * @param in Input buffer containing the checksummed data
+ * @param in_len The size of the input buffer
+ * @return The size of plain-text data buffer (output) or negative on error
+ */
+int el_null_decrypt_data(
+		const unsigned char *key,
+		unsigned char *out,
+		const unsigned char *in,
+		size_t in_len) {
+	uint32_t crc;
+
+	if (in_len < EL_NULL_CRC_LEN)
+		return -1;
+
+	crc = el_null_crc32c_copy(out, in + EL_NULL_CRC_LEN, in_len - EL_NULL_CRC_LEN);
+
+	if (crc != (((uint32_t) in[0] << 24) | ((uint32_t) in[1] << 16) | ((uint32_t) in[2] << 8) | in[3]))
+		return -2;
+
+	return in_len - EL_NULL_CRC_LEN;
+}
+
+/**
+ * @brief Keyed null cipher output data size
+ * @see el_null_mac_decrypt_output_len()
+ * @param plain_data_len The size of the plain-text data
+ * @return The required size for the 'out' param of the
+ * el_null_mac_encrypt_data() function.
+ */
+size_t el_null_mac_encrypt_output_len(size_t plain_data_len) {
+	return plain_data_len + EL_NULL_MAC_NONCE_LEN + EL_NULL_MAC_TAG_LEN;
+}
+
+/**
+ * @brief Keyed null cipher data size
+ * @see el_null_mac_encrypt_output_len()
+ * @param enc_data_len The size of the authenticated data
+ * @return The required size for the 'out' param of the
+ * el_null_mac_decrypt_data() function.
+ */
+size_t el_null_mac_decrypt_output_len(size_t enc_data_len) {
+	return enc_data_len - (EL_NULL_MAC_NONCE_LEN + EL_NULL_MAC_TAG_LEN);
+}
+
+/**
+ * @brief Keyed null cipher: copies 'in' into 'out', authenticated with a
+ * random nonce
+ * @see el_null_create_key()
+ * @see el_null_mac_decrypt_data()
+ * @param key The key generated by el_null_create_key()
+ * @param out Output buffer, laid out as [nonce][tag][data]
+ * @param in Input buffer containing the plain-text data
+ * @param in_len The size of the plain-text data buffer
+ * @return The size of the output buffer or negative on error
+ */
+int el_null_mac_encrypt_data(
+		const unsigned char *key,
+		unsigned char *out,
+		const unsigned char *in,
+		size_t in_len) {
+	int ret;
+
+	if (sidp_rng_bytes(out, EL_NULL_MAC_NONCE_LEN) < 0)
+		return -1;
+
+	if ((ret = el_null_mac_encrypt_data_nonce(NULL, key, out, out + EL_NULL_MAC_NONCE_LEN, in, in_len)) < 0)
+		return ret;
+
+	return ret + EL_NULL_MAC_NONCE_LEN;
+}
+
+/**
+ * @brief Keyed null cipher: verifies a [nonce][tag][data] buffer and copies
+ * its data into 'out'
+ * @see el_null_create_key()
+ * @see el_null_mac_encrypt_data()
+ * @param key The key generated by el_null_create_key()
+ * @param out Output buffer containing the plain-text data
+ * @param in Input buffer containing the authenticated data
+ * @param in_len The size of the input buffer
+ * @return The size of plain-text data buffer (output) or negative on error
+ */
+int el_null_mac_decrypt_data(
+		const unsigned char *key,
+		unsigned char *out,
+		const unsigned char *in,
+		size_t in_len) {
+	if (in_len < EL_NULL_MAC_NONCE_LEN)
+		return -1;
+
+	return el_null_mac_decrypt_data_nonce(NULL, key, in, out, in + EL_NULL_MAC_NONCE_LEN, in_len - EL_NULL_MAC_NONCE_LEN);
+}
+
+/**
+ * @brief Keyed null cipher with a caller supplied nonce. The nonce isn't
+ * written to the output, which is laid out as [tag][data].
+ * @see el_encrypt_seq()
+ * @param ctx Unused (no per-connection state is kept)
+ * @param key The key generated by el_null_create_key()
+ * @param nonce EL_NULL_MAC_NONCE_LEN bytes, never reused with the same key
+ * @param out Output buffer containing the authenticated data
+ * @param in Input buffer containing the plain-text data
+ * @param in_len The size of the plain-text data buffer
+ * @return The size of the output buffer or negative on error
+ */
+int el_null_mac_encrypt_data_nonce(
+		struct el_ctx *ctx,
+		const unsigned char *key,
+		const unsigned char *nonce,
+		unsigned char *out,
+		const unsigned char *in,
+		size_t in_len) {
+	if (el_null_mac_tag(key, nonce, out, in, in_len) < 0)
+		return -2;
+
+	memcpy(out + EL_NULL_MAC_TAG_LEN, in, in_len);
+
+	return in_len + EL_NULL_MAC_TAG_LEN;
+}
+
+/**
+ * @brief Keyed null cipher with a caller supplied nonce, for data laid out as
+ * [tag][data]
+ * @see el_decrypt_seq()
+ * @param ctx Unused (no per-connection state is kept)
+ * @param key The key generated by el_null_create_key()
+ * @param nonce The EL_NULL_MAC_NONCE_LEN bytes used on encryption
+ * @param out Output buffer containing the plain-text data
+ * @param in Input buffer containing the authenticated data
+ * @param in_len The size of the input buffer
+ * @return The size of plain-text data buffer (output) or negative on error
+ */
+int el_null_mac_decrypt_data_nonce(
+		struct el_ctx *ctx,
+		const unsigned char *key,
+		const unsigned char *nonce,
+		unsigned char *out,
+		const unsigned char *in,
+		size_t in_len) {
+	if (in_len < EL_NULL_MAC_TAG_LEN)
+		return -1;
+
+	if (el_null_mac_verify(key, nonce, in, in + EL_NULL_MAC_TAG_LEN, in_len - EL_NULL_MAC_TAG_LEN) < 0)
+		return -2;
+
+	memcpy(out, in + EL_NULL_MAC_TAG_LEN, in_len - EL_NULL_MAC_TAG_LEN);
+
+	return in_len - EL_NULL_MAC_TAG_LEN;
+}
+
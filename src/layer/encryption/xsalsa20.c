@@ -27,15 +27,72 @@
 #include <string.h>
 
 /* XXX: Get rid of openssl from xsalsa20 code asap */
+#include <openssl/crypto.h>
 #include <openssl/evp.h>
-#include <openssl/rand.h>
 
 
 #include <nacl/crypto_stream.h>
 #include <nacl/crypto_onetimeauth.h>
 
+#include "rng.h"
+
 #include "el_xsalsa20.h"
 
+/* Packets handed to nacl per batch call */
+#define EL_XSALSA20_BATCH_LEN	16
+
+/**
+ * @brief Encrypts 'in' into 'out' and authenticates the ciphertext into 'tag'
+ * @param nonce crypto_stream_NONCEBYTES bytes
+ * @param mac_key The Poly1305 key
+ * @param ic The keystream block the encryption starts at
+ * @param tag EL_XSALSA20_TAG_LEN bytes
+ * @return 0 on success, negative on error
+ */
+static int el_xsalsa20_seal(
+		const unsigned char *key,
+		const unsigned char *nonce,
+		const unsigned char *mac_key,
+		unsigned long long ic,
+		unsigned char *tag,
+		unsigned char *out,
+		const unsigned char *in,
+		size_t in_len) {
+	if (crypto_stream_xor_ic(out, in, in_len, nonce, ic, key) < 0)
+		return -2;
+
+	if (crypto_onetimeauth(tag, out, in_len, mac_key) < 0)
+		return -3;
+
+	return 0;
+}
+
+/**
+ * @brief Verifies 'tag' against the ciphertext in 'in' and decrypts it into
+ * 'out'
+ * @param nonce crypto_stream_NONCEBYTES bytes
+ * @param mac_key The Poly1305 key
+ * @param ic The keystream block the decryption starts at
+ * @param tag EL_XSALSA20_TAG_LEN bytes
+ * @return 0 on success, negative on error
+ */
+static int el_xsalsa20_open(
+		const unsigned char *key,
+		const unsigned char *nonce,
+		const unsigned char *mac_key,
+		unsigned long long ic,
+		const unsigned char *tag,
+		unsigned char *out,
+		const unsigned char *in,
+		size_t in_len) {
+	if (crypto_onetimeauth_verify(tag, in, in_len, mac_key) < 0)
+		return -1;
+
+	if (crypto_stream_xor_ic(out, in, in_len, nonce, ic, key) < 0)
+		return -2;
+
+	return 0;
+}
 
 /**
  * @brief XSalsa20 Initialization function.
@@ -101,21 +158,16 @@ int el_xsalsa20_encrypt_data(
 		unsigned char *out,
 		const unsigned char *in,
 		size_t in_len) {
-	unsigned char a[crypto_onetimeauth_KEYBYTES];
-	unsigned char n[crypto_stream_NONCEBYTES];
+	int ret;
 
-	/* XXX: Get rid of openssl from xsalsa20 code asap */
-	if (!RAND_bytes(n, crypto_stream_NONCEBYTES))
+	if (sidp_rng_bytes(out, crypto_stream_NONCEBYTES) < 0)
 		return -1;
 
-	if (crypto_stream_xor(out + crypto_stream_NONCEBYTES + crypto_onetimeauth_KEYBYTES, in, in_len, n, key) < 0)
-		return -2;
-
-	if (crypto_onetimeauth(a, out + crypto_stream_NONCEBYTES + crypto_onetimeauth_KEYBYTES, in_len, key) < 0)
-		return -3;
+	if ((ret = el_xsalsa20_seal(key, out, key, 0, out + crypto_stream_NONCEBYTES, out + crypto_stream_NONCEBYTES + crypto_onetimeauth_KEYBYTES, in, in_len)) < 0)
+		return ret;
 
-	memcpy(out, n, crypto_stream_NONCEBYTES);
-	memcpy(out + crypto_stream_NONCEBYTES, a, crypto_onetimeauth_KEYBYTES);
+	/* The authenticator field is larger than the tag */
+	memset(out + crypto_stream_NONCEBYTES + EL_XSALSA20_TAG_LEN, 0, crypto_onetimeauth_KEYBYTES - EL_XSALSA20_TAG_LEN);
 
 	return in_len + crypto_stream_NONCEBYTES + crypto_onetimeauth_KEYBYTES;
 }
@@ -135,18 +187,211 @@ int el_xsalsa20_decrypt_data(
 		unsigned char *out,
 		const unsigned char *in,
 		size_t in_len) {
-	unsigned char a[crypto_onetimeauth_KEYBYTES];
-	unsigned char n[crypto_stream_NONCEBYTES];
+	int ret;
+
+	if (in_len < (crypto_stream_NONCEBYTES + crypto_onetimeauth_KEYBYTES))
+		return -1;
+
+	if ((ret = el_xsalsa20_open(key, in, key, 0, in + crypto_stream_NONCEBYTES, out, in + crypto_stream_NONCEBYTES + crypto_onetimeauth_KEYBYTES, in_len - crypto_stream_NONCEBYTES - crypto_onetimeauth_KEYBYTES)) < 0)
+		return ret;
 
-	memcpy(n, in, crypto_stream_NONCEBYTES);
-	memcpy(a, in + crypto_stream_NONCEBYTES, crypto_onetimeauth_KEYBYTES);
+	return in_len - crypto_stream_NONCEBYTES - crypto_onetimeauth_KEYBYTES;
+}
 
-	if (crypto_onetimeauth_verify(a, in + crypto_stream_NONCEBYTES + crypto_onetimeauth_KEYBYTES, in_len - crypto_stream_NONCEBYTES - crypto_onetimeauth_KEYBYTES, key) < 0)
+/**
+ * @brief XSalsa20 data encryption with a caller supplied nonce. The nonce
+ * isn't written to the output, which is laid out as [tag][ciphertext].
+ *
+ * Like crypto_secretbox, the one-time Poly1305 key comes from the first
+ * keystream block (here the data starts at block 1), tying the tag to the
+ * nonce.
+ *
+ * @see el_encrypt_seq()
+ * @param ctx Unused (no per-connection state is kept)
+ * @param key The key generated by el_xsalsa20_create_key()
+ * @param nonce EL_XSALSA20_NONCE_LEN bytes, never reused with the same key
+ * @param out Output buffer containing the encrypted data
+ * @param in Input buffer containing the plain-text data
+ * @param in_len The size of the plain-text data buffer
+ * @return The size of encrypted data buffer (output) or negative on error
+ */
+int el_xsalsa20_encrypt_data_nonce(
+		struct el_ctx *ctx,
+		const unsigned char *key,
+		const unsigned char *nonce,
+		unsigned char *out,
+		const unsigned char *in,
+		size_t in_len) {
+	unsigned char otk[crypto_onetimeauth_KEYBYTES];
+	int ret;
+
+	memset(otk, 0, sizeof(otk));
+
+	if (crypto_stream_xor(otk, otk, sizeof(otk), nonce, key) < 0)
 		return -1;
 
-	if (crypto_stream_xor(out, in + crypto_stream_NONCEBYTES + crypto_onetimeauth_KEYBYTES, in_len - crypto_stream_NONCEBYTES - crypto_onetimeauth_KEYBYTES, n, key) < 0)
+	ret = el_xsalsa20_seal(key, nonce, otk, 1, out, out + EL_XSALSA20_TAG_LEN, in, in_len);
+
+	OPENSSL_cleanse(otk, sizeof(otk));
+
+	if (ret < 0)
+		return ret;
+
+	return in_len + EL_XSALSA20_TAG_LEN;
+}
+
+/**
+ * @brief XSalsa20 encryption of a batch of packets, each laid out as
+ * el_xsalsa20_encrypt_data_nonce() does. The subkeys, Poly1305 keys and data
+ * of all the packets go through a single nacl batch, which fills the lanes of
+ * the Salsa20 kernel with blocks of different packets. The tags are still
+ * computed one packet at a time.
+ * @see el_encrypt_seq_batch()
+ * @param jobs The packets (those with a NULL 'body' are skipped)
+ * @param njobs The number of packets
+ */
+void el_xsalsa20_encrypt_data_nonce_batch(struct el_batch_job *jobs, unsigned int njobs) {
+	struct crypto_stream_job stream[EL_XSALSA20_BATCH_LEN * 2];
+	struct el_batch_job *job[EL_XSALSA20_BATCH_LEN];
+	unsigned char otk[EL_XSALSA20_BATCH_LEN][crypto_onetimeauth_KEYBYTES];
+	unsigned int i = 0, j, n;
+
+	while (i < njobs) {
+		for (n = 0; (i < njobs) && (n < EL_XSALSA20_BATCH_LEN); i ++) {
+			if (!jobs[i].body)
+				continue;
+
+			job[n] = &jobs[i];
+
+			/* Both jobs of a packet point to the same nonce and key, so nacl
+			 * derives their subkey once */
+			memset(otk[n], 0, sizeof(otk[n]));
+
+			stream[n * 2].c = otk[n];
+			stream[n * 2].m = otk[n];
+			stream[n * 2].mlen = sizeof(otk[n]);
+			stream[n * 2].n = jobs[i].n;
+			stream[n * 2].ic = 0;
+			stream[n * 2].k = jobs[i].key;
+
+			stream[n * 2 + 1].c = jobs[i].body + EL_XSALSA20_TAG_LEN;
+			stream[n * 2 + 1].m = jobs[i].in;
+			stream[n * 2 + 1].mlen = jobs[i].in_len;
+			stream[n * 2 + 1].n = jobs[i].n;
+			stream[n * 2 + 1].ic = 1;
+			stream[n * 2 + 1].k = jobs[i].key;
+
+			n ++;
+		}
+
+		if (crypto_stream_xor_ic_batch(stream, n * 2) < 0) {
+			for (j = 0; j < n; j ++)
+				job[j]->ret = -2;
+		} else {
+			for (j = 0; j < n; j ++) {
+				if (crypto_onetimeauth(job[j]->body, job[j]->body + EL_XSALSA20_TAG_LEN, job[j]->in_len, otk[j]) < 0) {
+					job[j]->ret = -3;
+				} else {
+					job[j]->ret = job[j]->in_len + EL_XSALSA20_TAG_LEN;
+				}
+			}
+		}
+
+		OPENSSL_cleanse(otk, sizeof(otk));
+	}
+}
+
+/**
+ * @brief Precomputes the XSalsa20 keystream of a packet encrypted by
+ * el_xsalsa20_encrypt_data_nonce(): block 0 (the Poly1305 key) and the blocks
+ * the data starts with
+ * @see el_precompute_seq()
+ * @param key The key generated by el_xsalsa20_create_key()
+ * @param nonce The nonce the packet will be sent with
+ * @param ks The keystream slot to be filled
+ * @return 0 on success, negative on error
+ */
+int el_xsalsa20_keystream(
+		const unsigned char *key,
+		const unsigned char *nonce,
+		struct el_keystream *ks) {
+	memset(ks->ks, 0, EL_KEYSTREAM_LEN);
+
+	return -(crypto_stream_xor(ks->ks, ks->ks, EL_KEYSTREAM_LEN, nonce, key) < 0);
+}
+
+/**
+ * @brief Same as el_xsalsa20_encrypt_data_nonce(), from the keystream
+ * precomputed by el_xsalsa20_keystream(). Data past the precomputed keystream
+ * is encrypted as usual.
+ * @see el_encrypt_seq()
+ * @param ks The precomputed keystream of 'nonce'
+ * @param key The key generated by el_xsalsa20_create_key()
+ * @param nonce EL_XSALSA20_NONCE_LEN bytes, never reused with the same key
+ * @param out Output buffer containing the encrypted data
+ * @param in Input buffer containing the plain-text data
+ * @param in_len The size of the plain-text data buffer
+ * @return The size of encrypted data buffer (output) or negative on error
+ */
+int el_xsalsa20_encrypt_data_keystream(
+		const struct el_keystream *ks,
+		const unsigned char *key,
+		const unsigned char *nonce,
+		unsigned char *out,
+		const unsigned char *in,
+		size_t in_len) {
+	size_t pre = EL_KEYSTREAM_LEN - EL_KEYSTREAM_BLOCK_LEN;
+
+	if (in_len < pre)
+		pre = in_len;
+
+	el_keystream_xor(out + EL_XSALSA20_TAG_LEN, in, ks->ks + EL_KEYSTREAM_BLOCK_LEN, pre);
+
+	if ((in_len > pre) && (crypto_stream_xor_ic(out + EL_XSALSA20_TAG_LEN + pre, in + pre, in_len - pre, nonce, EL_KEYSTREAM_LEN / EL_KEYSTREAM_BLOCK_LEN, key) < 0))
 		return -2;
 
-	return in_len - crypto_stream_NONCEBYTES - crypto_onetimeauth_KEYBYTES;
+	if (crypto_onetimeauth(out, out + EL_XSALSA20_TAG_LEN, in_len, ks->ks) < 0)
+		return -3;
+
+	return in_len + EL_XSALSA20_TAG_LEN;
 }
 
+/**
+ * @brief XSalsa20 data decryption with a caller supplied nonce, for data laid
+ * out as [tag][ciphertext]
+ * @see el_decrypt_seq()
+ * @param ctx Unused (no per-connection state is kept)
+ * @param key The key generated by el_xsalsa20_create_key()
+ * @param nonce The EL_XSALSA20_NONCE_LEN bytes used on encryption
+ * @param out Output buffer containing the decrypted data
+ * @param in Input buffer containing the encrypted data
+ * @param in_len The size of encrypted data buffer
+ * @return The size of decrypted data buffer (output) or negative on error
+ */
+int el_xsalsa20_decrypt_data_nonce(
+		struct el_ctx *ctx,
+		const unsigned char *key,
+		const unsigned char *nonce,
+		unsigned char *out,
+		const unsigned char *in,
+		size_t in_len) {
+	unsigned char otk[crypto_onetimeauth_KEYBYTES];
+	int ret;
+
+	if (in_len < EL_XSALSA20_TAG_LEN)
+		return -1;
+
+	memset(otk, 0, sizeof(otk));
+
+	if (crypto_stream_xor(otk, otk, sizeof(otk), nonce, key) < 0)
+		return -1;
+
+	ret = el_xsalsa20_open(key, nonce, otk, 1, in, out, in + EL_XSALSA20_TAG_LEN, in_len - EL_XSALSA20_TAG_LEN);
+
+	OPENSSL_cleanse(otk, sizeof(otk));
+
+	if (ret < 0)
+		return ret;
+
+	return in_len - EL_XSALSA20_TAG_LEN;
+}
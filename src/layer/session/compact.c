@@ -0,0 +1,103 @@
+/**
+ * @file compact.c
+ * @brief SIDP - Compact session encapsulation
+ *
+ * The session identifiers (source and destination devices and session id)
+ * can't change once the init sequence completes, so they're not carried by
+ * the packets. The receiving end-point restores them from its connection
+ * descriptor.
+ */ 
+
+
+/*
+   Secure Inter-Device Protocol Library
+
+   Copyright 2012-2014 Pedro A. Hortas (pah@ucodev.org)
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+
+#include <stdio.h>
+#include <string.h>
+
+#include "sl_compact.h"
+
+/**
+ * @brief compact session initialization function.
+ * This function is automatically called by the sl_data_init() function.
+ * @see sl_data_init()
+ * @return 0 on success, -1 on failure
+ */
+int sl_compact_init(void) {
+	return 0;
+}
+
+/**
+ * @brief compact session encapsulation data length
+ * @param in_len The size of unencapsulated data
+ * @return The required size for the 'out' param of the sl_compact_encap_data()
+ * function.
+ */
+size_t sl_compact_encap_output_len(size_t in_len) {
+	return in_len;
+}
+
+/**
+ * @brief compact session decapsulation data length
+ * @param in_len The size of encapsulated data
+ * @return The required size for the 'out' param of the sl_compact_decap_data()
+ * function.
+ */
+size_t sl_compact_decap_output_len(size_t in_len) {
+	return in_len;
+}
+
+/**
+ * @brief compact session encapsulation data function
+ * @see sl_compact_decap_data()
+ * @param out Output buffer containing the encapsulated data.
+ * @param in Input buffer contataining the unencapsulated data.
+ * @param in_len The size of unencapsulated data.
+ * @param hdr Unused. There's no header to be written.
+ * @return The size of encapsulated data or -1 on error.
+ */
+int sl_compact_encap_data(
+		void *out,
+		void *in,
+		size_t in_len,
+		const void *hdr) {
+	memcpy(out, in, in_len);
+
+	return in_len;
+}
+
+/**
+ * @brief compact session decapsulation data function
+ * @see sl_compact_encap_data()
+ * @param out Output buffer containing the decapsulated data.
+ * @param in Input buffer contataining the encapsulated data.
+ * @param in_len The size of encapsulated data.
+ * @param hdr Unused. The session identifiers are taken from the connection.
+ * @return The size of decapsulated data or -1 on error.
+ */
+int sl_compact_decap_data(
+		void *out,
+		void *in,
+		size_t in_len,
+		void *hdr) {
+	memcpy(out, in, in_len);
+
+	return in_len;
+}
+
@@ -26,15 +26,17 @@
 #include <string.h>
 
 #include "sl_default.h"
+#include "sl_compact.h"
 #include "sl_api.h"
 
 /**
  * @brief Session Layer interface initializer
  * @see SL_ENCAP_TYPE_DEFAULT
+ * @see SL_ENCAP_TYPE_COMPACT
  * @see sl_data
  * @param sld A 'struct sl_data' to be initialized
  * @param encap_type The type of session encapsulation to be used
- * (e.g. default)
+ * (e.g. default, compact)
  * @return 0 on success, -1 on error.
  */
 int sl_data_init(struct sl_data *sld, int encap_type) {
@@ -47,6 +49,14 @@ int sl_data_init(struct sl_data *sld, int encap_type) {
 		sld->encap = (int (*) (void *, const void *, size_t, struct sl_hdr *)) sl_default_encap_data;
 		sld->decap = (int (*) (void *, const void *, size_t, struct sl_hdr *)) sl_default_decap_data;
 
+		return sld->init();
+	} else if (encap_type == SL_ENCAP_TYPE_COMPACT) {
+		sld->init = sl_compact_init;
+		sld->encap_output_len = sl_compact_encap_output_len;
+		sld->decap_output_len = sl_compact_decap_output_len;
+		sld->encap = (int (*) (void *, const void *, size_t, struct sl_hdr *)) sl_compact_encap_data;
+		sld->decap = (int (*) (void *, const void *, size_t, struct sl_hdr *)) sl_compact_decap_data;
+
 		return sld->init();
 	}
 
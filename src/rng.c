@@ -0,0 +1,205 @@
+/**
+ * @file rng.c
+ * @brief Per-thread random number generator (IVs, nonces, salts, ephemerals)
+ */
+
+/*
+   Secure Inter-Device Protocol Library
+
+   Copyright 2012-2014 Pedro A. Hortas (pah@ucodev.org)
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <openssl/crypto.h>
+#include <openssl/rand.h>
+
+#ifdef COMPILE_POSIX
+#include <errno.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/random.h>
+#include <chacha/chacha.h>
+#endif
+
+#include "rng.h"
+
+#ifdef COMPILE_POSIX
+/*
+ * Each thread runs its own ChaCha20 generator, so drawing a nonce takes no
+ * lock. It's a fast key erasure generator: every refill of the buffer also
+ * produces the next key and overwrites the current one, and served bytes are
+ * wiped from the buffer, so the output can't be recovered from a later state.
+ *
+ * A generator is seeded from the kernel (getrandom() or getentropy()) on
+ * first use, after SIDP_RNG_RESEED_LEN bytes, and in the child of a fork(),
+ * which would otherwise repeat the parent's output.
+ */
+struct sidp_rng {
+	unsigned char key[CHACHA_CRYPTO_KEYBYTES];
+	unsigned char buf[CHACHA_CRYPTO_KEYBYTES + SIDP_RNG_BUF_LEN];
+	size_t pos;
+	size_t generated;
+	unsigned int fork_gen;
+	int seeded;
+};
+
+static __thread struct sidp_rng sidp_rng_state;
+static pthread_once_t sidp_rng_once = PTHREAD_ONCE_INIT;
+static volatile unsigned int sidp_rng_fork_gen = 0;
+
+/* Refill and large request nonces. The key changes after each use. */
+static const unsigned char sidp_rng_nonce_refill[CHACHA_CRYPTO_NONCEBYTES] = { 0 };
+static const unsigned char sidp_rng_nonce_direct[CHACHA_CRYPTO_NONCEBYTES] = { 1 };
+
+/**
+ * @brief pthread_atfork() child handler: invalidates the generators inherited
+ * from the parent
+ */
+static void sidp_rng_atfork_child(void) {
+	sidp_rng_fork_gen ++;
+}
+
+/**
+ * @brief Registers sidp_rng_atfork_child(), once per process
+ */
+static void sidp_rng_atfork_register(void) {
+	pthread_atfork(NULL, NULL, sidp_rng_atfork_child);
+}
+
+/**
+ * @brief Reads 'len' bytes (256 at most) of kernel entropy into 'buf'
+ * @return 0 on success, -1 on error
+ */
+static int sidp_rng_entropy(unsigned char *buf, size_t len) {
+#if defined(__linux__)
+	ssize_t ret;
+
+	while ((ret = getrandom(buf, len, 0)) < 0) {
+		if (errno != EINTR)
+			return -(RAND_bytes(buf, len) != 1);
+	}
+
+	/* Requests of up to 256 bytes are never short */
+	return -(((size_t) ret) != len);
+#else
+	if (getentropy(buf, len) < 0)
+		return -(RAND_bytes(buf, len) != 1);
+
+	return 0;
+#endif
+}
+
+/**
+ * @brief Generates the next key and a buffer of output, and wipes the
+ * current key
+ * @param rng The calling thread generator
+ */
+static void sidp_rng_refill(struct sidp_rng *rng) {
+	chacha_crypto_stream(rng->buf, sizeof(rng->buf), sidp_rng_nonce_refill, rng->key);
+
+	memcpy(rng->key, rng->buf, sizeof(rng->key));
+	OPENSSL_cleanse(rng->buf, sizeof(rng->key));
+
+	rng->pos = sizeof(rng->key);
+	rng->generated += SIDP_RNG_BUF_LEN;
+}
+
+/**
+ * @brief Mixes fresh kernel entropy into the key of 'rng' and discards its
+ * buffered output
+ * @param rng The calling thread generator
+ * @return 0 on success, -1 on error
+ */
+static int sidp_rng_reseed(struct sidp_rng *rng) {
+	unsigned char seed[CHACHA_CRYPTO_KEYBYTES];
+	unsigned int i;
+
+	pthread_once(&sidp_rng_once, sidp_rng_atfork_register);
+
+	if (sidp_rng_entropy(seed, sizeof(seed)) < 0)
+		return -1;
+
+	for (i = 0; i < sizeof(seed); i ++)
+		rng->key[i] ^= seed[i];
+
+	OPENSSL_cleanse(seed, sizeof(seed));
+
+	rng->fork_gen = sidp_rng_fork_gen;
+	rng->generated = 0;
+	rng->seeded = 1;
+
+	sidp_rng_refill(rng);
+
+	return 0;
+}
+#endif
+
+/**
+ * @brief Fills 'buf' with 'len' cryptographically secure random bytes, from a
+ * generator private to the calling thread
+ * @param buf Output buffer
+ * @param len Number of bytes to be generated
+ * @return 0 on success, -1 on error
+ */
+#ifdef COMPILE_WIN32
+DLLIMPORT
+#endif
+int sidp_rng_bytes(void *buf, size_t len) {
+#ifdef COMPILE_POSIX
+	struct sidp_rng *rng = &sidp_rng_state;
+	unsigned char *out = buf;
+	size_t n;
+
+	if (!rng->seeded || (rng->fork_gen != sidp_rng_fork_gen) || (rng->generated >= SIDP_RNG_RESEED_LEN)) {
+		if (sidp_rng_reseed(rng) < 0)
+			return -1;
+	}
+
+	/* Large requests are generated in place, then the key is replaced */
+	if (len > SIDP_RNG_BUF_LEN) {
+		chacha_crypto_stream(out, len, sidp_rng_nonce_direct, rng->key);
+		rng->generated += len;
+		sidp_rng_refill(rng);
+
+		return 0;
+	}
+
+	while (len) {
+		if (rng->pos == sizeof(rng->buf))
+			sidp_rng_refill(rng);
+
+		n = sizeof(rng->buf) - rng->pos;
+
+		if (n > len)
+			n = len;
+
+		memcpy(out, rng->buf + rng->pos, n);
+		memset(rng->buf + rng->pos, 0, n);
+
+		rng->pos += n;
+		out += n;
+		len -= n;
+	}
+
+	return 0;
+#else
+	return -(RAND_bytes(buf, len) != 1);
+#endif
+}
+
@@ -0,0 +1,780 @@
+/**
+ * @file hub.c
+ * @brief SIDP - Routing hub
+ *
+ * The hub forwards the DATA packets received from a device to the connection
+ * of the destination device, looking only at the description and session
+ * headers. If both connections share the key and the negotiated settings,
+ * and don't use counter nonces, the packet body is relayed as is, moved from
+ * socket to socket with splice() where available. Otherwise, the packet is
+ * decrypted and encrypted again for the destination connection.
+ */
+
+
+/*
+   Secure Inter-Device Protocol Library
+
+   Copyright 2012-2014 Pedro A. Hortas (pah@ucodev.org)
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+
+#if defined(COMPILE_POSIX) && defined(__linux__) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE	/* splice() */
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+
+#ifdef COMPILE_POSIX
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <arpa/inet.h>
+#elif defined(COMPILE_WIN32)
+#include <windows.h>
+#include <winsock2.h>
+#endif
+
+#include "sidp.h"
+#include "skt.h"
+#include "bitops.h"
+
+#include "sl_api.h"
+#include "dl_api.h"
+#include "dl_compact.h"
+
+#include "chain_in.h"
+#include "chain_out.h"
+
+#include "hub.h"
+
+#if defined(COMPILE_POSIX) && defined(__linux__)
+#define SIDP_HUB_SPLICE	1
+#endif
+
+/**
+ * @def SIDP_HUB_COPY_LEN
+ * @brief The size of the buffer used to relay packets through user space.
+ * Packet bodies up to this size are read at once and relayed with a single
+ * write, as the system calls would otherwise cost more than the copy.
+ * Larger ones are spliced.
+ */
+#define SIDP_HUB_COPY_LEN	16384
+
+#ifdef SIDP_HUB_SPLICE
+/*
+ * splice() moves data between a socket and a pipe, so each forwarding
+ * thread keeps a pipe to move packets through. It's closed on thread exit.
+ */
+static pthread_key_t sidp_hub_pipe_key;
+static pthread_once_t sidp_hub_pipe_once = PTHREAD_ONCE_INIT;
+
+/**
+ * @brief Closes the pipe of an exiting thread
+ * @param data The pipe file descriptors
+ */
+static void sidp_hub_pipe_destroy(void *data) {
+	int *fds = (int *) data;
+
+	close(fds[0]);
+	close(fds[1]);
+
+	free(fds);
+}
+
+/**
+ * @brief Creates the key of the per-thread pipes
+ */
+static void sidp_hub_pipe_key_create(void) {
+	pthread_key_create(&sidp_hub_pipe_key, sidp_hub_pipe_destroy);
+}
+
+/**
+ * @brief Gets the pipe of the calling thread, creating it on first use
+ * @return The pipe file descriptors, or NULL on error.
+ */
+static int *sidp_hub_pipe(void) {
+	int *fds;
+
+	pthread_once(&sidp_hub_pipe_once, sidp_hub_pipe_key_create);
+
+	if ((fds = (int *) pthread_getspecific(sidp_hub_pipe_key)))
+		return fds;
+
+	if (!(fds = (int *) malloc(2 * sizeof(int))))
+		return NULL;
+
+	if (pipe(fds) < 0) {
+		free(fds);
+		return NULL;
+	}
+
+	fcntl(fds[0], F_SETFD, FD_CLOEXEC);
+	fcntl(fds[1], F_SETFD, FD_CLOEXEC);
+
+	if (pthread_setspecific(sidp_hub_pipe_key, fds)) {
+		sidp_hub_pipe_destroy(fds);
+		return NULL;
+	}
+
+	return fds;
+}
+
+/**
+ * @brief Drops the pipe of the calling thread (e.g. if data was left in it)
+ */
+static void sidp_hub_pipe_reset(void) {
+	int *fds;
+
+	if ((fds = (int *) pthread_getspecific(sidp_hub_pipe_key))) {
+		pthread_setspecific(sidp_hub_pipe_key, NULL);
+		sidp_hub_pipe_destroy(fds);
+	}
+}
+#endif
+
+/**
+ * @brief Locks the routing table of 'hub' for reading
+ * @param hub The hub
+ */
+static void sidp_hub_rdlock(struct sidp_hub *hub) {
+#ifdef COMPILE_POSIX
+	pthread_rwlock_rdlock(&hub->lock);
+#elif defined(COMPILE_WIN32)
+	AcquireSRWLockShared(&hub->lock);
+#endif
+}
+
+/**
+ * @brief Unlocks the routing table of 'hub' after sidp_hub_rdlock()
+ * @param hub The hub
+ */
+static void sidp_hub_rdunlock(struct sidp_hub *hub) {
+#ifdef COMPILE_POSIX
+	pthread_rwlock_unlock(&hub->lock);
+#elif defined(COMPILE_WIN32)
+	ReleaseSRWLockShared(&hub->lock);
+#endif
+}
+
+/**
+ * @brief Locks the routing table of 'hub' for writing
+ * @param hub The hub
+ */
+static void sidp_hub_wrlock(struct sidp_hub *hub) {
+#ifdef COMPILE_POSIX
+	pthread_rwlock_wrlock(&hub->lock);
+#elif defined(COMPILE_WIN32)
+	AcquireSRWLockExclusive(&hub->lock);
+#endif
+}
+
+/**
+ * @brief Unlocks the routing table of 'hub' after sidp_hub_wrlock()
+ * @param hub The hub
+ */
+static void sidp_hub_wrunlock(struct sidp_hub *hub) {
+#ifdef COMPILE_POSIX
+	pthread_rwlock_unlock(&hub->lock);
+#elif defined(COMPILE_WIN32)
+	ReleaseSRWLockExclusive(&hub->lock);
+#endif
+}
+
+/**
+ * @brief Locks 'route', so that a single packet is written to its connection
+ * @param route The route
+ */
+static void sidp_hub_route_lock(struct sidp_hub_route *route) {
+#ifdef COMPILE_POSIX
+	pthread_mutex_lock(&route->lock);
+#elif defined(COMPILE_WIN32)
+	EnterCriticalSection(&route->lock);
+#endif
+}
+
+/**
+ * @brief Unlocks 'route' after sidp_hub_route_lock()
+ * @param route The route
+ */
+static void sidp_hub_route_unlock(struct sidp_hub_route *route) {
+#ifdef COMPILE_POSIX
+	pthread_mutex_unlock(&route->lock);
+#elif defined(COMPILE_WIN32)
+	LeaveCriticalSection(&route->lock);
+#endif
+}
+
+/**
+ * @brief Releases the memory of 'route'
+ * @param route The route to be released
+ */
+static void sidp_hub_route_free(struct sidp_hub_route *route) {
+#ifdef COMPILE_POSIX
+	pthread_mutex_destroy(&route->lock);
+#elif defined(COMPILE_WIN32)
+	DeleteCriticalSection(&route->lock);
+#endif
+	free(route);
+}
+
+/**
+ * @brief Gets the routing table bucket of device 'dev'
+ * @param hub The hub
+ * @param dev The device ID
+ * @return The bucket index
+ */
+static uint32_t sidp_hub_bucket(const struct sidp_hub *hub, uint32_t dev) {
+	/* Fibonacci hashing: device IDs are usually sequential */
+	return hub->bits ? ((dev * 2654435761U) >> (32 - hub->bits)) : 0;
+}
+
+/**
+ * @brief Looks up the route to device 'dev'. The table shall be locked.
+ * @param hub The hub
+ * @param dev The device ID
+ * @return The route, or NULL if the device isn't reachable through the hub.
+ */
+static struct sidp_hub_route *sidp_hub_route_find(const struct sidp_hub *hub, uint32_t dev) {
+	struct sidp_hub_route *route;
+
+	for (route = hub->table[sidp_hub_bucket(hub, dev)]; route; route = route->next) {
+		if (route->dev == dev)
+			return route;
+	}
+
+	return NULL;
+}
+
+/**
+ * @brief Gets the ID of the device on the remote end of 'conn' (host side)
+ * @param conn The SIDP connection structure
+ * @return The device ID
+ */
+static uint32_t sidp_hub_conn_dev(const struct sidpconn *conn) {
+	/* Routing connections keep the device IDs as the device sent them */
+	return (conn->type == SIDP_CONN_TYPE_ROUTING) ? conn->sdev : conn->ddev;
+}
+
+/**
+ * @brief Reads and discards 'len' bytes from 'conn'
+ * @param conn The SIDP connection structure
+ * @param len The number of bytes to be discarded
+ * @return 0 on success, -1 on error
+ */
+static int sidp_hub_drain(struct sidpconn *conn, size_t len) {
+	char buf[SIDP_HUB_COPY_LEN];
+	size_t n;
+
+	for (; len; len -= n) {
+		n = (len > sizeof(buf)) ? sizeof(buf) : len;
+
+		if (sidp_read_nb(conn, buf, n) != (int) n)
+			return -1;
+	}
+
+	return 0;
+}
+
+/**
+ * @brief Relays 'len' bytes from 'from' to 'to' through a user space buffer
+ * @param from The connection the data is read from
+ * @param to The connection the data is written to
+ * @param len The number of bytes to relay
+ * @return 0 on success, -1 if 'from' failed, -2 if 'to' failed (the data
+ * was read anyway)
+ */
+static int sidp_hub_copy(struct sidpconn *from, struct sidpconn *to, size_t len) {
+	char buf[SIDP_HUB_COPY_LEN];
+	size_t n;
+	int ret = 0;
+
+	for (; len; len -= n) {
+		n = (len > sizeof(buf)) ? sizeof(buf) : len;
+
+		if (sidp_read_nb(from, buf, n) != (int) n)
+			return -1;
+
+		/* Keep reading if 'to' fails, so that 'from' remains in sync */
+		if (!ret && (sidp_write_nb(to, buf, n) != (int) n))
+			ret = -2;
+	}
+
+	return ret;
+}
+
+#ifdef SIDP_HUB_SPLICE
+/**
+ * @brief Relays 'len' bytes from 'from' to 'to' with splice(), falling back
+ * to sidp_hub_copy() if the sockets don't support it
+ * @see sidp_hub_copy()
+ * @param from The connection the data is read from
+ * @param to The connection the data is written to
+ * @param len The number of bytes to relay
+ * @return 0 on success, -1 if 'from' failed, -2 if 'to' failed (the data
+ * was read anyway)
+ */
+static int sidp_hub_splice(struct sidpconn *from, struct sidpconn *to, size_t len) {
+	size_t piped = 0;
+	ssize_t n;
+	int *fds;
+
+	if (!(fds = sidp_hub_pipe()))
+		return sidp_hub_copy(from, to, len);
+
+	while (len || piped) {
+		if (len) {
+			if ((n = splice(from->fd, NULL, fds[1], NULL, len, SPLICE_F_MOVE | (len > piped ? SPLICE_F_MORE : 0))) <= 0) {
+				if ((n < 0) && (errno == EINTR))
+					continue;
+
+				/* Nothing was moved yet: the socket doesn't support splice() */
+				if ((n < 0) && !piped && ((errno == EINVAL) || (errno == ENOSYS)))
+					return sidp_hub_copy(from, to, len);
+
+				sidp_hub_pipe_reset();
+
+				return -1;
+			}
+
+			len -= n;
+			piped += n;
+
+			from->bytes_in += n;
+			from->last_fd_read = time(NULL);
+		}
+
+		if ((n = splice(fds[0], NULL, to->fd, NULL, piped, SPLICE_F_MOVE | (len ? SPLICE_F_MORE : 0))) <= 0) {
+			if ((n < 0) && (errno == EINTR))
+				continue;
+
+			/* Drop the data left in the pipe and keep 'from' in sync */
+			sidp_hub_pipe_reset();
+
+			return sidp_hub_drain(from, len) < 0 ? -1 : -2;
+		}
+
+		piped -= n;
+
+		to->bytes_out += n;
+		to->last_fd_write = time(NULL);
+	}
+
+	return 0;
+}
+#endif
+
+/**
+ * @brief Checks if the packets received from 'from' can be relayed as they
+ * are to the remote end-point of 'to'
+ * @param hub The hub
+ * @param from The connection the packet was received from
+ * @param to The connection the packet shall be sent through
+ * @return 1 if the packets can be relayed, 0 otherwise
+ */
+static int sidp_hub_relay_check(
+		const struct sidp_hub *hub,
+		const struct sidpconn *from,
+		const struct sidpconn *to) {
+	uint32_t flags = from->negotiate_flags ^ to->negotiate_flags;
+
+	if (test_bit(&hub->flags, SIDP_HUB_NO_RELAY_FL))
+		return 0;
+
+	/* The framing is set for each connection, but the remote end-point must
+	 * be able to decompress and decrypt the packet body as it is.
+	 */
+	clear_bit(&flags, SIDP_NEGOTIATE_ENCAP_COMPACT_FL);
+
+	if (flags)
+		return 0;
+
+	if (memcmp(from->key, to->key, sizeof(from->key)))
+		return 0;
+
+	/* Counter nonces are derived from the connection state */
+	if (test_bit(&from->negotiate_flags, SIDP_NEGOTIATE_NONCE_COUNTER_FL))
+		return 0;
+
+	if (test_bit(&from->negotiate_flags, SIDP_NEGOTIATE_COMPRESS_TELEMETRY_FL) && memcmp(&from->cl_schema, &to->cl_schema, sizeof(from->cl_schema)))
+		return 0;
+
+	return 1;
+}
+
+/**
+ * @brief Relays the packet being received from 'from' to 'to', as it is
+ * @param hub The hub
+ * @param from The connection the packet is received from
+ * @param to The connection the packet is sent through
+ * @param dl_hdr The description header of the packet (host byte order)
+ * @param buf The first 'head_len' bytes of the packet data, already read,
+ * preceded by sizeof(struct dl_hdr) bytes where the header is crafted
+ * @param head_len The number of bytes of packet data already read
+ * @return 0 on success, -1 if 'from' failed, -2 if 'to' failed
+ */
+static int sidp_hub_relay(
+		const struct sidp_hub *hub,
+		struct sidpconn *from,
+		struct sidpconn *to,
+		const struct dl_hdr *dl_hdr,
+		unsigned char *buf,
+		size_t head_len) {
+	unsigned char dl_compact[DL_COMPACT_HDR_MAX_LEN];
+	struct dl_hdr dl_out;
+	int hdr_len, ret;
+	size_t len = dl_hdr->def_size - head_len;
+
+	/* Craft the description header as framed on 'to', right before the
+	 * packet data, so that both are written at once
+	 */
+	if (test_bit(&to->negotiate_flags, SIDP_NEGOTIATE_ENCAP_COMPACT_FL)) {
+		if ((hdr_len = dl_compact_encode(dl_compact, dl_hdr, to->dl_cipher_out)) < 0)
+			return sidp_hub_drain(from, len) < 0 ? -1 : -2;
+
+		memcpy(buf + sizeof(struct dl_hdr) - hdr_len, dl_compact, hdr_len);
+	} else {
+		memset(&dl_out, 0, sizeof(struct dl_hdr));
+
+		dl_out.inf_size = htons(dl_hdr->inf_size);
+		dl_out.def_size = htons(dl_hdr->def_size);
+		dl_out.session_type = htons(dl_hdr->session_type);
+		dl_out.cipher_type = htons(dl_hdr->cipher_type);
+		dl_out.compress_type = htons(dl_hdr->compress_type);
+		dl_out.msg_type = htons(dl_hdr->msg_type);
+
+		hdr_len = sizeof(struct dl_hdr);
+
+		memcpy(buf, &dl_out, sizeof(struct dl_hdr));
+	}
+
+	if (sidp_write_nb(to, buf + sizeof(struct dl_hdr) - hdr_len, hdr_len + head_len) != (int) (hdr_len + head_len))
+		return sidp_hub_drain(from, len) < 0 ? -1 : -2;
+
+	/* The remote end-point now knows the cipher type of this packet */
+	if (test_bit(&to->negotiate_flags, SIDP_NEGOTIATE_ENCAP_COMPACT_FL))
+		to->dl_cipher_out = dl_hdr->cipher_type;
+
+	/* Relay the remaining packet data */
+	if (!len)
+		return 0;
+
+#ifdef SIDP_HUB_SPLICE
+	if (!test_bit(&hub->flags, SIDP_HUB_NO_SPLICE_FL)) {
+		ret = sidp_hub_splice(from, to, len);
+	} else {
+		ret = sidp_hub_copy(from, to, len);
+	}
+#else
+	ret = sidp_hub_copy(from, to, len);
+#endif
+
+	return ret;
+}
+
+/**
+ * @brief Receives the packet being received from 'from' and sends it again
+ * through 'to', encrypted (and compressed) with the settings of 'to'
+ * @param from The connection the packet is received from
+ * @param to The connection the packet is sent through
+ * @param dl_hdr The description header of the packet (host byte order)
+ * @param head The first 'head_len' bytes of the packet data, already read
+ * @param head_len The number of bytes of packet data already read
+ * @return 0 on success, -1 if 'from' failed, -2 if 'to' failed, -3 if the
+ * packet was invalid
+ */
+static int sidp_hub_reencode(
+		struct sidpconn *from,
+		struct sidpconn *to,
+		const struct dl_hdr *dl_hdr,
+		const unsigned char *head,
+		size_t head_len) {
+	struct sidppkt pkt;
+	struct sidpopt opt;
+	int ret;
+
+	sidp_pkt_set_opt(&opt, 0, 0, 0, SIDP_MSG_TYPE_DATA, from->key);
+
+	if ((ret = chain_in_receive_data(from, dl_hdr, head, head_len, &pkt, &opt)) < 0) {
+		/* See chain_in_receive_data(): -6 and -7 are read errors, and
+		 * the packet data isn't read at all on -3, -4 and -5 (invalid
+		 * header or no memory), so it's discarded to keep 'from' in sync
+		 */
+		if ((ret == -6) || (ret == -7))
+			return -1;
+
+		if ((ret >= -5) && (sidp_hub_drain(from, dl_hdr->def_size - head_len) < 0))
+			return -1;
+
+		return -3;
+	}
+
+	if (sidp_seq_data_set_opt(to, &opt) < 0) {
+		free(pkt.msg);
+		return -2;
+	}
+
+	/* Relayed packets keep their identifiers, so the session header is
+	 * always present
+	 */
+	opt.session_type = SL_ENCAP_TYPE_DEFAULT;
+
+	ret = chain_out_dispatch(to, &pkt, &opt);
+
+	free(pkt.msg);
+
+	return (ret < 0) ? -2 : 0;
+}
+
+/**
+ * @brief Initializes the routing hub 'hub'
+ * @see sidp_hub_destroy()
+ * @param hub The hub to be initialized
+ * @param size The number of buckets of the routing table (rounded up to a
+ * power of two), or 0 for SIDP_HUB_SIZE_DEFAULT
+ * @param flags The hub flags (e.g. 1 << SIDP_HUB_NO_SPLICE_FL)
+ * @return 0 on success, negative on error.
+ */
+#ifdef COMPILE_WIN32
+DLLIMPORT
+#endif
+int sidp_hub_init(struct sidp_hub *hub, unsigned int size, uint32_t flags) {
+	memset(hub, 0, sizeof(struct sidp_hub));
+
+	if (!size)
+		size = SIDP_HUB_SIZE_DEFAULT;
+
+	while (((1U << hub->bits) < size) && (hub->bits < 24))
+		hub->bits ++;
+
+	hub->flags = flags;
+
+	if (!(hub->table = (struct sidp_hub_route **) calloc(1U << hub->bits, sizeof(struct sidp_hub_route *))))
+		return -1;
+
+#ifdef COMPILE_POSIX
+	if (pthread_rwlock_init(&hub->lock, NULL)) {
+		free(hub->table);
+		return -2;
+	}
+#elif defined(COMPILE_WIN32)
+	InitializeSRWLock(&hub->lock);
+#endif
+
+	return 0;
+}
+
+/**
+ * @brief Releases the resources held by 'hub'. The connections of the routes
+ * aren't closed.
+ * @see sidp_hub_init()
+ * @param hub The hub to be destroyed
+ */
+#ifdef COMPILE_WIN32
+DLLIMPORT
+#endif
+void sidp_hub_destroy(struct sidp_hub *hub) {
+	struct sidp_hub_route *route, *next;
+	uint32_t i;
+
+	for (i = 0; i < (1U << hub->bits); i ++) {
+		for (route = hub->table[i]; route; route = next) {
+			next = route->next;
+			sidp_hub_route_free(route);
+		}
+	}
+
+	free(hub->table);
+
+#ifdef COMPILE_POSIX
+	pthread_rwlock_destroy(&hub->lock);
+#endif
+
+	hub->table = NULL;
+}
+
+/**
+ * @brief Adds a route to device 'dev' through connection 'conn'
+ *
+ * While the route exists, the packets written to 'conn' from other threads
+ * shall be sent through the hub, as it writes to 'conn' from the threads
+ * calling sidp_hub_forward().
+ *
+ * @see sidp_hub_del()
+ * @param hub The hub
+ * @param dev The device ID. Usually the ID of the device on the remote end of
+ * 'conn' (conn->ddev, or conn->sdev for routing connections).
+ * @param conn The (negotiated) connection to the device
+ * @return 0 on success, -1 on error, -2 if the route already exists.
+ */
+#ifdef COMPILE_WIN32
+DLLIMPORT
+#endif
+int sidp_hub_add(struct sidp_hub *hub, uint32_t dev, struct sidpconn *conn) {
+	struct sidp_hub_route *route;
+	uint32_t bucket = sidp_hub_bucket(hub, dev);
+
+	if (!(route = (struct sidp_hub_route *) malloc(sizeof(struct sidp_hub_route))))
+		return -1;
+
+	route->dev = dev;
+	route->conn = conn;
+
+#ifdef COMPILE_POSIX
+	if (pthread_mutex_init(&route->lock, NULL)) {
+		free(route);
+		return -1;
+	}
+#elif defined(COMPILE_WIN32)
+	InitializeCriticalSection(&route->lock);
+#endif
+
+	sidp_hub_wrlock(hub);
+
+	if (sidp_hub_route_find(hub, dev)) {
+		sidp_hub_wrunlock(hub);
+		sidp_hub_route_free(route);
+		return -2;
+	}
+
+	route->next = hub->table[bucket];
+	hub->table[bucket] = route;
+
+	sidp_hub_wrunlock(hub);
+
+	return 0;
+}
+
+/**
+ * @brief Removes the route to device 'dev'. Waits for the packets being
+ * forwarded to complete.
+ * @see sidp_hub_add()
+ * @param hub The hub
+ * @param dev The device ID
+ * @return 0 on success, -1 if there's no route to 'dev'.
+ */
+#ifdef COMPILE_WIN32
+DLLIMPORT
+#endif
+int sidp_hub_del(struct sidp_hub *hub, uint32_t dev) {
+	struct sidp_hub_route **prev, *route;
+
+	sidp_hub_wrlock(hub);
+
+	for (prev = &hub->table[sidp_hub_bucket(hub, dev)]; (route = *prev); prev = &route->next) {
+		if (route->dev == dev) {
+			*prev = route->next;
+
+			sidp_hub_wrunlock(hub);
+			sidp_hub_route_free(route);
+
+			return 0;
+		}
+	}
+
+	sidp_hub_wrunlock(hub);
+
+	return -1;
+}
+
+/**
+ * @brief Forwards the next packet received from 'from' to its destination
+ *
+ * Reads the description and session headers of the packet and looks up the
+ * route to its destination device. The packet body is then relayed as is, if
+ * both connections allow it, or decrypted and encrypted again. Packets whose
+ * source isn't the device on the remote end of 'from' are refused. Packets
+ * that can't be forwarded are discarded, so 'from' remains usable unless -1
+ * is returned.
+ *
+ * Several threads may forward packets at the same time, as long as each
+ * connection is read by a single thread.
+ *
+ * @param hub The hub
+ * @param from The (negotiated) connection to receive the packet from
+ * @return 0 on success, -1 on read error (the connection shall be closed),
+ * -2 if the packet isn't a DATA packet with a session header, -3 if the
+ * source device was spoofed, -4 if there's no route to the destination, -5
+ * if the packet couldn't be sent to the destination, -6 if the packet was
+ * invalid.
+ */
+#ifdef COMPILE_WIN32
+DLLIMPORT
+#endif
+int sidp_hub_forward(struct sidp_hub *hub, struct sidpconn *from) {
+	unsigned char buf[sizeof(struct dl_hdr) + SIDP_HUB_COPY_LEN];
+	unsigned char *head = buf + sizeof(struct dl_hdr);
+	struct sidp_hub_route *route;
+	struct sl_default_hdr sl_hdr;
+	struct dl_hdr dl_hdr;
+	size_t head_len;
+	int ret;
+
+	/* Read the incoming description layer */
+	if (chain_in_read_hdr(from, buf, &dl_hdr) < 0)
+		return -1;
+
+	if (((dl_hdr.def_size + SIDP_PKT_HDRS_MAX_LEN) > SIDP_PKT_MAX_LEN) || (dl_hdr.inf_size > SIDP_PKT_MSG_MAX_LEN))
+		return -1;
+
+	/* Only DATA packets carrying the session identifiers can be routed */
+	if ((dl_hdr.msg_type != SIDP_MSG_TYPE_DATA) || (dl_hdr.session_type != SL_ENCAP_TYPE_DEFAULT) || (dl_hdr.def_size < sizeof(struct sl_default_hdr)))
+		return sidp_hub_drain(from, dl_hdr.def_size) < 0 ? -1 : -2;
+
+	/* Read the session layer, and the whole packet data if it's small */
+	head_len = (dl_hdr.def_size > SIDP_HUB_COPY_LEN) ? sizeof(struct sl_default_hdr) : dl_hdr.def_size;
+
+	if (sidp_read_nb(from, head, head_len) != (int) head_len)
+		return -1;
+
+	memcpy(&sl_hdr, head, sizeof(struct sl_default_hdr));
+
+	/* Refuse packets not originated by the device on the other end */
+	if (ntohl(sl_hdr.sdev) != sidp_hub_conn_dev(from))
+		return sidp_hub_drain(from, dl_hdr.def_size - head_len) < 0 ? -1 : -3;
+
+	sidp_hub_rdlock(hub);
+
+	if (!(route = sidp_hub_route_find(hub, ntohl(sl_hdr.ddev)))) {
+		sidp_hub_rdunlock(hub);
+
+		return sidp_hub_drain(from, dl_hdr.def_size - head_len) < 0 ? -1 : -4;
+	}
+
+	sidp_hub_route_lock(route);
+
+	if (sidp_hub_relay_check(hub, from, route->conn)) {
+		ret = sidp_hub_relay(hub, from, route->conn, &dl_hdr, buf, head_len);
+	} else {
+		ret = sidp_hub_reencode(from, route->conn, &dl_hdr, head, head_len);
+	}
+
+	sidp_hub_route_unlock(route);
+
+	sidp_hub_rdunlock(hub);
+
+	if (ret == -2)
+		return -5;
+
+	if (ret == -3)
+		return -6;
+
+	return ret;
+}
+
@@ -38,6 +38,7 @@
 #include "bitops.h"
 #include "srp.h"
 #include "seq_auth.h"
+#include "vstore.h"
 
 /**
  * @brief Send an authentication sequence packet with SRP data
@@ -126,13 +127,9 @@ int sidp_seq_auth_user(
 	struct SRPUser *usr;
 	struct srp_data srp_data;
 
-	const unsigned char *bytes_s = NULL;
-	const unsigned char *bytes_v = NULL;
 	const unsigned char *bytes_A = NULL;
 	const unsigned char *bytes_M = NULL;
 
-	int len_s = 0;
-	int len_v = 0;
 	int len_A = 0;
 	int len_M = 0;
 
@@ -151,11 +148,9 @@ int sidp_seq_auth_user(
 	/* Set connection key */
 	strncpy((char *) conn->key, (char *) pass, strlen((char *) pass) >= sizeof(conn->key) ? sizeof(conn->key) - 1 : strlen((char *) pass));
 
-	/* Create a salted verification key */
-	srp_create_salted_verification_key(alg, ng_type, user, pass, strlen((const char *) pass), &bytes_s, &len_s, &bytes_v, &len_v, NULL, NULL);
-
 	/* Create a SRP user */
-	usr = srp_user_new(alg, ng_type, user, pass, strlen((const char *) pass), NULL, NULL);
+	if (!(usr = srp_user_new(alg, ng_type, user, pass, strlen((const char *) pass), NULL, NULL)))
+		return -8;
 
 	/* Start user authentication */
 	srp_user_start_authentication(usr, &auth_username, &bytes_A, &len_A);
@@ -168,18 +163,12 @@ int sidp_seq_auth_user(
 
 	if (sidp_srp_pkt_send(conn, &srp_data) < 0) {
 		srp_user_delete(usr);
-		free((void *) bytes_s);
-		free((void *) bytes_v);
-
 		return -2;
 	}
 
 	/* RECV from Host: bytes_s, bytes_B */
 	if (sidp_srp_pkt_recv(conn, &srp_data) < 0) {
 		srp_user_delete(usr);
-		free((void *) bytes_s);
-		free((void *) bytes_v);
-
 		return -3;
 	}
 
@@ -188,9 +177,6 @@ int sidp_seq_auth_user(
 
 	if (!bytes_M) {
 		srp_user_delete(usr);
-		free((void *) bytes_s);
-		free((void *) bytes_v);
-
 		return -4; /* Safety check violated */
 	}
 
@@ -201,18 +187,12 @@ int sidp_seq_auth_user(
 
 	if (sidp_srp_pkt_send(conn, &srp_data) < 0) {
 		srp_user_delete(usr);
-		free((void *) bytes_s);
-		free((void *) bytes_v);
-
 		return -5;
 	}
 
 	/* RECV from Host: bytes_HAMK */
 	if (sidp_srp_pkt_recv(conn, &srp_data) < 0) {
 		srp_user_delete(usr);
-		free((void *) bytes_s);
-		free((void *) bytes_v);
-
 		return -6;
 	}
 
@@ -222,9 +202,6 @@ int sidp_seq_auth_user(
 	/* Verify authentication */
 	if (!srp_user_is_authenticated(usr)) {
 		srp_user_delete(usr);
-		free((void *) bytes_s);
-		free((void *) bytes_v);
-
 		return -7; /* Authentication failed */
 	}
 
@@ -273,8 +250,9 @@ int sidp_seq_auth_host(
 	/* Set connection key */
 	strncpy((char *) conn->key, (char *) pass, strlen((char *) pass) >= sizeof(conn->key) ? sizeof(conn->key) - 1 : strlen((char *) pass));
 
-	/* Create a salted verification key */
-	srp_create_salted_verification_key(alg, ng_type, user, pass, strlen((const char *) pass), &bytes_s, &len_s, &bytes_v, &len_v, NULL, NULL);
+	/* Get the salted verification key from the verifier store, or create it */
+	if (sidp_vstore_verifier(conn->vstore, user, pass, &bytes_s, &len_s, &bytes_v, &len_v) < 0)
+		return -8;
 
 	/* RECV From User: username, bytes_A */
 	if (sidp_srp_pkt_recv(conn, &srp_data) < 0) {
@@ -404,8 +382,9 @@ int sidp_seq_auth_host_c(
 	/* Set connection key */
 	strncpy((char *) conn->key, (char *) pass, strlen((char *) pass) >= sizeof(conn->key) ? sizeof(conn->key) - 1 : strlen((char *) pass));
 
-	/* Create a salted verification key */
-	srp_create_salted_verification_key(alg, ng_type, conn->user, pass, strlen((const char *) pass), &bytes_s, &len_s, &bytes_v, &len_v, NULL, NULL);
+	/* Get the salted verification key from the verifier store, or create it */
+	if (sidp_vstore_verifier(conn->vstore, conn->user, pass, &bytes_s, &len_s, &bytes_v, &len_v) < 0)
+		return -9;
 
 	/* Create a SRP verifier */
 	ver = srp_verifier_new(alg, ng_type, conn->user, bytes_s, len_s, bytes_v, len_v, srp_data.bytes_A, ntohs(srp_data.len_A), &bytes_B, &len_B, NULL, NULL);
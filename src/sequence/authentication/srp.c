@@ -43,15 +43,41 @@
 #include <openssl/crypto.h>
 #include <openssl/rand.h>
 
+#ifdef COMPILE_POSIX
+    #include <pthread.h>
+#elif defined(COMPILE_WIN32)
+    #include <windows.h>
+#endif
+
 
+#include "rng.h"
 #include "srp.h"
 
-static int g_initialized = 0;
+/* Fixed-base exponentiation of g: the exponent is split in windows of
+ * NG_WINDOW_BITS bits, and entry j of window i of the table holds
+ * g^(j * 2^(i * NG_WINDOW_BITS)) in Montgomery form, as a big-endian number of
+ * 'table_len' bytes, so that g^e takes a Montgomery multiplication per window
+ * and no squaring. Exponents up to NG_EXP_BITS bits (a, b and x with SHA-1 or
+ * SHA-256) use the table.
+ *
+ * The exponents are secret: every window is multiplied in, zero windows by
+ * entry 0 (one), and the entry is read by scanning the whole window with a
+ * mask, so that neither the timing nor the memory access pattern depends on
+ * the exponent bits.
+ */
+#define NG_WINDOW_BITS  4
+#define NG_WINDOW_SIZE  (1 << NG_WINDOW_BITS)
+#define NG_EXP_BITS     256
 
 typedef struct
 {
-    BIGNUM     * N;
-    BIGNUM     * g;
+    BIGNUM      * N;
+    BIGNUM      * g;
+    BN_MONT_CTX * mont;
+    BIGNUM      * one;       /* 1 in Montgomery form */
+    unsigned char * table;   /* Powers of g, NULL if not precomputed */
+    int           table_len; /* Size of a table entry */
+    int           cached; /* Shared by all the users and verifiers */
 } NGConstant;
 
 struct NGHex 
@@ -145,31 +171,227 @@ static struct NGHex global_Ng_constants[] = {
 };
 
 
-static NGConstant * new_ng( SRP_NGType ng_type, const char * n_hex, const char * g_hex )
+/* The constants of the predefined groups are parsed and precomputed once,
+ * on first use, and then shared read-only by every thread until exit.
+ */
+static NGConstant * ng_cache[ SRP_NG_CUSTOM ];
+
+#ifdef COMPILE_POSIX
+static pthread_mutex_t ng_cache_lock = PTHREAD_MUTEX_INITIALIZER;
+#elif defined(COMPILE_WIN32)
+static SRWLOCK ng_cache_lock = SRWLOCK_INIT;
+#endif
+
+
+static void free_ng( NGConstant * ng )
 {
-    NGConstant * ng   = (NGConstant *) malloc( sizeof(NGConstant) );
-    ng->N             = BN_new();
-    ng->g             = BN_new();
+    free( ng->table );
+
+    BN_MONT_CTX_free( ng->mont );
+    BN_free( ng->N );
+    BN_free( ng->g );
+    BN_free( ng->one );
+    free( ng );
+}
+
+/* Stores 'bn' (less than N) as table entry 'e'. Returns 0 on success, -1 on error. */
+static int put_ng_table( NGConstant * ng, int e, const BIGNUM * bn )
+{
+    unsigned char * entry = ng->table + (size_t) e * ng->table_len;
+    int             len   = BN_num_bytes( bn );
+
+    if ( len > ng->table_len )
+        return -1;
+
+    memset( entry, 0, ng->table_len - len );
+    BN_bn2bin( bn, entry + ng->table_len - len );
 
-    if ( ng_type != SRP_NG_CUSTOM )
+    return 0;
+}
+
+/* Fills the fixed-base table of g. Returns 0 on success, -1 on error. */
+static int build_ng_table( NGConstant * ng, BN_CTX * ctx )
+{
+    int      windows = NG_EXP_BITS / NG_WINDOW_BITS;
+    BIGNUM * base    = BN_new();
+    BIGNUM * cur     = BN_new();
+    int      i, j, ok = 0;
+
+    ng->table_len = BN_num_bytes( ng->N );
+    ng->table     = (unsigned char *) malloc( (size_t) windows * NG_WINDOW_SIZE * ng->table_len );
+
+    /* base = g^(2^(i * NG_WINDOW_BITS)) and each window is 1, base, base^2,
+     * ..., base^15. The last one times base is the base of the next window.
+     */
+    if ( ng->table && base && cur && BN_to_montgomery( base, ng->g, ng->mont, ctx ) )
     {
-        n_hex = global_Ng_constants[ ng_type ].n_hex;
-        g_hex = global_Ng_constants[ ng_type ].g_hex;
+        for ( i = 0, ok = 1; ok && i < windows; i++ )
+        {
+            ok = put_ng_table( ng, i * NG_WINDOW_SIZE, ng->one ) == 0 && BN_copy( cur, base );
+
+            for ( j = 1; ok && j < NG_WINDOW_SIZE; j++ )
+            {
+                ok = put_ng_table( ng, i * NG_WINDOW_SIZE + j, cur ) == 0 &&
+                     BN_mod_mul_montgomery( cur, cur, base, ng->mont, ctx );
+            }
+
+            ok = ok && BN_copy( base, cur );
+        }
     }
-        
-    BN_hex2bn( &ng->N, n_hex );
-    BN_hex2bn( &ng->g, g_hex );
-    
+
+    BN_free( base );
+    BN_free( cur );
+
+    return ok ? 0 : -1;
+}
+
+/* Reads entry 'w' of window 'i' of the table into 'r', touching every entry
+ * of the window the same way whatever 'w' is
+ */
+static BIGNUM * get_ng_table( BIGNUM * r, const NGConstant * ng, int i, int w, unsigned char * buf )
+{
+    const unsigned char * entry = ng->table + (size_t) i * NG_WINDOW_SIZE * ng->table_len;
+    size_t                len   = ng->table_len;
+    size_t                mask, a, b;
+    size_t                j, k;
+
+    memset( buf, 0, len );
+
+    for ( j = 0; j < NG_WINDOW_SIZE; j++, entry += len )
+    {
+        /* All ones if j == w, 0 otherwise */
+        mask = (size_t) 0 - ((((unsigned int) j ^ (unsigned int) w) - 1) >> (sizeof(unsigned int) * 8 - 1));
+
+        for ( k = 0; k + sizeof(size_t) <= len; k += sizeof(size_t) )
+        {
+            memcpy( &a, buf + k, sizeof(size_t) );
+            memcpy( &b, entry + k, sizeof(size_t) );
+            a |= b & mask;
+            memcpy( buf + k, &a, sizeof(size_t) );
+        }
+
+        for ( ; k < len; k++ )
+            buf[k] |= entry[k] & (unsigned char) mask;
+    }
+
+    return BN_bin2bn( buf, (int) len, r );
+}
+
+/* Parses N and g and sets up their Montgomery context and, if 'with_table',
+ * the fixed-base table of g. Returns NULL on error.
+ */
+static NGConstant * build_ng( const char * n_hex, const char * g_hex, int with_table )
+{
+    NGConstant * ng  = (NGConstant *) calloc( 1, sizeof(NGConstant) );
+    BN_CTX     * ctx = BN_CTX_new();
+    int          ok  = 0;
+
+    if ( ng && ctx )
+    {
+        ng->N    = BN_new();
+        ng->g    = BN_new();
+        ng->one  = BN_new();
+        ng->mont = BN_MONT_CTX_new();
+
+        ok = ng->N && ng->g && ng->one && ng->mont &&
+             BN_hex2bn( &ng->N, n_hex ) && BN_hex2bn( &ng->g, g_hex ) &&
+             BN_MONT_CTX_set( ng->mont, ng->N, ctx ) &&
+             BN_to_montgomery( ng->one, BN_value_one(), ng->mont, ctx ) &&
+             ( !with_table || build_ng_table( ng, ctx ) == 0 );
+    }
+
+    BN_CTX_free( ctx );
+
+    if ( !ok && ng )
+    {
+        free_ng( ng );
+        ng = 0;
+    }
+
+    return ng;
+}
+
+static NGConstant * new_ng( SRP_NGType ng_type, const char * n_hex, const char * g_hex )
+{
+    NGConstant * ng;
+
+    if ( ng_type == SRP_NG_CUSTOM )
+        return build_ng( n_hex, g_hex, 0 );
+
+#ifdef COMPILE_POSIX
+    pthread_mutex_lock( &ng_cache_lock );
+#elif defined(COMPILE_WIN32)
+    AcquireSRWLockExclusive( &ng_cache_lock );
+#endif
+
+    if ( !ng_cache[ ng_type ] && (ng_cache[ ng_type ] = build_ng( global_Ng_constants[ ng_type ].n_hex, global_Ng_constants[ ng_type ].g_hex, 1 )) )
+        ng_cache[ ng_type ]->cached = 1;
+
+    ng = ng_cache[ ng_type ];
+
+#ifdef COMPILE_POSIX
+    pthread_mutex_unlock( &ng_cache_lock );
+#elif defined(COMPILE_WIN32)
+    ReleaseSRWLockExclusive( &ng_cache_lock );
+#endif
+
     return ng;
 }
 
 static void delete_ng( NGConstant * ng )
 {
-    BN_free( ng->N );
-    BN_free( ng->g );
-    ng->N = 0;
-    ng->g = 0;
-    free(ng);
+    if ( ng && !ng->cached )
+        free_ng( ng );
+}
+
+/* r = g^e mod N, for a secret e */
+static int ng_exp_g( BIGNUM * r, const NGConstant * ng, const BIGNUM * e, BN_CTX * ctx )
+{
+    BIGNUM        * acc, * entry;
+    unsigned char * buf;
+    int             i, j, w, ok;
+
+    if ( !ng->table || BN_is_negative(e) || BN_num_bits(e) > NG_EXP_BITS )
+        return BN_mod_exp_mont_consttime( r, ng->g, e, ng->N, ctx, ng->mont );
+
+    if ( !(buf = (unsigned char *) malloc( ng->table_len )) )
+        return 0;
+
+    BN_CTX_start( ctx );
+
+    acc   = BN_CTX_get( ctx );
+    entry = BN_CTX_get( ctx );
+    ok    = entry && BN_copy( acc, ng->one );
+
+    for ( i = 0; ok && i < NG_EXP_BITS / NG_WINDOW_BITS; i++ )
+    {
+        for ( j = NG_WINDOW_BITS - 1, w = 0; j >= 0; j-- )
+            w = (w << 1) | BN_is_bit_set( e, i * NG_WINDOW_BITS + j );
+
+        ok = get_ng_table( entry, ng, i, w, buf ) &&
+             BN_mod_mul_montgomery( acc, acc, entry, ng->mont, ctx );
+    }
+
+    ok = ok && BN_from_montgomery( r, acc, ng->mont, ctx );
+
+    BN_CTX_end( ctx );
+
+    OPENSSL_cleanse( buf, ng->table_len );
+    free( buf );
+
+    return ok;
+}
+
+/* r = a^e mod N, for a secret e */
+static int ng_exp( BIGNUM * r, const BIGNUM * a, const NGConstant * ng, const BIGNUM * e, BN_CTX * ctx )
+{
+    return BN_mod_exp_mont_consttime( r, a, e, ng->N, ctx, ng->mont );
+}
+
+/* r = a^e mod N, for a public e */
+static int ng_exp_pub( BIGNUM * r, const BIGNUM * a, const NGConstant * ng, const BIGNUM * e, BN_CTX * ctx )
+{
+    return BN_mod_exp_mont( r, a, e, ng->N, ctx, ng->mont );
 }
 
 
@@ -393,47 +615,26 @@ static void calculate_H_AMK( SRP_HashAlgorithm alg, unsigned char *dest, const B
 }
 
 
-static void init_random()
-{    
-    if (g_initialized)
-        return;
-    
-    g_initialized = 1;
+/* Same as BN_rand(bn, bits, -1, 0), drawing from the per-thread generator
+ * of rng.c instead of the (locked) OpenSSL one.
+ */
+static void rand_bn( BIGNUM * bn, int bits )
+{
+    unsigned char buff[64];
+    int           len = (bits + 7) / 8;
     
-#ifdef WIN32
-    HCRYPTPROV wctx;
-#else
-    FILE   *fp   = 0;
-#endif
+    if ( len > (int) sizeof(buff) || sidp_rng_bytes( buff, len ) < 0 )
+    {
+        BN_rand(bn, bits, -1, 0);
+        return;
+    }
     
-    unsigned char buff[32];
-
+    if ( bits % 8 )
+        buff[0] &= 0xff >> (8 - bits % 8);
     
-#ifdef WIN32
-
-        CryptAcquireContext(&wctx, NULL, NULL, PROV_RSA_FULL, CRYPT_VERIFYCONTEXT);
-        
-        CryptGenRandom(wctx, sizeof(buff), (BYTE*) buff);
-        
-        CryptReleaseContext(wctx, 0);
-        
-#else
-        fp = fopen("/dev/urandom", "r");
-        
-        if (fp)
-        {
-            fread(buff, sizeof(buff), 1, fp);
-            fclose(fp);
-            
-        }
-        else
-        {
-            /* Dirty... but better than nothing. */
-            gettimeofday( (struct timeval *)buff, 0);
-        }
-#endif
+    BN_bin2bn(buff, len, bn);
     
-    RAND_seed( buff, sizeof(buff) );
+    OPENSSL_cleanse(buff, len);
 }
 
 
@@ -445,8 +646,6 @@ static void init_random()
 
 void srp_random_seed( const unsigned char * random_data, int data_length )
 {
-    g_initialized = 1;
-
     if (random_data)
         RAND_seed( random_data, data_length );
 }
@@ -464,14 +663,26 @@ void srp_create_salted_verification_key( SRP_HashAlgorithm alg,
     BIGNUM     * x   = 0;
     BN_CTX     * ctx = BN_CTX_new();
     NGConstant * ng  = new_ng( ng_type, n_hex, g_hex );
-
-    init_random(); /* Only happens once */
     
-    BN_rand(s, 32, -1, 0);
+    *bytes_s = NULL;
+    *bytes_v = NULL;
+    *len_s   = 0;
+    *len_v   = 0;
+    
+    if ( !ng || !s || !v || !ctx )
+    {
+        delete_ng( ng );
+        BN_free(s);
+        BN_free(v);
+        BN_CTX_free(ctx);
+        return;
+    }
+    
+    rand_bn(s, 32);
     
     x = calculate_x( alg, s, username, password, len_password );
 
-    BN_mod_exp(v, ng->g, x, ng->N, ctx);
+    ng_exp_g(v, ng, x, ctx);
         
     *len_s   = BN_num_bytes(s);
     *len_v   = BN_num_bytes(v);
@@ -516,9 +727,25 @@ struct SRPVerifier *  srp_verifier_new( SRP_HashAlgorithm alg, SRP_NGType ng_typ
     int         ulen = strlen(username) + 1;
     NGConstant *ng   = new_ng( ng_type, n_hex, g_hex );
     
-    struct SRPVerifier * ver = (struct SRPVerifier *) malloc( sizeof(struct SRPVerifier) );
-
-    init_random(); /* Only happens once */
+    struct SRPVerifier * ver = 0;
+    
+    *len_B   = 0;
+    *bytes_B = NULL;
+    
+    if ( !ng || !(ver = (struct SRPVerifier *) malloc( sizeof(struct SRPVerifier) )) )
+    {
+        delete_ng( ng );
+        BN_free(s);
+        BN_free(v);
+        BN_free(A);
+        BN_free(B);
+        BN_free(S);
+        BN_free(b);
+        BN_free(tmp1);
+        BN_free(tmp2);
+        BN_CTX_free(ctx);
+        return 0;
+    }
     
     ver->username = (char *) malloc( ulen );
     ver->hash_alg = alg;
@@ -527,26 +754,27 @@ struct SRPVerifier *  srp_verifier_new( SRP_HashAlgorithm alg, SRP_NGType ng_typ
     memcpy( (char*)ver->username, username, ulen );
     
     ver->authenticated = 0;
+    ver->bytes_B       = 0;
         
     /* SRP-6a safety check */
     BN_mod(tmp1, A, ng->N, ctx);
     if ( !BN_is_zero(tmp1) )
     {        
-        BN_rand(b, 256, -1, 0);
+        rand_bn(b, 256);
         
         k = H_nn(alg, ng->N, ng->g);
         
         /* B = kv + g^b */
         BN_mul(tmp1, k, v, ctx);
-        BN_mod_exp(tmp2, ng->g, b, ng->N, ctx);
+        ng_exp_g(tmp2, ng, b, ctx);
         BN_add(B, tmp1, tmp2);
         
         u = H_nn(alg, A, B);
         
         /* S = (A *(v^u)) ^ b */
-        BN_mod_exp(tmp1, v, u, ng->N, ctx);
+        ng_exp_pub(tmp1, v, ng, u, ctx);
         BN_mul(tmp2, A, tmp1, ctx);
-        BN_mod_exp(S, tmp2, b, ng->N, ctx);
+        ng_exp(S, tmp2, ng, b, ctx);
 
         hash_num(alg, S, ver->session_key);
         
@@ -586,6 +814,9 @@ struct SRPVerifier *  srp_verifier_new( SRP_HashAlgorithm alg, SRP_NGType ng_typ
 
 void srp_verifier_delete( struct SRPVerifier * ver )
 {
+    if ( !ver )
+        return;
+    
     delete_ng( ver->ng );
     free( (char *) ver->username );
     free( (unsigned char *) ver->bytes_B );
@@ -640,12 +871,19 @@ struct SRPUser * srp_user_new( SRP_HashAlgorithm alg, SRP_NGType ng_type, const
 {
     struct SRPUser  *usr  = (struct SRPUser *) malloc( sizeof(struct SRPUser) );
     int              ulen = strlen(username) + 1;
-
-    init_random(); /* Only happens once */
+    
+    if ( !usr )
+        return 0;
     
     usr->hash_alg = alg;
     usr->ng       = new_ng( ng_type, n_hex, g_hex );
     
+    if ( !usr->ng )
+    {
+        free( usr );
+        return 0;
+    }
+    
     usr->a = BN_new();
     usr->A = BN_new();
     usr->S = BN_new();
@@ -666,6 +904,9 @@ struct SRPUser * srp_user_new( SRP_HashAlgorithm alg, SRP_NGType ng_type, const
 
 void srp_user_delete( struct SRPUser * usr )
 {
+    if ( !usr )
+        return;
+    
     BN_free( usr->a );
     BN_free( usr->A );
     BN_free( usr->S );
@@ -717,9 +958,9 @@ void  srp_user_start_authentication( struct SRPUser * usr, const char ** usernam
 {
     BN_CTX  *ctx  = BN_CTX_new();
     
-    BN_rand(usr->a, 256, -1, 0);
+    rand_bn(usr->a, 256);
         
-    BN_mod_exp(usr->A, usr->ng->g, usr->a, usr->ng->N, ctx);
+    ng_exp_g(usr->A, usr->ng, usr->a, ctx);
         
     BN_CTX_free(ctx);
     
@@ -759,15 +1000,14 @@ void  srp_user_process_challenge( struct SRPUser * usr,
     /* SRP-6a safety check */
     if ( !BN_is_zero(B) && !BN_is_zero(u) )
     {
-        BN_mod_exp(v, usr->ng->g, x, usr->ng->N, ctx);
+        ng_exp_g(v, usr->ng, x, ctx);          /* v = g^x              */
         
         /* S = (B - k*(g^x)) ^ (a + ux) */
         BN_mul(tmp1, u, x, ctx);
         BN_add(tmp2, usr->a, tmp1);             /* tmp2 = (a + ux)      */
-        BN_mod_exp(tmp1, usr->ng->g, x, usr->ng->N, ctx);
-        BN_mul(tmp3, k, tmp1, ctx);             /* tmp3 = k*(g^x)       */
+        BN_mul(tmp3, k, v, ctx);                /* tmp3 = k*(g^x)       */
         BN_sub(tmp1, B, tmp3);                  /* tmp1 = (B - K*(g^x)) */
-        BN_mod_exp(usr->S, tmp1, tmp2, usr->ng->N, ctx);
+        ng_exp(usr->S, tmp1, usr->ng, tmp2, ctx);
 
         hash_num(usr->hash_alg, usr->S, usr->session_key);
         
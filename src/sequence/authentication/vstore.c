@@ -0,0 +1,558 @@
+/**
+ * @file vstore.c
+ * @brief SIDP - SRP verifier store
+ *
+ * The host authentication sequences need the SRP salt and verifier of the
+ * user, computed from the password with a modular exponentiation. The store
+ * keeps them per username, created once by sidp_vstore_set(), in a table
+ * whose memory layout is also the file format: sidp_vstore_save() writes it
+ * as is and sidp_vstore_load() maps it read-only, so a store file is shared
+ * by the host processes without being parsed.
+ */
+
+/*
+   Secure Inter-Device Protocol Library
+
+   Copyright 2012-2014 Pedro A. Hortas (pah@ucodev.org)
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#ifdef COMPILE_POSIX
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <arpa/inet.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#elif defined(COMPILE_WIN32)
+#include <windows.h>
+#include <winsock2.h>
+#endif
+
+#include "sidp.h"
+#include "srp.h"
+#include "vstore.h"
+
+/**
+ * @def SIDP_VSTORE_ALG
+ * @brief SRP hash algorithm of the authentication sequences
+ */
+#define SIDP_VSTORE_ALG		SRP_SHA1
+/**
+ * @def SIDP_VSTORE_NG_TYPE
+ * @brief SRP group of the authentication sequences
+ */
+#define SIDP_VSTORE_NG_TYPE	SRP_NG_2048
+/**
+ * @def SIDP_VSTORE_BITS_MAX
+ * @brief Maximum log2 of the number of slots of a verifier store
+ */
+#define SIDP_VSTORE_BITS_MAX	24
+
+/**
+ * @brief Locks the slots of 'vstore' for reading
+ * @param vstore The verifier store
+ */
+static void sidp_vstore_rdlock(struct sidp_vstore *vstore) {
+#ifdef COMPILE_POSIX
+	pthread_rwlock_rdlock(&vstore->lock);
+#elif defined(COMPILE_WIN32)
+	AcquireSRWLockShared(&vstore->lock);
+#endif
+}
+
+/**
+ * @brief Unlocks the slots of 'vstore' after sidp_vstore_rdlock()
+ * @param vstore The verifier store
+ */
+static void sidp_vstore_rdunlock(struct sidp_vstore *vstore) {
+#ifdef COMPILE_POSIX
+	pthread_rwlock_unlock(&vstore->lock);
+#elif defined(COMPILE_WIN32)
+	ReleaseSRWLockShared(&vstore->lock);
+#endif
+}
+
+/**
+ * @brief Locks the slots of 'vstore' for writing
+ * @param vstore The verifier store
+ */
+static void sidp_vstore_wrlock(struct sidp_vstore *vstore) {
+#ifdef COMPILE_POSIX
+	pthread_rwlock_wrlock(&vstore->lock);
+#elif defined(COMPILE_WIN32)
+	AcquireSRWLockExclusive(&vstore->lock);
+#endif
+}
+
+/**
+ * @brief Unlocks the slots of 'vstore' after sidp_vstore_wrlock()
+ * @param vstore The verifier store
+ */
+static void sidp_vstore_wrunlock(struct sidp_vstore *vstore) {
+#ifdef COMPILE_POSIX
+	pthread_rwlock_unlock(&vstore->lock);
+#elif defined(COMPILE_WIN32)
+	ReleaseSRWLockExclusive(&vstore->lock);
+#endif
+}
+
+/**
+ * @brief Initializes the lock of 'vstore'
+ * @param vstore The verifier store
+ * @return 0 on success, -1 on error.
+ */
+static int sidp_vstore_lock_init(struct sidp_vstore *vstore) {
+#ifdef COMPILE_POSIX
+	if (pthread_rwlock_init(&vstore->lock, NULL))
+		return -1;
+#elif defined(COMPILE_WIN32)
+	InitializeSRWLock(&vstore->lock);
+#endif
+
+	return 0;
+}
+
+/**
+ * @brief Releases the header and slots memory of 'vstore'
+ * @param vstore The verifier store
+ */
+static void sidp_vstore_free(struct sidp_vstore *vstore) {
+#ifdef COMPILE_POSIX
+	if (vstore->mapped) {
+		munmap(vstore->header, vstore->size);
+	} else {
+		free(vstore->header);
+	}
+#else
+	free(vstore->header);
+#endif
+
+	vstore->header = NULL;
+	vstore->slots = NULL;
+}
+
+/**
+ * @brief Gets the number of slots of 'vstore'
+ * @param vstore The verifier store
+ * @return The number of slots
+ */
+static uint32_t sidp_vstore_slots(const struct sidp_vstore *vstore) {
+	return 1U << ntohl(vstore->header->bits);
+}
+
+/**
+ * @brief Hashes 'user' (FNV-1a)
+ * @param user The username
+ * @return The hash
+ */
+static uint32_t sidp_vstore_hash(const char *user) {
+	uint32_t hash = 2166136261U;
+
+	while (*user)
+		hash = (hash ^ (unsigned char) *user ++) * 16777619U;
+
+	return hash;
+}
+
+/**
+ * @brief Looks up the slot of 'user' (linear probing). The slots shall be
+ * locked.
+ * @param vstore The verifier store
+ * @param user The username
+ * @return The slot of 'user', the free slot where it shall be added, or NULL
+ * if it isn't found and the store is full.
+ */
+static struct sidp_vstore_slot *sidp_vstore_slot_find(const struct sidp_vstore *vstore, const char *user) {
+	struct sidp_vstore_slot *slot;
+	uint32_t mask = sidp_vstore_slots(vstore) - 1;
+	uint32_t i, n;
+
+	for (i = sidp_vstore_hash(user) & mask, n = 0; n <= mask; i = (i + 1) & mask, n ++) {
+		slot = &vstore->slots[i];
+
+		if (!slot->username[0] || !strncmp(slot->username, user, sizeof(slot->username)))
+			return slot;
+	}
+
+	return NULL;
+}
+
+/**
+ * @brief Validates the header of a loaded verifier store
+ * @param vstore The verifier store
+ * @return 0 if valid, -1 otherwise.
+ */
+static int sidp_vstore_check(const struct sidp_vstore *vstore) {
+	const struct sidp_vstore_header *header = vstore->header;
+
+	if (memcmp(header->magic, SIDP_VSTORE_MAGIC, sizeof(header->magic)))
+		return -1;
+
+	if ((ntohl(header->alg) != SIDP_VSTORE_ALG) || (ntohl(header->ng_type) != SIDP_VSTORE_NG_TYPE))
+		return -1;
+
+	if (ntohl(header->bits) > SIDP_VSTORE_BITS_MAX)
+		return -1;
+
+	if (vstore->size != (sizeof(struct sidp_vstore_header) + sidp_vstore_slots(vstore) * sizeof(struct sidp_vstore_slot)))
+		return -1;
+
+	if (ntohl(header->count) > sidp_vstore_slots(vstore))
+		return -1;
+
+	return 0;
+}
+
+/**
+ * @brief Initializes an empty in-memory verifier store
+ * @param vstore The verifier store
+ * @param size Number of slots, rounded up to a power of two (0 for default).
+ * Up to 3/4 of the slots can be used.
+ * @return 0 on success, negative integer on error.
+ */
+#ifdef COMPILE_WIN32
+DLLIMPORT
+#endif
+int sidp_vstore_init(struct sidp_vstore *vstore, unsigned int size) {
+	uint32_t bits = 0;
+
+	memset(vstore, 0, sizeof(struct sidp_vstore));
+
+	if (!size)
+		size = SIDP_VSTORE_SIZE_DEFAULT;
+
+	while (((1U << bits) < size) && (bits < SIDP_VSTORE_BITS_MAX))
+		bits ++;
+
+	vstore->size = sizeof(struct sidp_vstore_header) + (1U << bits) * sizeof(struct sidp_vstore_slot);
+
+	if (!(vstore->header = (struct sidp_vstore_header *) calloc(1, vstore->size)))
+		return -1;
+
+	vstore->slots = (struct sidp_vstore_slot *) (vstore->header + 1);
+
+	memcpy(vstore->header->magic, SIDP_VSTORE_MAGIC, sizeof(vstore->header->magic));
+	vstore->header->alg = htonl(SIDP_VSTORE_ALG);
+	vstore->header->ng_type = htonl(SIDP_VSTORE_NG_TYPE);
+	vstore->header->bits = htonl(bits);
+
+	if (sidp_vstore_lock_init(vstore) < 0) {
+		sidp_vstore_free(vstore);
+		return -2;
+	}
+
+	return 0;
+}
+
+/**
+ * @brief Loads the verifier store file 'path', written by sidp_vstore_save().
+ * On POSIX systems the file is mapped read-only and looked up in place, so
+ * the store can't be changed with sidp_vstore_set().
+ * @param vstore The verifier store
+ * @param path The store file
+ * @return 0 on success, negative integer on error.
+ */
+#ifdef COMPILE_WIN32
+DLLIMPORT
+#endif
+int sidp_vstore_load(struct sidp_vstore *vstore, const char *path) {
+#ifdef COMPILE_POSIX
+	struct stat st;
+	void *map;
+	int fd;
+#else
+	FILE *fp;
+	long len;
+#endif
+
+	memset(vstore, 0, sizeof(struct sidp_vstore));
+
+#ifdef COMPILE_POSIX
+	if ((fd = open(path, O_RDONLY)) < 0)
+		return -1;
+
+	if ((fstat(fd, &st) < 0) || ((size_t) st.st_size < sizeof(struct sidp_vstore_header))) {
+		close(fd);
+		return -2;
+	}
+
+	map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+
+	close(fd);
+
+	if (map == MAP_FAILED)
+		return -2;
+
+	vstore->header = (struct sidp_vstore_header *) map;
+	vstore->size = st.st_size;
+	vstore->mapped = 1;
+#else
+	if (!(fp = fopen(path, "rb")))
+		return -1;
+
+	if (fseek(fp, 0, SEEK_END) || ((len = ftell(fp)) < (long) sizeof(struct sidp_vstore_header)) || fseek(fp, 0, SEEK_SET)) {
+		fclose(fp);
+		return -2;
+	}
+
+	if (!(vstore->header = (struct sidp_vstore_header *) malloc(len))) {
+		fclose(fp);
+		return -2;
+	}
+
+	vstore->size = len;
+
+	if (fread(vstore->header, 1, len, fp) != (size_t) len) {
+		fclose(fp);
+		sidp_vstore_free(vstore);
+		return -2;
+	}
+
+	fclose(fp);
+#endif
+
+	vstore->slots = (struct sidp_vstore_slot *) (vstore->header + 1);
+
+	if (sidp_vstore_check(vstore) < 0) {
+		sidp_vstore_free(vstore);
+		return -3;
+	}
+
+	if (sidp_vstore_lock_init(vstore) < 0) {
+		sidp_vstore_free(vstore);
+		return -4;
+	}
+
+	return 0;
+}
+
+/**
+ * @brief Saves 'vstore' to the file 'path'. The file is replaced atomically,
+ * so the hosts that mapped the previous one keep using it until reloaded.
+ * The file holds no passwords, but allows dictionary attacks against them
+ * and shall be readable by the host only.
+ * @param vstore The verifier store
+ * @param path The store file
+ * @return 0 on success, negative integer on error.
+ */
+#ifdef COMPILE_WIN32
+DLLIMPORT
+#endif
+int sidp_vstore_save(struct sidp_vstore *vstore, const char *path) {
+	FILE *fp;
+	char *tmp;
+	int ret = 0;
+
+	if (!(tmp = (char *) malloc(strlen(path) + 5)))
+		return -1;
+
+	sprintf(tmp, "%s.tmp", path);
+
+	if (!(fp = fopen(tmp, "wb"))) {
+		free(tmp);
+		return -2;
+	}
+
+	sidp_vstore_rdlock(vstore);
+
+	if (fwrite(vstore->header, 1, vstore->size, fp) != vstore->size)
+		ret = -3;
+
+	sidp_vstore_rdunlock(vstore);
+
+	if (fclose(fp))
+		ret = -3;
+
+#ifdef COMPILE_WIN32
+	/* rename() doesn't replace existing files */
+	if (!ret)
+		remove(path);
+#endif
+
+	if (!ret && rename(tmp, path))
+		ret = -4;
+
+	if (ret < 0)
+		remove(tmp);
+
+	free(tmp);
+
+	return ret;
+}
+
+/**
+ * @brief Releases the resources held by 'vstore'
+ * @see sidp_vstore_init()
+ * @see sidp_vstore_load()
+ * @param vstore The verifier store to be destroyed
+ */
+#ifdef COMPILE_WIN32
+DLLIMPORT
+#endif
+void sidp_vstore_destroy(struct sidp_vstore *vstore) {
+	sidp_vstore_free(vstore);
+
+#ifdef COMPILE_POSIX
+	pthread_rwlock_destroy(&vstore->lock);
+#endif
+}
+
+/**
+ * @brief Creates a new salt and verifier for 'user' from 'pass' and stores
+ * them, replacing the previous ones. The host connections using 'vstore'
+ * authenticate 'user' against the stored verifier, so it shall be set again
+ * whenever the password of 'user' changes.
+ * @param vstore The verifier store (not loaded from a file)
+ * @param user The username
+ * @param pass The password
+ * @return 0 on success, negative integer on error.
+ */
+#ifdef COMPILE_WIN32
+DLLIMPORT
+#endif
+int sidp_vstore_set(
+		struct sidp_vstore *vstore,
+		const char *user,
+		const unsigned char *pass) {
+	struct sidp_vstore_slot *slot;
+
+	const unsigned char *bytes_s = NULL;
+	const unsigned char *bytes_v = NULL;
+
+	int len_s = 0;
+	int len_v = 0;
+
+	int ret = 0;
+
+	if (vstore->mapped)
+		return -1;
+
+	if (!user[0] || (strlen(user) > SIDP_USER_MAX_LEN))
+		return -2;
+
+	/* Create a salted verification key, outside of the lock */
+	srp_create_salted_verification_key(SIDP_VSTORE_ALG, SIDP_VSTORE_NG_TYPE, user, pass, strlen((const char *) pass), &bytes_s, &len_s, &bytes_v, &len_v, NULL, NULL);
+
+	if (!bytes_s || !len_s || (len_s > SIDP_VSTORE_SALT_MAX_LEN) || !bytes_v || !len_v || (len_v > SIDP_VSTORE_VERIFIER_MAX_LEN)) {
+		free((void *) bytes_s);
+		free((void *) bytes_v);
+
+		return -3;
+	}
+
+	sidp_vstore_wrlock(vstore);
+
+	if (!(slot = sidp_vstore_slot_find(vstore, user))) {
+		ret = -4;
+	} else if (!slot->username[0] && (ntohl(vstore->header->count) >= ((sidp_vstore_slots(vstore) / 4) * 3))) {
+		ret = -4;	/* Keep probe sequences short */
+	} else {
+		if (!slot->username[0]) {
+			strcpy(slot->username, user);
+			vstore->header->count = htonl(ntohl(vstore->header->count) + 1);
+		}
+
+		memcpy(slot->bytes_s, bytes_s, len_s);
+		memcpy(slot->bytes_v, bytes_v, len_v);
+		slot->len_s = htons(len_s);
+		slot->len_v = htons(len_v);
+	}
+
+	sidp_vstore_wrunlock(vstore);
+
+	free((void *) bytes_s);
+	free((void *) bytes_v);
+
+	return ret;
+}
+
+/**
+ * @brief Gets the salt and verifier of 'user' from 'vstore', or creates new
+ * ones from 'pass' if 'vstore' is NULL or holds no entry for 'user'
+ * @param vstore The verifier store, or NULL
+ * @param user The username
+ * @param pass The password
+ * @param bytes_s Salt, to be released with free()
+ * @param len_s Length of 'bytes_s'
+ * @param bytes_v Verifier, to be released with free()
+ * @param len_v Length of 'bytes_v'
+ * @return 1 if found in 'vstore', 0 if created, negative integer on error.
+ */
+#ifdef COMPILE_WIN32
+DLLIMPORT
+#endif
+int sidp_vstore_verifier(
+		struct sidp_vstore *vstore,
+		const char *user,
+		const unsigned char *pass,
+		const unsigned char **bytes_s,
+		int *len_s,
+		const unsigned char **bytes_v,
+		int *len_v) {
+	const struct sidp_vstore_slot *slot;
+	unsigned char *s = NULL;
+	unsigned char *v = NULL;
+	int ret = 0;
+
+	if (vstore && user[0]) {
+		sidp_vstore_rdlock(vstore);
+
+		if ((slot = sidp_vstore_slot_find(vstore, user)) && slot->username[0]) {
+			*len_s = ntohs(slot->len_s);
+			*len_v = ntohs(slot->len_v);
+
+			if (!*len_s || (*len_s > SIDP_VSTORE_SALT_MAX_LEN) || !*len_v || (*len_v > SIDP_VSTORE_VERIFIER_MAX_LEN)) {
+				ret = -1;
+			} else if (!(s = (unsigned char *) malloc(*len_s)) || !(v = (unsigned char *) malloc(*len_v))) {
+				free(s);
+				ret = -2;
+			} else {
+				memcpy(s, slot->bytes_s, *len_s);
+				memcpy(v, slot->bytes_v, *len_v);
+
+				*bytes_s = s;
+				*bytes_v = v;
+
+				ret = 1;
+			}
+		}
+
+		sidp_vstore_rdunlock(vstore);
+
+		if (ret)
+			return ret;
+	}
+
+	/* Create a salted verification key */
+	srp_create_salted_verification_key(SIDP_VSTORE_ALG, SIDP_VSTORE_NG_TYPE, user, pass, strlen((const char *) pass), bytes_s, len_s, bytes_v, len_v, NULL, NULL);
+
+	if (!*bytes_s || !*len_s || !*bytes_v || !*len_v) {
+		free((void *) *bytes_s);
+		free((void *) *bytes_v);
+
+		*bytes_s = NULL;
+		*bytes_v = NULL;
+
+		return -3;
+	}
+
+	return 0;
+}
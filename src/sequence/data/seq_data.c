@@ -33,10 +33,17 @@
 /**
  * @brief Gets the encapsulation type, based on 'conn' settings.
  * @see SL_ENCAP_TYPE_DEFAULT
+ * @see SL_ENCAP_TYPE_COMPACT
  * @param conn The SIDP connection structure
  * @return The encapsulation type on success, negative integer on error.
  */
 static int sidp_seq_data_get_encap_type(const struct sidpconn *conn) {
+	/* The host side of a routing connection keeps the device identifiers
+	 * as the remote device sent them, so they can't be elided.
+	 */
+	if (test_bit(&conn->negotiate_flags, SIDP_NEGOTIATE_ENCAP_COMPACT_FL) && (conn->type != SIDP_CONN_TYPE_ROUTING))
+		return SL_ENCAP_TYPE_COMPACT;
+
 	if (test_bit(&conn->negotiate_flags, SIDP_NEGOTIATE_ENCAP_DEFAULT_FL))
 		return SL_ENCAP_TYPE_DEFAULT;
 
@@ -52,10 +59,18 @@ static int sidp_seq_data_get_encap_type(const struct sidpconn *conn) {
  * @brief Gets the compress type, based on 'conn' settings.
  * @see CL_COMPRESS_TYPE_LZO
  * @see CL_COMPRESS_TYPE_ZLIB
+ * @see CL_COMPRESS_TYPE_LZ4
+ * @see CL_COMPRESS_TYPE_TELEMETRY
  * @param conn The SIDP connection structure
  * @return The compress type on success, negative integer on error.
  */
 static int sidp_seq_data_get_compress_type(const struct sidpconn *conn) {
+	if (test_bit(&conn->negotiate_flags, SIDP_NEGOTIATE_COMPRESS_TELEMETRY_FL) && conn->cl_schema.count)
+		return CL_COMPRESS_TYPE_TELEMETRY;
+
+	if (test_bit(&conn->negotiate_flags, SIDP_NEGOTIATE_COMPRESS_LZ4_FL))
+		return CL_COMPRESS_TYPE_LZ4;
+
 	if (test_bit(&conn->negotiate_flags, SIDP_NEGOTIATE_COMPRESS_LZO_FL))
 		return CL_COMPRESS_TYPE_LZO;
 
@@ -78,15 +93,35 @@ static int sidp_seq_data_get_compress_type(const struct sidpconn *conn) {
 /**
  * @brief Gets the cipher type, based on 'conn' settings.
  * @see EL_CIPHER_TYPE_XSALSA20
+ * @see EL_CIPHER_TYPE_CHACHA
+ * @see EL_CIPHER_TYPE_CHACHA20_POLY1305
  * @see EL_CIPHER_TYPE_AES256
+ * @see EL_CIPHER_TYPE_AES256_GCM
+ * @see EL_CIPHER_TYPE_NONE
+ * @see EL_CIPHER_TYPE_NONE_MAC
  * @param conn The SIDP connection structure
  * @return The cipher type on success, negative integer on error.
  */
 static int sidp_seq_data_get_cipher_type(const struct sidpconn *conn) {
+	if (test_bit(&conn->negotiate_flags, SIDP_NEGOTIATE_CIPHER_NONE_MAC_FL))
+		return EL_CIPHER_TYPE_NONE_MAC;
+
+	if (test_bit(&conn->negotiate_flags, SIDP_NEGOTIATE_CIPHER_NONE_FL))
+		return EL_CIPHER_TYPE_NONE;
+
+	if (test_bit(&conn->negotiate_flags, SIDP_NEGOTIATE_CIPHER_AES256_GCM_FL))
+		return EL_CIPHER_TYPE_AES256_GCM;
+
 #ifndef COMPILE_WIN32
+	if (test_bit(&conn->negotiate_flags, SIDP_NEGOTIATE_CIPHER_CHACHA20_POLY1305_FL))
+		return EL_CIPHER_TYPE_CHACHA20_POLY1305;
+
 	if (test_bit(&conn->negotiate_flags, SIDP_NEGOTIATE_CIPHER_XSALSA20_FL))
 		return EL_CIPHER_TYPE_XSALSA20;
 
+	if (test_bit(&conn->negotiate_flags, SIDP_NEGOTIATE_CIPHER_CHACHA_FL))
+		return EL_CIPHER_TYPE_CHACHA;
+
 	if (test_bit(&conn->negotiate_flags, SIDP_NEGOTIATE_CIPHER_CHACHA_AVX_FL))
 		return EL_CIPHER_TYPE_CHACHA_AVX;
 
@@ -105,6 +140,39 @@ static int sidp_seq_data_get_cipher_type(const struct sidpconn *conn) {
 	return -1;
 }
 
+/**
+ * @brief Sets the options 'opt' of the next DATA packet to be sent through
+ * 'conn', based on its negotiated settings. Useful to send packets crafted
+ * with sidp_pkt_send() (e.g. relayed packets) as sidp_seq_data_send() would.
+ * @see sidp_seq_data_send()
+ * @param conn The SIDP connection structure
+ * @param opt The packet options to be set
+ * @return 0 on success, negative integer on error.
+ */
+#ifdef COMPILE_WIN32
+DLLIMPORT
+#endif
+int sidp_seq_data_set_opt(struct sidpconn *conn, struct sidpopt *opt) {
+	int compress_type, compress_level = CL_COMPRESS_LEVEL_DEFAULT;
+
+	/* Ensure that connection is negotiated */
+	if (!test_bit(&conn->status_flags, SIDP_NEGOTIATED_FL))
+		return -1;
+
+	/* Select codec and level for this message */
+	if (test_bit(&conn->negotiate_flags, SIDP_NEGOTIATE_COMPRESS_ADAPTIVE_FL)) {
+		cl_adaptive_select(&conn->cl_adaptive, &compress_type, &compress_level);
+	} else {
+		compress_type = sidp_seq_data_get_compress_type(conn);
+	}
+
+	/* Set packet options */
+	sidp_pkt_set_opt(opt, sidp_seq_data_get_encap_type(conn), sidp_seq_data_get_cipher_type(conn), compress_type, SIDP_MSG_TYPE_DATA, conn->key);
+	opt->compress_level = compress_level;
+
+	return 0;
+}
+
 /**
  * @brief Sends 'data' of length 'len' with the 'conn' settings.
  * @param conn The SIDP connection structure
@@ -135,7 +203,7 @@ int sidp_seq_data_send(
 		return -3;
 
 	/* Set packet options */
-	sidp_pkt_set_opt(&opt, sidp_seq_data_get_encap_type(conn), sidp_seq_data_get_cipher_type(conn), sidp_seq_data_get_compress_type(conn), SIDP_MSG_TYPE_DATA, conn->key);
+	sidp_seq_data_set_opt(conn, &opt);
 
 	/* Create packet */
 	pkt.sdev = conn->sdev;
@@ -151,6 +219,112 @@ int sidp_seq_data_send(
 	return 0;
 }
 
+/**
+ * @brief Sends 'data' of length 'len' to each of the 'count' connections
+ * 'conn', with their settings. The message is compressed once per codec and
+ * level in use, and encrypted once for the connections sharing the cipher
+ * type and key (unless they use counter nonces), instead of once per
+ * connection.
+ * @see sidp_seq_data_send()
+ * @see sidp_pkt_send_fanout()
+ * @param conn The SIDP connection structures
+ * @param count The number of connections
+ * @param data The pointer to a buffer containing the data to be sent
+ * @param len The length of the data to be sent
+ * @param ret If not NULL, set to the value sidp_seq_data_send() would have
+ * returned for each connection
+ * @return Number of connections the data was sent to on success, negative
+ * integer on error.
+ */
+#ifdef COMPILE_WIN32
+DLLIMPORT
+#endif
+int sidp_seq_data_publish(
+		struct sidpconn **conn,
+		unsigned int count,
+		const void *data,
+		size_t len,
+		int *ret) {
+	struct sidpsend *send;
+	struct sidpopt *opt;
+	struct sidppkt *pkt;
+	unsigned int *idx;
+	unsigned int i, n;
+	int sent;
+
+	if (!count)
+		return 0;
+
+	send = malloc(count * sizeof(struct sidpsend));
+	opt = malloc(count * sizeof(struct sidpopt));
+	pkt = malloc(count * sizeof(struct sidppkt));
+	idx = malloc(count * sizeof(unsigned int));
+
+	if (!send || !opt || !pkt || !idx) {
+		free(idx);
+		free(pkt);
+		free(opt);
+		free(send);
+		return -1;
+	}
+
+	for (i = 0, n = 0; i < count; i ++) {
+		/* Check if the connection is initiated, authenticated and
+		 * negotiated */
+		if (!test_bit(&conn[i]->status_flags, SIDP_INITIATED_FL)) {
+			if (ret)
+				ret[i] = -1;
+
+			continue;
+		}
+
+		if (!test_bit(&conn[i]->status_flags, SIDP_AUTHENTICATED_FL)) {
+			if (ret)
+				ret[i] = -2;
+
+			continue;
+		}
+
+		if (!test_bit(&conn[i]->status_flags, SIDP_NEGOTIATED_FL)) {
+			if (ret)
+				ret[i] = -3;
+
+			continue;
+		}
+
+		/* Set packet options */
+		sidp_seq_data_set_opt(conn[i], &opt[n]);
+
+		/* Create packet. All of them carry the same message buffer. */
+		pkt[n].sdev = conn[i]->sdev;
+		pkt[n].ddev = conn[i]->ddev;
+		pkt[n].sid = conn[i]->sid;
+		pkt[n].msg = (void *) data;
+		pkt[n].msg_size = len;
+
+		send[n].conn = conn[i];
+		send[n].pkt = &pkt[n];
+		send[n].opt = &opt[n];
+
+		idx[n ++] = i;
+	}
+
+	/* Dispatch packets */
+	sent = sidp_pkt_send_fanout(send, n);
+
+	if (ret) {
+		for (i = 0; i < n; i ++)
+			ret[idx[i]] = ((sent < 0) || (send[i].ret < 0)) ? -4 : 0;
+	}
+
+	free(idx);
+	free(pkt);
+	free(opt);
+	free(send);
+
+	return sent;
+}
+
 /**
  * @brief Receives data into param 'data' and sets 'len' with the length of 
  * the data received.
@@ -198,3 +372,46 @@ int sidp_seq_data_recv(
 	return 0;
 }
 
+/**
+ * @brief Precomputes the keystream of the next packets to be sent on 'conn',
+ * so that small messages are then encrypted with a XOR and a Poly1305 tag.
+ * Meant to be called when the connection is idle (e.g. from an event loop
+ * with nothing to send). It's a no-op unless counter nonces were negotiated
+ * with a ChaCha or XSalsa20 cipher, and before the first message is sent.
+ * @see el_precompute_seq()
+ * @param conn The SIDP connection structure
+ * @return The number of packets precomputed (0 if there was nothing to do),
+ * negative integer on error.
+ */
+#ifdef COMPILE_WIN32
+DLLIMPORT
+#endif
+int sidp_seq_data_precompute(struct sidpconn *conn) {
+	struct el_data eld;
+	int ret;
+
+	/* Check if the connection is initiated */
+	if (!test_bit(&conn->status_flags, SIDP_INITIATED_FL))
+		return -1;
+
+	/* Ensure that connection is authenticated */
+	if (!test_bit(&conn->status_flags, SIDP_AUTHENTICATED_FL))
+		return -2;
+
+	/* Ensure that connection is negotiated */
+	if (!test_bit(&conn->status_flags, SIDP_NEGOTIATED_FL))
+		return -3;
+
+	/* Packet nonces are only known ahead with counter nonces */
+	if (!test_bit(&conn->negotiate_flags, SIDP_NEGOTIATE_NONCE_COUNTER_FL))
+		return 0;
+
+	if (el_data_init(&eld, sidp_seq_data_get_cipher_type(conn)) < 0)
+		return -4;
+
+	if ((ret = el_precompute_seq(&eld, &conn->el_out, &conn->el_nonce_out, conn->key, EL_KEYSTREAM_SLOTS)) < 0)
+		return -5;
+
+	return ret;
+}
+
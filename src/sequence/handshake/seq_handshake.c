@@ -0,0 +1,1370 @@
+/**
+ * @file seq_handshake.c
+ * @brief SIDP - Combined Handshake Sequence API
+ *
+ * The init, authentication and negotiation sequences are pipelined in two
+ * round trips:
+ *
+ *   User -> Host: HELLO      init data, support flags, username, A
+ *   Host -> User: CHALLENGE  init reply, crossed support flags, s, B
+ *   User -> Host: PROOF      M, user MAC
+ *   Host -> User: VERIFY     HAMK, host MAC, resumption ticket
+ *
+ * The MACs of a full handshake are keyed by a secret derived from the SRP
+ * session key and cover the HELLO and CHALLENGE messages, so that the crossed
+ * support flags are bound to the session. They're only sent along with the
+ * SRP proofs, so the CHALLENGE gives nothing to check a password guess
+ * against.
+ *
+ * On persistent connections, a user holding a resumption ticket skips SRP:
+ *
+ *   User -> Host: HELLO      init data, support flags, username, ticket, nonce
+ *   Host -> User: CHALLENGE  init reply, ticket flags, nonce, host MAC
+ *   User -> Host: PROOF      user MAC
+ *
+ * The MACs are keyed by the resumption secret bound to the ticket, and cover
+ * the HELLO and CHALLENGE messages. A rejected ticket is answered with an
+ * empty CHALLENGE, and the user follows with a full handshake.
+ *
+ * Both end-points shall use the handshake sequence (it does not interoperate
+ * with the init/auth/negotiation sequences).
+ */
+
+/*
+   Secure Inter-Device Protocol Library
+
+   Copyright 2012-2014 Pedro A. Hortas (pah@ucodev.org)
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+
+#include <openssl/crypto.h>
+#include <openssl/evp.h>
+#include <openssl/hmac.h>
+#include <openssl/sha.h>
+
+#ifdef COMPILE_POSIX
+#include <arpa/inet.h>
+#elif defined(COMPILE_WIN32)
+#include <windows.h>
+#include <winsock2.h>
+#endif
+
+#include "sidp.h"
+#include "bitops.h"
+#include "rng.h"
+#include "el_api.h"
+#include "srp.h"
+#include "seq_init.h"
+#include "seq_negotiation.h"
+#include "seq_handshake.h"
+
+/**
+ * @brief Copies string 'src' into 'dst', truncated to 'size' - 1 bytes. The
+ * whole of 'dst' is cleared first, so nothing of a previous, longer, value is
+ * left after the terminator.
+ * @param dst The destination buffer (e.g. conn->user, conn->key)
+ * @param size The size of 'dst'
+ * @param src The string to be copied
+ */
+static void sidp_seq_handshake_set_str(char *dst, size_t size, const char *src) {
+	size_t len = strlen(src);
+
+	if (len >= size)
+		len = size - 1;
+
+	memset(dst, 0, size);
+	memcpy(dst, src, len);
+	dst[len] = 0;
+}
+
+/**
+ * @brief Send a handshake sequence packet
+ * @param conn SIDP connection descriptor
+ * @param data Handshake data to be sent
+ * @param msg_type SIDP_MSG_TYPE_INIT or SIDP_MSG_TYPE_AUTH
+ */
+static int sidp_seq_handshake_pkt_send(
+		struct sidpconn *conn,
+		const struct hs_data *data,
+		uint16_t msg_type) {
+	struct sidpopt opt;
+	struct sidppkt pkt;
+
+	/* Reset options and packet memory */
+	memset(&pkt, 0, sizeof(struct sidppkt));
+	memset(&opt, 0, sizeof(struct sidpopt));
+
+	/* Set SIDP packet options */
+	sidp_pkt_set_opt(&opt, SL_ENCAP_TYPE_DEFAULT, 0, 0, msg_type, NULL);
+
+	/* Create SIDP packet */
+	pkt.sdev = conn->sdev;
+	pkt.ddev = conn->ddev;
+	pkt.sid = conn->sid;
+	pkt.msg = (void *) data->buf;
+	pkt.msg_size = data->len;
+
+	/* Dispatch packet */
+	if (sidp_pkt_send(conn, &pkt, &opt) < 0)
+		return -1;
+
+	return 0;
+}
+
+/**
+ * @brief Receives a handshake sequence packet
+ * @param conn SIDP connection descriptor
+ * @param data Received handshake data buffer
+ * @param msg_type Expected message type
+ */
+static int sidp_seq_handshake_pkt_recv(
+		struct sidpconn *conn,
+		struct hs_data *data,
+		uint16_t msg_type) {
+	struct sidpopt opt;
+	struct sidppkt pkt;
+
+	/* Reset data, options and packet memory */
+	data->len = 0;
+	data->pos = 0;
+	memset(&pkt, 0, sizeof(struct sidppkt));
+	memset(&opt, 0, sizeof(struct sidpopt));
+
+	/* Receive packet */
+	if (sidp_pkt_recv(conn, &pkt, &opt) < 0)
+		return -1;
+
+	/* Check if the received message type is the expected one and if it
+	 * fits the data buffer
+	 */
+	if ((opt.msg_type != msg_type) || (pkt.msg_size > sizeof(data->buf))) {
+		free(pkt.msg);
+		return -2;
+	}
+
+	/* Copy packet message to data buffer */
+	memcpy(data->buf, pkt.msg, pkt.msg_size);
+	data->len = pkt.msg_size;
+
+	/* Free packet memory */
+	free(pkt.msg);
+
+	return 0;
+}
+
+/**
+ * @brief Appends 'len' bytes of a fixed size field to handshake data
+ * @param data Handshake data
+ * @param field Field to be appended
+ * @param len Length of 'field'
+ * @return 0 on success, -1 if 'data' is full.
+ */
+static int sidp_seq_handshake_put(
+		struct hs_data *data,
+		const void *field,
+		size_t len) {
+	if (len > (sizeof(data->buf) - data->len))
+		return -1;
+
+	if (len)
+		memcpy(&data->buf[data->len], field, len);
+
+	data->len += len;
+
+	return 0;
+}
+
+/**
+ * @brief Appends a 16-bit length-prefixed field to handshake data
+ * @param data Handshake data
+ * @param field Field to be appended (NULL if empty)
+ * @param len Length of 'field'
+ * @return 0 on success, -1 if 'data' is full.
+ */
+static int sidp_seq_handshake_put_field(
+		struct hs_data *data,
+		const void *field,
+		size_t len) {
+	uint16_t len_field = htons((uint16_t) len);
+
+	if (len > SIDP_HANDSHAKE_FIELD_MAX_LEN)
+		return -1;
+
+	if (sidp_seq_handshake_put(data, &len_field, sizeof(len_field)) < 0)
+		return -1;
+
+	return sidp_seq_handshake_put(data, field, len);
+}
+
+/**
+ * @brief Extracts 'len' bytes of a fixed size field from handshake data
+ * @param data Handshake data
+ * @param field Buffer to store the field
+ * @param len Length of 'field'
+ * @return 0 on success, -1 if 'data' is truncated.
+ */
+static int sidp_seq_handshake_get(
+		struct hs_data *data,
+		void *field,
+		size_t len) {
+	if (len > (data->len - data->pos))
+		return -1;
+
+	memcpy(field, &data->buf[data->pos], len);
+	data->pos += len;
+
+	return 0;
+}
+
+/**
+ * @brief Extracts a 16-bit length-prefixed field from handshake data
+ * @param data Handshake data
+ * @param field Set to the field contents, within 'data'
+ * @param len Set to the length of 'field'
+ * @return 0 on success, -1 if 'data' is truncated or the field is too long.
+ */
+static int sidp_seq_handshake_get_field(
+		struct hs_data *data,
+		const unsigned char **field,
+		size_t *len) {
+	uint16_t len_field;
+
+	if (sidp_seq_handshake_get(data, &len_field, sizeof(len_field)) < 0)
+		return -1;
+
+	*len = ntohs(len_field);
+
+	if ((*len > SIDP_HANDSHAKE_FIELD_MAX_LEN) || (*len > (data->len - data->pos)))
+		return -1;
+
+	*field = &data->buf[data->pos];
+	data->pos += *len;
+
+	return 0;
+}
+
+/**
+ * @brief Composes a new handshake message with the version, the init
+ * sequence data and the support flags
+ * @param data Handshake data
+ * @param init_data Init sequence data (network order)
+ * @param flags Support flags (host order)
+ * @return 0 on success, -1 on error.
+ */
+static int sidp_seq_handshake_put_init(
+		struct hs_data *data,
+		const struct init_data *init_data,
+		uint32_t flags) {
+	uint8_t version = SIDP_HANDSHAKE_VERSION;
+
+	data->len = 0;
+	data->pos = 0;
+
+	flags = htonl(flags);
+
+	if (sidp_seq_handshake_put(data, &version, sizeof(version)) < 0)
+		return -1;
+
+	if (sidp_seq_handshake_put(data, &init_data->conn_type, sizeof(init_data->conn_type)) < 0)
+		return -1;
+
+	if (sidp_seq_handshake_put(data, &init_data->sdev, sizeof(init_data->sdev)) < 0)
+		return -1;
+
+	if (sidp_seq_handshake_put(data, &init_data->ddev, sizeof(init_data->ddev)) < 0)
+		return -1;
+
+	if (sidp_seq_handshake_put(data, &init_data->sid, sizeof(init_data->sid)) < 0)
+		return -1;
+
+	return sidp_seq_handshake_put(data, &flags, sizeof(flags));
+}
+
+/**
+ * @brief Extracts the version, the init sequence data and the support flags
+ * of a received handshake message
+ * @param data Handshake data
+ * @param init_data Init sequence data (network order)
+ * @param flags Support flags (host order)
+ * @return 0 on success, -1 if truncated, -2 on version mismatch.
+ */
+static int sidp_seq_handshake_get_init(
+		struct hs_data *data,
+		struct init_data *init_data,
+		uint32_t *flags) {
+	uint8_t version;
+
+	memset(init_data, 0, sizeof(struct init_data));
+
+	if (sidp_seq_handshake_get(data, &version, sizeof(version)) < 0)
+		return -1;
+
+	if (version != SIDP_HANDSHAKE_VERSION)
+		return -2;
+
+	if (sidp_seq_handshake_get(data, &init_data->conn_type, sizeof(init_data->conn_type)) < 0)
+		return -1;
+
+	if (sidp_seq_handshake_get(data, &init_data->sdev, sizeof(init_data->sdev)) < 0)
+		return -1;
+
+	if (sidp_seq_handshake_get(data, &init_data->ddev, sizeof(init_data->ddev)) < 0)
+		return -1;
+
+	if (sidp_seq_handshake_get(data, &init_data->sid, sizeof(init_data->sid)) < 0)
+		return -1;
+
+	if (sidp_seq_handshake_get(data, flags, sizeof(*flags)) < 0)
+		return -1;
+
+	*flags = ntohl(*flags);
+
+	return 0;
+}
+
+/**
+ * @brief Extracts the fields of a received HELLO message
+ * @param data Handshake data
+ * @param hello Decoded HELLO message
+ * @return 0 on success, negative integer if malformed.
+ */
+static int sidp_seq_handshake_get_hello(
+		struct hs_data *data,
+		struct hs_hello *hello) {
+	const unsigned char *field = NULL;
+	size_t len = 0;
+
+	if (sidp_seq_handshake_get_init(data, &hello->init_data, &hello->flags) < 0)
+		return -1;
+
+	if ((sidp_seq_handshake_get_field(data, &field, &len) < 0) || (len > SIDP_USER_MAX_LEN))
+		return -1;
+
+	memset(hello->username, 0, sizeof(hello->username));
+	memcpy(hello->username, field, len);
+
+	if (sidp_seq_handshake_get_field(data, &hello->bytes_A, &hello->len_A) < 0)
+		return -1;
+
+	if (sidp_seq_handshake_get_field(data, &hello->ticket, &hello->len_ticket) < 0)
+		return -1;
+
+	if (sidp_seq_handshake_get_field(data, &hello->nonce, &hello->len_nonce) < 0)
+		return -1;
+
+	return 0;
+}
+
+/**
+ * @brief Composes a CHALLENGE message with the init reply, the crossed
+ * support flags and the SRP salt and public ephemeral value (both empty on a
+ * resumption or a rejected ticket). The nonce and MAC fields are appended by
+ * the caller.
+ * @param data Handshake data
+ * @param hello Decoded HELLO message, with the init reply and the crossed
+ * support flags
+ * @param bytes_s Salt
+ * @param len_s Length of 'bytes_s'
+ * @param bytes_B Host public ephemeral value
+ * @param len_B Length of 'bytes_B'
+ * @return 0 on success, -1 on error.
+ */
+static int sidp_seq_handshake_put_challenge(
+		struct hs_data *data,
+		const struct hs_hello *hello,
+		const unsigned char *bytes_s,
+		size_t len_s,
+		const unsigned char *bytes_B,
+		size_t len_B) {
+	if (sidp_seq_handshake_put_init(data, &hello->init_data, hello->flags) < 0)
+		return -1;
+
+	if (sidp_seq_handshake_put_field(data, bytes_s, len_s) < 0)
+		return -1;
+
+	return sidp_seq_handshake_put_field(data, bytes_B, len_B);
+}
+
+/**
+ * @brief Derives a secret from the SRP session key: the resumption secret or
+ * the key of the confirmation MACs of a full handshake
+ * @param session_key SRP session key
+ * @param len Length of 'session_key'
+ * @param label "sidp resumption" or "sidp confirmation"
+ * @param secret Derived secret (SIDP_TICKET_SECRET_LEN bytes)
+ * @return 0 on success, -1 on error.
+ */
+static int sidp_seq_handshake_secret(
+		const unsigned char *session_key,
+		int len,
+		const char *label,
+		unsigned char *secret) {
+	unsigned int secret_len = 0;
+
+	if (!HMAC(EVP_sha256(), session_key, len, (const unsigned char *) label, strlen(label), secret, &secret_len))
+		return -1;
+
+	return -(secret_len != SIDP_TICKET_SECRET_LEN);
+}
+
+/**
+ * @brief Computes a MAC of a handshake: HMAC-SHA256, keyed by 'secret' and the
+ * connection key, of the 'role' byte, the HELLO message and the first 'len'
+ * bytes of the CHALLENGE message
+ * @param conn SIDP connection descriptor
+ * @param secret Resumption secret, or confirmation secret on a full handshake
+ * @param role 'h' for the host MAC, 'u' for the user MAC
+ * @param hello HELLO message
+ * @param challenge CHALLENGE message
+ * @param len Length of 'challenge' covered by the MAC
+ * @param mac MAC (SIDP_HANDSHAKE_MAC_LEN bytes)
+ * @return 0 on success, -1 on error.
+ */
+static int sidp_seq_handshake_mac(
+		const struct sidpconn *conn,
+		const unsigned char *secret,
+		unsigned char role,
+		const struct hs_data *hello,
+		const struct hs_data *challenge,
+		size_t len,
+		unsigned char *mac) {
+	unsigned char buf[1 + (2 * SIDP_HANDSHAKE_MSG_MAX_LEN)];
+	unsigned char mac_key[SIDP_HANDSHAKE_MAC_LEN];
+	unsigned int mac_len = 0;
+	int ret = 0;
+
+	/* Both end-points shall also hold the same connection key */
+	if (!HMAC(EVP_sha256(), secret, SIDP_TICKET_SECRET_LEN, conn->key, strlen((const char *) conn->key), mac_key, &mac_len))
+		return -1;
+
+	buf[0] = role;
+	memcpy(&buf[1], hello->buf, hello->len);
+	memcpy(&buf[1 + hello->len], challenge->buf, len);
+
+	if (!HMAC(EVP_sha256(), mac_key, sizeof(mac_key), buf, 1 + hello->len + len, mac, &mac_len) || (mac_len != SIDP_HANDSHAKE_MAC_LEN))
+		ret = -1;
+
+	memset(mac_key, 0, sizeof(mac_key));
+
+	return ret;
+}
+
+/**
+ * @brief Appends a resumption ticket and its lifetime to a VERIFY message.
+ * The ticket binds the user, the device, the negotiated flags, a digest of
+ * the connection key (so that a password change invalidates it) and the
+ * resumption secret, and is encrypted with the ticket key of 'conn'. An
+ * empty ticket is appended if the host doesn't issue tickets for 'conn'.
+ * @param conn SIDP connection descriptor
+ * @param data Handshake data
+ * @param flags Negotiated (crossed) support flags
+ * @param secret Resumption secret
+ * @return 0 on success, -1 on error.
+ */
+static int sidp_seq_handshake_ticket_issue(
+		const struct sidpconn *conn,
+		struct hs_data *data,
+		uint32_t flags,
+		const unsigned char *secret) {
+	unsigned char ticket[SIDP_TICKET_MAX_LEN];
+	unsigned char key_digest[SHA256_DIGEST_LENGTH];
+	struct hs_data plain;
+	struct el_data eld;
+	uint8_t version = SIDP_HANDSHAKE_VERSION;
+	uint64_t expires;
+	uint32_t expires_hi, expires_lo, sdev, lifetime = 0;
+	uint16_t conn_type;
+	int len = 0;
+
+	/* Tickets are only issued for persistent connections */
+	if (!conn->ticket_key || (conn->type != SIDP_CONN_TYPE_PERSISTENT) || (el_data_init(&eld, EL_CIPHER_TYPE_CHACHA20_POLY1305) < 0)) {
+		if (sidp_seq_handshake_put_field(data, NULL, 0) < 0)
+			return -1;
+
+		return sidp_seq_handshake_put(data, &lifetime, sizeof(lifetime));
+	}
+
+	expires = (uint64_t) time(NULL) + conn->ticket_key->lifetime;
+	expires_hi = htonl((uint32_t) (expires >> 32));
+	expires_lo = htonl((uint32_t) expires);
+	conn_type = htons(conn->type);
+	sdev = htonl(conn->ddev);
+	flags = htonl(flags);
+
+	SHA256(conn->key, strlen((const char *) conn->key), key_digest);
+
+	/* Compose the plain-text ticket */
+	plain.len = 0;
+
+	if ((sidp_seq_handshake_put(&plain, &version, sizeof(version)) < 0) ||
+			(sidp_seq_handshake_put(&plain, &expires_hi, sizeof(expires_hi)) < 0) ||
+			(sidp_seq_handshake_put(&plain, &expires_lo, sizeof(expires_lo)) < 0) ||
+			(sidp_seq_handshake_put(&plain, &conn_type, sizeof(conn_type)) < 0) ||
+			(sidp_seq_handshake_put(&plain, &sdev, sizeof(sdev)) < 0) ||
+			(sidp_seq_handshake_put(&plain, &flags, sizeof(flags)) < 0) ||
+			(sidp_seq_handshake_put(&plain, key_digest, sizeof(key_digest)) < 0) ||
+			(sidp_seq_handshake_put(&plain, secret, SIDP_TICKET_SECRET_LEN) < 0) ||
+			(sidp_seq_handshake_put_field(&plain, conn->user, strlen(conn->user)) < 0))
+		return -1;
+
+	/* Encrypt it */
+	if (eld.encrypt_output_len(plain.len) <= sizeof(ticket))
+		len = eld.encrypt(conn->ticket_key->key, ticket, plain.buf, plain.len);
+
+	memset(plain.buf, 0, plain.len);
+
+	if (len <= 0)
+		return -1;
+
+	lifetime = htonl(conn->ticket_key->lifetime);
+
+	if (sidp_seq_handshake_put_field(data, ticket, len) < 0)
+		return -1;
+
+	return sidp_seq_handshake_put(data, &lifetime, sizeof(lifetime));
+}
+
+/**
+ * @brief Opens the resumption ticket of a HELLO message and validates it
+ * against the connection settings and key set from that message
+ * @param conn SIDP connection descriptor
+ * @param hello Decoded HELLO message, with the crossed support flags
+ * @param ticket Contents of the ticket
+ * @return 0 if the ticket is valid, negative integer otherwise.
+ */
+static int sidp_seq_handshake_ticket_open(
+		const struct sidpconn *conn,
+		const struct hs_hello *hello,
+		struct hs_ticket *ticket) {
+	unsigned char key_digest[SHA256_DIGEST_LENGTH];
+	unsigned char ticket_digest[SHA256_DIGEST_LENGTH];
+	struct hs_data plain;
+	struct el_data eld;
+	const unsigned char *username = NULL;
+	size_t len_user = 0;
+	uint64_t expires;
+	uint32_t expires_hi, expires_lo, sdev;
+	uint16_t conn_type;
+	uint8_t version;
+	int len, ret = 0;
+
+	if (!conn->ticket_key || !hello->len_ticket || (hello->len_ticket > SIDP_TICKET_MAX_LEN))
+		return -1;
+
+	if (el_data_init(&eld, EL_CIPHER_TYPE_CHACHA20_POLY1305) < 0)
+		return -1;
+
+	/* Decrypt and authenticate the ticket */
+	if (hello->len_ticket < eld.encrypt_output_len(0))
+		return -2;
+
+	if ((len = eld.decrypt(conn->ticket_key->key, plain.buf, hello->ticket, hello->len_ticket)) < 0)
+		return -2;
+
+	plain.len = len;
+	plain.pos = 0;
+
+	if ((sidp_seq_handshake_get(&plain, &version, sizeof(version)) < 0) ||
+			(sidp_seq_handshake_get(&plain, &expires_hi, sizeof(expires_hi)) < 0) ||
+			(sidp_seq_handshake_get(&plain, &expires_lo, sizeof(expires_lo)) < 0) ||
+			(sidp_seq_handshake_get(&plain, &conn_type, sizeof(conn_type)) < 0) ||
+			(sidp_seq_handshake_get(&plain, &sdev, sizeof(sdev)) < 0) ||
+			(sidp_seq_handshake_get(&plain, &ticket->flags, sizeof(ticket->flags)) < 0) ||
+			(sidp_seq_handshake_get(&plain, ticket_digest, sizeof(ticket_digest)) < 0) ||
+			(sidp_seq_handshake_get(&plain, ticket->secret, SIDP_TICKET_SECRET_LEN) < 0) ||
+			(sidp_seq_handshake_get_field(&plain, &username, &len_user) < 0)) {
+		ret = -3;
+	} else {
+		expires = ((uint64_t) ntohl(expires_hi) << 32) | ntohl(expires_lo);
+		ticket->flags = ntohl(ticket->flags);
+
+		SHA256(conn->key, strlen((const char *) conn->key), key_digest);
+
+		if (version != SIDP_HANDSHAKE_VERSION) {
+			ret = -3;
+		} else if (expires <= (uint64_t) time(NULL)) {
+			ret = -4; /* Expired */
+		} else if ((ntohs(conn_type) != conn->type) || (ntohl(sdev) != conn->ddev)) {
+			ret = -5; /* Issued to another device or connection type */
+		} else if ((len_user != strlen(hello->username)) || memcmp(username, hello->username, len_user)) {
+			ret = -6; /* Issued to another user */
+		} else if (ticket->flags & ~hello->flags) {
+			ret = -7; /* Negotiated flags no longer supported */
+		} else if (CRYPTO_memcmp(ticket_digest, key_digest, sizeof(key_digest))) {
+			ret = -8; /* Password changed */
+		}
+	}
+
+	memset(plain.buf, 0, plain.len);
+
+	if (ret < 0)
+		memset(ticket, 0, sizeof(struct hs_ticket));
+
+	return ret;
+}
+
+/**
+ * @brief Exchanges the user handshake sequence messages with the host
+ * @param conn SIDP connection descriptor
+ * @param usr SRP user
+ * @return 0 on success, negative integer on error.
+ */
+static int sidp_seq_handshake_user_exchange(
+		struct sidpconn *conn,
+		struct SRPUser *usr) {
+	unsigned char secret[SIDP_TICKET_SECRET_LEN];
+	unsigned char mac_u[SIDP_HANDSHAKE_MAC_LEN];
+	unsigned char mac[SIDP_HANDSHAKE_MAC_LEN];
+	struct hs_data hello_data;
+	struct hs_data hs_data;
+	struct init_data init_data;
+
+	const unsigned char *bytes_A = NULL;
+	const unsigned char *bytes_M = NULL;
+	const unsigned char *bytes_s = NULL;
+	const unsigned char *bytes_B = NULL;
+	const unsigned char *bytes_HAMK = NULL;
+	const unsigned char *session_key = NULL;
+	const unsigned char *field = NULL;
+	const unsigned char *ticket = NULL;
+	const unsigned char *mac_h = NULL;
+
+	int len_A = 0;
+	int len_M = 0;
+	int len_key = 0;
+	size_t len_s = 0;
+	size_t len_B = 0;
+	size_t len_HAMK = 0;
+	size_t len_field = 0;
+	size_t len_ticket = 0;
+	size_t len_mac = 0;
+
+	const char *auth_username = NULL;
+	uint32_t flags, lifetime;
+	int ret;
+
+	/* Start user authentication */
+	srp_user_start_authentication(usr, &auth_username, &bytes_A, &len_A);
+
+	/* SEND to Host: init data, support flags, username, bytes_A (no ticket
+	 * and no nonce)
+	 */
+	init_data.conn_type = htons(conn->type);
+	init_data.sdev = htonl(conn->sdev);
+	init_data.ddev = htonl(conn->ddev);
+	init_data.sid = htonl(conn->sid);
+
+	if (sidp_seq_handshake_put_init(&hello_data, &init_data, sidp_seq_negotiation_support_flags(conn)) < 0)
+		return -2;
+
+	if (sidp_seq_handshake_put_field(&hello_data, conn->user, strlen(conn->user)) < 0)
+		return -2;
+
+	if (sidp_seq_handshake_put_field(&hello_data, bytes_A, len_A) < 0)
+		return -2;
+
+	if ((sidp_seq_handshake_put_field(&hello_data, NULL, 0) < 0) || (sidp_seq_handshake_put_field(&hello_data, NULL, 0) < 0))
+		return -2;
+
+	if (sidp_seq_handshake_pkt_send(conn, &hello_data, SIDP_MSG_TYPE_INIT) < 0)
+		return -3;
+
+	/* RECV from Host: init reply, crossed support flags, bytes_s, bytes_B
+	 * (and the empty nonce and MAC fields)
+	 */
+	if (sidp_seq_handshake_pkt_recv(conn, &hs_data, SIDP_MSG_TYPE_INIT) < 0)
+		return -4;
+
+	if (sidp_seq_handshake_get_init(&hs_data, &init_data, &flags) < 0)
+		return -4;
+
+	if (sidp_seq_handshake_get_field(&hs_data, &bytes_s, &len_s) < 0)
+		return -4;
+
+	if (sidp_seq_handshake_get_field(&hs_data, &bytes_B, &len_B) < 0)
+		return -4;
+
+	if ((sidp_seq_handshake_get_field(&hs_data, &field, &len_field) < 0) || (sidp_seq_handshake_get_field(&hs_data, &field, &len_field) < 0))
+		return -4;
+
+	/* Validate init reply */
+	if (sidp_seq_init_user_validate(conn, &init_data) < 0)
+		return -5;
+
+	/* Set connection to initiated */
+	set_bit(&conn->status_flags, SIDP_INITIATED_FL);
+
+	/* User SRP-6a safety check */
+	srp_user_process_challenge(usr, bytes_s, len_s, bytes_B, len_B, &bytes_M, &len_M);
+
+	if (!bytes_M)
+		return -6; /* Safety check violated */
+
+	/* Confirm the HELLO and CHALLENGE messages, as sent and received by
+	 * this end-point, under the SRP session key
+	 */
+	session_key = srp_user_get_session_key(usr, &len_key);
+
+	if (sidp_seq_handshake_secret(session_key, len_key, "sidp confirmation", secret) < 0)
+		return -7;
+
+	ret = sidp_seq_handshake_mac(conn, secret, 'u', &hello_data, &hs_data, hs_data.len, mac_u);
+
+	if (!ret)
+		ret = sidp_seq_handshake_mac(conn, secret, 'h', &hello_data, &hs_data, hs_data.len, mac);
+
+	memset(secret, 0, sizeof(secret));
+
+	if (ret < 0)
+		return -7;
+
+	/* SEND to Host: bytes_M, user MAC */
+	hs_data.len = 0;
+
+	if (sidp_seq_handshake_put_field(&hs_data, bytes_M, len_M) < 0)
+		return -7;
+
+	if (sidp_seq_handshake_put_field(&hs_data, mac_u, sizeof(mac_u)) < 0)
+		return -7;
+
+	if (sidp_seq_handshake_pkt_send(conn, &hs_data, SIDP_MSG_TYPE_AUTH) < 0)
+		return -7;
+
+	/* RECV from Host: bytes_HAMK, host MAC, resumption ticket and its
+	 * lifetime
+	 */
+	if (sidp_seq_handshake_pkt_recv(conn, &hs_data, SIDP_MSG_TYPE_AUTH) < 0)
+		return -8;
+
+	if (sidp_seq_handshake_get_field(&hs_data, &bytes_HAMK, &len_HAMK) < 0)
+		return -8;
+
+	if (sidp_seq_handshake_get_field(&hs_data, &mac_h, &len_mac) < 0)
+		return -8;
+
+	if ((sidp_seq_handshake_get_field(&hs_data, &ticket, &len_ticket) < 0) || (len_ticket > SIDP_TICKET_MAX_LEN))
+		return -8;
+
+	if (sidp_seq_handshake_get(&hs_data, &lifetime, sizeof(lifetime)) < 0)
+		return -8;
+
+	/* User session verification */
+	if (len_HAMK != (size_t) srp_user_get_session_key_length(usr))
+		return -9;
+
+	srp_user_verify_session(usr, bytes_HAMK);
+
+	/* Verify authentication */
+	if (!srp_user_is_authenticated(usr))
+		return -9; /* Authentication failed */
+
+	/* Verify that the host got the same HELLO and sent the same CHALLENGE */
+	if ((len_mac != sizeof(mac)) || CRYPTO_memcmp(mac_h, mac, sizeof(mac)))
+		return -9; /* Authentication failed */
+
+	/* Set connection status to authenticated */
+	set_bit(&conn->status_flags, SIDP_AUTHENTICATED_FL);
+
+	/* Select the settings of the connection. The crossed support flags
+	 * shall not contain any flag not supported by this end-point.
+	 */
+	if (sidp_seq_negotiation_set_flags(conn, flags & sidp_seq_negotiation_support_flags(conn)) < 0)
+		return -10;
+
+	/* Keep the resumption ticket, if any, for the next connection */
+	if (conn->ticket && len_ticket) {
+		if (sidp_seq_handshake_secret(session_key, len_key, "sidp resumption", conn->ticket->secret) < 0) {
+			conn->ticket->len = 0;
+		} else {
+			memcpy(conn->ticket->data, ticket, len_ticket);
+			conn->ticket->len = len_ticket;
+			conn->ticket->expires = time(NULL) + ntohl(lifetime);
+		}
+	}
+
+	return 0;
+}
+
+/**
+ * @brief Exchanges the user resumption handshake messages with the host,
+ * presenting the resumption ticket of 'conn' instead of running SRP
+ * @param conn SIDP connection descriptor
+ * @return 0 on success, 1 if the ticket was rejected by the host (a full
+ * handshake follows), negative integer on error.
+ */
+static int sidp_seq_handshake_user_resume(struct sidpconn *conn) {
+	struct hs_data hello_data;
+	struct hs_data hs_data;
+	struct init_data init_data;
+	unsigned char nonce[SIDP_HANDSHAKE_NONCE_LEN];
+	unsigned char mac[SIDP_HANDSHAKE_MAC_LEN];
+
+	const unsigned char *field = NULL;
+	const unsigned char *mac_h = NULL;
+
+	size_t len_field = 0;
+	size_t len_mac = 0;
+	size_t mac_pos;
+
+	uint32_t flags;
+
+	/* SEND to Host: init data, support flags, username, ticket and nonce
+	 * (no bytes_A)
+	 */
+	init_data.conn_type = htons(conn->type);
+	init_data.sdev = htonl(conn->sdev);
+	init_data.ddev = htonl(conn->ddev);
+	init_data.sid = htonl(conn->sid);
+
+	if (sidp_rng_bytes(nonce, sizeof(nonce)) < 0)
+		return -2;
+
+	if (sidp_seq_handshake_put_init(&hello_data, &init_data, sidp_seq_negotiation_support_flags(conn)) < 0)
+		return -2;
+
+	if (sidp_seq_handshake_put_field(&hello_data, conn->user, strlen(conn->user)) < 0)
+		return -2;
+
+	if (sidp_seq_handshake_put_field(&hello_data, NULL, 0) < 0)
+		return -2;
+
+	if (sidp_seq_handshake_put_field(&hello_data, conn->ticket->data, conn->ticket->len) < 0)
+		return -2;
+
+	if (sidp_seq_handshake_put_field(&hello_data, nonce, sizeof(nonce)) < 0)
+		return -2;
+
+	if (sidp_seq_handshake_pkt_send(conn, &hello_data, SIDP_MSG_TYPE_INIT) < 0)
+		return -3;
+
+	/* RECV from Host: init reply, ticket flags, (empty bytes_s and bytes_B),
+	 * nonce and host MAC
+	 */
+	if (sidp_seq_handshake_pkt_recv(conn, &hs_data, SIDP_MSG_TYPE_INIT) < 0)
+		return -4;
+
+	if (sidp_seq_handshake_get_init(&hs_data, &init_data, &flags) < 0)
+		return -4;
+
+	if ((sidp_seq_handshake_get_field(&hs_data, &field, &len_field) < 0) || (sidp_seq_handshake_get_field(&hs_data, &field, &len_field) < 0))
+		return -4;
+
+	if (sidp_seq_handshake_get_field(&hs_data, &field, &len_field) < 0)
+		return -4;
+
+	mac_pos = hs_data.pos;
+
+	if (sidp_seq_handshake_get_field(&hs_data, &mac_h, &len_mac) < 0)
+		return -4;
+
+	/* An empty MAC means the ticket was rejected */
+	if (!len_mac)
+		return 1;
+
+	/* Validate init reply */
+	if (sidp_seq_init_user_validate(conn, &init_data) < 0)
+		return -5;
+
+	/* Set connection to initiated */
+	set_bit(&conn->status_flags, SIDP_INITIATED_FL);
+
+	/* Verify the host MAC */
+	if (sidp_seq_handshake_mac(conn, conn->ticket->secret, 'h', &hello_data, &hs_data, mac_pos, mac) < 0)
+		return -9;
+
+	if ((len_mac != sizeof(mac)) || CRYPTO_memcmp(mac_h, mac, sizeof(mac)))
+		return -9; /* Authentication failed */
+
+	/* SEND to Host: user MAC */
+	if (sidp_seq_handshake_mac(conn, conn->ticket->secret, 'u', &hello_data, &hs_data, hs_data.len, mac) < 0)
+		return -7;
+
+	hs_data.len = 0;
+
+	if (sidp_seq_handshake_put_field(&hs_data, mac, sizeof(mac)) < 0)
+		return -7;
+
+	if (sidp_seq_handshake_pkt_send(conn, &hs_data, SIDP_MSG_TYPE_AUTH) < 0)
+		return -7;
+
+	/* Set connection status to authenticated */
+	set_bit(&conn->status_flags, SIDP_AUTHENTICATED_FL);
+
+	/* Select the settings bound to the ticket */
+	if (sidp_seq_negotiation_set_flags(conn, flags & sidp_seq_negotiation_support_flags(conn)) < 0)
+		return -10;
+
+	return 0;
+}
+
+/**
+ * @brief Initializes user handshake sequence: init, authentication and
+ * negotiation in two round trips. If a valid resumption ticket is set on
+ * 'conn', it is presented instead of running SRP, in one round trip.
+ * @see sidp_conn_set_ticket()
+ * @param conn SIDP connection descriptor
+ * @param user User name
+ * @param pass Password
+ * @return 0 on success, negative integer on error.
+ */
+#ifdef COMPILE_WIN32
+DLLIMPORT
+#endif
+int sidp_seq_handshake_user(
+		struct sidpconn *conn,
+		const char *user,
+		const unsigned char *pass) {
+	struct SRPUser *usr;
+	int ret;
+
+	SRP_HashAlgorithm alg = SRP_SHA1;
+	SRP_NGType ng_type = SRP_NG_2048;
+
+	/* Check if the connection is already initiated */
+	if (test_bit(&conn->status_flags, SIDP_INITIATED_FL))
+		return -1;
+
+	/* Set connection username */
+	sidp_seq_handshake_set_str(conn->user, sizeof(conn->user), user);
+
+	/* Set connection key */
+	sidp_seq_handshake_set_str((char *) conn->key, sizeof(conn->key), (const char *) pass);
+
+	/* Present the resumption ticket, if still valid */
+	if (conn->ticket && conn->ticket->len && (conn->ticket->expires > time(NULL))) {
+		if ((ret = sidp_seq_handshake_user_resume(conn)) <= 0)
+			return ret;
+
+		/* Rejected by the host */
+		conn->ticket->len = 0;
+	}
+
+	/* Create a SRP user */
+	if (!(usr = srp_user_new(alg, ng_type, conn->user, pass, strlen((const char *) pass), NULL, NULL)))
+		return -1;
+
+	ret = sidp_seq_handshake_user_exchange(conn, usr);
+
+	srp_user_delete(usr);
+
+	return ret;
+}
+
+/**
+ * @brief Exchanges the host handshake sequence messages with the user, after
+ * the user HELLO message is processed
+ * @param conn SIDP connection descriptor
+ * @param ver SRP verifier
+ * @param hello_data HELLO message
+ * @param hello Decoded HELLO message, with the init reply and the crossed
+ * support flags
+ * @param bytes_s Salt
+ * @param len_s Length of 'bytes_s'
+ * @param bytes_B Host public ephemeral value (NULL if the SRP-6a safety check
+ * was violated)
+ * @param len_B Length of 'bytes_B'
+ * @return 0 on success, negative integer on error.
+ */
+static int sidp_seq_handshake_host_exchange(
+		struct sidpconn *conn,
+		struct SRPVerifier *ver,
+		const struct hs_data *hello_data,
+		const struct hs_hello *hello,
+		const unsigned char *bytes_s,
+		int len_s,
+		const unsigned char *bytes_B,
+		int len_B) {
+	unsigned char secret[SIDP_TICKET_SECRET_LEN];
+	unsigned char mac_h[SIDP_HANDSHAKE_MAC_LEN];
+	unsigned char mac[SIDP_HANDSHAKE_MAC_LEN];
+	struct hs_data hs_data;
+
+	const unsigned char *bytes_M = NULL;
+	const unsigned char *bytes_HAMK = NULL;
+	const unsigned char *session_key = NULL;
+	const unsigned char *mac_u = NULL;
+
+	size_t len_M = 0;
+	size_t len_mac = 0;
+	int len_key = 0;
+	int ret;
+
+	/* Verifier - SRP-6a Safety check */
+	if (!bytes_B)
+		return -4; /* Safety check violated */
+
+	/* SEND To User: init reply, crossed support flags, bytes_s, bytes_B
+	 * (and empty nonce and MAC fields)
+	 */
+	if (sidp_seq_handshake_put_challenge(&hs_data, hello, bytes_s, len_s, bytes_B, len_B) < 0)
+		return -5;
+
+	if ((sidp_seq_handshake_put_field(&hs_data, NULL, 0) < 0) || (sidp_seq_handshake_put_field(&hs_data, NULL, 0) < 0))
+		return -5;
+
+	if (sidp_seq_handshake_pkt_send(conn, &hs_data, SIDP_MSG_TYPE_INIT) < 0)
+		return -5;
+
+	/* The confirmation MACs cover the HELLO and CHALLENGE messages, as
+	 * received and sent by this end-point
+	 */
+	session_key = srp_verifier_get_session_key(ver, &len_key);
+
+	if (sidp_seq_handshake_secret(session_key, len_key, "sidp confirmation", secret) < 0)
+		return -6;
+
+	ret = sidp_seq_handshake_mac(conn, secret, 'u', hello_data, &hs_data, hs_data.len, mac);
+
+	if (!ret)
+		ret = sidp_seq_handshake_mac(conn, secret, 'h', hello_data, &hs_data, hs_data.len, mac_h);
+
+	memset(secret, 0, sizeof(secret));
+
+	if (ret < 0)
+		return -6;
+
+	/* RECV From User: bytes_M, user MAC */
+	if (sidp_seq_handshake_pkt_recv(conn, &hs_data, SIDP_MSG_TYPE_AUTH) < 0)
+		return -6;
+
+	if (sidp_seq_handshake_get_field(&hs_data, &bytes_M, &len_M) < 0)
+		return -6;
+
+	if (sidp_seq_handshake_get_field(&hs_data, &mac_u, &len_mac) < 0)
+		return -6;
+
+	/* Verify authentication */
+	if (len_M != (size_t) srp_verifier_get_session_key_length(ver))
+		return -7;
+
+	srp_verifier_verify_session(ver, bytes_M, &bytes_HAMK);
+
+	if (!bytes_HAMK)
+		return -7; /* Authentication failed */
+
+	/* Verify that the user sent the same HELLO and got the same CHALLENGE */
+	if ((len_mac != sizeof(mac)) || CRYPTO_memcmp(mac_u, mac, sizeof(mac)))
+		return -7; /* Authentication failed */
+
+	/* Set connection status to authenticated */
+	set_bit(&conn->status_flags, SIDP_AUTHENTICATED_FL);
+
+	/* SEND to User: bytes_HAMK, host MAC, resumption ticket and its
+	 * lifetime
+	 */
+	hs_data.len = 0;
+
+	if (sidp_seq_handshake_put_field(&hs_data, bytes_HAMK, len_M) < 0)
+		return -8;
+
+	if (sidp_seq_handshake_put_field(&hs_data, mac_h, sizeof(mac_h)) < 0)
+		return -8;
+
+	if (sidp_seq_handshake_secret(session_key, len_key, "sidp resumption", secret) < 0)
+		return -8;
+
+	ret = sidp_seq_handshake_ticket_issue(conn, &hs_data, hello->flags, secret);
+
+	memset(secret, 0, sizeof(secret));
+
+	if (ret < 0)
+		return -8;
+
+	if (sidp_seq_handshake_pkt_send(conn, &hs_data, SIDP_MSG_TYPE_AUTH) < 0)
+		return -8;
+
+	/* Select the settings of the connection. The packets following the
+	 * VERIFY message use them.
+	 */
+	if (sidp_seq_negotiation_set_flags(conn, hello->flags) < 0)
+		return -9;
+
+	return 0;
+}
+
+/**
+ * @brief Exchanges the host resumption handshake messages with the user,
+ * after the user HELLO message and its ticket are validated
+ * @param conn SIDP connection descriptor
+ * @param hello_data HELLO message
+ * @param hello Decoded HELLO message, with the init reply
+ * @param ticket Contents of the resumption ticket
+ * @return 0 on success, negative integer on error.
+ */
+static int sidp_seq_handshake_host_resume(
+		struct sidpconn *conn,
+		const struct hs_data *hello_data,
+		const struct hs_hello *hello,
+		const struct hs_ticket *ticket) {
+	struct hs_data hs_data;
+	struct hs_hello reply = *hello;
+	unsigned char nonce[SIDP_HANDSHAKE_NONCE_LEN];
+	unsigned char mac[SIDP_HANDSHAKE_MAC_LEN];
+
+	const unsigned char *mac_u = NULL;
+
+	size_t len_mac = 0;
+
+	/* The settings bound to the ticket are reused */
+	reply.flags = ticket->flags;
+
+	/* SEND to User: init reply, ticket flags, (empty bytes_s and bytes_B),
+	 * nonce and host MAC
+	 */
+	if (sidp_rng_bytes(nonce, sizeof(nonce)) < 0)
+		return -5;
+
+	if (sidp_seq_handshake_put_challenge(&hs_data, &reply, NULL, 0, NULL, 0) < 0)
+		return -5;
+
+	if (sidp_seq_handshake_put_field(&hs_data, nonce, sizeof(nonce)) < 0)
+		return -5;
+
+	if (sidp_seq_handshake_mac(conn, ticket->secret, 'h', hello_data, &hs_data, hs_data.len, mac) < 0)
+		return -5;
+
+	if (sidp_seq_handshake_put_field(&hs_data, mac, sizeof(mac)) < 0)
+		return -5;
+
+	if (sidp_seq_handshake_pkt_send(conn, &hs_data, SIDP_MSG_TYPE_INIT) < 0)
+		return -5;
+
+	/* The user MAC covers the whole CHALLENGE message */
+	if (sidp_seq_handshake_mac(conn, ticket->secret, 'u', hello_data, &hs_data, hs_data.len, mac) < 0)
+		return -6;
+
+	/* RECV From User: user MAC */
+	if (sidp_seq_handshake_pkt_recv(conn, &hs_data, SIDP_MSG_TYPE_AUTH) < 0)
+		return -6;
+
+	if (sidp_seq_handshake_get_field(&hs_data, &mac_u, &len_mac) < 0)
+		return -6;
+
+	if ((len_mac != sizeof(mac)) || CRYPTO_memcmp(mac_u, mac, sizeof(mac)))
+		return -7; /* Authentication failed */
+
+	/* Set connection status to authenticated */
+	set_bit(&conn->status_flags, SIDP_AUTHENTICATED_FL);
+
+	/* Select the settings of the connection */
+	if (sidp_seq_negotiation_set_flags(conn, ticket->flags) < 0)
+		return -9;
+
+	return 0;
+}
+
+/**
+ * @brief Initializes host handshake sequence
+ * @param conn SIDP connection descriptor
+ * @param user Expected User name (ignored if 'get_password' is set)
+ * @param pass Password (ignored if 'get_password' is set)
+ * @param get_password A function pointer to a function that gets the user
+ * password, or NULL.
+ * @return 0 on success, negative integer on error.
+ */
+static int sidp_seq_handshake_host_common(
+		struct sidpconn *conn,
+		const char *user,
+		const unsigned char *pass,
+		int (*get_password) (const char *, unsigned char *, size_t)) {
+	unsigned char pass_buf[SIDP_KEY_MAX_LEN + 1];
+	struct SRPVerifier *ver;
+	struct hs_data hello_data;
+	struct hs_data hs_data;
+	struct hs_hello hello;
+	struct hs_ticket ticket;
+
+	const unsigned char *bytes_s = NULL;
+	const unsigned char *bytes_v = NULL;
+	const unsigned char *bytes_B = NULL;
+
+	int len_s = 0;
+	int len_v = 0;
+	int len_B = 0;
+
+	int rejected = 0;
+	int ret;
+
+	SRP_HashAlgorithm alg = SRP_SHA1;
+	SRP_NGType ng_type = SRP_NG_2048;
+
+	/* Check if the connection is already initiated */
+	if (test_bit(&conn->status_flags, SIDP_INITIATED_FL))
+		return -1;
+
+	for (;;) {
+		/* RECV From User: init data, support flags, username, bytes_A,
+		 * ticket and nonce
+		 */
+		if (sidp_seq_handshake_pkt_recv(conn, &hello_data, SIDP_MSG_TYPE_INIT) < 0)
+			return -1;
+
+		if (sidp_seq_handshake_get_hello(&hello_data, &hello) < 0)
+			return -1;
+
+		/* Set connection fields and compose the init reply */
+		if (sidp_seq_init_host_process(conn, &hello.init_data) < 0)
+			return -2;
+
+		/* Get user password */
+		if (get_password) {
+			if (get_password(hello.username, pass_buf, sizeof(pass_buf) - 1) < 0)
+				return -3;
+
+			/* Ensure null termination for safe strlen() usage */
+			pass_buf[sizeof(pass_buf) - 1] = 0;
+
+			pass = pass_buf;
+		} else if (strcmp(hello.username, user)) {
+			return -3;
+		}
+
+		/* Set connection username */
+		sidp_seq_handshake_set_str(conn->user, sizeof(conn->user), hello.username);
+
+		/* Set connection key */
+		sidp_seq_handshake_set_str((char *) conn->key, sizeof(conn->key), (const char *) pass);
+
+		/* Set connection to initiated */
+		set_bit(&conn->status_flags, SIDP_INITIATED_FL);
+
+		/* Cross support flags of both end-points */
+		hello.flags &= sidp_seq_negotiation_support_flags(conn);
+
+		/* A full handshake carries bytes_A */
+		if (hello.len_A)
+			break;
+
+		/* Resumption, on the first HELLO message only */
+		if (rejected)
+			return -1;
+
+		if (!sidp_seq_handshake_ticket_open(conn, &hello, &ticket)) {
+			ret = sidp_seq_handshake_host_resume(conn, &hello_data, &hello, &ticket);
+
+			memset(&ticket, 0, sizeof(ticket));
+
+			return ret;
+		}
+
+		/* Reject the ticket: empty bytes_s, bytes_B, nonce and MAC. The
+		 * user follows with a full handshake.
+		 */
+		if (sidp_seq_handshake_put_challenge(&hs_data, &hello, NULL, 0, NULL, 0) < 0)
+			return -5;
+
+		if ((sidp_seq_handshake_put_field(&hs_data, NULL, 0) < 0) || (sidp_seq_handshake_put_field(&hs_data, NULL, 0) < 0))
+			return -5;
+
+		if (sidp_seq_handshake_pkt_send(conn, &hs_data, SIDP_MSG_TYPE_INIT) < 0)
+			return -5;
+
+		clear_bit(&conn->status_flags, SIDP_INITIATED_FL);
+
+		rejected = 1;
+	}
+
+	/* Get the salted verification key from the verifier store, or create it */
+	if (sidp_vstore_verifier(conn->vstore, conn->user, pass, &bytes_s, &len_s, &bytes_v, &len_v) < 0)
+		return -10;
+
+	/* Create a SRP verifier */
+	ver = srp_verifier_new(alg, ng_type, conn->user, bytes_s, len_s, bytes_v, len_v, hello.bytes_A, hello.len_A, &bytes_B, &len_B, NULL, NULL);
+
+	ret = sidp_seq_handshake_host_exchange(conn, ver, &hello_data, &hello, bytes_s, len_s, bytes_B, len_B);
+
+	srp_verifier_delete(ver);
+	free((void *) bytes_s);
+	free((void *) bytes_v);
+
+	return ret;
+}
+
+/**
+ * @brief Initializes host handshake sequence: init, authentication and
+ * negotiation in two round trips, or one if the user presents a valid
+ * resumption ticket
+ * @see sidp_conn_set_ticket_key()
+ * @param conn SIDP connection descriptor
+ * @param user Expected User name
+ * @param pass Password
+ * @return 0 on success, negative integer on error.
+ */
+#ifdef COMPILE_WIN32
+DLLIMPORT
+#endif
+int sidp_seq_handshake_host(
+		struct sidpconn *conn,
+		const char *user,
+		const unsigned char *pass) {
+	return sidp_seq_handshake_host_common(conn, user, pass, NULL);
+}
+
+/**
+ * @brief Initializes host handshake sequence: init, authentication and
+ * negotiation in two round trips, or one if the user presents a valid
+ * resumption ticket
+ * @see sidp_conn_set_ticket_key()
+ * @param conn SIDP connection descriptor
+ * @param get_password A function pointer to a function that gets the user
+ * password.
+ * @return 0 on success, negative integer on error.
+ */
+#ifdef COMPILE_WIN32
+DLLIMPORT
+#endif
+int sidp_seq_handshake_host_c(
+		struct sidpconn *conn,
+		int (*get_password) (const char *, unsigned char *, size_t)) {
+	return sidp_seq_handshake_host_common(conn, NULL, NULL, get_password);
+}
+
+/**
+ * @brief Initializes the key used by the host to issue and open resumption
+ * tickets
+ * @see sidp_conn_set_ticket_key()
+ * @param ticket_key Ticket key
+ * @param key_data The data used to derive the key (eg. shared by the hosts
+ * of a cluster), or NULL for a random key
+ * @param lifetime Lifetime of the issued tickets, in seconds
+ * @return 0 on success, -1 on error.
+ */
+#ifdef COMPILE_WIN32
+DLLIMPORT
+#endif
+int sidp_ticket_key_init(
+		struct sidp_ticket_key *ticket_key,
+		const unsigned char *key_data,
+		unsigned int lifetime) {
+	struct el_data eld;
+
+	memset(ticket_key, 0, sizeof(struct sidp_ticket_key));
+
+	ticket_key->lifetime = lifetime;
+
+	if (!key_data)
+		return sidp_rng_bytes(ticket_key->key, sizeof(ticket_key->key));
+
+	if (el_data_init(&eld, EL_CIPHER_TYPE_CHACHA20_POLY1305) < 0)
+		return -1;
+
+	return eld.create_key(key_data, ticket_key->key);
+}
@@ -108,6 +108,50 @@ static int sidp_seq_init_pkt_recv(
 	return 0;
 }
 
+/**
+ * @brief Validates the init sequence reply 'init_data' of the remote host
+ * against the settings of 'conn'
+ * @see sidp_seq_init_user()
+ * @param conn SIDP connection descriptor
+ * @param init_data Init sequence data received from the host (network order)
+ * @return 0 if valid, negative integer otherwise.
+ */
+#ifdef COMPILE_WIN32
+DLLIMPORT
+#endif
+int sidp_seq_init_user_validate(
+		const struct sidpconn *conn,
+		const struct init_data *init_data) {
+	/* Validate data */
+	if (conn->sid != ntohl(init_data->sid))
+		return -3;
+
+	/* Validate connection type and device id fields */
+	if (conn->type == SIDP_CONN_TYPE_NORMAL) {
+		if (conn->sdev != ntohl(init_data->ddev))
+			return -4;
+
+		if (conn->ddev != ntohl(init_data->sdev))
+			return -5;
+	} else if (conn->type == SIDP_CONN_TYPE_PERSISTENT) {
+		if (conn->sdev != ntohl(init_data->ddev))
+			return -6;
+
+		if (conn->ddev != ntohl(init_data->sdev))
+			return -7;
+	} else if (conn->type == SIDP_CONN_TYPE_ROUTING) {
+		if (conn->ddev != ntohl(init_data->ddev))
+			return -8;
+
+		if (conn->sdev != ntohl(init_data->sdev))
+			return -9;
+	} else {
+		return -10;
+	}
+
+	return 0;
+}
+
 /**
  * @brief Initializes user init sequence
  * @param conn SIDP connection descriptor
@@ -117,6 +161,7 @@ DLLIMPORT
 #endif
 int sidp_seq_init_user(struct sidpconn *conn) {
 	struct init_data init_data;
+	int ret;
 
 	/* Compose data to be sent */
 	init_data.conn_type = htons(conn->type);
@@ -133,36 +178,53 @@ int sidp_seq_init_user(struct sidpconn *conn) {
 		return -2;
 
 	/* Validate data */
-	if (conn->sid != ntohl(init_data.sid))
-		return -3;
+	if ((ret = sidp_seq_init_user_validate(conn, &init_data)) < 0)
+		return ret;
 
-	/* Validate connection type and device id fields */
-	if (conn->type == SIDP_CONN_TYPE_NORMAL) {
-		if (conn->sdev != ntohl(init_data.ddev))
-			return -4;
+	/* Set connection to initiated */
+	set_bit(&conn->status_flags, SIDP_INITIATED_FL);
 
-		if (conn->ddev != ntohl(init_data.sdev))
-			return -5;
-	} else if (conn->type == SIDP_CONN_TYPE_PERSISTENT) {
-		if (conn->sdev != ntohl(init_data.ddev))
-			return -6;
+	/* Everything is ok */
+	return 0;
+}
 
-		if (conn->ddev != ntohl(init_data.sdev))
-			return -7;
-	} else if (conn->type == SIDP_CONN_TYPE_ROUTING) {
-		if (conn->ddev != ntohl(init_data.ddev))
-			return -8;
+/**
+ * @brief Sets the connection type, session and device ids of 'conn' from the
+ * init sequence request 'init_data' of the remote user, and turns it into the
+ * reply to be sent back for validation
+ * @see sidp_seq_init_host()
+ * @param conn SIDP connection descriptor
+ * @param init_data Init sequence data received from the user, replaced by the
+ * reply (network order)
+ * @return 0 on success, negative integer on error.
+ */
+#ifdef COMPILE_WIN32
+DLLIMPORT
+#endif
+int sidp_seq_init_host_process(
+		struct sidpconn *conn,
+		struct init_data *init_data) {
+	conn->type = ntohs(init_data->conn_type);
+	conn->sid = ntohl(init_data->sid);
 
-		if (conn->sdev != ntohl(init_data.sdev))
-			return -9;
+	/* Validate connection type and set device id fields */
+	if (conn->type == SIDP_CONN_TYPE_NORMAL) {
+		conn->ddev = ntohl(init_data->sdev);
+	} else if (conn->type == SIDP_CONN_TYPE_PERSISTENT) {
+		conn->ddev = ntohl(init_data->sdev);
+	} else if (conn->type == SIDP_CONN_TYPE_ROUTING) {
+		conn->ddev = ntohl(init_data->ddev);
+		conn->sdev = ntohl(init_data->sdev);
 	} else {
-		return -10;
+		return -2;
 	}
 
-	/* Set connection to initiated */
-	set_bit(&conn->status_flags, SIDP_INITIATED_FL);
+	/* Reply for validation */
+	init_data->sdev = htonl(conn->sdev);
+	init_data->ddev = htonl(conn->ddev);
+	init_data->sid = htonl(conn->sid);
+	init_data->conn_type = htons(conn->type);
 
-	/* Everything is ok */
 	return 0;
 }
 
@@ -180,26 +242,9 @@ int sidp_seq_init_host(struct sidpconn *conn) {
 	if (sidp_seq_init_pkt_recv(conn, &init_data) < 0)
 		return -1;
 
-	conn->type = ntohs(init_data.conn_type);
-	conn->sid = ntohl(init_data.sid);
-
-	/* Validate connection type and set device id fields */
-	if (conn->type == SIDP_CONN_TYPE_NORMAL) {
-		conn->ddev = ntohl(init_data.sdev);
-	} else if (conn->type == SIDP_CONN_TYPE_PERSISTENT) {
-		conn->ddev = ntohl(init_data.sdev);
-	} else if (conn->type == SIDP_CONN_TYPE_ROUTING) {
-		conn->ddev = ntohl(init_data.ddev);
-		conn->sdev = ntohl(init_data.sdev);
-	} else {
+	/* Set connection fields and compose the reply */
+	if (sidp_seq_init_host_process(conn, &init_data) < 0)
 		return -2;
-	}
-
-	/* Reply for validation */
-	init_data.sdev = htonl(conn->sdev);
-	init_data.ddev = htonl(conn->ddev);
-	init_data.sid = htonl(conn->sid);
-	init_data.conn_type = htons(conn->type);
 
 	/* Send packet back */
 	if (sidp_seq_init_pkt_send(conn, &init_data) < 0)
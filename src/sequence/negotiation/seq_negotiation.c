@@ -109,74 +109,205 @@ static int sidp_seq_negotiation_pkt_recv(
 }
 
 /**
- * @brief Initializes user negotiation sequence
+ * @brief Gets the support flags to be announced (or crossed) for 'conn'
+ *
+ * All ChaCha cipher types share the same runtime selected implementation, so
+ * supporting any of them means supporting all of them. The ChaCha-AVX and
+ * ChaCha-AVX2 flags are kept as aliases, letting peers that only know one of
+ * those still agree on a ChaCha cipher.
+ *
  * @param conn SIDP connection descriptor
+ * @return The support flags of 'conn', with the ChaCha aliases expanded.
  */
 #ifdef COMPILE_WIN32
 DLLIMPORT
 #endif
-int sidp_seq_negotiation_user(struct sidpconn *conn) {
-	struct neg_data neg_data;
+uint32_t sidp_seq_negotiation_support_flags(const struct sidpconn *conn) {
+	uint32_t flags = conn->support_flags;
+#ifndef COMPILE_WIN32
+	uint32_t chacha_flags = 0;
 
-	/* Check if the connection is initiated */
-	if (!test_bit(&conn->status_flags, SIDP_INITIATED_FL))
-		return -1;
+	set_bit(&chacha_flags, SIDP_SUPPORT_CIPHER_CHACHA_FL);
+	set_bit(&chacha_flags, SIDP_SUPPORT_CIPHER_CHACHA_AVX_FL);
+	set_bit(&chacha_flags, SIDP_SUPPORT_CIPHER_CHACHA_AVX2_FL);
 
-	/* Check if the connection is authenticated */
-	if (!test_bit(&conn->status_flags, SIDP_AUTHENTICATED_FL))
-		return -2;
+	if (flags & chacha_flags)
+		flags |= chacha_flags;
+#endif
 
-	/* Send support flags to remote host */
-	neg_data.flags = htonl(conn->support_flags);
+	return flags;
+}
 
-	if (sidp_seq_negotiation_pkt_send(conn, &neg_data) < 0)
-		return -3;
+/**
+ * @brief Enables adaptive compression if supported by both end-points
+ * @param conn SIDP connection descriptor
+ * @param flags Crossed support flags of both end-points
+ */
+static void sidp_seq_negotiation_adaptive(
+		struct sidpconn *conn,
+		uint32_t flags) {
+	uint32_t compress_types = 0;
 
-	/* Receive support flags of the remote host based on the sent
-	 * support flags
-	 */
-	if (sidp_seq_negotiation_pkt_recv(conn, &neg_data) < 0)
-		return -4;
+	if (!test_bit(&flags, SIDP_SUPPORT_COMPRESS_ADAPTIVE_FL))
+		return;
 
-	neg_data.flags = ntohl(neg_data.flags);
+	/* Schema driven telemetry compression takes precedence */
+	if (test_bit(&conn->negotiate_flags, SIDP_NEGOTIATE_COMPRESS_TELEMETRY_FL))
+		return;
+
+	/* Gather the codecs both end-points are able to decompress */
+	if (test_bit(&flags, SIDP_SUPPORT_COMPRESS_LZ4_FL))
+		compress_types |= 1 << CL_COMPRESS_TYPE_LZ4;
+
+	if (test_bit(&flags, SIDP_SUPPORT_COMPRESS_LZO_FL))
+		compress_types |= 1 << CL_COMPRESS_TYPE_LZO;
+
+	if (test_bit(&flags, SIDP_SUPPORT_COMPRESS_FASTLZ_FL))
+		compress_types |= 1 << CL_COMPRESS_TYPE_FASTLZ;
 
-	/* Test compression negotiation */
-	if (test_bit(&neg_data.flags, SIDP_SUPPORT_COMPRESS_LZO_FL)) {
+#ifndef COMPILE_WIN32
+	if (test_bit(&flags, SIDP_SUPPORT_COMPRESS_ZLIB_FL))
+		compress_types |= 1 << CL_COMPRESS_TYPE_ZLIB;
+#endif
+
+	if (cl_adaptive_init(&conn->cl_adaptive, compress_types) < 0)
+		return;
+
+	set_bit(&conn->negotiate_flags, SIDP_NEGOTIATE_COMPRESS_ADAPTIVE_FL);
+}
+
+/**
+ * @brief Sets the negotiate flags of 'conn' from the crossed support flags
+ * 'flags' of both end-points, and its status to negotiated
+ * @see sidp_seq_negotiation_support_flags()
+ * @param conn SIDP connection descriptor
+ * @param flags Crossed support flags of both end-points (host order)
+ * @return 0 on success, negative integer if no compression (-5), cipher (-6)
+ * or encapsulation (-7) type is supported by both end-points.
+ */
+#ifdef COMPILE_WIN32
+DLLIMPORT
+#endif
+int sidp_seq_negotiation_set_flags(
+		struct sidpconn *conn,
+		uint32_t flags) {
+	/* Test compression negotiation. Telemetry compression is only selected
+	 * if a record schema is registered on the connection, and a general
+	 * compressor is still negotiated for the messages sent without it.
+	 */
+	if (test_bit(&flags, SIDP_SUPPORT_COMPRESS_TELEMETRY_FL) && conn->cl_schema.count)
+		set_bit(&conn->negotiate_flags, SIDP_NEGOTIATE_COMPRESS_TELEMETRY_FL);
+
+	if (test_bit(&flags, SIDP_SUPPORT_COMPRESS_LZ4_FL)) {
+		set_bit(&conn->negotiate_flags, SIDP_NEGOTIATE_COMPRESS_LZ4_FL);
+	} else if (test_bit(&flags, SIDP_SUPPORT_COMPRESS_LZO_FL)) {
 		set_bit(&conn->negotiate_flags, SIDP_NEGOTIATE_COMPRESS_LZO_FL);
-	} else if (test_bit(&neg_data.flags, SIDP_SUPPORT_COMPRESS_FASTLZ_FL)) {
+	} else if (test_bit(&flags, SIDP_SUPPORT_COMPRESS_FASTLZ_FL)) {
 		set_bit(&conn->negotiate_flags, SIDP_NEGOTIATE_COMPRESS_FASTLZ_FL);
-	} else if (test_bit(&neg_data.flags, SIDP_SUPPORT_COMPRESS_ZLIB_FL)) {
+	} else if (test_bit(&flags, SIDP_SUPPORT_COMPRESS_ZLIB_FL)) {
 		set_bit(&conn->negotiate_flags, SIDP_NEGOTIATE_COMPRESS_ZLIB_FL);
-	} else {
+	} else if (!test_bit(&conn->negotiate_flags, SIDP_NEGOTIATE_COMPRESS_TELEMETRY_FL)) {
 		return -5;
 	}
 
-	/* Test encryption negotiation */
-	if (test_bit(&neg_data.flags, SIDP_SUPPORT_CIPHER_XSALSA20_FL)) {
+	/* Test encryption negotiation. The null cipher types are only present
+	 * in the crossed flags if both end-points explicitly enabled them, and
+	 * then take precedence (the link is trusted by both sides).
+	 */
+	if (test_bit(&flags, SIDP_SUPPORT_CIPHER_NONE_MAC_FL)) {
+		set_bit(&conn->negotiate_flags, SIDP_NEGOTIATE_CIPHER_NONE_MAC_FL);
+	} else if (test_bit(&flags, SIDP_SUPPORT_CIPHER_NONE_FL)) {
+		set_bit(&conn->negotiate_flags, SIDP_NEGOTIATE_CIPHER_NONE_FL);
+	} else if (test_bit(&flags, SIDP_SUPPORT_CIPHER_AES256_GCM_FL)) {
+		set_bit(&conn->negotiate_flags, SIDP_NEGOTIATE_CIPHER_AES256_GCM_FL);
+	} else if (test_bit(&flags, SIDP_SUPPORT_CIPHER_CHACHA20_POLY1305_FL)) {
+		set_bit(&conn->negotiate_flags, SIDP_NEGOTIATE_CIPHER_CHACHA20_POLY1305_FL);
+	} else if (test_bit(&flags, SIDP_SUPPORT_CIPHER_XSALSA20_FL)) {
 		set_bit(&conn->negotiate_flags, SIDP_NEGOTIATE_CIPHER_XSALSA20_FL);
-	} else if (test_bit(&neg_data.flags, SIDP_SUPPORT_CIPHER_CHACHA_AVX_FL)) {
+	} else if (test_bit(&flags, SIDP_SUPPORT_CIPHER_CHACHA_FL)) {
+		set_bit(&conn->negotiate_flags, SIDP_NEGOTIATE_CIPHER_CHACHA_FL);
+	} else if (test_bit(&flags, SIDP_SUPPORT_CIPHER_CHACHA_AVX_FL)) {
 		set_bit(&conn->negotiate_flags, SIDP_NEGOTIATE_CIPHER_CHACHA_AVX_FL);
-	} else if (test_bit(&neg_data.flags, SIDP_SUPPORT_CIPHER_CHACHA_AVX2_FL)) {
+	} else if (test_bit(&flags, SIDP_SUPPORT_CIPHER_CHACHA_AVX2_FL)) {
 		set_bit(&conn->negotiate_flags, SIDP_NEGOTIATE_CIPHER_CHACHA_AVX2_FL);
-	} else if (test_bit(&neg_data.flags, SIDP_SUPPORT_CIPHER_AES256_FL)) {
+	} else if (test_bit(&flags, SIDP_SUPPORT_CIPHER_AES256_FL)) {
 		set_bit(&conn->negotiate_flags, SIDP_NEGOTIATE_CIPHER_AES256_FL);
 	} else {
 		return -6;
 	}
 
 	/* Test encapsulation negotiation */
-	if (test_bit(&neg_data.flags, SIDP_SUPPORT_ENCAP_DEFAULT_FL)) {
+	if (test_bit(&flags, SIDP_SUPPORT_ENCAP_DEFAULT_FL)) {
 		set_bit(&conn->negotiate_flags, SIDP_NEGOTIATE_ENCAP_DEFAULT_FL);
 	} else {
 		return -7;
 	}
 
+	/* Test compact framing negotiation (optional). The packets following
+	 * the negotiation sequence carry a compact description header and the
+	 * session identifiers are elided from data packets.
+	 */
+	if (test_bit(&flags, SIDP_SUPPORT_ENCAP_COMPACT_FL))
+		set_bit(&conn->negotiate_flags, SIDP_NEGOTIATE_ENCAP_COMPACT_FL);
+
+	/* Test adaptive compression negotiation (optional) */
+	sidp_seq_negotiation_adaptive(conn, flags);
+
+	/* Test counter nonce negotiation (optional) */
+	if (test_bit(&flags, SIDP_SUPPORT_NONCE_COUNTER_FL))
+		set_bit(&conn->negotiate_flags, SIDP_NEGOTIATE_NONCE_COUNTER_FL);
+
 	/* Set status to negotiated */
 	set_bit(&conn->status_flags, SIDP_NEGOTIATED_FL);
 
 	return 0;
 }
 
+/**
+ * @brief Initializes user negotiation sequence
+ * @param conn SIDP connection descriptor
+ */
+#ifdef COMPILE_WIN32
+DLLIMPORT
+#endif
+int sidp_seq_negotiation_user(struct sidpconn *conn) {
+	struct neg_data neg_data;
+	int ret;
+
+	/* Check if the connection is initiated */
+	if (!test_bit(&conn->status_flags, SIDP_INITIATED_FL))
+		return -1;
+
+	/* Check if the connection is authenticated */
+	if (!test_bit(&conn->status_flags, SIDP_AUTHENTICATED_FL))
+		return -2;
+
+	/* Send support flags to remote host */
+	neg_data.flags = htonl(sidp_seq_negotiation_support_flags(conn));
+
+	if (sidp_seq_negotiation_pkt_send(conn, &neg_data) < 0)
+		return -3;
+
+	/* Receive support flags of the remote host based on the sent
+	 * support flags
+	 */
+	if (sidp_seq_negotiation_pkt_recv(conn, &neg_data) < 0)
+		return -4;
+
+	neg_data.flags = ntohl(neg_data.flags);
+
+	/* The reply isn't authenticated: never accept a setting (such as a
+	 * null cipher type) this end-point doesn't support
+	 */
+	neg_data.flags &= sidp_seq_negotiation_support_flags(conn);
+
+	/* Select the settings of the connection */
+	if ((ret = sidp_seq_negotiation_set_flags(conn, neg_data.flags)) < 0)
+		return ret;
+
+	return 0;
+}
+
 /**
  * @brief Initializes host negotiation sequence
  * @param conn SIDP connection descriptor
@@ -186,6 +317,7 @@ DLLIMPORT
 #endif
 int sidp_seq_negotiation_host(struct sidpconn *conn) {
 	struct neg_data neg_data;
+	int ret;
 
 	/* Check if the connection is initiated */
 	if (!test_bit(&conn->status_flags, SIDP_INITIATED_FL))
@@ -202,7 +334,7 @@ int sidp_seq_negotiation_host(struct sidpconn *conn) {
 	neg_data.flags = ntohl(neg_data.flags);
 
 	/* Cross support flags of both end-points */
-	neg_data.flags &= conn->support_flags;
+	neg_data.flags &= sidp_seq_negotiation_support_flags(conn);
 
 	neg_data.flags = htonl(neg_data.flags);
 
@@ -212,39 +344,9 @@ int sidp_seq_negotiation_host(struct sidpconn *conn) {
 
 	neg_data.flags = ntohl(neg_data.flags);
 
-	/* Test compression negotiation */
-	if (test_bit(&neg_data.flags, SIDP_SUPPORT_COMPRESS_LZO_FL)) {
-		set_bit(&conn->negotiate_flags, SIDP_NEGOTIATE_COMPRESS_LZO_FL);
-	} else if (test_bit(&neg_data.flags, SIDP_SUPPORT_COMPRESS_FASTLZ_FL)) {
-		set_bit(&conn->negotiate_flags, SIDP_NEGOTIATE_COMPRESS_FASTLZ_FL);
-	} else if (test_bit(&neg_data.flags, SIDP_SUPPORT_COMPRESS_ZLIB_FL)) {
-		set_bit(&conn->negotiate_flags, SIDP_NEGOTIATE_COMPRESS_ZLIB_FL);
-	} else {
-		return -5;
-	}
-
-	/* Test encryption negotiation */
-	if (test_bit(&neg_data.flags, SIDP_SUPPORT_CIPHER_XSALSA20_FL)) {
-		set_bit(&conn->negotiate_flags, SIDP_NEGOTIATE_CIPHER_XSALSA20_FL);
-	} else if (test_bit(&neg_data.flags, SIDP_SUPPORT_CIPHER_CHACHA_AVX_FL)) {
-		set_bit(&conn->negotiate_flags, SIDP_NEGOTIATE_CIPHER_CHACHA_AVX_FL);
-	} else if (test_bit(&neg_data.flags, SIDP_SUPPORT_CIPHER_CHACHA_AVX2_FL)) {
-		set_bit(&conn->negotiate_flags, SIDP_NEGOTIATE_CIPHER_CHACHA_AVX2_FL);
-	} else if (test_bit(&neg_data.flags, SIDP_SUPPORT_CIPHER_AES256_FL)) {
-		set_bit(&conn->negotiate_flags, SIDP_NEGOTIATE_CIPHER_AES256_FL);
-	} else {
-		return -6;
-	}
-
-	/* Test encapsulation negotiation */
-	if (test_bit(&neg_data.flags, SIDP_SUPPORT_ENCAP_DEFAULT_FL)) {
-		set_bit(&conn->negotiate_flags, SIDP_NEGOTIATE_ENCAP_DEFAULT_FL);
-	} else {
-		return -7;
-	}
-
-	/* Set status to negotiated */
-	set_bit(&conn->status_flags, SIDP_NEGOTIATED_FL);
+	/* Select the settings of the connection */
+	if ((ret = sidp_seq_negotiation_set_flags(conn, neg_data.flags)) < 0)
+		return ret;
 
 	return 0;
 }
@@ -97,6 +97,11 @@ int sidp_pkt_raw_send(struct sidpconn *conn, void *buf, size_t len) {
 
 /**
  * @brief Receives a RAW packet from fd
+ *
+ * The packet is received as framed on 'conn', so if a compact framing was
+ * negotiated, the packet shall be forwarded through a connection that
+ * negotiated it as well.
+ *
  * @param fd The SIDP Connection structure
  * @param buf The buffer to were the packet will be written
  * @param len The size of the packet
@@ -107,20 +112,16 @@ DLLIMPORT
 #endif
 int sidp_pkt_raw_recv(struct sidpconn *conn, void *buf, size_t *len) {
 	uint32_t def_size;
-	int rlen;
+	int rlen, hdr_len;
 	char *raw_data = (char *) buf;
-	struct dl_hdr *dl_hdr = (struct dl_hdr *) raw_data;
+	struct dl_hdr dl_hdr;
 
 	/* Read the incoming description layer */
-	if ((rlen = sidp_read_nb(conn, dl_hdr, sizeof(struct dl_hdr))) < 0)
-		return -1;
-
-	/* If the read() size is different than the header size, return error */
-	if (rlen != sizeof(struct dl_hdr))
-		return -2;
+	if ((hdr_len = chain_in_read_hdr(conn, raw_data, &dl_hdr)) < 0)
+		return hdr_len;
 
 	/* decompose description header */
-	def_size = ntohs(dl_hdr->def_size);
+	def_size = dl_hdr.def_size;
 
 	/* if the deflate size, plus the session and descriptor headers,
 	 * is greter than SIDP_PKT_MAX_LEN, return error
@@ -129,11 +130,11 @@ int sidp_pkt_raw_recv(struct sidpconn *conn, void *buf, size_t *len) {
 		return -3;
 
 	/* Read the remaining packet data */
-	if ((rlen = sidp_read_nb(conn, raw_data + sizeof(struct dl_hdr), def_size)) < 0)
+	if ((rlen = sidp_read_nb(conn, raw_data + hdr_len, def_size)) < 0)
 		return -4;
 
 	/* Set total read bytes to 'len' and return */
-	return (*len = (def_size + sizeof(struct dl_hdr)));
+	return (*len = (def_size + hdr_len));
 }
 
 /**
@@ -154,6 +155,56 @@ int sidp_pkt_send(
 	return chain_out_dispatch(conn, pkt, opt);
 }
 
+/**
+ * @brief Sends a batch of packets, usually pending on different connections
+ *
+ * Same as calling sidp_pkt_send() for each element of 'send', in order, but
+ * the DATA packets of connections that negotiated counter nonces are
+ * encrypted together, so that servers flushing many short messages at once
+ * fill the SIMD lanes of the cipher with the blocks of several packets.
+ * Once a packet fails, the packets that follow it on the same connection
+ * aren't sent.
+ *
+ * @see sidp_pkt_send()
+ * @param send The packets to be sent. The 'ret' field of each of them is set
+ * to the value sidp_pkt_send() would have returned, or to -15 if an earlier
+ * packet of the same connection failed.
+ * @param count The number of packets
+ * @return Number of packets sent on success, -1 on error.
+ */
+#ifdef COMPILE_WIN32
+DLLIMPORT
+#endif
+int sidp_pkt_send_batch(struct sidpsend *send, unsigned int count) {
+	return chain_out_dispatch_batch(send, count);
+}
+
+/**
+ * @brief Sends a batch of packets, usually carrying the same message to many
+ * connections (publish)
+ *
+ * Same as calling sidp_pkt_send() for each element of 'send', in order, but
+ * the DATA packets whose 'msg' points to the same buffer are compressed once
+ * per codec and level. Those whose connections also share the cipher type and
+ * key (e.g. a group key), and don't use counter nonces, share one encrypted
+ * frame, written to each connection after its own headers and released after
+ * the last of them.
+ *
+ * @see sidp_pkt_send()
+ * @see sidp_pkt_send_batch()
+ * @param send The packets to be sent. The 'ret' field of each of them is set
+ * to the value sidp_pkt_send() would have returned, or to -15 if an earlier
+ * packet of the same connection failed.
+ * @param count The number of packets
+ * @return Number of packets sent on success, -1 on error.
+ */
+#ifdef COMPILE_WIN32
+DLLIMPORT
+#endif
+int sidp_pkt_send_fanout(struct sidpsend *send, unsigned int count) {
+	return chain_out_dispatch_fanout(send, count);
+}
+
 /**
  * @brief Receives a packet 'pkt' from 'conn' and fills 'opt'
  * @param conn The SIDP connection description structure
@@ -236,6 +287,76 @@ void sidp_conn_set_support_flags(struct sidpconn *conn, uint32_t flags) {
 	conn->support_flags = flags;
 }
 
+/**
+ * @brief Set the record schema used by the telemetry compression type on
+ * connection 'conn'. Both end-points shall register the same schema. The
+ * telemetry compression type is only selected if the schema is registered
+ * before the connection is negotiated.
+ * @see cl_telemetry_schema_init()
+ * @param conn SIDP Connection Settings
+ * @param types Array of field types (CL_TELEMETRY_FIELD_*)
+ * @param count Number of fields per record
+ * @return 0 on success, -1 on error.
+ */
+#ifdef COMPILE_WIN32
+DLLIMPORT
+#endif
+int sidp_conn_set_schema(
+		struct sidpconn *conn,
+		const uint8_t *types,
+		unsigned int count) {
+	return cl_telemetry_schema_init(&conn->cl_schema, types, count);
+}
+
+/**
+ * @brief Set the resumption ticket of the user connection 'conn'. A valid
+ * ticket is presented by sidp_seq_handshake_user() to skip the SRP exchange,
+ * and replaced by the one issued on a full handshake.
+ * @see sidp_seq_handshake_user()
+ * @param conn SIDP connection settings
+ * @param ticket Resumption ticket, kept by the caller between connections
+ * (zeroed before first use)
+ */
+#ifdef COMPILE_WIN32
+DLLIMPORT
+#endif
+void sidp_conn_set_ticket(struct sidpconn *conn, struct sidp_ticket *ticket) {
+	conn->ticket = ticket;
+}
+
+/**
+ * @brief Set the key used to issue and open resumption tickets on the host
+ * connection 'conn'
+ * @see sidp_ticket_key_init()
+ * @see sidp_seq_handshake_host()
+ * @param conn SIDP connection settings
+ * @param ticket_key Ticket key, shared by the host connections
+ */
+#ifdef COMPILE_WIN32
+DLLIMPORT
+#endif
+void sidp_conn_set_ticket_key(
+		struct sidpconn *conn,
+		const struct sidp_ticket_key *ticket_key) {
+	conn->ticket_key = ticket_key;
+}
+
+/**
+ * @brief Set the SRP verifier store of the host connection 'conn'. The host
+ * authentication sequences look the salt and verifier of the user up in the
+ * store instead of computing them from the password, which is still used as
+ * the connection key.
+ * @see sidp_vstore_set()
+ * @param conn SIDP connection settings
+ * @param vstore Verifier store, shared by the host connections
+ */
+#ifdef COMPILE_WIN32
+DLLIMPORT
+#endif
+void sidp_conn_set_vstore(struct sidpconn *conn, struct sidp_vstore *vstore) {
+	conn->vstore = vstore;
+}
+
 /**
  * @brief Destroy a SIDP connection refered by 'conn'
  * @param conn SIDP connection settings
@@ -248,6 +369,9 @@ int sidp_conn_close(struct sidpconn *conn) {
 
 	ret = close(conn->fd);
 
+	el_ctx_destroy(&conn->el_out);
+	el_ctx_destroy(&conn->el_in);
+
 	memset(conn, 0, sizeof(struct sidpconn));
 
 	conn->type = SIDP_CONN_TYPE_NONE;
@@ -25,6 +25,10 @@
 #include <stdio.h>
 #include <time.h>
 
+#ifdef COMPILE_POSIX
+#include <sys/uio.h>
+#endif
+
 #include "sidp.h"
 #include "skt.h"
 
@@ -78,3 +82,65 @@ int sidp_write_nb(struct sidpconn *conn, const void *buf, size_t len) {
 	return offset;
 }
 
+/**
+ * @brief A wrapper to writev() with non-blocking support. Writes 'hdr'
+ * followed by 'data' with a single system call, when possible, so that a
+ * buffer shared by several connections can be sent without copying it.
+ */
+int sidp_writev_nb(
+		struct sidpconn *conn,
+		const void *hdr,
+		size_t hdr_len,
+		const void *data,
+		size_t data_len) {
+#ifdef COMPILE_POSIX
+	struct iovec iov[2];
+	unsigned int i = 0;
+	int ret, offset = 0;
+
+	iov[0].iov_base = (void *) hdr;
+	iov[0].iov_len = hdr_len;
+	iov[1].iov_base = (void *) data;
+	iov[1].iov_len = data_len;
+
+	for (;;) {
+		/* Skip the buffers already written */
+		while ((i < 2) && !iov[i].iov_len)
+			i ++;
+
+		if (i == 2)
+			break;
+
+		ret = writev(conn->fd, &iov[i], 2 - i);
+
+		if (ret <= 0)
+			return -1;
+
+		conn->bytes_out += ret;
+		conn->last_fd_write = time(NULL);
+
+		offset += ret;
+
+		/* Advance past what was written */
+		for (; (i < 2) && (((size_t) ret) >= iov[i].iov_len); i ++)
+			ret -= iov[i].iov_len;
+
+		if (i < 2) {
+			iov[i].iov_base = ((char *) iov[i].iov_base) + ret;
+			iov[i].iov_len -= ret;
+		}
+	}
+
+	return offset;
+#elif defined(COMPILE_WIN32)
+	int hret, dret;
+
+	if ((hret = sidp_write_nb(conn, hdr, hdr_len)) < 0)
+		return -1;
+
+	if ((dret = sidp_write_nb(conn, data, data_len)) < 0)
+		return -1;
+
+	return hret + dret;
+#endif
+}
@@ -4,6 +4,16 @@
 #define crypto_stream_KEYBYTES 32
 #define crypto_stream_NONCEBYTES 24
 
+/* One message of a batch: the arguments of crypto_stream_xor_ic() */
+struct crypto_stream_job {
+        unsigned char *c;
+  const unsigned char *m;
+  unsigned long long mlen;
+  const unsigned char *n;
+  unsigned long long ic;
+  const unsigned char *k;
+};
+
 /* Prototypes */
 int crypto_stream_xor(
         unsigned char *c,
@@ -11,12 +21,30 @@ int crypto_stream_xor(
   const unsigned char *n,
   const unsigned char *k
 );
+/* Same as crypto_stream_xor(), starting at keystream block 'ic' */
+int crypto_stream_xor_ic(
+        unsigned char *c,
+  const unsigned char *m,unsigned long long mlen,
+  const unsigned char *n,unsigned long long ic,
+  const unsigned char *k
+);
+/*
+ * crypto_stream_xor_ic() of 'njobs' messages, with one block of a different
+ * message in each AVX2 lane. Consecutive jobs with the same nonce and key
+ * pointers (e.g. a one-time key followed by its message) share a subkey.
+ */
+int crypto_stream_xor_ic_batch(struct crypto_stream_job *jobs,unsigned int njobs);
 int crypto_core_hsalsa20(
         unsigned char *out,
   const unsigned char *in,
   const unsigned char *k,
   const unsigned char *c
 );
+int crypto_core_hsalsa20_batch(
+        unsigned char *out,
+  const unsigned char * const *in,
+  const unsigned char * const *k,unsigned int n
+);
 int crypto_core_salsa20(
         unsigned char *out,
   const unsigned char *in,
@@ -30,5 +58,12 @@ int crypto_stream_salsa20_xor(
   const unsigned char *k
 );
 
-#endif
+int crypto_stream_salsa20_xor_ic(
+        unsigned char *c,
+  const unsigned char *m,unsigned long long mlen,
+  const unsigned char *n,unsigned long long ic,
+  const unsigned char *k
+);
+int crypto_stream_salsa20_xor_ic_batch(struct crypto_stream_job *jobs,unsigned int njobs);
 
+#endif